@@ -181,7 +181,7 @@ macro (osl_add_all_tests)
     # List all the individual testsuite tests here, except those that need
     # special installed tests.
     TESTSUITE ( aastep allowconnect-err andor-reg and-or-not-synonyms
-                arithmetic area-reg arithmetic-reg
+                aot arithmetic area-reg arithmetic-reg
                 array array-reg array-copy-reg array-derivs array-range 
                 array-aassign array-assign-reg array-length-reg
                 bitwise-and-reg bitwise-or-reg bitwise-shl-reg  bitwise-shr-reg bitwise-xor-reg
@@ -189,33 +189,34 @@ macro (osl_add_all_tests)
                 bug-array-heapoffsets bug-locallifetime bug-outputinit
                 bug-param-duplicate bug-peep bug-return
                 calculatenormal-reg
-                cellnoise closure closure-array color color-reg comparison
+                cellnoise closure closure-array closure-static color color-reg comparison
                 complement-reg compile-buffer compassign-reg
                 component-range 
                 control-flow-reg connect-components
                 const-array-params const-array-fill
                 debugnan debug-uninit
-                derivs derivs-muldiv-clobber
+                derivs derivs-muldiv-clobber derivs-noderivs
                 draw_string
                 error-dupes error-serialized
                 example-deformer
                 exit exponential
                 filterwidth-reg
-                for-reg format-reg fprintf
+                for-reg format-reg fprintf fprintf-buffered
                 function-earlyreturn function-simple function-outputelem
                 function-overloads function-redef
                 geomath getattribute-camera getattribute-shader
                 getsymbol-nonheap gettextureinfo gettextureinfo-reg
-                group-outputs groupstring
+                group-dedup group-dedup-outputs group-outputs groupstring
                 hash hashnoise hex hyperb
-                ieee_fp if if-reg incdec initlist initops intbits isconnected
+                ieee_fp if if-reg incdec initlist initops instance-cow intbits isconnected
                 isconstant
                 layers layers-Ciassign layers-entry layers-lazy layers-lazyerror
                 layers-nonlazycopy layers-repeatedoutputs
-                length-reg linearstep
+                length-reg linearstep llvm-tier
                 logic loop luminance-reg
-                matrix matrix-reg matrix-arithmetic-reg
-                matrix-compref-reg max-reg message message-no-closure message-reg
+                matrix matrix-cache matrix-reg matrix-arithmetic-reg
+                matrix-compref-reg max-reg message message-dynamic
+                message-no-closure message-reg
                 mergeinstances-duplicate-entrylayers
                 mergeinstances-nouserdata mergeinstances-vararray
                 metadata-braces min-reg miscmath missing-shader
@@ -224,7 +225,7 @@ macro (osl_add_all_tests)
                 noise noise-cell
                 noise-gabor noise-gabor2d-filter noise-gabor3d-filter
                 noise-gabor-reg
-                noise-generic
+                noise-fractal noise-generic
                 noise-perlin noise-simplex
                 noise-reg
                 normalize-reg
@@ -236,6 +237,7 @@ macro (osl_add_all_tests)
                 oslc-comma oslc-D oslc-M
                 oslc-err-arrayindex oslc-err-assignmenttypes
                 oslc-err-closuremul oslc-err-field
+                oslc-buffer-cache
                 oslc-err-format oslc-err-funcoverload
                 oslc-err-intoverflow oslc-err-write-nonoutput
                 oslc-err-noreturn oslc-err-notfunc
@@ -247,25 +249,27 @@ macro (osl_add_all_tests)
                 oslc-err-unknown-ctr
                 oslc-pragma-warnerr
                 oslc-warn-commainit
-                oslc-variadic-macro
+                oslc-multifile oslc-variadic-macro
                 oslc-version
                 oslinfo-arrayparams oslinfo-colorctrfloat
-                oslinfo-metadata oslinfo-noparams
+                oslinfo-index oslinfo-metadata oslinfo-noparams
                 osl-imageio
                 paramval-floatpromotion
+                pool-usage
                 pragma-nowarn
                 printf-reg
                 printf-whole-array
                 raytype raytype-reg raytype-specialized regex-reg reparam
+                reparam-interactive
                 render-background render-bumptest
                 render-cornell render-furnace-diffuse
                 render-microfacet render-oren-nayar render-veachmis render-ward
-                select select-reg shaderglobals shortcircuit
-                smoothstep-reg 
+                select select-reg shadeimage shaderglobals shortcircuit
+                smoothstep-reg space-uniform-lanes
                 spline spline-reg splineinverse splineinverse-ident 
                 splineinverse-knots-ascend-reg splineinverse-knots-descend-reg
-                spline-boundarybug spline-derivbug
-                split-reg
+                spline-boundarybug spline-derivbug spline-table
+                split-reg stats-json
                 string string-reg
                 struct struct-array struct-array-mixture
                 struct-err struct-init-copy
@@ -275,7 +279,7 @@ macro (osl_add_all_tests)
                 ternary
                 testshade-expr
                 texture-alpha texture-alpha-derivs
-                texture-blur texture-connected-options
+                texture-blur texture-connected-options texture-const-options
                 texture-derivs texture-environment texture-errormsg
                 texture-environment-opts-reg
                 texture-firstchannel texture-interp
@@ -289,7 +293,7 @@ macro (osl_add_all_tests)
                 transform transform-reg transformc transformc-reg trig trig-reg 
                 typecast
                 unknown-instruction
-                userdata userdata-passthrough
+                userdata userdata-byindex userdata-passthrough
                 vararray-connect vararray-default
                 vararray-deserialize vararray-param
                 vecctr vector vector-reg
@@ -310,7 +314,7 @@ macro (osl_add_all_tests)
     # because the Python interpreter itself won't be linked with the right asan
     # libraries to run correctly.
     if (USE_PYTHON AND NOT SANITIZE_ON_LINUX)
-        TESTSUITE ( python-oslquery )
+        TESTSUITE ( python-oslexec python-oslquery )
     endif ()
 
     # Only run openvdb-related tests if the local OIIO has openvdb support.
@@ -131,6 +131,24 @@ public:
         return m_dfoptautomata.getTransition(state, symbol);
     };
 
+    /// Labels can be turned into small integer ids once, after compile(),
+    /// and then each transition on them is a single table lookup.
+    int getSymbolId(ustring symbol) const
+    {
+        return m_dfoptautomata.getSymbolId(symbol);
+    };
+    int getTransition(int state, int symbol_id) const
+    {
+        return m_dfoptautomata.getTransition(state, symbol_id);
+    };
+
+    /// Advance a batch of n paths (of 8 or 16, say) in one go: each of
+    /// states[i] moves along symbol_ids[i]. Broken paths stay broken.
+    void getTransitions(int* states, const int* symbol_ids, int n) const
+    {
+        m_dfoptautomata.getTransitions(states, symbol_ids, n);
+    };
+
     /// The rule list is for public use in read-only, so Accumulator knows what AOVS are we using
     const std::list<AccumRule>& getRuleList() const { return m_accumrules; };
 
@@ -177,6 +195,13 @@ public:
     /// Push a single label
     void move(ustring symbol);
 
+    /// Push a single label by id (see AccumAutomata::getSymbolId)
+    void moveSymbolId(int symbol_id)
+    {
+        if (m_state >= 0)
+            m_state = m_accum_automata->getTransition(m_state, symbol_id);
+    }
+
     /// Push a NONE terminated array of labels
     void move(const ustring* symbols);
 
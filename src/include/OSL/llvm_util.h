@@ -8,7 +8,9 @@
 #include <OSL/oslversion.h>
 #include <OSL/oslconfig.h>
 
+#include <string>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 
 #ifdef LLVM_NAMESPACE
@@ -634,7 +636,17 @@ public:
     /// If the type specified is NULL, it will make a 'void *'.
     llvm::Value *constant_ptr (void *p, llvm::PointerType *type=NULL);
 
-    /// Return an llvm::Value holding the given string constant.
+    /// Return a void pointer to a read-only copy of the given bytes,
+    /// emitted as a private constant global in the current module. This
+    /// lets the generated code hand a fully built structure to a library
+    /// function (or memcpy it into place) instead of assembling it field
+    /// by field at run time.
+    llvm::Value *constant_data_ptr (const void *data, size_t size,
+                                    int align = 1,
+                                    const std::string &name = std::string());
+
+    /// Return an llvm::Value holding the given string constant. (In aot
+    /// mode, this is a load from a "ustring" slot.)
     llvm::Value *constant (ustring s);
     llvm::Value *constant (string_view s) {
         return constant(ustring(s));
@@ -912,6 +924,54 @@ public:
     bool ptx_compile_group (llvm::Module* lib_module, const std::string& name,
                             std::string& out);
 
+    /// Ahead-of-time ("aot") code generation support. The JIT is free to
+    /// bake addresses from this process (ustring characters, renderer and
+    /// closure callbacks, parameter storage) into the code as constants,
+    /// but code meant to be saved and loaded by another process can't.
+    /// In aot mode, each such value is instead loaded from a "slot", an
+    /// external global that the loader fills in before the code runs. A
+    /// slot is described by a kind (such as "ustring") and the keys that
+    /// the loader needs to recompute its value.
+    void aot (bool on) { m_aot = on; }
+    bool aot () const { return m_aot; }
+
+    struct AotSlot {
+        std::string name;               ///< Global symbol name
+        std::string kind;               ///< What sort of value it holds
+        std::vector<std::string> keys;  ///< One per pointer in the slot
+    };
+
+    /// Return (as a void*) the address of the slot holding one pointer for
+    /// each of the keys, creating it if this kind and keys haven't been
+    /// seen before in this module.
+    llvm::Value *aot_slot (string_view kind, cspan<std::string> keys);
+
+    /// Return the value held by a single-pointer slot, cast to the given
+    /// pointer type (or void* if type is NULL).
+    llvm::Value *aot_slot_value (string_view kind, string_view key,
+                                 llvm::Type *type = nullptr);
+
+    /// All the slots created in this module.
+    const std::vector<AotSlot> &aot_slots () const { return m_aot_slots; }
+
+    /// If code generated in aot mode baked in a pointer constant that no
+    /// slot accounts for, a description of it; empty if none.
+    const std::string &aot_unrelocatable () const { return m_aot_unrelocatable; }
+
+    /// Compile the (already optimized) current module into a relocatable
+    /// native object file, for the same target the JIT would use, and
+    /// store its bytes in out. Return true on success.
+    bool emit_object (std::string &out, std::string *err = nullptr);
+
+    /// Load an object previously created by emit_object into the exec
+    /// engine, resolving its external references as the JIT would. Use
+    /// getPointerToSymbol to find its functions and slots afterwards.
+    bool add_object (string_view object, std::string *err = nullptr);
+
+    /// Return the address of the named function or global of an object
+    /// loaded with add_object, or NULL if there is no such symbol.
+    void *getPointerToSymbol (const std::string &name);
+
     /// Convert all functions in module's bitcode to a string.
     std::string bitcode_string (llvm::Module *module);
 
@@ -1023,6 +1083,11 @@ private:
     bool m_ModuleIsFinalized;
     bool m_ModuleIsPruned;
 
+    bool m_aot = false;
+    std::vector<AotSlot> m_aot_slots;
+    std::unordered_map<std::string, llvm::Value*> m_aot_slot_map;
+    std::string m_aot_unrelocatable;
+
     // Additional tracking for masked conditionals, shaders, subroutines, and loop flow control
     struct MaskInfo
     {
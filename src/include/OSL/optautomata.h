@@ -22,25 +22,55 @@ class DfAutomata;
 /// is a fast compact equivalent of the DfAutomata designed for read
 /// only operations.
 ///
+/// The symbols that appear in any transition are renumbered as small
+/// dense integers (see getSymbolId), and the transitions are a flat
+/// table with one row per state and one column per symbol, so once a
+/// label has been turned into an id, every move is a single lookup. The
+/// last column stands for every symbol outside the alphabet, and holds
+/// the wildcard transitions.
+///
 class OSLEXECPUBLIC DfOptimizedAutomata {
 public:
     void compileFrom(const DfAutomata& dfautomata);
 
+    /// Number of distinct symbols the transitions mention. Ids range
+    /// from 0 to nsymbols() inclusive, nsymbols() being "anything else".
+    int nsymbols() const { return int(m_symbols.size()); }
+
+    /// Return the id of a symbol. This is a probe of a small hash table
+    /// keyed on the ustring's own hash, but callers that move on the same
+    /// labels over and over can do it once up front.
+    int getSymbolId(OIIO::ustring symbol) const
+    {
+        size_t mask = m_symbol_hash.size() - 1;
+        for (size_t h = symbol.hash() & mask;; h = (h + 1) & mask) {
+            int id = m_symbol_hash[h];
+            if (id < 0 || m_symbols[id] == symbol)
+                return id < 0 ? nsymbols() : id;
+        }
+    }
+
+    int getTransition(int state, int symbol_id) const
+    {
+        return m_table[state * m_stride + symbol_id];
+    }
+
     int getTransition(int state, OIIO::ustring symbol) const
     {
-        const State& mystate    = m_states[state];
-        const Transition* begin = &m_trans[mystate.begin_trans];
-        const Transition* end   = begin + mystate.ntrans;
-        while (begin < end) {  // binary search
-            const Transition* middle = begin + ((end - begin) >> 1);
-            if (symbol.data() < middle->symbol.data())
-                end = middle;
-            else if (middle->symbol.data() < symbol.data())
-                begin = middle + 1;
-            else  // match
-                return middle->state;
+        return getTransition(state, getSymbolId(symbol));
+    }
+
+    /// Move n paths at once, each from states[i] along symbol_ids[i].
+    /// Broken paths (state < 0) stay broken. The loop has no branches,
+    /// so it vectorizes for a batch of paths.
+    void getTransitions(int* states, const int* symbol_ids, int n) const
+    {
+        const int* table = m_table.data();
+        for (int i = 0; i < n; ++i) {
+            int s     = states[i];
+            int t     = table[(s < 0 ? 0 : s) * m_stride + symbol_ids[i]];
+            states[i] = s < 0 ? s : t;
         }
-        return mystate.wildcard_trans;
     }
 
     void* const* getRules(int state, int& count) const
@@ -51,19 +81,13 @@ public:
 
 protected:
     struct State {
-        unsigned int begin_trans;
-        unsigned int ntrans;
         unsigned int begin_rules;
         unsigned int nrules;
-        int wildcard_trans;
-    };
-    struct Transition {
-        // we use this only for sorting
-        static bool trans_comp(const Transition& a, const Transition& b);
-        OIIO::ustring symbol;
-        int state;
     };
-    std::vector<Transition> m_trans;
+    std::vector<OIIO::ustring> m_symbols;  ///< The alphabet, by id
+    std::vector<int> m_symbol_hash = { -1 };  ///< Open addressing into m_symbols
+    std::vector<int> m_table;  ///< nstates rows of m_stride transitions
+    int m_stride = 1;          ///< nsymbols() + 1
     std::vector<void*> m_rules;
     std::vector<State> m_states;
 };
@@ -11,10 +11,16 @@ OSL_NAMESPACE_ENTER
 
 namespace pvt {
 class OSLCompilerImpl;
+struct CompiledBufferCache;
 }
 
 
 
+/// The compiler may be reused for any number of compiles. It remembers
+/// the oso it produced for each named buffer, and when a buffer of the
+/// same name is compiled again with the same options and identical
+/// preprocessed source (e.g., only comments within a line were edited),
+/// the earlier oso is returned without parsing or generating code again.
 class OSLCOMPPUBLIC OSLCompiler {
 public:
     OSLCompiler(ErrorHandler* errhandler = NULL);
@@ -38,12 +44,32 @@ public:
                         string_view stdoslpath = string_view(),
                         string_view filename   = string_view());
 
+    /// Compile several source code buffers, using up to nthreads threads
+    /// (0 means use all cores), placing the oso for sourcecodes[i] into
+    /// osobuffers[i], suitable for ShadingSystem::LoadMemoryCompiledShader.
+    /// The filenames, if not empty, name each buffer for error reporting
+    /// and for reusing the results of earlier compiles. If more than one
+    /// thread is used, the ErrorHandler must be thread-safe. Return true
+    /// if all of them compiled; osobuffers[i] is left empty for any that
+    /// failed.
+    bool compile_buffers(const std::vector<std::string>& sourcecodes,
+                         std::vector<std::string>& osobuffers,
+                         const std::vector<std::string>& options,
+                         string_view stdoslpath = string_view(),
+                         const std::vector<std::string>& filenames = {},
+                         int nthreads                              = 0);
+
     /// Return the name of our compiled output (must be called after
     /// compile()).
     string_view output_filename() const;
 
 private:
+    /// Make sure m_impl hasn't been used for an earlier compile.
+    void fresh_impl();
+
     pvt::OSLCompilerImpl* m_impl;
+    ErrorHandler* m_errhandler;
+    pvt::CompiledBufferCache* m_buffer_cache;
 };
 
 
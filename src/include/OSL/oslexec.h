@@ -103,6 +103,18 @@ public:
 
 
 
+/// Where one of a shader group's userdata values lives within a
+/// renderer's per-point data record.  The renderer resolves the group's
+/// "userdata_names" and "userdata_types" once per object into a table of
+/// these (in the same order), so that shading reads each value by its
+/// index rather than asking RendererServices::get_userdata() by name.
+struct UserDataBinding {
+    int64_t offset = -1;    ///< Byte offset within the record, -1 if absent
+    bool derivs = false;    ///< Value is followed by its x and y derivs
+};
+
+
+
 class OSLEXECPUBLIC ShadingSystem
 {
 public:
@@ -129,13 +141,30 @@ public:
     ///                              every shader compiled (0).
     ///    int max_warnings_per_thread  Number of warning calls that should be
     ///                              processed per thread (100).
+    ///    int max_shared_contexts  Most idle contexts kept by the pool used
+    ///                              by get_shared_context; 0 means twice
+    ///                              the number of cores. Must be set before
+    ///                              the first get_shared_context call. (0)
     ///    int buffer_printf      Buffer printf output from shaders and
     ///                              output atomically, to prevent threads
     ///                              from interleaving lines. (1)
+    ///    int buffer_fprintf     Hold each shade's fprintf output until
+    ///                              execute_cleanup, so that it is written
+    ///                              contiguously per file; if 0, it is
+    ///                              queued as each fprintf is called. (0)
+    ///    int fprintf_flush_bytes  Bytes of fprintf output a file may
+    ///                              accumulate before it is appended to
+    ///                              disk; 0 writes immediately. Anything
+    ///                              left is written by flush_file_output()
+    ///                              or when the ShadingSystem is destroyed.
+    ///                              (0)
     ///    int profile            Perform some rudimentary profiling (0)
     ///    int no_noise           Replace noise with constant value. (0)
     ///    int no_pointcloud      Skip pointcloud lookups. (0)
     ///    int exec_repeat        How many times to run each group (1).
+    ///    int no_derivs_raytypes  Default for the group attribute of the
+    ///                              same name (0). May also be given as
+    ///                              string[] raytype names.
     ///    int opt_warnings       Warn on certain failure to runtime-optimize
     ///                              certain shader constructs. (0)
     ///    int gpu_opt_error      Consider a hard error if certain shader
@@ -149,6 +178,11 @@ public:
     ///                              that should not be optimized away.
     ///    int unknown_coordsys_error  Should errors be issued when unknown
     ///                              coord system names are used? (1)
+    ///    int matrix_cache       Cache named coordinate system matrices
+    ///                              retrieved from the renderer in each
+    ///                              ShadingContext: 0 = never, 1 = for the
+    ///                              duration of one shade, 2 = until
+    ///                              clear_matrix_cache() is called. (1)
     ///    int connection_error   Should errors be issued when ConnectShaders
     ///                              fails to find the layer or parameter? (1)
     ///    int strict_messages    Issue error if a message is set after
@@ -211,9 +245,31 @@ public:
     ///         opt_peephole, opt_coalesce_temps, opt_assign, opt_mix
     ///         opt_merge_instances, opt_merge_instance_with_userdata,
     ///         opt_fold_getattribute, opt_middleman, opt_texture_handle
-    ///         opt_seed_bblock_aliases
+    ///         opt_seed_bblock_aliases, opt_hoist_transforms
     ///    int opt_passes         Number of optimization passes per layer (10)
     ///    int llvm_optimize      Which of several LLVM optimize strategies (1)
+    ///    int llvm_tier_threshold  If nonzero, JIT each group first with the
+    ///                              quick llvm_tier1_optimize strategy, and
+    ///                              let recompile_hot_groups() redo, at full
+    ///                              llvm_optimize, those that executed at
+    ///                              least this many times. (0)
+    ///    int llvm_tier1_optimize  LLVM optimize strategy for that first,
+    ///                              quick JIT (10)
+    ///    int dedup_groups       If nonzero, a group whose spec (shaders,
+    ///                              params, connections, and the group
+    ///                              attributes that affect its code) is
+    ///                              identical to an earlier group's runs
+    ///                              that group's optimized, compiled code
+    ///                              instead of compiling its own. Such a
+    ///                              group is never optimized itself:
+    ///                              queries that need optimization are
+    ///                              answered by its twin, and ReParameter
+    ///                              still accepts any of its params (the
+    ///                              edit makes it stop sharing). Stat
+    ///                              "groups_deduplicated" is the number of
+    ///                              groups sharing right now, not a running
+    ///                              total. The getstats() options line only
+    ///                              mentions this when it is off. (1)
     ///    int llvm_debug         Set LLVM extra debug level (0)
     ///    int llvm_debug_layers  Extra printfs upon entering and leaving
     ///                              layer functions.
@@ -269,6 +325,20 @@ public:
     ///                                 be elided, but nor will they be
     ///                                 called unconditionally.
     ///    int exec_repeat            How many times to run the group (1).
+    ///    string[] interactive_params  Array of "param" or "layer.param"
+    ///                                 names that stay editable with
+    ///                                 ReParameter after optimization (see
+    ///                                 respecialize()). Must be set before
+    ///                                 the group is optimized.
+    ///    int no_derivs_raytypes     Raytype bits (or string[] raytype
+    ///                                 names) of rays that need no
+    ///                                 derivatives. An execute whose
+    ///                                 ShaderGlobals.raytype has any of
+    ///                                 them set runs a separately compiled
+    ///                                 variant of the group that computes
+    ///                                 none: Dx, Dy and area are 0, and
+    ///                                 texture lookups have zero filter
+    ///                                 width. (0)
     ///
     bool attribute (ShaderGroup *group, string_view name,
                     TypeDesc type, const void *val);
@@ -379,6 +449,15 @@ public:
     ///   int unknown_closures_needed  Nonzero if additional closures may be
     ///                                needed, whose names can't be known
     ///                                without actually running the shader.
+    ///   int closure_bytes_needed   Estimated closure memory one execution
+    ///                                allocates (ops in loops counted once,
+    ///                                so not a bound).
+    ///   int message_bytes_needed   Estimated memory for the messages one
+    ///                                execution sets.
+    ///   int closure_bytes_peak     Most closure memory any execution so
+    ///                                far has used.
+    ///   int message_bytes_peak     Most message memory used so far.
+    ///   int scratch_bytes_peak     Most scratch memory used so far.
     ///   int globals_read           Bitfield ("or'ed" SGBits values) of
     ///                                which ShaderGlobals may be read by
     ///                                by the shader group.
@@ -420,6 +499,10 @@ public:
     ///   string entry_layers[]      List of entry point layers.
     ///   string pickle              Retrieves a serialized representation
     ///                                 of the shader group declaration.
+    ///   int num_interactive_params Number of interactive params.
+    ///   string interactive_params[] List of interactive params.
+    ///   int specialized            1 if an interactive group currently has
+    ///                                 a respecialized version installed.
     /// Note: the attributes referred to as "string" are actually on the app
     /// side as ustring or const char* (they have the same data layout), NOT
     /// std::string!
@@ -583,6 +666,60 @@ public:
                             (const char**)&val);
     }
 
+    /// Interactive edit mode. Parameters named by the group's
+    /// "interactive_params" attribute are compiled as runtime values, so
+    /// ReParameter on them takes effect on the very next execute, at the
+    /// cost of losing the constant folding their values would allow.
+    /// respecialize() recovers that: if the last edit is at least
+    /// `settle_time` seconds old, it builds, optimizes, and JITs a clone of
+    /// the group with the current values baked in, and installs it so that
+    /// subsequent executes of `group` run the clone instead. Any later
+    /// interactive edit drops the clone again until the next
+    /// respecialize().
+    ///
+    /// The shading system does not start threads of its own; the intent
+    /// is that the renderer calls this periodically from a low-priority
+    /// background thread while shading continues on the others. The
+    /// context, if supplied, must not be in use by anybody else; if it is
+    /// nullptr, a temporary one is used. Returns true if an up-to-date
+    /// specialized version is installed upon return.
+    bool respecialize (ShaderGroup *group, ShadingContext *ctx = nullptr,
+                       float settle_time = 0.0f);
+
+    /// Tiered compilation. When the "llvm_tier_threshold" attribute is
+    /// nonzero, groups are first JITed with the cheap
+    /// "llvm_tier1_optimize" passes and count their executions.
+    /// recompile_hot_groups() finds the ones that have executed at least
+    /// that many times, compiles a clone of each at full "llvm_optimize"
+    /// strength, and atomically swaps it in, so that subsequent executes
+    /// of the group run the faster code. Like respecialize(), it is meant
+    /// to be called periodically from a background thread of the
+    /// renderer's, with an unshared context or nullptr. Returns the number
+    /// of groups promoted by this call.
+    int recompile_hot_groups (ShadingContext *ctx = nullptr);
+
+    /// Ahead-of-time compilation. aot_compile() optimizes and compiles a
+    /// copy of the (complete, but not necessarily optimized) group to
+    /// native code for the JIT's target, without running it, and returns
+    /// the bytes of a relocatable object file along with a text manifest
+    /// describing how to bind it. A renderer can store both alongside the
+    /// scene. Returns false (and issues an error) if the group can't be
+    /// compiled this way.
+    ///
+    /// aot_load() gives a group that has not been optimized yet the saved
+    /// object and manifest of an identically specified group, previously
+    /// compiled by the same OSL version. When the group is next optimized
+    /// it still runs the usual runtime optimization, but then merely loads
+    /// and links the saved code instead of generating and JITing its own,
+    /// which is where most of the time goes. Returns false (and issues an
+    /// error) if the saved code can't be used here, in which case the group
+    /// is compiled as usual. Neither is supported for OptiX or for batched
+    /// execution, which always JIT.
+    bool aot_compile (ShaderGroup *group, std::string &object,
+                      std::string &manifest, ShadingContext *ctx = nullptr);
+    bool aot_load (ShaderGroup *group, string_view object,
+                   string_view manifest);
+
     // Non-threadsafe versions of Parameter, Shader, ConnectShaders, and
     // ShaderGroupEnd. These depend on some persistent state about which
     // shader group is the "current" one being amended. It's fine to use
@@ -620,10 +757,22 @@ public:
     ShadingContext *get_context (PerThreadInfo *threadinfo,
                                  TextureSystem::Perthread *texture_threadinfo=NULL);
 
-    /// Return a ShadingContext to the pool.
+    /// Return a ShadingContext to the pool it came from.
     ///
     void release_context (ShadingContext *ctx);
 
+    /// Get a ShadingContext from a pool shared by all threads, for
+    /// renderers whose tasks migrate between threads (work stealing),
+    /// where keeping contexts per thread would multiply their memory.
+    /// Acquisition and release are lock-free, and a context keeps its
+    /// heap, closure and scratch memory between uses. The context may be
+    /// used by only one thread at a time, with the given 'threadinfo'
+    /// (which must belong to that thread), until it is handed back with
+    /// release_context. The pool holds at most "max_shared_contexts" idle
+    /// contexts; extra ones are freed when released.
+    ShadingContext *get_shared_context (PerThreadInfo *threadinfo,
+                                        TextureSystem::Perthread *texture_threadinfo=NULL);
+
     /// Execute the shader group in this context on shading point
     /// `shadeindex`. If ctx is nullptr, then execute will request one
     /// (based on the running thread) on its own and then return it when
@@ -701,6 +850,28 @@ public:
     /// execute_layer.
     bool execute_cleanup (ShadingContext &ctx);
 
+    /// Supply userdata by index for the following executions in `ctx`:
+    /// `bindings` holds one UserDataBinding per userdata of the group
+    /// (see the "num_userdata" group attribute), and `record` is the
+    /// data record of the point about to be shaded.  Userdata that a
+    /// binding marks absent takes its default value, and get_userdata()
+    /// is not called.  Passing nullptr bindings goes back to
+    /// get_userdata().  Both pointers must stay valid while shading, and
+    /// the binding is dropped when the context is released.
+    void bind_userdata (ShadingContext &ctx, const UserDataBinding *bindings,
+                        const void *record);
+
+    /// Discard any named coordinate system matrices cached in the context.
+    /// Only needed when the "matrix_cache" attribute is 2, in which case
+    /// the renderer must call this whenever its transformations change
+    /// (for example, between frames or after an interactive edit).
+    void clear_matrix_cache (ShadingContext &ctx);
+
+    /// Append to disk all shader fprintf output that is still buffered
+    /// (see the "fprintf_flush_bytes" attribute), for instance before the
+    /// renderer reads or hands off the files.
+    void flush_file_output ();
+
     /// Find the named layer within a group and return its index, or -1
     /// if no such named layer exists.
     int find_layer (const ShaderGroup &group, ustring layername) const;
@@ -780,18 +951,68 @@ public:
         /// specified number of threads (0 means use all available HW cores).
         void jit_all_groups (int nthreads=0);
 
+        /// Execute the shader group on a batch of `batch_size` points.
+        /// Lane `i` of the batch is shade index `shadeindex + i`, which
+        /// is used together with `userdata_base_ptr` and
+        /// `output_base_ptr` to locate any symbols placed with
+        /// add_symlocs(), exactly as for the single point execute().
         bool execute(ShadingContext &ctx, ShaderGroup &group, int batch_size,
-                         BatchedShaderGlobals<WidthT> &globals_batch, bool run=true);
+                     int shadeindex, BatchedShaderGlobals<WidthT> &globals_batch,
+                     void* userdata_base_ptr, void* output_base_ptr,
+                     bool run=true);
 
         bool execute_init (ShadingContext &ctx, ShaderGroup &group, int batch_size,
-                                 BatchedShaderGlobals<WidthT> &globals_batch, bool run=true);
+                           int shadeindex, BatchedShaderGlobals<WidthT> &globals_batch,
+                           void* userdata_base_ptr, void* output_base_ptr,
+                           bool run=true);
 
-        bool execute_layer (ShadingContext &ctx, int batch_size, BatchedShaderGlobals<WidthT> &globals_batch,
+        bool execute_layer (ShadingContext &ctx, int batch_size, int shadeindex,
+                            BatchedShaderGlobals<WidthT> &globals_batch,
+                            void* userdata_base_ptr, void* output_base_ptr,
                             int layernumber);
+        bool execute_layer (ShadingContext &ctx, int batch_size, int shadeindex,
+                            BatchedShaderGlobals<WidthT> &globals_batch,
+                            void* userdata_base_ptr, void* output_base_ptr,
+                            ustring layername);
+        bool execute_layer (ShadingContext &ctx, int batch_size, int shadeindex,
+                            BatchedShaderGlobals<WidthT> &globals_batch,
+                            void* userdata_base_ptr, void* output_base_ptr,
+                            const ShaderSymbol *symbol);
+
+        /// Batched bind_userdata(): `bindings[i]` and `records[i]` are
+        /// the binding table and data record for lane `i` of the next
+        /// batches shaded in `ctx` (a lane with a null table gets no
+        /// userdata).  The arrays must hold at least batch_size entries.
+        void bind_userdata (ShadingContext &ctx,
+                            const UserDataBinding *const *bindings,
+                            const void *const *records);
+
+        // No shadeindex or base pointers (symloc placement not used)
+        bool execute(ShadingContext &ctx, ShaderGroup &group, int batch_size,
+                     BatchedShaderGlobals<WidthT> &globals_batch, bool run=true) {
+            return execute(ctx, group, batch_size, 0, globals_batch,
+                           nullptr, nullptr, run);
+        }
+        bool execute_init (ShadingContext &ctx, ShaderGroup &group, int batch_size,
+                           BatchedShaderGlobals<WidthT> &globals_batch, bool run=true) {
+            return execute_init(ctx, group, batch_size, 0, globals_batch,
+                                nullptr, nullptr, run);
+        }
+        bool execute_layer (ShadingContext &ctx, int batch_size, BatchedShaderGlobals<WidthT> &globals_batch,
+                            int layernumber) {
+            return execute_layer(ctx, batch_size, 0, globals_batch,
+                                 nullptr, nullptr, layernumber);
+        }
         bool execute_layer (ShadingContext &ctx, int batch_size, BatchedShaderGlobals<WidthT> &globals_batch,
-                                  ustring layername);
+                            ustring layername) {
+            return execute_layer(ctx, batch_size, 0, globals_batch,
+                                 nullptr, nullptr, layername);
+        }
         bool execute_layer (ShadingContext &ctx, int batch_size, BatchedShaderGlobals<WidthT> &globals_batch,
-                                  const ShaderSymbol *symbol);
+                            const ShaderSymbol *symbol) {
+            return execute_layer(ctx, batch_size, 0, globals_batch,
+                                 nullptr, nullptr, symbol);
+        }
     };
 
     template<int WidthT>
@@ -805,6 +1026,28 @@ public:
     ///
     std::string getstats (int level=1) const;
 
+    /// Return the statistics as a JSON object, for programs rather than
+    /// people: every named counter (each also available individually as
+    /// getattribute("stat:<name>")) with its value, type, unit ("count",
+    /// "seconds", or "bytes"), and whether it is cumulative; the growth
+    /// of the cumulative ones since the last reset_stats_interval() (or
+    /// since startup); and a per-group breakdown of executions and
+    /// shading time, also broken down per layer if level > 1. The names
+    /// and units of the counters can be enumerated with the attributes
+    /// "stat:num_counters" (int), "stat:counter_names" and
+    /// "stat:counter_units" (string arrays).
+    ///
+    /// The counters are read without locking, so this is cheap enough to
+    /// poll periodically during a render; the numbers are consistent to
+    /// within whatever changes while they're being read. A value that is
+    /// not finite is reported as null, as is the layer count (with no
+    /// layer breakdown) of a group that is still being built or is being
+    /// optimized at that moment.
+    std::string getstats_json (int level=1) const;
+
+    /// Begin a new interval for the "interval" section of getstats_json.
+    void reset_stats_interval ();
+
     void register_closure (string_view name, int id, const ClosureParam *params,
                            PrepareClosureFunc prepare, SetupClosureFunc setup);
 
@@ -943,6 +1186,14 @@ enum ShadeImageLocations {
 /// themselves will either be at "pixel centers" (position (i+0.5)/res), or
 /// as if it were a grid that is shaded at exact endpoints (position
 /// i/(res+1)). In either case, derivatives will be set appropriately.
+///
+/// Outputs are normally copied from the context into the image after each
+/// shade. If instead the group has symlocs (see add_symlocs()) placing
+/// every output in SymArena::Outputs, at the byte offset of its first
+/// channel within a pixel and with a stride of the buffer's pixel size,
+/// the shader writes them directly into `buf`, which is passed as the
+/// output base pointer with a pixel's shade index being its offset from
+/// the buffer origin.  Any other placement of the outputs is an error.
 OSLEXECPUBLIC
 bool
 shade_image(ShadingSystem& shadingsys, ShaderGroup& group,
@@ -952,6 +1203,22 @@ shade_image(ShadingSystem& shadingsys, ShaderGroup& group,
             OIIO::ROI roi                                   = OIIO::ROI(),
             OIIO::parallel_options popt = 0);
 
+#if OSL_USE_BATCHED
+/// Batched variant of shade_image(): pixels are shaded `batch_size` (16
+/// or 8) at a time with BatchedExecutor::execute(), which requires that
+/// the renderer provide BatchedRendererServices of that width.  A batch
+/// never spans more than one row of the roi, so placed outputs still see
+/// consecutive shade indices across the lanes of a batch.
+OSLEXECPUBLIC
+bool
+shade_image(ShadingSystem& shadingsys, ShaderGroup& group, int batch_size,
+            const ShaderGlobals* defaultsg, OIIO::ImageBuf& buf,
+            cspan<ustring> outputs,
+            ShadeImageLocations shadelocations              = ShadePixelCenters,
+            OIIO::ROI roi                                   = OIIO::ROI(),
+            OIIO::parallel_options popt = 0);
+#endif
+
 #endif
 
 
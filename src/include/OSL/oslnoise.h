@@ -2553,6 +2553,104 @@ struct SNoiseScalar : SNoiseImpl<CGScalar> {};
 
 
 
+// Which sum of octaves FractalNoiseImpl computes.
+enum class FractalType { FBM, Turbulence, Ridged };
+
+// Per-octave shaping of a signed Perlin value: identity for fBm, |n| for
+// turbulence, (1-|n|)^2 for ridged.  Triples are shaped per component so
+// that each channel stays an independent fractal.
+template<FractalType Type>
+struct FractalShape {
+    static OSL_FORCEINLINE OSL_HOSTDEVICE float apply (float n) {
+        if (Type == FractalType::FBM)
+            return n;
+        float a = fabsf (n);
+        if (Type == FractalType::Turbulence)
+            return a;
+        float r = 1.0f - a;
+        return r * r;
+    }
+
+    static OSL_FORCEINLINE OSL_HOSTDEVICE Dual2<float> apply (const Dual2<float> &n) {
+        if (Type == FractalType::FBM)
+            return n;
+        Dual2<float> a = fabs (n);
+        if (Type == FractalType::Turbulence)
+            return a;
+        Dual2<float> r = 1.0f - a;
+        return r * r;
+    }
+
+    static OSL_FORCEINLINE OSL_HOSTDEVICE Vec3 apply (const Vec3 &n) {
+        return Vec3 (apply (n.x), apply (n.y), apply (n.z));
+    }
+
+    static OSL_FORCEINLINE OSL_HOSTDEVICE Dual2<Vec3> apply (const Dual2<Vec3> &n) {
+        return make_Vec3 (apply (comp_x (n)), apply (comp_y (n)),
+                          apply (comp_z (n)));
+    }
+};
+
+
+
+// Fractal sums of signed Perlin noise.  All octaves are evaluated in a
+// single call: each one is taken at `lacunarity` times the frequency and
+// `gain` times the amplitude of the previous one, and the total is
+// divided by the sum of the amplitudes, so fBm stays in about [-1,1] and
+// turbulence/ridged in [0,1] regardless of the octave count.  Derivatives
+// follow from evaluating the octaves on Dual2 inputs.
+template<FractalType Type, typename CGPolicyT = CGDefault>
+struct FractalNoiseImpl {
+    static constexpr int max_octaves = 16;
+
+    OSL_FORCEINLINE OSL_HOSTDEVICE
+    FractalNoiseImpl (int octaves = 4, float lacunarity = 2.0f, float gain = 0.5f)
+        : m_octaves (octaves < 1 ? 1 : (octaves > max_octaves ? max_octaves : octaves)),
+          m_lacunarity (lacunarity), m_gain (gain)
+    { }
+
+    template<typename R, typename S>
+    OSL_FORCEINLINE OSL_HOSTDEVICE void operator() (R &result, const S &s) const {
+        SNoiseImpl<CGPolicyT> snoise;
+        snoise (result, s);
+        result = FractalShape<Type>::apply (result);
+        float freq = 1.0f, amp = 1.0f, ampsum = 1.0f;
+        for (int o = 1; o < m_octaves; ++o) {
+            freq *= m_lacunarity;
+            amp *= m_gain;
+            R n;
+            snoise (n, S(s * freq));
+            result += FractalShape<Type>::apply (n) * amp;
+            ampsum += amp;
+        }
+        result *= 1.0f / ampsum;
+    }
+
+    template<typename R, typename S, typename T>
+    OSL_FORCEINLINE OSL_HOSTDEVICE void operator() (R &result, const S &s, const T &t) const {
+        SNoiseImpl<CGPolicyT> snoise;
+        snoise (result, s, t);
+        result = FractalShape<Type>::apply (result);
+        float freq = 1.0f, amp = 1.0f, ampsum = 1.0f;
+        for (int o = 1; o < m_octaves; ++o) {
+            freq *= m_lacunarity;
+            amp *= m_gain;
+            R n;
+            snoise (n, S(s * freq), T(t * freq));
+            result += FractalShape<Type>::apply (n) * amp;
+            ampsum += amp;
+        }
+        result *= 1.0f / ampsum;
+    }
+
+private:
+    int m_octaves;
+    float m_lacunarity;
+    float m_gain;
+};
+
+
+
 template<typename CGPolicyT = CGDefault>
 struct PeriodicNoiseImpl {
 	OSL_FORCEINLINE OSL_HOSTDEVICE PeriodicNoiseImpl () { }
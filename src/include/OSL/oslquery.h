@@ -24,6 +24,7 @@ Sony Pictures Imageworks terms, above.
 OSL_NAMESPACE_ENTER
 
 class ShaderGroup;  // opaque class for now
+class OSLQueryIndex;
 
 namespace pvt {
 class OSOReaderQuery;  // Just so OSLQuery can friend OSLReaderQuery
@@ -144,6 +145,14 @@ public:
     /// the named shader with optional searchpath.  Return true for success,
     /// false if the shader could not be found or opened properly.
 
+    bool open(const OSLQueryIndex& index, string_view shadername,
+              string_view searchpath = string_view());
+    ///< Initialize from the record for `shadername` in a shader index
+    /// (see `OSLQueryIndex` below), which takes constant time and does not
+    /// read the `.oso` file at all.  If the index has no up-to-date record
+    /// for the file that `open(shadername, searchpath)` would read, fall
+    /// back to reading it.
+
     bool open_bytecode(string_view buffer);
     ///< Get info on the shader from it's compiled bytecode (i.e., like the
     /// contents of an `.oso` file, but in a string).  Return `true` for
@@ -213,6 +222,7 @@ private:
     std::vector<Parameter> m_params;  //< Params to the shader
     std::vector<Parameter> m_meta;    //< Meta-data about the shader
     friend class pvt::OSOReaderQuery;
+    friend class OSLQueryIndex;
 
     // Internal error reporting routine, with std::format-like arguments.
     template<typename Str, typename... Args>
@@ -241,6 +251,102 @@ private:
 
 
 
+
+/// OSLQueryIndex class API Reference
+/// =================================
+///
+/// An `OSLQueryIndex` is a single file holding the already-parsed
+/// `OSLQuery` information (parameters, types, defaults, and metadata) of
+/// any number of compiled shaders, with a hash table keyed on shader name.
+/// Applications that query thousands of shaders at startup can map the
+/// index once and then open each shader with `OSLQuery::open(index, name)`
+/// in constant time, instead of parsing every `.oso` file.
+///
+/// Each record remembers the path, modification time, and size of the
+/// `.oso` it came from.  Lookups by default ignore records whose file has
+/// since changed, and `build()` re-parses only those shaders, copying the
+/// records of all the others from the previous index unchanged. `oslinfo
+/// --build-index` is the command-line front end for `build()`.
+///
+/// Index files are in native byte order and are not meant to be moved
+/// between machines of different endianness.
+
+class OSLQUERYPUBLIC OSLQueryIndex {
+public:
+    OSLQueryIndex();
+    ~OSLQueryIndex();
+    OSLQueryIndex(const OSLQueryIndex&) = delete;
+    const OSLQueryIndex& operator=(const OSLQueryIndex&) = delete;
+
+    bool open(string_view indexfile);
+    ///< Map an index file, replacing any that was open before. Return
+    /// true for success, false if it could not be read or is not a valid
+    /// index.
+
+    void close();
+    ///< Unmap the index.
+
+    bool is_open() const { return m_data != nullptr; }
+
+    size_t size() const;
+    ///< How many shaders the index holds.
+
+    bool lookup(string_view shadername, OSLQuery& query,
+                bool check_stale = true,
+                string_view searchpath = string_view()) const;
+    ///< Fill in `query` from the record for `shadername` (a shader name,
+    /// `.oso` file name, or path to one).  Records are filed by base name,
+    /// but if `shadername` has a directory, the record is only used if it
+    /// came from that very file; likewise, with a `searchpath`, only if it
+    /// came from the file the searchpath finds (or, if none is found, from
+    /// one of its directories).  Return false if there is no such record,
+    /// or if `check_stale` is true and the `.oso` file it came from has
+    /// changed since.
+
+    static bool build(string_view indexfile,
+                      const std::vector<std::string>& osofiles,
+                      std::string& errormessage, int* nreused = nullptr);
+    ///< Write the index file for the given `.oso` files, plus any shaders
+    /// already in an existing `indexfile` whose files still exist.  Only
+    /// shaders that are new or whose files changed are parsed; `nreused`,
+    /// if not null, receives the number of records copied as they were.
+    /// If two files have the same shader name, the first one wins.  The
+    /// new index replaces the old one atomically, so processes that still
+    /// have the old one open are unaffected.
+
+    std::string geterror(bool clear_error = true) const
+    {
+        std::string e = m_error;
+        if (clear_error)
+            m_error.clear();
+        return e;
+    }
+
+private:
+    std::string m_filename;
+    const char* m_data = nullptr;  //< The index contents
+    size_t m_size      = 0;
+    bool m_mapped      = false;    //< m_data is mmapped (or else m_buffer)
+    std::string m_buffer;
+    mutable std::string m_error;
+
+    const char* find_entry(string_view key) const;
+
+    template<typename Str, typename... Args>
+    inline void errorfmt(const Str& fmt, Args&&... args) const
+    {
+        if (m_error.size())
+            m_error += '\n';
+        m_error += OIIO::Strutil::fmt::format(fmt,
+                                              std::forward<Args>(args)...);
+    }
+
+    static void write_record(const OSLQuery& query, std::string& out);
+    static bool read_record(string_view record, OSLQuery& query);
+};
+
+
+
 ////////// Implementation
 
 inline const OSLQuery::Parameter*
@@ -111,6 +111,15 @@ STRDECL("direction", direction)
 STRDECL("do_filter", do_filter)
 STRDECL("bandwidth", bandwidth)
 STRDECL("impulses", impulses)
+STRDECL("fbm", fbm)
+STRDECL("fbmnoise", fbmnoise)
+STRDECL("turbulence", turbulence)
+STRDECL("turbulencenoise", turbulencenoise)
+STRDECL("ridged", ridged)
+STRDECL("ridgednoise", ridgednoise)
+STRDECL("octaves", octaves)
+STRDECL("lacunarity", lacunarity)
+STRDECL("gain", gain)
 STRDECL("dowhile", op_dowhile)
 STRDECL("for", op_for)
 STRDECL("while", op_while)
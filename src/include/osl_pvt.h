@@ -479,6 +479,7 @@ public:
         , m_lockgeom(false)
         , m_allowconnect(true)
         , m_renderer_output(false)
+        , m_interactive(false)
         , m_readonly(false)
         , m_is_uniform(true)
         , m_forced_llvm_bool(false)
@@ -772,6 +773,12 @@ public:
     bool renderer_output() const { return m_renderer_output; }
     void renderer_output(bool v) { m_renderer_output = v; }
 
+    // An interactive param is left non-constant (like lockgeom=0) so that
+    // ReParameter can edit it after optimization, but its value comes
+    // from the instance, never from userdata.
+    bool interactive() const { return m_interactive; }
+    void interactive(bool v) { m_interactive = v; }
+
     // When not uniform a symbol will have a varying value under batched
     // execution and must use a Wide data type to hold different values
     // for each data lane executing
@@ -873,6 +880,7 @@ protected:
     unsigned m_lockgeom : 1;         ///< Is the param not overridden by geom?
     unsigned m_allowconnect : 1;     ///< Is the param not overridden by geom?
     unsigned m_renderer_output : 1;  ///< Is this sym a renderer output?
+    unsigned m_interactive : 1;      ///< Editable after optimization?
     unsigned m_readonly : 1;         ///< read-only symbol
     unsigned m_is_uniform : 1;  ///< symbol is uniform under batched execution
     unsigned m_forced_llvm_bool : 1;  ///< Is this sym forced to be llvm bool?
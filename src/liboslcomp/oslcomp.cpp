@@ -3,11 +3,17 @@
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstdio>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <streambuf>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "oslcomp_pvt.h"
@@ -17,6 +23,7 @@
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/thread.h>
+#include <OpenImageIO/timer.h>
 
 #if !defined(__STDC_CONSTANT_MACROS)
 #    define __STDC_CONSTANT_MACROS 1
@@ -36,8 +43,10 @@ OSL_NAMESPACE_ENTER
 
 
 OSLCompiler::OSLCompiler(ErrorHandler* errhandler)
+    : m_errhandler(errhandler)
 {
-    m_impl = new pvt::OSLCompilerImpl(errhandler);
+    m_impl         = new pvt::OSLCompilerImpl(errhandler);
+    m_buffer_cache = new pvt::CompiledBufferCache;
 }
 
 
@@ -45,6 +54,21 @@ OSLCompiler::OSLCompiler(ErrorHandler* errhandler)
 OSLCompiler::~OSLCompiler()
 {
     delete m_impl;
+    delete m_buffer_cache;
+}
+
+
+
+void
+OSLCompiler::fresh_impl()
+{
+    // An OSLCompilerImpl's symbol table can't be emptied, so each compile
+    // needs a new one.
+    if (m_impl->used()) {
+        delete m_impl;
+        m_impl = new pvt::OSLCompilerImpl(m_errhandler);
+    }
+    m_impl->buffer_cache(m_buffer_cache);
 }
 
 
@@ -54,6 +78,7 @@ OSLCompiler::compile(string_view filename,
                      const std::vector<std::string>& options,
                      string_view stdoslpath)
 {
+    fresh_impl();
     return m_impl->compile(filename, options, stdoslpath);
 }
 
@@ -64,12 +89,60 @@ OSLCompiler::compile_buffer(string_view sourcecode, std::string& osobuffer,
                             const std::vector<std::string>& options,
                             string_view stdoslpath, string_view filename)
 {
+    fresh_impl();
     return m_impl->compile_buffer(sourcecode, osobuffer, options, stdoslpath,
                                   filename);
 }
 
 
 
+bool
+OSLCompiler::compile_buffers(const std::vector<std::string>& sourcecodes,
+                             std::vector<std::string>& osobuffers,
+                             const std::vector<std::string>& options,
+                             string_view stdoslpath,
+                             const std::vector<std::string>& filenames,
+                             int nthreads)
+{
+    size_t nbuffers = sourcecodes.size();
+    osobuffers.clear();
+    osobuffers.resize(nbuffers);
+    std::vector<char> succeeded(nbuffers, 0);
+    auto compile_one = [&](size_t i) {
+        pvt::OSLCompilerImpl compiler(m_errhandler);
+        compiler.buffer_cache(m_buffer_cache);
+        string_view filename = i < filenames.size() ? filenames[i]
+                                                    : string_view();
+        succeeded[i] = compiler.compile_buffer(sourcecodes[i], osobuffers[i],
+                                               options, stdoslpath, filename);
+        if (!succeeded[i])
+            osobuffers[i].clear();
+    };
+
+    if (nthreads <= 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max(1, std::min(nthreads, int(nbuffers)));
+    if (nthreads == 1) {
+        for (size_t i = 0; i < nbuffers; ++i)
+            compile_one(i);
+    } else {
+        std::atomic<size_t> next_buffer(0);
+        OIIO::thread_group threads;
+        for (int t = 0; t < nthreads; ++t) {
+            threads.add_thread(new std::thread([&]() {
+                for (size_t i = next_buffer++; i < nbuffers;
+                     i        = next_buffer++)
+                    compile_one(i);
+            }));
+        }
+        threads.join_all();
+    }
+    return std::all_of(succeeded.begin(), succeeded.end(),
+                       [](char ok) { return ok != 0; });
+}
+
+
+
 string_view
 OSLCompiler::output_filename() const
 {
@@ -116,7 +189,20 @@ OSLCompilerImpl::OSLCompilerImpl(ErrorHandler* errhandler)
 
 OSLCompilerImpl::~OSLCompilerImpl()
 {
+    // Deleting our symbols clears the global struct table, so make sure
+    // no other compiler is in the middle of using it.
+    std::lock_guard<std::mutex> lock(compile_mutex());
     delete m_derivsym;
+    m_symtab.delete_syms();
+}
+
+
+
+std::mutex&
+OSLCompilerImpl::compile_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
 }
 
 
@@ -140,6 +226,29 @@ OSLCompilerImpl::preprocess_file(const std::string& filename,
 
 
 
+// The result of preprocessing stdosl.h on its own: its preprocessed text,
+// plus the macros in effect afterwards (as -D options) so that they can
+// be handed to the preprocessor when it runs on the main source.
+struct PreprocessedStdosl {
+    std::string text;
+    std::vector<std::string> macros;
+};
+
+
+
+namespace {
+
+// Process-wide cache of preprocessed stdosl.h, keyed by the path,
+// modification time, defines, and include paths that produced it.
+static std::mutex stdosl_cache_mutex;
+static std::unordered_map<std::string,
+                          std::shared_ptr<const PreprocessedStdosl>>
+    stdosl_cache;
+
+}  // namespace
+
+
+
 bool
 OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
                                    const std::string& filename,
@@ -148,6 +257,29 @@ OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
                                    const std::vector<std::string>& includepaths,
                                    std::string& result)
 {
+    // Unless the full preprocessed output is going to be seen (-E, or
+    // embedded in the oso), reuse the preprocessed stdosl.h rather than
+    // running it through the preprocessor again for every shader. The
+    // main source is then preprocessed with just the macros it defined.
+    if (!stdoslpath.empty() && m_stdosl_cache && !m_preprocess_only
+        && !m_embed_source) {
+        std::shared_ptr<const PreprocessedStdosl> stdosl
+            = preprocess_stdosl(stdoslpath, defines, includepaths);
+        if (!stdosl)
+            return false;
+        std::vector<std::string> alldefines(defines);
+        alldefines.insert(alldefines.end(), stdosl->macros.begin(),
+                          stdosl->macros.end());
+        // Keep the leading blank line that would have been the #include,
+        // so that line numbers of the main file are adjusted the same way.
+        std::string mainresult;
+        if (!run_preprocessor("\n" + buffer, filename, alldefines,
+                              includepaths, false, mainresult))
+            return false;
+        result = stdosl->text + mainresult;
+        return true;
+    }
+
     std::string instring;
     if (!stdoslpath.empty()) {
         instring
@@ -162,6 +294,82 @@ OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
         instring = "\n";
     }
     instring += buffer;
+    return run_preprocessor(instring, filename, defines, includepaths, false,
+                            result);
+}
+
+
+
+std::shared_ptr<const PreprocessedStdosl>
+OSLCompilerImpl::preprocess_stdosl(const std::string& stdoslpath,
+                                   const std::vector<std::string>& defines,
+                                   const std::vector<std::string>& includepaths)
+{
+    std::string key = OIIO::Strutil::sprintf(
+        "%s;%d;%s;%s", stdoslpath,
+        (long long)OIIO::Filesystem::last_write_time(stdoslpath),
+        OIIO::Strutil::join(defines, " "),
+        OIIO::Strutil::join(includepaths, ";"));
+    {
+        std::lock_guard<std::mutex> lock(stdosl_cache_mutex);
+        auto found = stdosl_cache.find(key);
+        if (found != stdosl_cache.end())
+            return found->second;
+    }
+
+    // Not cached yet. It's possible for two threads to get here at once,
+    // in which case both do the work, and one of the results is kept.
+    std::string contents;
+    if (!OIIO::Filesystem::read_text_file(stdoslpath, contents)) {
+        errorf(ustring(stdoslpath), 0, "Could not open \"%s\"\n",
+               stdoslpath);
+        return nullptr;
+    }
+    auto stdosl = std::make_shared<PreprocessedStdosl>();
+    std::string macrodump;
+    if (!run_preprocessor(contents, stdoslpath, defines, includepaths, false,
+                          stdosl->text)
+        || !run_preprocessor(contents, stdoslpath, defines, includepaths,
+                             true, macrodump))
+        return nullptr;
+    if (stdosl->text.size() && stdosl->text.back() != '\n')
+        stdosl->text += '\n';
+
+    // Turn each "#define NAME(args) body" line of the macro dump into the
+    // "-DNAME(args)=body" form that run_preprocessor accepts.
+    for (string_view line : OIIO::Strutil::splits(macrodump, "\n")) {
+        if (!OIIO::Strutil::parse_prefix(line, "#define "))
+            continue;
+        size_t namelen = 0;
+        while (namelen < line.size() && line[namelen] != ' '
+               && line[namelen] != '(')
+            ++namelen;
+        if (namelen < line.size() && line[namelen] == '(') {
+            size_t close = line.find(')', namelen);
+            namelen = (close == string_view::npos) ? line.size() : close + 1;
+        }
+        string_view name = line.substr(0, namelen);
+        string_view value = line.substr(namelen);
+        if (value.size() && value[0] == ' ')
+            value.remove_prefix(1);
+        stdosl->macros.push_back(
+            OIIO::Strutil::sprintf("-D%s=%s", name, value));
+    }
+
+    std::lock_guard<std::mutex> lock(stdosl_cache_mutex);
+    auto inserted = stdosl_cache.emplace(key, stdosl);
+    return inserted.first->second;
+}
+
+
+
+bool
+OSLCompilerImpl::run_preprocessor(const std::string& instring,
+                                  const std::string& filename,
+                                  const std::vector<std::string>& defines,
+                                  const std::vector<std::string>& includepaths,
+                                  bool dump_macros, std::string& result)
+{
     std::unique_ptr<llvm::MemoryBuffer> mbuf(
         llvm::MemoryBuffer::getMemBuffer(instring, filename));
 
@@ -193,8 +401,8 @@ OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
     clang::SourceManager& sm = inst.getSourceManager();
     sm.setMainFileID(sm.createFileID(std::move(mbuf), clang::SrcMgr::C_User));
 
-    inst.getPreprocessorOutputOpts().ShowCPP               = 1;
-    inst.getPreprocessorOutputOpts().ShowMacros            = 0;
+    inst.getPreprocessorOutputOpts().ShowCPP               = !dump_macros;
+    inst.getPreprocessorOutputOpts().ShowMacros            = dump_macros;
     inst.getPreprocessorOutputOpts().ShowComments          = 0;
     inst.getPreprocessorOutputOpts().ShowLineMarkers       = 1;
     inst.getPreprocessorOutputOpts().ShowMacroComments     = 0;
@@ -286,6 +494,10 @@ OSLCompilerImpl::read_compile_options(const std::vector<std::string>& options,
         } else if (options[i] == "-embed-source"
                    || options[i] == "--embed-source") {
             m_embed_source = true;
+        } else if (options[i] == "-time" || options[i] == "--time") {
+            m_print_times = true;
+        } else if (options[i] == "-no-stdosl-cache") {
+            m_stdosl_cache = false;
         } else if (options[i] == "-MD"
                    || options[i] == "--write-dependencies") {
             // write depfile w/ user and system headers
@@ -411,6 +623,7 @@ OSLCompilerImpl::compile(string_view filename,
         return false;
     }
 
+    m_used = true;
     std::vector<std::string> defines;
     std::vector<std::string> includepaths;
     m_cwd           = OIIO::Filesystem::current_path();
@@ -431,22 +644,30 @@ OSLCompilerImpl::compile(string_view filename,
         includepaths.push_back(OIIO::Filesystem::parent_path(stdoslpath));
     }
 
+    OIIO::Timer timer;
     std::string preprocess_result;
     if (!preprocess_file(filename, stdoslpath, defines, includepaths,
                          preprocess_result)) {
         return false;
     }
+    m_time_preprocess = timer.lap();
+
+    // Preprocessing may run concurrently in several compilers, but the
+    // rest must not, since struct types are kept in a global table.
+    std::lock_guard<std::mutex> lock(compile_mutex());
 
     if (m_preprocess_only && !m_generate_deps) {
         std::cout << preprocess_result;
     } else {
         bool parseerr = osl_parse_buffer(preprocess_result);
+        m_time_parse  = timer.lap();
         if (!parseerr) {
             if (shader())
                 shader()->typecheck();
             else
                 errorf(ustring(), 0, "No shader function defined");
         }
+        m_time_typecheck = timer.lap();
 
         // Print the parse tree if there were no errors
         if (m_debug) {
@@ -458,6 +679,7 @@ OSLCompilerImpl::compile(string_view filename,
         if (m_generate_deps)
             write_dependency_file(filename);
 
+        timer.lap();  // don't count debug printing or dependency output
         if (!error_encountered()) {
             shader()->codegen();
             track_variable_dependencies();
@@ -466,6 +688,7 @@ OSLCompilerImpl::compile(string_view filename,
             //            if (m_optimizelevel >= 1)
             //                coalesce_temporaries ();
         }
+        m_time_codegen = timer.lap();
 
         if (!error_encountered()) {
             if (m_output_filename.size() == 0)
@@ -491,7 +714,10 @@ OSLCompilerImpl::compile(string_view filename,
                        m_output_filename);
                 return false;
             }
+            m_time_write = timer.lap();
         }
+        if (m_print_times)
+            print_times(filename);
     }
 
     return !error_encountered();
@@ -506,6 +732,7 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
 {
     if (filename.empty())
         filename = string_view("<buffer>");
+    m_used = true;
 
     std::vector<std::string> defines;
     std::vector<std::string> includepaths;
@@ -523,22 +750,49 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
     if (stdoslpath.empty() || !OIIO::Filesystem::exists(stdoslpath))
         warningf(ustring(filename), 0, "Unable to find \"stdosl.h\"");
 
+    OIIO::Timer timer;
     std::string preprocess_result;
     if (!preprocess_buffer(sourcecode, filename, stdoslpath, defines,
                            includepaths, preprocess_result)) {
         return false;
     }
+    m_time_preprocess = timer.lap();
+
+    // If this buffer was compiled before with the same options and the
+    // preprocessed source hasn't changed, the oso would be identical.
+    std::string cachekey;
+    if (m_buffer_cache && !m_preprocess_only) {
+        cachekey = OIIO::Strutil::join(options, " ") + "\n"
+                   + preprocess_result;
+        DiagnosticList diagnostics;
+        if (m_buffer_cache->find(filename, cachekey, osobuffer,
+                                 m_output_filename, diagnostics)) {
+            // Say again whatever the original compile had to say.
+            for (auto& d : diagnostics)
+                report(d.first, d.second);
+            if (m_verbose)
+                infof(ustring(filename), 0, "unchanged, reusing earlier oso");
+            return true;
+        }
+        m_record_diagnostics = true;
+    }
+
+    // Preprocessing may run concurrently in several compilers, but the
+    // rest must not, since struct types are kept in a global table.
+    std::lock_guard<std::mutex> lock(compile_mutex());
 
     if (m_preprocess_only) {
         std::cout << preprocess_result;
     } else {
         bool parseerr = osl_parse_buffer(preprocess_result);
+        m_time_parse  = timer.lap();
         if (!parseerr) {
             if (shader())
                 shader()->typecheck();
             else
                 errorf(ustring(), 0, "No shader function defined");
         }
+        m_time_typecheck = timer.lap();
 
         // Print the parse tree if there were no errors
         if (m_debug) {
@@ -547,6 +801,7 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
                 shader()->print(std::cout);
         }
 
+        timer.lap();  // don't count debug printing
         if (!error_encountered()) {
             shader()->codegen();
             track_variable_dependencies();
@@ -555,6 +810,7 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
             //            if (m_optimizelevel >= 1)
             //                coalesce_temporaries ();
         }
+        m_time_codegen = timer.lap();
 
         if (!error_encountered()) {
             if (m_output_filename.empty())
@@ -569,7 +825,13 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
                            preprocess_result);
             osobuffer = oso_output.str();
             OSL_DASSERT(m_osofile == nullptr);
+            m_time_write = timer.lap();
+            if (cachekey.size() && !error_encountered())
+                m_buffer_cache->insert(filename, cachekey, osobuffer,
+                                       m_output_filename, m_diagnostics);
         }
+        if (m_print_times)
+            print_times(filename);
     }
 
     return !error_encountered();
@@ -577,6 +839,21 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
 
 
 
+void
+OSLCompilerImpl::print_times(string_view filename) const
+{
+    using OIIO::Strutil::timeintervalformat;
+    m_errhandler->messagef(
+        "%s: preprocess %s, parse %s, typecheck %s, codegen %s, write %s\n",
+        filename, timeintervalformat(m_time_preprocess, 3),
+        timeintervalformat(m_time_parse, 3),
+        timeintervalformat(m_time_typecheck, 3),
+        timeintervalformat(m_time_codegen, 3),
+        timeintervalformat(m_time_write, 3));
+}
+
+
+
 void
 OSLCompilerImpl::write_dependency_file(string_view filename)
 {
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <stack>
 #include <vector>
@@ -31,6 +33,53 @@ typedef std::set<const Symbol*> SymPtrSet;
 /// depends on it).
 typedef std::map<const Symbol*, SymPtrSet> SymDependencyMap;
 
+struct PreprocessedStdosl;
+
+
+
+/// A warning, info, or message issued while compiling, kept so that it can
+/// be reported again.
+typedef std::vector<std::pair<ErrorHandler::ErrCode, std::string>>
+    DiagnosticList;
+
+/// Remembers the oso most recently compiled from each named buffer, along
+/// with the options and preprocessed source that produced it and the
+/// diagnostics issued along the way, so that an unchanged buffer can be
+/// recompiled without parsing it again.
+struct CompiledBufferCache {
+    bool find(string_view name, const std::string& key, std::string& oso,
+              std::string& output_filename, DiagnosticList& diagnostics) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_entries.find(std::string(name));
+        if (found == m_entries.end() || found->second.key != key)
+            return false;
+        oso             = found->second.oso;
+        output_filename = found->second.output_filename;
+        diagnostics     = found->second.diagnostics;
+        return true;
+    }
+
+    void insert(string_view name, const std::string& key,
+                const std::string& oso, const std::string& output_filename,
+                const DiagnosticList& diagnostics)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[std::string(name)] = Entry { key, oso, output_filename,
+                                               diagnostics };
+    }
+
+private:
+    struct Entry {
+        std::string key;              ///< Options + preprocessed source
+        std::string oso;              ///< The resulting oso
+        std::string output_filename;  ///< Its output filename
+        DiagnosticList diagnostics;   ///< Warnings etc. from the compile
+    };
+    mutable std::mutex m_mutex;
+    std::map<std::string, Entry> m_entries;
+};
+
 
 
 class OSLCompilerImpl {
@@ -49,6 +98,12 @@ public:
 
     bool osl_parse_buffer(const std::string& preprocessed_buffer);
 
+    /// Has this compiler already been used to compile a shader?
+    bool used() const { return m_used; }
+
+    /// Set the cache of earlier compile_buffer results to consult.
+    void buffer_cache(CompiledBufferCache* cache) { m_buffer_cache = cache; }
+
     /// The name of the file we're currently parsing
     ///
     ustring filename() const { return m_filename; }
@@ -107,9 +162,11 @@ public:
             return;
         }
         if (filename.size())
-            m_errhandler->warningf("%s:%d: warning: %s", filename, line, msg);
+            msg = OIIO::Strutil::sprintf("%s:%d: warning: %s", filename, line,
+                                         msg);
         else
-            m_errhandler->warningf("warning: %s", msg);
+            msg = "warning: " + msg;
+        report(ErrorHandler::EH_WARNING, msg);
     }
 
     /// Info reporting
@@ -122,9 +179,11 @@ public:
         if (msg.size() && msg.back() == '\n')  // trim extra newline
             msg.pop_back();
         if (filename.size())
-            m_errhandler->infof("%s:%d: info: %s", filename, line, msg);
+            msg = OIIO::Strutil::sprintf("%s:%d: info: %s", filename, line,
+                                         msg);
         else
-            m_errhandler->infof("info: %s", msg);
+            msg = "info: " + msg;
+        report(ErrorHandler::EH_INFO, msg);
     }
 
     /// message reporting
@@ -137,11 +196,32 @@ public:
         if (msg.size() && msg.back() == '\n')  // trim extra newline
             msg.pop_back();
         if (filename.size())
-            m_errhandler->messagef("%s:%d: %s", filename, line, msg);
+            msg = OIIO::Strutil::sprintf("%s:%d: %s", filename, line, msg);
+        report(ErrorHandler::EH_MESSAGE, msg);
+    }
+
+    /// Pass a warning, info, or message to the error handler (through the
+    /// wrappers that apply its verbosity), and remember it if the result
+    /// of this compile may be cached.
+    void report(ErrorHandler::ErrCode code, const std::string& msg) const
+    {
+        if (code == ErrorHandler::EH_WARNING)
+            m_errhandler->warningf("%s", msg);
+        else if (code == ErrorHandler::EH_INFO)
+            m_errhandler->infof("%s", msg);
         else
             m_errhandler->messagef("%s", msg);
+        if (m_record_diagnostics)
+            m_diagnostics.emplace_back(code, msg);
     }
 
+    /// Mutex serializing the parts of compilation (after preprocessing)
+    /// that touch global state, for compilers running on several threads.
+    static std::mutex& compile_mutex();
+
+    /// Print the time spent in each compiler phase (-time).
+    void print_times(string_view filename) const;
+
     /// Have we hit an error?
     ///
     bool error_encountered() const { return m_err; }
@@ -165,6 +245,22 @@ public:
                            const std::vector<std::string>& includepaths,
                            std::string& result);
 
+    /// Return the preprocessed stdosl.h for these defines and include
+    /// paths, running the preprocessor only if it isn't already cached.
+    std::shared_ptr<const PreprocessedStdosl>
+    preprocess_stdosl(const std::string& stdoslpath,
+                      const std::vector<std::string>& defines,
+                      const std::vector<std::string>& includepaths);
+
+    /// Run the preprocessor on a buffer. If dump_macros is true, the
+    /// result is the list of macros defined at the end, rather than the
+    /// preprocessed text.
+    bool run_preprocessor(const std::string& instring,
+                          const std::string& filename,
+                          const std::vector<std::string>& defines,
+                          const std::vector<std::string>& includepaths,
+                          bool dump_macros, std::string& result);
+
     /// Has a shader already been defined?
     bool shader_is_defined() const { return (bool)m_shader; }
 
@@ -473,6 +569,17 @@ private:
     bool m_generate_system_deps = false;  ///< Generate system header deps? -MD
     bool m_embed_source         = false;  ///< Embed preprocessed source in oso?
     bool m_err_on_warning;                ///< Treat warnings as errors?
+    bool m_used = false;                  ///< Has compile been called?
+    CompiledBufferCache* m_buffer_cache = nullptr;  ///< Earlier results
+    bool m_record_diagnostics = false;      ///< Keep diagnostics for cache?
+    mutable DiagnosticList m_diagnostics;  ///< Diagnostics to cache
+    bool m_stdosl_cache = true;           ///< Reuse preprocessed stdosl.h?
+    bool m_print_times = false;           ///< Print time for each phase?
+    double m_time_preprocess = 0;         ///< Time spent preprocessing
+    double m_time_parse = 0;              ///< Time spent parsing
+    double m_time_typecheck = 0;          ///< Time spent type checking
+    double m_time_codegen = 0;            ///< Time spent generating code
+    double m_time_write = 0;              ///< Time spent writing the oso
     int m_optimizelevel;                  ///< Optimization level
     OpcodeVec m_ircode;                   ///< Generated IR code
     SymbolPtrVec m_opargs;                ///< Arguments for all instructions
@@ -274,6 +274,8 @@ SymbolTable::pop()
 void
 SymbolTable::delete_syms()
 {
+    if (m_allsyms.empty())
+        return;  // already deleted, don't clear anyone else's structs
     for (auto& sym : m_allsyms)
         delete sym;
     m_allsyms.clear();
@@ -169,6 +169,30 @@ int main()
     OIIO_CHECK_ASSERT(aovs[reflections ].check());
     OIIO_CHECK_ASSERT(aovs[nocaustic   ].check());
 
+    // Moving a batch of paths by symbol id must agree with moving them
+    // one at a time by name.
+    {
+        const char *names[] = { "C", "_", "R", "T", "D", "S", "G", "L",
+                                "1", "3", "U", "Y", "s", "X" };
+        std::vector<ustring> syms (std::begin(names), std::end(names));
+        syms.push_back(Labels::STOP);
+        const int width = 16;
+        int states[width], ids[width], expected[width];
+        for (int i = 0; i < width; ++i)
+            states[i] = 0;
+        for (int step = 0; step < 8; ++step) {
+            for (int i = 0; i < width; ++i) {
+                ustring sym = syms[(i + step * (i + 1)) % syms.size()];
+                ids[i] = automata.getSymbolId(sym);
+                expected[i] = states[i] < 0 ? states[i]
+                                            : automata.getTransition(states[i], sym);
+            }
+            automata.getTransitions(states, ids, width);
+            for (int i = 0; i < width; ++i)
+                OIIO_CHECK_EQUAL(states[i], expected[i]);
+        }
+    }
+
     std::cout << "Light expressions check OK" << std::endl;
     return unit_test_failures;
 }
@@ -592,44 +592,51 @@ ndfautoToDfauto(const NdfAutomata &ndfautomata, DfAutomata &dfautomata)
 
 
 
-bool
-DfOptimizedAutomata::Transition::trans_comp (const DfOptimizedAutomata::Transition &a, const DfOptimizedAutomata::Transition &b)
-{
-    return a.symbol.data() < b.symbol.data();
-}
-
-
-
 void
 DfOptimizedAutomata::compileFrom(const DfAutomata &dfautomata)
 {
-    m_states.resize(dfautomata.m_states.size());
-    size_t totaltrans = 0;
+    // Number the alphabet, and index it by hash. The hash table is kept
+    // at most half full, so probes stay short.
+    size_t nstates = dfautomata.m_states.size();
     size_t totalrules = 0;
-    for (size_t s = 0; s < m_states.size(); ++s) {
-        totaltrans += dfautomata.m_states[s]->m_symbol_trans.size();
+    m_symbols.clear();
+    for (size_t s = 0; s < nstates; ++s) {
+        for (auto&& t : dfautomata.m_states[s]->m_symbol_trans)
+            m_symbols.push_back (t.first);
         totalrules += dfautomata.m_states[s]->m_rules.size();
     }
-    m_trans.resize(totaltrans);
+    std::sort (m_symbols.begin(), m_symbols.end());
+    m_symbols.erase (std::unique (m_symbols.begin(), m_symbols.end()),
+                     m_symbols.end());
+    size_t hashsize = 1;
+    while (hashsize < 2 * m_symbols.size() + 1)
+        hashsize *= 2;
+    m_symbol_hash.assign (hashsize, -1);
+    for (int id = 0; id < nsymbols(); ++id) {
+        size_t h = m_symbols[id].hash() & (hashsize - 1);
+        while (m_symbol_hash[h] >= 0)
+            h = (h + 1) & (hashsize - 1);
+        m_symbol_hash[h] = id;
+    }
+    m_stride = nsymbols() + 1;
+
+    // Every cell starts out as the state's wildcard transition, and the
+    // symbols the state knows about overwrite theirs.
+    m_states.resize(nstates);
+    m_table.resize(nstates * m_stride);
     m_rules.resize(totalrules);
-    size_t trans_offset = 0;
     size_t rules_offset = 0;
-    for (size_t s = 0; s < m_states.size(); ++s) {
-        m_states[s].begin_trans = trans_offset;
+    for (size_t s = 0; s < nstates; ++s) {
+        const DfAutomata::State &state (*dfautomata.m_states[s]);
+        int *row = &m_table[s * m_stride];
+        std::fill (row, row + m_stride, state.m_wildcard_trans);
+        for (auto&& t : state.m_symbol_trans)
+            row[getSymbolId(t.first)] = t.second;
         m_states[s].begin_rules = rules_offset;
-        for (SymbolToInt::const_iterator i = dfautomata.m_states[s]->m_symbol_trans.begin();
-              i != dfautomata.m_states[s]->m_symbol_trans.end(); ++i, ++trans_offset) {
-            m_trans[trans_offset].symbol = i->first;
-            m_trans[trans_offset].state = i->second;
-        }
-        for (RuleSet::const_iterator i = dfautomata.m_states[s]->m_rules.begin();
-              i != dfautomata.m_states[s]->m_rules.end(); ++i, ++rules_offset)
+        for (RuleSet::const_iterator i = state.m_rules.begin();
+              i != state.m_rules.end(); ++i, ++rules_offset)
             m_rules[rules_offset] = *i;
-        m_states[s].ntrans = dfautomata.m_states[s]->m_symbol_trans.size();
-        m_states[s].nrules = dfautomata.m_states[s]->m_rules.size();
-        std::sort(m_trans.begin() + m_states[s].begin_trans, m_trans.begin() + m_states[s].begin_trans + m_states[s].ntrans,
-                     DfOptimizedAutomata::Transition::trans_comp);
-        m_states[s].wildcard_trans = dfautomata.m_states[s]->m_wildcard_trans;
+        m_states[s].nrules = state.m_rules.size();
     }
 }
 
@@ -70,7 +70,7 @@ BackendLLVM::BackendLLVM (ShadingSystemImpl &shadingsys,
       ll(ctx->llvm_thread_info(), llvm_debug(), shadingsys.m_vector_width),
       m_stat_total_llvm_time(0), m_stat_llvm_setup_time(0),
       m_stat_llvm_irgen_time(0), m_stat_llvm_opt_time(0),
-      m_stat_llvm_jit_time(0)
+      m_stat_llvm_jit_time(0), m_llvm_temp_texture_options_ptr(nullptr)
 {
 #ifdef OSL_SPI
     // Temporary (I hope) check to diagnose an intermittent failure of
@@ -552,6 +552,21 @@ BackendLLVM::llvm_get_pointer (const Symbol& sym, int deriv,
                 result = ll.ptr_cast (ptr, cast_type);
             }
         }
+        else if (ll.aot()) {
+            // Code compiled ahead of time can't point at our copy of the
+            // constant, so give it one of its own (strings get a slot).
+            TypeDesc t = sym.typespec().simpletype();
+            if (sym.typespec().is_string()) {
+                std::vector<std::string> keys;
+                for (int i = 0, e = std::max(1, t.arraylen); i < e; ++i)
+                    keys.emplace_back (((const ustring *)sym.data())[i].string());
+                result = ll.aot_slot ("ustring", keys);
+            } else {
+                result = ll.constant_data_ptr (sym.data(), t.size(), t.basesize());
+            }
+            result = ll.ptr_cast (result,
+                                  ll.type_ptr (llvm_type(sym.typespec().elementtype())));
+        }
         else {
             // For constants, start with *OUR* pointer to the constant values.
             result = ll.ptr_cast (ll.constant_ptr (sym.data()),
@@ -708,6 +723,25 @@ BackendLLVM::llvm_load_device_string (const Symbol& sym, bool follow)
 
 
 
+llvm::Value *
+BackendLLVM::llvm_texture_handle (RendererServices::TextureHandle *handle,
+                                  const Symbol& filename)
+{
+    if (ll.aot() && handle)
+        return ll.aot_slot_value ("texture_handle", filename.get_string());
+    return ll.constant_ptr (handle);
+}
+
+
+
+std::string
+BackendLLVM::aot_symdata_key (const Symbol& sym) const
+{
+    return Strutil::sprintf ("%d %s", layer(), sym.name());
+}
+
+
+
 llvm::Value *
 BackendLLVM::llvm_load_constant_value (const Symbol& sym, 
                                        int arrayindex, int component,
@@ -911,6 +945,21 @@ BackendLLVM::groupdata_field_ptr (int fieldnum, TypeDesc type)
 }
 
 
+llvm::Value *
+BackendLLVM::temp_texture_options_ptr ()
+{
+    if (! m_llvm_temp_texture_options_ptr) {
+        // op_alloca always places the allocation at the top of the
+        // function, so it doesn't matter where we are right now.
+        m_llvm_temp_texture_options_ptr = ll.void_ptr (
+            ll.op_alloca (ll.type_char(), (int)sizeof(TextureOpt),
+                          std::string(), (int)alignof(TextureOpt)));
+    }
+    return m_llvm_temp_texture_options_ptr;
+}
+
+
+
 llvm::Value *
 BackendLLVM::layer_run_ref (int layer)
 {
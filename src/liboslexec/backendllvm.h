@@ -49,6 +49,16 @@ public:
     ///
     void initialize_llvm_group ();
 
+    /// Bind group() to the code that ShadingSystem::aot_compile saved for
+    /// it instead of generating any. Return false (after warning) if that
+    /// code can't be used here, in which case the caller should JIT.
+    bool aot_load_group ();
+
+    /// Compile the optimized module to a native object and store it, and
+    /// the manifest describing it, in group().
+    bool aot_emit_group (llvm::Function *init_func,
+                         const std::vector<llvm::Function*> &funcs);
+
     int layer_remap (int origlayer) const { return m_layer_remap[origlayer]; }
 
     /// Create an llvm function for the current shader instance.
@@ -128,6 +138,16 @@ public:
     /// reside in a global variable, the groupdata struct, or a local value.
     llvm::Value *llvm_load_device_string (const Symbol& sym, bool follow);
 
+    /// Return a pointer value for a texture handle looked up at compile
+    /// time (which may be NULL). In aot mode, a non-NULL handle is loaded
+    /// from a slot that the loader refills by looking up the file name.
+    llvm::Value *llvm_texture_handle (RendererServices::TextureHandle *handle,
+                                      const Symbol& filename);
+
+    /// Key naming sym (of the current layer) for a "symdata" aot slot:
+    /// the layer index and the symbol name, separated by a space.
+    std::string aot_symdata_key (const Symbol& sym) const;
+
     /// Convenience function to load a string for CPU or GPU device
     llvm::Value *llvm_load_string (const Symbol& sym) {
         OSL_DASSERT(sym.typespec().is_string());
@@ -298,6 +318,10 @@ public:
     llvm::Value *groupdata_field_ptr (int fieldnum,
                                       TypeDesc type = TypeDesc::UNKNOWN);
 
+    /// Return a pointer to stack scratch space big enough for a
+    /// TextureOpt, shared by all texture lookups in the current function.
+    llvm::Value *temp_texture_options_ptr ();
+
     /// Return the userdata base pointer.
     llvm::Value *userdata_base_ptr () const { return m_llvm_userdata_base_ptr; }
 
@@ -446,6 +470,14 @@ public:
     /// Return whether or not we are compiling for an OptiX-based renderer.
     bool use_optix() { return m_use_optix; }
 
+    /// The LLVM optimization strategy for this group: the quick first-tier
+    /// one if it's being tiered, otherwise "llvm_optimize".
+    int llvm_optimize_level () const {
+        return m_group.llvm_tier() == ShaderGroup::LLVMTierQuick
+                   ? shadingsys().llvm_tier1_optimize()
+                   : shadingsys().llvm_optimize();
+    }
+
     /// Return the userdata index for the given Symbol.  Return -1 if the Symbol
     /// is not an input parameter or is constant and therefore doesn't have an
     /// entry in the groupdata struct.
@@ -472,6 +504,7 @@ private:
     llvm::Value *m_llvm_userdata_base_ptr;
     llvm::Value *m_llvm_output_base_ptr;
     llvm::Value *m_llvm_shadeindex;
+    llvm::Value *m_llvm_temp_texture_options_ptr;
     llvm::BasicBlock * m_exit_instance_block;  // exit point for the instance
     llvm::Type *m_llvm_type_sg;  // LLVM type of ShaderGlobals struct
     llvm::Type *m_llvm_type_groupdata;  // LLVM type of group data
@@ -1656,6 +1656,80 @@ BatchedBackendLLVM::llvm_call_function(const FuncSpec& name, const Symbol& A,
 
 
 
+llvm::Value*
+BatchedBackendLLVM::llvm_call_with_uniform_fastpath(
+    const FuncSpec& varying_spec, const FuncSpec& uniform_spec,
+    cspan<llvm::Value*> args, cspan<std::pair<int, const Symbol*>> varying_args)
+{
+    OSL_DASSERT(!varying_args.empty());
+    llvm::Value* mask      = ll.current_mask();
+    llvm::Value* lead_lane = ll.op_1st_active_lane_of(mask);
+
+    // Substitute the first active lane's value for each varying argument,
+    // narrowing the set of matching lanes as we go.
+    std::vector<llvm::Value*> uniform_args(args.begin(), args.end());
+    llvm::Value* matching_lanes = mask;
+    for (const auto& varying_arg : varying_args) {
+        const Symbol& sym = *varying_arg.second;
+        OSL_DASSERT(!sym.is_uniform());
+        llvm::Value* wide_val = llvm_load_value(sym, 0 /*deriv*/,
+                                                0 /*component*/,
+                                                TypeDesc::UNKNOWN,
+                                                false /*op_is_uniform*/);
+        llvm::Value* lead_val = ll.op_extract(wide_val, lead_lane);
+        uniform_args[varying_arg.first] = lead_val;
+        matching_lanes = ll.op_lanes_that_match_masked(lead_val, wide_val,
+                                                       matching_lanes);
+    }
+
+    // An empty mask has no first active lane, so the lead values are
+    // undefined; select rather than 'and' so they can't leak into the
+    // condition.
+    llvm::Value* int_mask        = ll.mask_as_int(mask);
+    llvm::Value* all_lanes_match = ll.op_eq(ll.mask_as_int(matching_lanes),
+                                            int_mask);
+    llvm::Value* is_uniform
+        = ll.op_select(ll.op_ne(int_mask, ll.constant(0)), all_lanes_match,
+                       ll.constant_bool(false));
+
+    llvm::BasicBlock* uniform_block = ll.new_basic_block(
+        llvm_debug() ? std::string("uniform_lanes_fastpath") : std::string());
+    llvm::BasicBlock* varying_block = ll.new_basic_block(
+        llvm_debug() ? std::string("varying_lanes") : std::string());
+    llvm::BasicBlock* after_block = ll.new_basic_block(
+        llvm_debug() ? std::string("after_uniform_lanes_check")
+                     : std::string());
+
+    ll.op_branch(is_uniform, uniform_block, varying_block);
+    llvm::Value* result = ll.call_function(build_name(uniform_spec),
+                                           uniform_args);
+    llvm::Value* result_loc = nullptr;
+    if (!result->getType()->isVoidTy()) {
+        result_loc = ll.op_alloca(result->getType(), 1,
+                                  "uniform lanes fastpath result");
+        ll.op_store(result, result_loc);
+    }
+    ll.op_branch(after_block);
+
+    ll.set_insert_point(varying_block);
+    result = ll.call_function(build_name(varying_spec), args);
+    if (result_loc)
+        ll.op_store(result, result_loc);
+    ll.op_branch(after_block);
+
+    // Let the shading system know how often the fast path was taken, but
+    // only when profiling, so the check itself stays cheap.
+    if (shadingsys().profile() >= 1) {
+        llvm::Value* stat_args[] = { sg_void_ptr(),
+                                     ll.op_bool_to_int(is_uniform) };
+        ll.call_function(build_name("incr_uniform_lanes_checks"), stat_args);
+    }
+
+    return result_loc ? ll.op_load(result_loc) : nullptr;
+}
+
+
+
 llvm::Value*
 BatchedBackendLLVM::llvm_test_nonzero(const Symbol& val, bool test_derivs)
 {
@@ -404,6 +404,15 @@ public:
         return ll.void_ptr(m_llvm_groupdata_ptr);
     }
 
+    /// Return the userdata base pointer.
+    llvm::Value* userdata_base_ptr() const { return m_llvm_userdata_base_ptr; }
+
+    /// Return the output base pointer.
+    llvm::Value* output_base_ptr() const { return m_llvm_output_base_ptr; }
+
+    /// Return the shade index of the first lane of the batch.
+    llvm::Value* shadeindex() const { return m_llvm_shadeindex; }
+
     /// Return a reference to the specified field within the group data.
     llvm::Value* groupdata_field_ref(int fieldnum);
 
@@ -624,6 +633,21 @@ public:
                                     bool functionIsLlvmInlined     = false,
                                     bool ptrToReturnStructIs1stArg = false);
 
+    /// Generate code for a call to a masked library function with varying
+    /// arguments that may, at runtime, hold the same value in every active
+    /// lane.  Each entry of 'varying_args' pairs an index into 'args' with
+    /// the varying Symbol passed there.  Emits a check of whether all
+    /// active lanes of those symbols match the first active lane; if so,
+    /// 'uniform_spec' is called once with the first active lane's values
+    /// substituted, otherwise 'varying_spec' is called with 'args' as is.
+    /// Both functions must share a signature apart from those arguments.
+    /// Return the result of whichever function ran, or nullptr if the
+    /// functions return void.
+    llvm::Value* llvm_call_with_uniform_fastpath(
+        const FuncSpec& varying_spec, const FuncSpec& uniform_spec,
+        cspan<llvm::Value*> args,
+        cspan<std::pair<int, const Symbol*>> varying_args);
+
     TypeDesc llvm_typedesc(const TypeSpec& typespec)
     {
         return typespec.is_closure_based()
@@ -770,6 +794,9 @@ private:
     std::map<const Symbol*, int> m_param_order_map;
     llvm::Value* m_llvm_shaderglobals_ptr;
     llvm::Value* m_llvm_groupdata_ptr;
+    llvm::Value* m_llvm_userdata_base_ptr;
+    llvm::Value* m_llvm_output_base_ptr;
+    llvm::Value* m_llvm_shadeindex;
 
     // Reused allocas for temps used to pass options or intermediates
     llvm::Value* m_llvm_temp_wide_matrix_ptr;  // for gen_tranform
@@ -15,6 +15,7 @@
 #endif
 
 #include "batched_backendllvm.h"
+#include "splineimpl.h"
 
 
 
@@ -89,15 +90,20 @@ BatchedBackendLLVM::llvm_call_layer(int layer, bool unconditional)
                            << " unconditional=" << unconditional << std::endl);
     // Make code that looks like:
     //     if (! groupdata->run[parentlayer])
-    //         parent_layer (sg, groupdata);
+    //         parent_layer (sg, groupdata, userdata_base_ptr,
+    //                       output_base_ptr, shadeindex, mask);
     // if it's a conditional call, or
-    //     parent_layer (sg, groupdata);
+    //     parent_layer (sg, groupdata, userdata_base_ptr,
+    //                   output_base_ptr, shadeindex, mask);
     // if it's run unconditionally.
     // The code in the parent layer itself will set its 'executed' flag.
 
-    llvm::Value* args[3];
+    llvm::Value* args[6];
     args[0] = sg_ptr();
     args[1] = groupdata_ptr();
+    args[2] = userdata_base_ptr();
+    args[3] = output_base_ptr();
+    args[4] = shadeindex();
 
     ShaderInstance* parent       = group()[layer];
     llvm::Value* layerfield      = layer_run_ref(layer_remap(layer));
@@ -127,7 +133,7 @@ BatchedBackendLLVM::llvm_call_layer(int layer, bool unconditional)
         lanes_requiring_execution_value = ll.mask_as_int(ll.shader_mask());
     }
 
-    args[2] = lanes_requiring_execution_value;
+    args[5] = lanes_requiring_execution_value;
 
     // Before the merge, keeping in case we broke it
     //std::string name = Strutil::format ("%s_%s_%d", m_library_selector,  parent->layername().c_str(),
@@ -2934,6 +2940,41 @@ LLVMGEN (llvm_gen_regex)
 }
 
 
+// Call the masked space lookup 'func_spec', whose wide matrix result is
+// followed by the 'From' (and optionally 'To') space names as arguments 2
+// and 3.  Varying space names usually hold the same name in every lane,
+// so when either is varying, check for that at runtime and perform one
+// lookup with the uniform space names instead of one per lane.
+static llvm::Value*
+llvm_call_space_lookup (BatchedBackendLLVM &rop, const FuncSpec &func_spec,
+                        cspan<llvm::Value*> args,
+                        const Symbol &From, const Symbol *To)
+{
+    bool from_is_uniform = From.is_uniform();
+    bool to_is_uniform = (To == nullptr) || To->is_uniform();
+    if (from_is_uniform && to_is_uniform)
+        return rop.ll.call_function (rop.build_name(func_spec), args);
+
+    // Same function, but with every space name uniform
+    FuncSpec uniform_spec(func_spec.name());
+    for (const auto &arg : func_spec) {
+        bool is_string = (arg.type() == TypeDesc::TypeString);
+        uniform_spec.arg(arg.type(), arg.has_derivs(), is_string || arg.is_uniform());
+    }
+    uniform_spec.mask();
+
+    std::pair<int, const Symbol*> varying_args[2];
+    int nvarying = 0;
+    if (!from_is_uniform)
+        varying_args[nvarying++] = { 2, &From };
+    if (!to_is_uniform)
+        varying_args[nvarying++] = { 3, To };
+    return rop.llvm_call_with_uniform_fastpath (func_spec, uniform_spec, args,
+                cspan<std::pair<int, const Symbol*>>(varying_args, nvarying));
+}
+
+
+
 // Construct spatial triple (point, vector, normal), optionally with a
 // transformation from a named coordinate system.
 LLVMGEN (llvm_gen_construct_triple)
@@ -3042,7 +3083,7 @@ LLVMGEN (llvm_gen_construct_triple)
             func_spec.arg_uniform(TypeDesc::TypeString);
             func_spec.mask();
 
-            succeeded_as_int = rop.ll.call_function (rop.build_name(func_spec), args);
+            succeeded_as_int = llvm_call_space_lookup (rop, func_spec, args, Space, nullptr);
         }
         {
             llvm::Value *args[] = {
@@ -3112,7 +3153,7 @@ LLVMGEN (llvm_gen_matrix)
         // non-affine matrix inversion, we will always call a masked version
         func_spec.mask();
 
-        rop.ll.call_function (rop.build_name(func_spec), args);
+        llvm_call_space_lookup (rop, func_spec, args, From, &To);
     } else {
         if (nfloats == 1) {
             llvm::Value *zero;
@@ -3160,7 +3201,7 @@ LLVMGEN (llvm_gen_matrix)
                 // renderer services to lookup matrices,  we will always call a masked version
                 func_spec.mask();
 
-                rop.ll.call_function (rop.build_name(func_spec), args);
+                llvm_call_space_lookup (rop, func_spec, args, From, nullptr);
             }
         }
     }
@@ -3206,7 +3247,7 @@ LLVMGEN (llvm_gen_getmatrix)
     // non-affine matrix inversion, we will always call a masked version
     func_spec.mask();
 
-    llvm::Value *result = rop.ll.call_function (rop.build_name(func_spec), args);
+    llvm::Value *result = llvm_call_space_lookup (rop, func_spec, args, From, &To);
     rop.llvm_conversion_store_masked_status(result, Result);
     rop.llvm_zero_derivs (M);
     return true;
@@ -3306,7 +3347,7 @@ LLVMGEN (llvm_gen_transform)
             func_spec.arg(*To, to_is_uniform);
             func_spec.mask();
 
-            succeeded_as_int = rop.ll.call_function (rop.build_name(func_spec), args);
+            succeeded_as_int = llvm_call_space_lookup (rop, func_spec, args, *From, To);
         }
         // The results of looking up a transform are always wide
     }
@@ -3929,10 +3970,7 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
     llvm::Value * swrap = wrap_default_value;
     llvm::Value * twrap = wrap_default_value;
     llvm::Value * rwrap = wrap_default_value;
-    llvm::Value * mipmode = rop.ll.constant(static_cast<int>(Tex::MipMode::Default));
     llvm::Value * interpmode = rop.ll.constant(static_cast<int>(Tex::InterpMode::SmartBicubic));
-    llvm::Value * anisotropic = rop.ll.constant(32);
-    llvm::Value * conservative_filter = rop.ll.constant(1);
     llvm::Value * fill = rop.ll.constant(0.0f);
 
     bool is_swrap_uniform = true;
@@ -3948,6 +3986,19 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
 
     llvm::Value * missingcolor = rop.ll.constant_ptr(nullptr, rop.ll.type_float_ptr());
 
+    // Host side image of the uniform options, which picks up every value
+    // known at compile time.  Only the fields flagged as needing a patch
+    // are stored individually after it is copied into place.
+    UniformTextureOptions uproto;
+    bool firstchannel_patch = false;
+    bool subimage_patch = false;
+    bool subimagename_patch = false;
+    bool swrap_patch = false;
+    bool twrap_patch = false;
+    bool rwrap_patch = false;
+    bool interpmode_patch = false;
+    bool fill_patch = false;
+
     Opcode &op (rop.inst()->ops()[opnum]);
     for (int a = first_optional_arg;  a < op.nargs();  ++a) {
         Symbol &Name(*rop.opargsym(op,a));
@@ -4022,6 +4073,10 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
             if (valtype == TypeDesc::INT)                               \
                 val = rop.ll.op_int_to_float (val);                     \
             paramname = val;                                            \
+            if (Val.is_constant())                                      \
+                uproto.paramname = Val.coerce_float();                  \
+            else                                                        \
+                paramname##_patch = true;                               \
             continue;                                                   \
         }
 
@@ -4034,6 +4089,10 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
             }                                                           \
             llvm::Value *val = rop.llvm_load_value (Val);               \
             paramname = val;                                            \
+            if (Val.is_constant())                                      \
+                uproto.paramname = Val.get_int();                       \
+            else                                                        \
+                paramname##_patch = true;                               \
             continue;                                                   \
         }
 
@@ -4048,9 +4107,11 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
             if (Val.is_constant()) {                                               \
                 int mode = decoder (Val.get_string());                       \
                 val = rop.ll.constant (mode);                                      \
+                uproto.fieldname = decltype(uproto.fieldname)(mode);               \
             } else {                                                               \
                 val = rop.llvm_load_value (Val);                                   \
                 val = rop.ll.call_function(#llvm_decoder, val);                    \
+                fieldname##_patch = true;                                          \
             }                                                                      \
             fieldname = val;                                                       \
             continue;                                                              \
@@ -4069,9 +4130,18 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
             if (Val.is_constant()) {
                 int mode = TextureOpt::decode_wrapmode (Val.get_string());
                 val = rop.ll.constant (mode);
+                uproto.swrap = static_cast<Tex::Wrap>(mode);
+                uproto.twrap = static_cast<Tex::Wrap>(mode);
+                if (tex3d) {
+                    uproto.rwrap = static_cast<Tex::Wrap>(mode);
+                }
             } else {
                 val = rop.llvm_load_value (Val);
                 val = rop.ll.call_function("osl_texture_decode_wrapmode", val);
+                swrap_patch = twrap_patch = true;
+                if (tex3d) {
+                    rwrap_patch = true;
+                }
             }
             swrap = val;
             twrap = val;
@@ -4100,6 +4170,9 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
                 if (v.empty() && (subimage == const_zero_value)) {
                     continue;     // Ignore nulls unless they are overrides
                 }
+                uproto.subimagename = v;
+            } else {
+                subimagename_patch = true;
             }
             llvm::Value *val = rop.llvm_load_value (Val);
             subimagename = val;
@@ -4193,39 +4266,43 @@ llvm_batched_texture_options(BatchedBackendLLVM &rop, int opnum,
     // so we will just use a WidthT=16 to look them up
     typedef OSL::BatchedTextureOptions<16>::LLVMMemberIndex LLVMMemberIndex;
 
-    if (is_firstchannel_uniform)
+    // Copy the prebuilt uniform options (including mipmode, anisotropic
+    // and conservative_filter, which can't be set from OSL) in one go,
+    // then patch the fields computed at run time.  Any varying fields get
+    // overwritten by llvm_batched_texture_varying_options.
+    llvm::Value * uniform_ptr = rop.ll.void_ptr (rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::firstchannel)));
+    rop.ll.op_memcpy (uniform_ptr,
+                      rop.ll.constant_data_ptr (&uproto, sizeof(uproto),
+                                                (int)alignof(UniformTextureOptions),
+                                                "uniform_texture_options"),
+                      (int)sizeof(uproto), (int)alignof(UniformTextureOptions));
+
+    if (is_firstchannel_uniform && firstchannel_patch)
         rop.ll.op_unmasked_store (firstchannel, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::firstchannel)));
-    if (is_subimage_uniform)
+    if (is_subimage_uniform && subimage_patch)
         rop.ll.op_unmasked_store (subimage, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::subimage)));
 
-    if (is_subimagename_uniform)
+    if (is_subimagename_uniform && subimagename_patch)
         rop.ll.op_unmasked_store (subimagename, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::subimagename)));
 
-    if (is_swrap_uniform)
+    if (is_swrap_uniform && swrap_patch)
         rop.ll.op_unmasked_store (swrap, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::swrap)));
-    if (is_twrap_uniform)
+    if (is_twrap_uniform && twrap_patch)
         rop.ll.op_unmasked_store (twrap, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::twrap)));
-    if (is_rwrap_uniform)
+    if (is_rwrap_uniform && rwrap_patch)
         rop.ll.op_unmasked_store (rwrap, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::rwrap)));
 
-    // No way to set mipmode option from OSL
-    rop.ll.op_unmasked_store (mipmode, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::mipmode)));
-
-    if (is_interpmode_uniform)
+    if (is_interpmode_uniform && interpmode_patch)
         rop.ll.op_unmasked_store (interpmode, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::interpmode)));
 
-    // No way to set anisotropic option from OSL
-    rop.ll.op_unmasked_store (anisotropic, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::anisotropic)));
-
-    // No way to set conservative_filter option from OSL
-    rop.ll.op_unmasked_store (conservative_filter, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::conservative_filter)));
-
-    if (is_fill_uniform)
+    if (is_fill_uniform && fill_patch)
         rop.ll.op_unmasked_store (fill, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::fill)));
 
-    // For uniform and varying we point the missingcolor to nullptr or the missingcolor_buffer,
-    // The varying options will copy the lead lane's missing color value into the missingcolor_buffer
-    rop.ll.op_unmasked_store (missingcolor, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::missingcolor)));
+    // When a missingcolor or missingalpha was given, point the options at
+    // the missingcolor_buffer (the prebuilt block holds a nullptr).  The
+    // varying options will copy the lead lane's missing color value into it.
+    if (missingcolor_buffer)
+        rop.ll.op_unmasked_store (missingcolor, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::missingcolor)));
 
     // blur's and width's are always communicated as wide, we we will handle them here
     rop.ll.op_unmasked_store (sblur, rop.ll.GEP (bto, 0, static_cast<int>(LLVMMemberIndex::sblur)));
@@ -5214,6 +5291,7 @@ llvm_batched_noise_options (BatchedBackendLLVM &rop, int opnum,
     bool is_bandwidth_uniform = true;
     bool is_impulses_uniform = true;
     bool is_do_filter_uniform = true;
+    bool is_fractal_uniform = true;
 
     OSL_DASSERT(loc_wide_direction == nullptr);
 
@@ -5283,6 +5361,24 @@ llvm_batched_noise_options (BatchedBackendLLVM &rop, int opnum,
             rop.ll.call_function ("osl_noiseparams_set_impulses", opt,
                                     rop.llvm_load_value (Val, 0, NULL, 0,
                                                          TypeDesc::TypeFloat));
+        } else if ((name == Strings::octaves || name == Strings::lacunarity ||
+                    name == Strings::gain) &&
+                   (Val.typespec().is_float() || Val.typespec().is_int())) {
+            if (!Val.is_uniform()) {
+                is_fractal_uniform = false;
+                continue; // We are only setting uniform options here
+            }
+            if (name == Strings::octaves)
+                rop.ll.call_function ("osl_noiseparams_set_octaves", opt,
+                                      rop.llvm_load_value (Val, 0, NULL, 0,
+                                                           TypeDesc::TypeInt));
+            else
+                rop.ll.call_function (name == Strings::gain
+                                          ? "osl_noiseparams_set_gain"
+                                          : "osl_noiseparams_set_lacunarity",
+                                      opt,
+                                      rop.llvm_load_value (Val, 0, NULL, 0,
+                                                           TypeDesc::TypeFloat));
         } else {
             rop.shadingcontext()->errorf ("Unknown %s optional argument: \"%s\", <%s> (%s:%d)",
                                     op.opname().c_str(),
@@ -5295,7 +5391,8 @@ llvm_batched_noise_options (BatchedBackendLLVM &rop, int opnum,
     all_options_are_uniform &= is_anisotropic_uniform &&
                                is_bandwidth_uniform &&
                                is_impulses_uniform &&
-                               is_do_filter_uniform;
+                               is_do_filter_uniform &&
+                               is_fractal_uniform;
 
     return opt;
 }
@@ -5368,6 +5465,26 @@ llvm_batched_noise_varying_options (
             remainingMask = rop.ll.op_lanes_that_match_masked(scalar_impulses, wide_impulses, remainingMask);
             rop.ll.call_function ("osl_noiseparams_set_impulses", opt,
                                   scalar_impulses);
+        } else if (name == Strings::octaves &&
+                   (Val.typespec().is_float() || Val.typespec().is_int())) {
+            OSL_DEV_ONLY(std::cout << "Varying octaves" << std::endl);
+            llvm::Value *wide_octaves = rop.llvm_load_value (Val,
+                    /*deriv=*/0, /*component=*/0, /*cast=*/TypeDesc::TypeInt, /*op_is_uniform=*/false);
+            llvm::Value *scalar_octaves = rop.ll.op_extract(wide_octaves, leadLane);
+            remainingMask = rop.ll.op_lanes_that_match_masked(scalar_octaves, wide_octaves, remainingMask);
+            rop.ll.call_function ("osl_noiseparams_set_octaves", opt,
+                                  scalar_octaves);
+        } else if ((name == Strings::lacunarity || name == Strings::gain) &&
+                   (Val.typespec().is_float() || Val.typespec().is_int())) {
+            OSL_DEV_ONLY(std::cout << "Varying " << name << std::endl);
+            llvm::Value *wide_val = rop.llvm_load_value (Val,
+                    /*deriv=*/0, /*component=*/0, /*cast=*/TypeDesc::TypeFloat, /*op_is_uniform=*/false);
+            llvm::Value *scalar_val = rop.ll.op_extract(wide_val, leadLane);
+            remainingMask = rop.ll.op_lanes_that_match_masked(scalar_val, wide_val, remainingMask);
+            rop.ll.call_function (name == Strings::gain
+                                      ? "osl_noiseparams_set_gain"
+                                      : "osl_noiseparams_set_lacunarity",
+                                  opt, scalar_val);
         } else if (name == Strings::direction && Val.typespec().is_triple()) {
                     OSL_DEV_ONLY(std::cout << "Varying direction" << std::endl);
                     // As we passed the pointer to the varying direction along
@@ -5488,6 +5605,15 @@ LLVMGEN (llvm_gen_noise)
         pass_options = true;
         derivs = true;
         name = periodic ? Strings::gaborpnoise : Strings::gabornoise;
+    } else if ((name == Strings::fbm || name == Strings::turbulence ||
+                name == Strings::ridged) && !periodic) {
+        pass_name = true;
+        pass_sg = true;
+        pass_options = true;
+        derivs = true;
+        name = (name == Strings::fbm) ? Strings::fbmnoise
+             : (name == Strings::turbulence) ? Strings::turbulencenoise
+             : Strings::ridgednoise;
     } else {
         rop.shadingcontext()->errorf ("%snoise type \"%s\" is unknown, called from (%s:%d)",
                                 (periodic ? "periodic " : ""), name.c_str(),
@@ -6361,13 +6487,71 @@ LLVMGEN (llvm_gen_spline)
 
     bool op_is_uniform = Spline.is_uniform() && Value.is_uniform() && Knots.is_uniform();
 
+    // only use derivatives for result if:
+    //   result has derivs and (value || knots) have derivs
+    bool op_derivs = Result.has_derivs() && (Value.has_derivs() || Knots.has_derivs());
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    // With a constant basis and knots, apply the basis to the knots once
+    // here and pass the per-segment coefficients (and for splineinverse,
+    // a table of samples) instead, just as the scalar code generator does.
+    if (Spline.is_constant() && Knots.is_constant() && !Knots.has_derivs()
+          && (!has_knot_count || Knot_count.is_constant())) {
+        int knot_count = has_knot_count ? Knot_count.get_int()
+                                        : Knots.typespec().arraylength();
+        int ncomps = Knots.typespec().simpletype().elementtype().aggregate;
+        bool inverse = (op.opname() == "splineinverse");
+        bool with_inverse = inverse;
+        std::vector<float> table;
+        int nsegs = 0;
+        if (knot_count <= Knots.typespec().arraylength())
+            nsegs = Spline::build_table (table,
+                        Spline::basis_type_of (Spline.get_string()),
+                        (const float *)Knots.dataptr(), knot_count, ncomps,
+                        with_inverse);
+        if (nsegs && with_inverse == inverse) {
+            FuncSpec table_spec(inverse ? "splineinverse_table" : "spline_table");
+            table_spec.arg(Result, op_derivs, Value.is_uniform());
+            table_spec.arg(Value, op_derivs && Value.has_derivs(), Value.is_uniform());
+            table_spec.arg(Knots.typespec().simpletype().elementtype(), false, true);
+
+            llvm::Value *temp_uniform_results = nullptr;
+            llvm::Value *result_ptr = nullptr;
+            if (Value.is_uniform() && !Result.is_uniform()) {
+                temp_uniform_results = rop.getOrAllocateTemp (Result.typespec(), Result.has_derivs(), true /*is_uniform*/, false /*forceBool*/, "uniform spline result");
+                result_ptr = rop.ll.void_ptr(temp_uniform_results);
+            } else {
+                result_ptr = rop.llvm_void_ptr (Result);
+            }
+            std::vector<llvm::Value *> args = {
+                result_ptr,
+                rop.llvm_void_ptr (Value),
+                rop.ll.constant_data_ptr (table.data(),
+                                          table.size() * sizeof(float),
+                                          (int)alignof(float), "spline_table"),
+                rop.ll.constant (nsegs)
+            };
+            if (Value.is_uniform()) {
+                table_spec.unbatch();
+            } else {
+                table_spec.mask();
+                args.push_back (rop.ll.mask_as_int(rop.ll.current_mask()));
+            }
+            rop.ll.call_function (rop.build_name(table_spec), args);
+            if (temp_uniform_results)
+                rop.llvm_broadcast_uniform_value_from_mem(temp_uniform_results, Result);
+
+            if (Result.has_derivs() && !op_derivs)
+                rop.llvm_zero_derivs (Result);
+            return true;
+        }
+    }
+
     FuncSpec func_spec(op.opname().c_str());
 
     //std::string name = Strutil::sprintf("osl_%s_", op.opname());
     std::vector<llvm::Value *> args;
-    // only use derivatives for result if:
-    //   result has derivs and (value || knots) have derivs
-    bool op_derivs = Result.has_derivs() && (Value.has_derivs() || Knots.has_derivs());
 
     func_spec.arg(Result,op_derivs,op_is_uniform);
     func_spec.arg(Value,op_derivs && Value.has_derivs(), Value.is_uniform());
@@ -6381,8 +6565,6 @@ LLVMGEN (llvm_gen_spline)
     }
     const char * splineFuncName = rop.build_name(func_spec);
 
-    BatchedBackendLLVM::TempScope temp_scope(rop);
-
     llvm::Value *temp_uniform_results = nullptr;
     if (op_is_uniform && !Result.is_uniform()) {
         temp_uniform_results = rop.getOrAllocateTemp (Result.typespec(), Result.has_derivs(), true /*is_uniform*/, false /*forceBool*/, "uniform spline result");
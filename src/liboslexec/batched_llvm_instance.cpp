@@ -1031,7 +1031,7 @@ BatchedBackendLLVM::llvm_assign_initial_value(
     llvm::BasicBlock* after_userdata_block = NULL;
     bool partial_userdata_mask_was_pushed  = false;
     LLVM_Util::ScopedMasking partial_data_masking_scope;
-    if (!sym.lockgeom() && !sym.typespec().is_closure()) {
+    if (!sym.lockgeom() && !sym.interactive() && !sym.typespec().is_closure()) {
         ustring symname = sym.name();
         TypeDesc type   = sym.typespec().simpletype();
 
@@ -1040,22 +1040,62 @@ BatchedBackendLLVM::llvm_assign_initial_value(
 
         // User connectable params must be varying
         OSL_ASSERT(sym.is_varying());
-        std::vector<llvm::Value*> args;
-        args.push_back(sg_void_ptr());
-        args.push_back(ll.constant(symname));
-        args.push_back(ll.constant(type));
-        args.push_back(
-            ll.constant((int)group().m_userdata_derivs[userdata_index]));
-        args.push_back(
-            groupdata_field_ptr(2 + userdata_index));  // userdata data ptr
-        args.push_back(ll.constant((int)sym.has_derivs()));
-        args.push_back(llvm_void_ptr(sym));
-        args.push_back(ll.constant(sym.derivsize() * m_width));
-        args.push_back(ll.void_ptr(userdata_initialized_ref(userdata_index)));
-        args.push_back(ll.constant(userdata_index));
-        args.push_back(llvm_initial_shader_mask_value);
-        llvm::Value* got_userdata
-            = ll.call_function(build_name("bind_interpolated_param"), args);
+
+        // See if userdata input placement has been used for this symbol
+        ustring layersym = ustring::fmtformat("{}.{}", inst()->layername(),
+                                              sym.name());
+        const SymLocationDesc* symloc
+            = group().find_symloc(layersym, SymArena::UserData);
+        if (!symloc)
+            symloc = group().find_symloc(sym.name(), SymArena::UserData);
+        if (symloc && !equivalent(sym.typespec(), symloc->type))
+            symloc = nullptr;
+
+        llvm::Value* got_userdata = nullptr;
+        if (symloc) {
+            // Gather each lane's value straight from the placement
+            // location of its shade index, no renderer callback needed.
+            // A null userdata base pointer fills no lanes, leaving them
+            // to the default value or init ops below.
+            int ncomps = type.numelements() * type.aggregate;
+            int nzero  = 0;
+            if (symloc->derivs && sym.has_derivs())
+                ncomps *= 3;  // If we're copying the derivs
+            else if (sym.has_derivs())
+                nzero = 2 * ncomps;  // Clear derivs the source didn't have
+            llvm::Value* args[] = { llvm_void_ptr(sym),
+                                    m_llvm_userdata_base_ptr,
+                                    ll.constanti64(symloc->offset),
+                                    ll.constanti64(symloc->stride),
+                                    m_llvm_shadeindex,
+                                    ll.constant(ncomps),
+                                    ll.constant(int(type.basesize())),
+                                    ll.constant(nzero),
+                                    llvm_initial_shader_mask_value };
+            got_userdata
+                = ll.call_function(build_name(
+                                       FuncSpec("copy_symloc_to_wide").mask()),
+                                   args);
+        } else {
+            std::vector<llvm::Value*> args;
+            args.push_back(sg_void_ptr());
+            args.push_back(ll.constant(symname));
+            args.push_back(ll.constant(type));
+            args.push_back(
+                ll.constant((int)group().m_userdata_derivs[userdata_index]));
+            args.push_back(
+                groupdata_field_ptr(2 + userdata_index));  // userdata data ptr
+            args.push_back(ll.constant((int)sym.has_derivs()));
+            args.push_back(llvm_void_ptr(sym));
+            args.push_back(ll.constant(sym.derivsize() * m_width));
+            args.push_back(
+                ll.void_ptr(userdata_initialized_ref(userdata_index)));
+            args.push_back(ll.constant(userdata_index));
+            args.push_back(llvm_initial_shader_mask_value);
+            got_userdata = ll.call_function(build_name(
+                                                "bind_interpolated_param"),
+                                            args);
+        }
         llvm::Value* got_userdata_mask = ll.int_as_mask(got_userdata);
 
         if (shadingsys().debug_nan() && type.basetype == TypeDesc::FLOAT) {
@@ -1617,17 +1657,22 @@ BatchedBackendLLVM::build_llvm_code(int beginop, int endop,
 llvm::Function*
 BatchedBackendLLVM::build_llvm_init()
 {
-    // Make a group init function: void group_init(ShaderGlobals*, GroupData*)
+    // Make a group init function: void group_init(ShaderGlobals*, GroupData*,
+    //     void* userdata_base_ptr, void* output_base_ptr, int shadeindex,
+    //     int mask_value)
     // Note that the GroupData* is passed as a void*.
     OSL_ASSERT(m_library_selector);
     std::string unique_name = Strutil::sprintf("%s_group_%d_init",
                                                m_library_selector,
                                                group().id());
-    ll.current_function(ll.make_function(unique_name, false,
-                                         ll.type_void(),  // return type
-                                         { llvm_type_sg_ptr(),
-                                           llvm_type_groupdata_ptr(),
-                                           ll.type_int() }));
+    ll.current_function(
+        ll.make_function(unique_name, false,
+                         ll.type_void(),  // return type
+                         { llvm_type_sg_ptr(), llvm_type_groupdata_ptr(),
+                           ll.type_void_ptr(),  // userdata_base_ptr
+                           ll.type_void_ptr(),  // output_base_ptr
+                           ll.type_int(),       // shadeindex
+                           ll.type_int() }));   // mask_value
 
     if (ll.debug_is_enabled()) {
         ustring file_name
@@ -1639,8 +1684,11 @@ BatchedBackendLLVM::build_llvm_init()
     // Get shader globals and groupdata pointers
     m_llvm_shaderglobals_ptr = ll.current_function_arg(0);  //arg_it++;
     m_llvm_groupdata_ptr     = ll.current_function_arg(1);  //arg_it++;
+    m_llvm_userdata_base_ptr = ll.current_function_arg(2);  //arg_it++;
+    m_llvm_output_base_ptr   = ll.current_function_arg(3);  //arg_it++;
+    m_llvm_shadeindex        = ll.current_function_arg(4);  //arg_it++;
     // TODO: do we need to utilize the shader mask in the init function?
-    //llvm::Value * llvm_initial_shader_mask_value = ll.current_function_arg(2); //arg_it++;
+    //llvm::Value * llvm_initial_shader_mask_value = ll.current_function_arg(5); //arg_it++;
 
     // New function, reset temp matrix pointer
     m_llvm_temp_wide_matrix_ptr             = nullptr;
@@ -1730,7 +1778,9 @@ BatchedBackendLLVM::build_llvm_init()
 llvm::Function*
 BatchedBackendLLVM::build_llvm_instance(bool groupentry)
 {
-    // Make a layer function: void layer_func(ShaderGlobals*, GroupData*)
+    // Make a layer function: void layer_func(ShaderGlobals*, GroupData*,
+    //     void* userdata_base_ptr, void* output_base_ptr, int shadeindex,
+    //     int mask_value)
     // Note that the GroupData* is passed as a void*.
     OSL_ASSERT(m_library_selector);
     std::string unique_layer_name
@@ -1743,7 +1793,11 @@ BatchedBackendLLVM::build_llvm_instance(bool groupentry)
         unique_layer_name,
         !is_entry_layer,  // fastcall for non-entry layer functions
         ll.type_void(),   // return type
-        { llvm_type_sg_ptr(), llvm_type_groupdata_ptr(), ll.type_int() }));
+        { llvm_type_sg_ptr(), llvm_type_groupdata_ptr(),
+          ll.type_void_ptr(),  // userdata_base_ptr
+          ll.type_void_ptr(),  // output_base_ptr
+          ll.type_int(),       // shadeindex
+          ll.type_int() }));   // mask_value
 
     if (ll.debug_is_enabled()) {
         const Opcode& mainbegin (inst()->op(inst()->maincodebegin()));
@@ -1755,8 +1809,11 @@ BatchedBackendLLVM::build_llvm_instance(bool groupentry)
     // Get shader globals and groupdata pointers
     m_llvm_shaderglobals_ptr = ll.current_function_arg(0);  //arg_it++;
     m_llvm_groupdata_ptr     = ll.current_function_arg(1);  //arg_it++;
+    m_llvm_userdata_base_ptr = ll.current_function_arg(2);  //arg_it++;
+    m_llvm_output_base_ptr   = ll.current_function_arg(3);  //arg_it++;
+    m_llvm_shadeindex        = ll.current_function_arg(4);  //arg_it++;
     llvm::Value* llvm_initial_shader_mask_value = ll.current_function_arg(
-        2);  //arg_it++;
+        5);  //arg_it++;
 
     // New function, reset temp matrix pointer
     m_llvm_temp_wide_matrix_ptr             = nullptr;
@@ -2052,6 +2109,53 @@ BatchedBackendLLVM::build_llvm_instance(bool groupentry)
         // llvm_gen_debug_printf ("done copying connections");
     }
 
+    // Copy results to renderer outputs.  Each lane is written to the
+    // placement location of its own shade index, so a contiguous batch
+    // lands directly in the renderer's output buffers.
+    FOREACH_PARAM(Symbol & s, inst())
+    {
+        if (!s.renderer_output())  // Skip if not a renderer output
+            continue;
+        // Try to look up the sym among the outputs with the full layer.name
+        // specification first. If that fails, look for name only.
+        ustring layersym = ustring::fmtformat("{}.{}", inst()->layername(),
+                                              s.name());
+        auto symloc = group().find_symloc(layersym, SymArena::Outputs);
+        if (!symloc)
+            symloc = group().find_symloc(s.name(), SymArena::Outputs);
+        if (!symloc)
+            continue;  // not found in either place
+
+        if (!equivalent(s.typespec(), symloc->type)
+            || s.typespec().is_closure()) {
+            std::cout << "No output copy for " << s.typespec() << ' '
+                      << s.name() << " because of type mismatch vs symloc="
+                      << symloc->type << "\n";
+            continue;  // types didn't match
+        }
+        // make_renderer_outputs_varying() guarantees the wide layout
+        OSL_ASSERT(s.is_varying());
+
+        TypeDesc type = s.typespec().simpletype();
+        int ncomps    = type.numelements() * type.aggregate;
+        int nzero     = 0;
+        if (symloc->derivs && s.has_derivs())
+            ncomps *= 3;  // If we're copying the derivs
+        else if (symloc->derivs)
+            nzero = 2 * ncomps;  // Clear derivs the source didn't have
+        llvm::Value* args[] = { m_llvm_output_base_ptr,
+                                ll.constanti64(symloc->offset),
+                                ll.constanti64(symloc->stride),
+                                m_llvm_shadeindex,
+                                llvm_void_ptr(s),
+                                ll.constant(ncomps),
+                                ll.constant(int(type.basesize())),
+                                ll.constant(nzero),
+                                llvm_initial_shader_mask_value };
+        ll.call_function(build_name(FuncSpec("copy_wide_to_symloc").mask()),
+                         args);
+    }
+
     // All done
     if (shadingsys().llvm_debug_layers())
         llvm_gen_debug_printf(
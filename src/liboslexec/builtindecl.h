@@ -137,6 +137,9 @@ NOISE_DERIV_IMPL(simplexnoise)
 NOISE_IMPL(usimplexnoise)
 NOISE_DERIV_IMPL(usimplexnoise)
 GENERIC_NOISE_DERIV_IMPL(gabornoise)
+GENERIC_NOISE_DERIV_IMPL(fbmnoise)
+GENERIC_NOISE_DERIV_IMPL(turbulencenoise)
+GENERIC_NOISE_DERIV_IMPL(ridgednoise)
 GENERIC_NOISE_DERIV_IMPL(genericnoise)
 NOISE_IMPL(nullnoise)
 NOISE_DERIV_IMPL(nullnoise)
@@ -156,6 +159,9 @@ DECL (osl_noiseparams_set_do_filter, "xXi")
 DECL (osl_noiseparams_set_direction, "xXv")
 DECL (osl_noiseparams_set_bandwidth, "xXf")
 DECL (osl_noiseparams_set_impulses, "xXf")
+DECL (osl_noiseparams_set_octaves, "xXi")
+DECL (osl_noiseparams_set_lacunarity, "xXf")
+DECL (osl_noiseparams_set_gain, "xXf")
 DECL (osl_count_noise, "xX")
 DECL (osl_hash_ii,  "ii")
 DECL (osl_hash_if,  "if")
@@ -175,8 +181,16 @@ DECL (osl_splineinverse_fff, "xXXXXii")
 DECL (osl_splineinverse_dfdfdf, "xXXXXii")
 DECL (osl_splineinverse_dfdff, "xXXXXii")
 DECL (osl_splineinverse_dffdf, "xXXXXii")
+DECL (osl_spline_table_fff, "xXXXi")
+DECL (osl_spline_table_dfdff, "xXXXi")
+DECL (osl_spline_table_vfv, "xXXXi")
+DECL (osl_spline_table_dvdfv, "xXXXi")
+DECL (osl_splineinverse_table_fff, "xXXXi")
+DECL (osl_splineinverse_table_dfdff, "xXXXi")
 DECL (osl_setmessage, "xXsLXisi")
 DECL (osl_getmessage, "iXssLXiisi")
+DECL (osl_setmessage_slot, "xXisLXisi")
+DECL (osl_getmessage_slot, "iXisLXiisi")
 DECL (osl_pointcloud_search, "iXsXfiiXXii*")
 DECL (osl_pointcloud_get, "iXsXisLX")
 DECL (osl_pointcloud_write, "iXsXiXXX")
@@ -186,6 +186,7 @@ DECL(__OSL_OP(fprintf), "xXiss*")
 DECL(__OSL_MASKED_OP(split), "xXXXXXii")
 
 // DECL (osl_incr_layers_executed, "xX") // original used by wide currently
+DECL(__OSL_OP(incr_uniform_lanes_checks), "xXi")
 
 WIDE_NOISE_IMPL(cellnoise)
 // commented out in non-wide, there is no derivative version of cellnoise
@@ -224,6 +225,9 @@ WIDE_PNOISE_IMPL(phashnoise)
 
 
 WIDE_GENERIC_NOISE_DERIV_IMPL(gabornoise)
+WIDE_GENERIC_NOISE_DERIV_IMPL(fbmnoise)
+WIDE_GENERIC_NOISE_DERIV_IMPL(turbulencenoise)
+WIDE_GENERIC_NOISE_DERIV_IMPL(ridgednoise)
 WIDE_GENERIC_PNOISE_DERIV_IMPL(gaborpnoise)
 
 WIDE_GENERIC_NOISE_DERIV_IMPL(genericnoise)
@@ -312,6 +316,14 @@ DECL(__OSL_MASKED_OP3(splineinverse, Wdf, f, Wdf), "xXXXXiii")
 // // unreachable, can't find .osl to produce this combination
 //DECL(__OSL_MASKED_OP3(splineinverse, Wdf, Wf, Wdf), "xXXXXiii")
 
+// constant basis and knots, passed as a table of coefficients
+DECL(__OSL_MASKED_OP3(spline_table, Wf, Wf, f), "xXXXii")
+DECL(__OSL_MASKED_OP3(spline_table, Wdf, Wdf, f), "xXXXii")
+DECL(__OSL_MASKED_OP3(spline_table, Wv, Wf, v), "xXXXii")
+DECL(__OSL_MASKED_OP3(spline_table, Wdv, Wdf, v), "xXXXii")
+DECL(__OSL_MASKED_OP3(splineinverse_table, Wf, Wf, f), "xXXXii")
+DECL(__OSL_MASKED_OP3(splineinverse_table, Wdf, Wdf, f), "xXXXii")
+
 #ifdef __OSL_TBD
 //DECL (osl_setmessage, "xXsLXisi")
 DECL (osl_pointcloud_search, "iXsXfiiXXii*")
@@ -386,6 +398,8 @@ DECL(__OSL_OP(get_attribute_uniform), "iXiXXiiXX")
 
 // TODO:  shouldn't bind_interpolated_param be MASKED?  change name to reflect
 DECL(__OSL_OP(bind_interpolated_param), "iXXLiXiXiXii")
+DECL(__OSL_MASKED_OP(copy_symloc_to_wide), "iXXLLiiiii")
+DECL(__OSL_MASKED_OP(copy_wide_to_symloc), "xXLLiXiiii")
 
 //DECL (osl_get_texture_options, "XX") // uneeded
 DECL(__OSL_OP(get_noise_options), "XX")
@@ -2732,6 +2732,46 @@ DECLFOLDER(constfold_pointcloud_get)
 
 
 
+// Evaluate a noise functor on constant coordinates and replace the op
+// with an assignment of the result.
+template<class NOISE>
+static int
+fold_const_noise (RuntimeOptimizer &rop, int opnum, int outdim,
+                  const float *input, int indim, const NOISE &noise,
+                  const char *why)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    if (outdim == 1) {
+        float n;
+        if (indim == 1)
+            noise (n, input[0]);
+        else if (indim == 2)
+            noise (n, input[0], input[1]);
+        else if (indim == 3)
+            noise (n, Vec3(input[0], input[1], input[2]));
+        else
+            noise (n, Vec3(input[0], input[1], input[2]), input[3]);
+        int cind = rop.add_constant (n);
+        rop.turn_into_assign (op, cind, why);
+    } else {
+        OSL_DASSERT (outdim == 3);
+        Vec3 n;
+        if (indim == 1)
+            noise (n, input[0]);
+        else if (indim == 2)
+            noise (n, input[0], input[1]);
+        else if (indim == 3)
+            noise (n, Vec3(input[0], input[1], input[2]));
+        else
+            noise (n, Vec3(input[0], input[1], input[2]), input[3]);
+        int cind = rop.add_constant (TypeDesc::TypePoint, &n);
+        rop.turn_into_assign (op, cind, why);
+    }
+    return 1;
+}
+
+
+
 DECLFOLDER(constfold_noise)
 {
     Opcode &op (rop.inst()->ops()[opnum]);
@@ -2760,9 +2800,11 @@ DECLFOLDER(constfold_noise)
     if (op.argtakesderivs_all() &&  name.length() && name != "gabor")
         op.argtakesderivs_all(0);
 
-    // Gabor noise is the only one that takes optional arguments, so
-    // optimize them away for other noise types.
-    if (name.length() && name != "gabor") {
+    // Gabor and the fractal noises are the only ones that take optional
+    // arguments, so optimize them away for other noise types.
+    bool fractal = (name == Strings::fbm || name == Strings::turbulence ||
+                    name == Strings::ridged);
+    if (name.length() && name != "gabor" && !fractal) {
         for (int a = arg; a < op.nargs(); ++a) {
             // Advance until we hit a string argument, which will be the
             // first optional token/value pair. Then just turn all arguments
@@ -2780,8 +2822,58 @@ DECLFOLDER(constfold_noise)
         }
     }
 
-    // Early out: for now, we only fold cell noise
-    if (name != u_cellnoise && name != u_cell)
+    // Fractal options that are known constants can be settled now: ones
+    // equal to the defaults need not be passed at all, and a single octave
+    // of fbm is plain snoise (the sum is normalized by its amplitude).
+    if (fractal) {
+        static const NoiseParams defaults;
+        bool single_octave = false;
+        int changed = 0;
+        for (int a = arg; a + 1 < op.nargs(); ++a) {
+            Symbol *Opt = rop.opargsym(op,a);
+            if (! Opt->typespec().is_string())
+                continue;
+            Symbol *Val = rop.opargsym(op,a+1);
+            if (! Opt->is_constant() || ! Val->is_constant() ||
+                ! (Val->typespec().is_float() || Val->typespec().is_int())) {
+                ++a;
+                continue;
+            }
+            ustring optname = Opt->get_string();
+            float v = Val->typespec().is_int() ? float(Val->get_int())
+                                               : Val->get_float();
+            if (optname == Strings::octaves && int(v) <= 1)
+                single_octave = true;
+            if ((optname == Strings::octaves && int(v) == defaults.octaves) ||
+                (optname == Strings::lacunarity && v == defaults.lacunarity) ||
+                (optname == Strings::gain && v == defaults.gain)) {
+                int cind = rop.add_constant (ustring());
+                rop.inst()->args()[op.firstarg()+a] = cind;
+                rop.inst()->args()[op.firstarg()+a+1] = cind;
+                ++changed;
+            }
+            ++a;
+        }
+        if (single_octave && name == Strings::fbm) {
+            int cind = rop.add_constant (ustring());
+            for (int a = arg; a < op.nargs(); ++a) {
+                if (rop.opargsym(op,a)->typespec().is_string()) {
+                    for ( ; a + 1 < op.nargs(); a += 2) {
+                        rop.inst()->args()[op.firstarg()+a] = cind;
+                        rop.inst()->args()[op.firstarg()+a+1] = cind;
+                    }
+                }
+            }
+            rop.inst()->args()[op.firstarg()+1] = rop.add_constant (Strings::snoise);
+            rop.debug_opt_ops (opnum, opnum+1, "single octave fbm -> snoise");
+            return 1;
+        }
+        if (changed)
+            return 1;
+    }
+
+    // Early out: for now, we only fold cell and fractal noise
+    if (name != u_cellnoise && name != u_cell && !fractal)
         return 0;
 
     // Take an early out if any args are not constant (other than the result)
@@ -2802,7 +2894,31 @@ DECLFOLDER(constfold_noise)
             input[indim++] = in->get_float(2);
         }
         else
-            return 0;  // optional args starting, we don't fold them yet
+            break;  // optional args starting
+    }
+
+    // Only fractal noise understands optional args; they are all constant
+    // by now, so pick up the octave controls the same way the runtime would.
+    NoiseParams params;
+    for ( ; arg + 1 < op.nargs(); arg += 2) {
+        if (! fractal)
+            return 0;
+        ustring optname = rop.opargsym(op,arg)->get_string();
+        const Symbol *Val = rop.opargsym(op,arg+1);
+        if (optname.empty())
+            continue;
+        if (! Val->typespec().is_float() && ! Val->typespec().is_int())
+            return 0;
+        float v = Val->typespec().is_int() ? float(Val->get_int())
+                                           : Val->get_float();
+        if (optname == Strings::octaves)
+            params.octaves = int(v);
+        else if (optname == Strings::lacunarity)
+            params.lacunarity = v;
+        else if (optname == Strings::gain)
+            params.gain = v;
+        else
+            return 0;  // leave unknown options for the back end to report
     }
 
 #if OSL_GNUC_VERSION >= 90000
@@ -2840,6 +2956,21 @@ DECLFOLDER(constfold_noise)
             return 1;
         }
     }
+    if (fractal) {
+        int oct = params.octaves;
+        float lac = params.lacunarity, gain = params.gain;
+        if (name == Strings::fbm)
+            return fold_const_noise (rop, opnum, outdim, input, indim,
+                        FractalNoiseImpl<FractalType::FBM> (oct, lac, gain),
+                        "const fold fbm noise");
+        if (name == Strings::turbulence)
+            return fold_const_noise (rop, opnum, outdim, input, indim,
+                        FractalNoiseImpl<FractalType::Turbulence> (oct, lac, gain),
+                        "const fold turbulence noise");
+        return fold_const_noise (rop, opnum, outdim, input, indim,
+                        FractalNoiseImpl<FractalType::Ridged> (oct, lac, gain),
+                        "const fold ridged noise");
+    }
 #if OSL_GNUC_VERSION >= 90000
 #    pragma GCC diagnostic pop
 #endif
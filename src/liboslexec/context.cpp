@@ -7,6 +7,7 @@
 #include <cstdio>
 #include <cstdint>
 
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/timer.h>
 #include <OpenImageIO/thread.h>
@@ -25,9 +26,6 @@
 OSL_NAMESPACE_ENTER
 
 static mutex buffered_errors_mutex;
-#if OSL_USE_BATCHED
-static mutex buffered_file_output_mutex;
-#endif
 
 
 namespace pvt {
@@ -57,29 +55,71 @@ ShadingContext::ShadingContext (ShadingSystemImpl &shadingsys,
 ShadingContext::~ShadingContext ()
 {
     process_errors ();
-#if OSL_USE_BATCHED
     process_file_output();
-#endif
     m_shadingsys.m_stat_contexts -= 1;
     free_dict_resources ();
 }
 
 
 
+ShaderGroup&
+ShadingContext::select_group (ShaderGroup& requested, int raytype)
+{
+    // A group identical to one seen before runs that one's code. A ray
+    // that doesn't need derivatives runs the derivative-free variant. An
+    // interactive group runs its fully specialized clone instead, if
+    // respecialize() has installed one, and so does a quick-compiled group
+    // that recompile_hot_groups() has promoted. We hold a reference so that an
+    // edit that drops the clone can't free it while we're running it.
+    m_requested_group = &requested;
+    ShaderGroup *g = &requested;
+    if (requested.maybe_shared()) {
+        // The twin found last time still holds as long as neither group
+        // has been edited since (twins always hash alike), so repeated
+        // executes of the same group skip the atomic load and reference
+        // count of shared_body().
+        if (&requested != m_dedup_requested || ! m_dedup_body
+              || requested.m_dedup_dirty || m_dedup_body->m_dedup_dirty
+              || m_dedup_body->m_dedup_hash != requested.m_dedup_hash) {
+            m_dedup_requested = &requested;
+            m_dedup_body = shadingsys().shared_body (requested);
+        }
+        if (m_dedup_body)
+            g = m_dedup_body.get();
+    }
+    ShaderGroupRef run;
+    if (raytype & requested.no_derivs_raytypes()) {
+        if (ShaderGroupRef v = shadingsys().no_derivs_variant (*g)) {
+            run = v;
+            g = v.get();
+        }
+    }
+    if (g->interactive() || g->llvm_tier() == ShaderGroup::LLVMTierPromoted)
+        if (ShaderGroupRef s = g->specialized()) {
+            run = s;
+            g = s.get();
+        }
+    m_specialized_group = run;
+    return *g;
+}
+
+
+
 bool
-ShadingContext::execute_init(ShaderGroup& sgroup, int shadeindex,
+ShadingContext::execute_init(ShaderGroup& requested, int shadeindex,
                              ShaderGlobals& ssg, void* userdata_base_ptr,
                              void* output_base_ptr, bool run)
 {
     if (m_group)
         execute_cleanup ();
+    ShaderGroup& sgroup (select_group (requested, ssg.raytype));
     batch_size_executed = 0;
     m_group = &sgroup;
     m_ticks = 0;
 
     // Optimize if we haven't already
     if (sgroup.nlayers()) {
-        sgroup.start_running ();
+        sgroup.start_running (shadingsys().llvm_tier_threshold() > 0);
         if (! sgroup.jitted()) {
             auto ctx = shadingsys().get_context(thread_info());
             shadingsys().optimize_group (sgroup, ctx, true /*do_jit*/);
@@ -106,11 +146,19 @@ ShadingContext::execute_init(ShaderGroup& sgroup, int shadeindex,
     if (shadingsys().m_clearmemory)
         memset (m_heap.get(), 0, heap_size_needed);
 
-    // Set up closure storage
+    // Set up closure storage, sized for what this group needs
     m_closure_pool.clear();
+    m_closure_pool.reserve (sgroup.pool_size_closures());
 
     // Clear the message blackboard
     m_messages.clear ();
+    m_messages.set_slots (sgroup.message_names());
+    m_messages.reserve (sgroup.pool_size_messages());
+
+    // Forget named-space matrices from the previous shade, unless the
+    // renderer has asked for them to persist
+    if (shadingsys().matrix_cache() < 2)
+        m_matrix_cache.clear ();
 
     // Clear miscellaneous scratch space
     m_scratch_pool.clear ();
@@ -173,9 +221,17 @@ ShadingContext::execute_cleanup ()
 
     // Process any queued up error messages, warnings, printfs from shaders
     process_errors ();
-#if OSL_USE_BATCHED
     process_file_output();
-#endif
+
+    // The group that ran sizes its pools from these; the one asked for
+    // (which may have run a twin's code or a specialized clone, which
+    // respecializing replaces) is the one callers query.
+    group()->record_pool_usage (m_closure_pool.used(), m_messages.used(),
+                                m_scratch_pool.used());
+    if (m_requested_group && m_requested_group != group())
+        m_requested_group->record_pool_usage (m_closure_pool.used(),
+                                              m_messages.used(),
+                                              m_scratch_pool.used());
 
     if (shadingsys().m_profile) {
         record_runtime_stats ();   // Transfer runtime stats to the shadingsys
@@ -233,10 +289,14 @@ ShadingContext::execute (ShaderGroup &sgroup, int shadeindex,
 template<int WidthT>
 bool
 ShadingContext::Batched<WidthT>::execute_init
-(ShaderGroup &sgroup, int batch_size, BatchedShaderGlobals<WidthT> &bsg, bool run)
+(ShaderGroup &requested, int batch_size, int shadeindex,
+ BatchedShaderGlobals<WidthT> &bsg, void* userdata_base_ptr,
+ void* output_base_ptr, bool run)
 {
     if (context().m_group)
         context().execute_cleanup ();
+    ShaderGroup& sgroup (context().select_group (requested,
+                                                  bsg.uniform.raytype));
 
     context().batch_size_executed = batch_size;
     context().m_group = &sgroup;
@@ -244,7 +304,7 @@ ShadingContext::Batched<WidthT>::execute_init
 
     // Optimize if we haven't already
     if (sgroup.nlayers()) {
-        sgroup.start_running ();
+        sgroup.start_running (shadingsys().llvm_tier_threshold() > 0);
         if (! sgroup.batch_jitted()) {
             // Matching ShadingContext::execute_init behavior
             // of grabbing another context.
@@ -283,11 +343,14 @@ ShadingContext::Batched<WidthT>::execute_init
     if (shadingsys().m_clearmemory)
         memset (context().m_heap.get(), 0, heap_size_needed);
 
-    // Set up closure storage
+    // Set up closure storage, sized for what this group needs
     context().m_closure_pool.clear();
+    context().m_closure_pool.reserve (sgroup.pool_size_closures());
 
     // Clear the message blackboard
     context().m_messages.clear ();
+    context().m_messages.set_slots (sgroup.message_names());
+    context().m_messages.reserve (sgroup.pool_size_messages());
     context().batched_messages_buffer().clear ();
 
     // Clear miscellaneous scratch space
@@ -308,7 +371,8 @@ ShadingContext::Batched<WidthT>::execute_init
             Mask<WidthT> run_mask(false);
             run_mask.set_count_on(batch_size);
 
-            run_func (&bsg, context().m_heap.get(), run_mask.value());
+            run_func (&bsg, context().m_heap.get(), userdata_base_ptr,
+                      output_base_ptr, shadeindex, run_mask.value());
         }
     }
 
@@ -319,7 +383,11 @@ ShadingContext::Batched<WidthT>::execute_init
 
 template<int WidthT>
 bool
-ShadingContext::Batched<WidthT>::execute_layer (int batch_size, BatchedShaderGlobals<WidthT> &bsg, int layernumber)
+ShadingContext::Batched<WidthT>::execute_layer (int batch_size, int shadeindex,
+                                                BatchedShaderGlobals<WidthT> &bsg,
+                                                void* userdata_base_ptr,
+                                                void* output_base_ptr,
+                                                int layernumber)
 {
     if (!group() || group()->nlayers() == 0 || group()->does_nothing() || (context().batch_size_executed != batch_size))
         return false;
@@ -339,7 +407,8 @@ ShadingContext::Batched<WidthT>::execute_layer (int batch_size, BatchedShaderGlo
         Mask<WidthT> run_mask(false);
         run_mask.set_count_on(batch_size);
 
-        run_func (&bsg, context().m_heap.get(), run_mask.value());
+        run_func (&bsg, context().m_heap.get(), userdata_base_ptr,
+                  output_base_ptr, shadeindex, run_mask.value());
     }
 
     if (profile)
@@ -351,7 +420,11 @@ ShadingContext::Batched<WidthT>::execute_layer (int batch_size, BatchedShaderGlo
 
 template<int WidthT>
 bool
-ShadingContext::Batched<WidthT>::execute(ShaderGroup &sgroup, int batch_size, BatchedShaderGlobals<WidthT> &bsg, bool run)
+ShadingContext::Batched<WidthT>::execute(ShaderGroup &sgroup, int batch_size,
+                                         int shadeindex,
+                                         BatchedShaderGlobals<WidthT> &bsg,
+                                         void* userdata_base_ptr,
+                                         void* output_base_ptr, bool run)
 {
     OSL_ASSERT(is_aligned<64>(&bsg));
     int n = sgroup.m_exec_repeat;
@@ -369,10 +442,12 @@ ShadingContext::Batched<WidthT>::execute(ShaderGroup &sgroup, int batch_size, Ba
 
     bool result = true;
     while (1) {
-        if (! execute_init (sgroup, batch_size, bsg, run))
+        if (! execute_init (sgroup, batch_size, shadeindex, bsg,
+                            userdata_base_ptr, output_base_ptr, run))
             return false;
         if (run && n)
-            execute_layer (batch_size, bsg, group()->nlayers()-1);
+            execute_layer (batch_size, shadeindex, bsg, userdata_base_ptr,
+                           output_base_ptr, group()->nlayers()-1);
         result = context().execute_cleanup ();
         if (--n < 1)
             break;   // done
@@ -406,6 +481,16 @@ ShadingContext::record_to_file (ustring filename,
 
 #endif
 
+void
+ShadingContext::record_to_file (ustring filename,
+                                const std::string &text) const
+{
+    if (shadingsys().m_buffer_fprintf)
+        m_buffered_file_output.emplace_back (filename, text);
+    else
+        shadingsys().file_output().append (filename, text);
+}
+
 void
 ShadingContext::record_error (ErrorHandler::ErrCode code,
                               const std::string &text) const
@@ -495,37 +580,101 @@ ShadingContext::process_errors () const
     m_buffered_errors.clear();
 }
 
-#if OSL_USE_BATCHED
 void
 ShadingContext::process_file_output () const
 {
-    int nerrors(m_buffered_file_output.size());
-    if (! nerrors)
+    int nitems(m_buffered_file_output.size());
+    if (! nitems)
         return;
 
-    // Use a mutex to make sure output from different threads stays
-    // together, at least for one shader invocation, rather than being
-    // interleaved with other threads.
-    lock_guard lock (buffered_file_output_mutex);
-
-    OSL_ASSERT(execution_is_batched());
-    OSL_DASSERT(batch_size_executed <= MaxSupportedSimdLaneCount);
-    // Process each data lane separately and in the correct order
-    for(int lane=0; lane < batch_size_executed; ++lane) {
-        for (int i = 0;  i < nerrors;  ++i) {
-            const auto & item = m_buffered_file_output[i];
-            if (item.mask.is_on(lane)){
-                // TODO: if performance critical, one could keep a cache of
-                // open files instead of closing and reopening
-                FILE *file = fopen (item.filename.c_str(), "a");
-                fputs (item.msgString.c_str(), file);
-                fclose (file);
+    // Gather this shade's text for each file, so that it reaches the
+    // output manager as one piece per file and can't be interleaved with
+    // the output of other threads.
+    std::vector<std::pair<ustring,std::string>> files;
+    auto add = [&](const FileItem &item) {
+        for (auto &f : files) {
+            if (f.first == item.filename) {
+                f.second += item.msgString;
+                return;
+            }
+        }
+        files.emplace_back (item.filename, item.msgString);
+    };
+
+#if OSL_USE_BATCHED
+    if (execution_is_batched()) {
+        OSL_DASSERT(batch_size_executed <= MaxSupportedSimdLaneCount);
+        // Process each data lane separately and in the correct order
+        for (int lane = 0; lane < batch_size_executed; ++lane) {
+            for (int i = 0;  i < nitems;  ++i) {
+                const auto & item = m_buffered_file_output[i];
+                if (item.mask.is_on(lane))
+                    add (item);
             }
         }
+    } else
+#endif
+    {
+        for (int i = 0;  i < nitems;  ++i)
+            add (m_buffered_file_output[i]);
     }
     m_buffered_file_output.clear();
+
+    FileOutputManager &out (shadingsys().file_output());
+    for (auto &f : files)
+        out.append (f.first, f.second);
 }
-#endif
+
+
+
+void
+pvt::FileOutputManager::append (ustring filename, string_view text)
+{
+    if (text.empty())
+        return;
+    Shard &sh (shard (filename));
+    lock_guard lock (sh.m_mutex);
+    std::string &pending (sh.m_pending[filename]);
+    pending.append (text.data(), text.size());
+    if (pending.size() >= m_flush_threshold) {
+        write (filename, pending);
+        pending.clear();
+    }
+}
+
+
+
+void
+pvt::FileOutputManager::flush ()
+{
+    for (auto &sh : m_shards) {
+        lock_guard lock (sh.m_mutex);
+        for (auto &p : sh.m_pending) {
+            if (p.second.size())
+                write (p.first, p.second);
+        }
+        sh.m_pending.clear();
+    }
+}
+
+
+
+void
+pvt::FileOutputManager::write (ustring filename, const std::string &text)
+{
+    FILE *file = OIIO::Filesystem::fopen (filename, "a");
+    if (! file) {
+        m_shadingsys.errorfmt ("Could not open \"{}\" for fprintf output",
+                               filename);
+        return;
+    }
+    fwrite (text.data(), 1, text.size(), file);
+    fclose (file);
+    m_bytes_written += text.size();
+    m_file_writes += 1;
+}
+
+
 
 const Symbol *
 ShadingContext::symbol (ustring layername, ustring symbolname) const
@@ -539,6 +688,27 @@ const void *
 ShadingContext::symbol_data (const Symbol &sym) const
 {
     const ShaderGroup &sgroup (*group());
+
+    // Symbols that the caller found in the group it asked for, or (for a
+    // group sharing an identical one's code) in the group whose code it
+    // shares, stand for the same-named ones of the one we actually ran (a
+    // specialized clone or a derivative-free variant).
+    const ShaderGroup *owners[2] = { m_requested_group,
+        m_dedup_requested == m_requested_group ? m_dedup_body.get() : nullptr };
+    for (const ShaderGroup *owner : owners) {
+        if (! owner || owner == &sgroup)
+            continue;
+        for (int i = 0, e = owner->nlayers();  i < e;  ++i) {
+            const ShaderInstance *inst = (*owner)[i];
+            const SymbolVec &syms (inst->symbols());
+            if (syms.size() && &sym >= &syms.front() && &sym <= &syms.back()) {
+                const Symbol *s = sgroup.find_symbol (inst->layername(),
+                                                      sym.name());
+                return s ? symbol_data (*s) : NULL;
+            }
+        }
+    }
+
 #if OSL_USE_BATCHED
     if (execution_is_batched()) {
         if (! sgroup.batch_jitted())
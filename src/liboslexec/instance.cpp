@@ -30,6 +30,7 @@ ShaderInstance::ShaderInstance (ShaderMaster::ref master,
     : m_master(master),
       //DON'T COPY  m_instsymbols(m_master->m_symbols),
       //DON'T COPY  m_instops(m_master->m_ops), m_instargs(m_master->m_args),
+      m_code_shared(false), m_syms_shared(false), m_code_mem(0),
       m_layername(layername),
       m_writes_globals(false),
       m_outgoing_connections(false),
@@ -68,9 +69,11 @@ ShaderInstance::~ShaderInstance ()
 {
     shadingsys().m_stat_instances -= 1;
 
-    OSL_DASSERT (m_instops.size() == 0 && m_instargs.size() == 0);
+    // Normally released right after JIT, but a group that was optimized
+    // and never compiled still holds its code.
+    release_code ();
     ShadingSystemImpl &ss (shadingsys());
-    off_t symmem = vectorbytes (m_instsymbols) + vectorbytes(m_instoverrides);
+    off_t symmem = release_symbols () + vectorbytes(m_instoverrides);
     off_t parammem = vectorbytes (m_iparams)
         + vectorbytes (m_fparams) + vectorbytes (m_sparams);
     off_t connectionmem = vectorbytes (m_connections);
@@ -91,12 +94,13 @@ ShaderInstance::~ShaderInstance ()
 int
 ShaderInstance::findsymbol (ustring name) const
 {
-    for (size_t i = 0, e = m_instsymbols.size();  i < e;  ++i)
-        if (m_instsymbols[i].name() == name)
+    const SymbolVec &syms (symbols());
+    for (size_t i = 0, e = syms.size();  i < e;  ++i)
+        if (syms[i].name() == name)
             return (int)i;
 
     // If we haven't yet copied the syms from the master, get it from there
-    if (m_instsymbols.empty())
+    if (syms.empty())
         return m_master->findsymbol (name);
 
     return -1;
@@ -107,9 +111,10 @@ ShaderInstance::findsymbol (ustring name) const
 int
 ShaderInstance::findparam (ustring name) const
 {
-    if (m_instsymbols.size())
+    const SymbolVec &syms (symbols());
+    if (syms.size())
         for (int i = m_firstparam, e = m_lastparam;  i < e;  ++i)
-            if (m_instsymbols[i].name() == name)
+            if (syms[i].name() == name)
                 return i;
 
     // Not found? Try the master.
@@ -125,7 +130,9 @@ ShaderInstance::findparam (ustring name) const
 void *
 ShaderInstance::param_storage (int index)
 {
-    const Symbol *sym = m_instsymbols.size() ? symbol(index) : mastersymbol(index);
+    const ShaderInstance *cthis = this;
+    const Symbol *sym = cthis->symbols().size() ? cthis->symbol(index)
+                                                : mastersymbol(index);
 
     // Get the data offset. If there are instance overrides for symbols,
     // check whether we are overriding the array size, otherwise just read
@@ -353,14 +360,15 @@ ShaderInstance::parameters (const ParamValueList &params)
 void
 ShaderInstance::make_symbol_room (size_t moresyms)
 {
-    size_t oldsize = m_instsymbols.capacity();
-    if (oldsize < m_instsymbols.size()+moresyms) {
+    SymbolVec &syms (symbols());  // adding symbols needs our own
+    size_t oldsize = syms.capacity();
+    if (oldsize < syms.size()+moresyms) {
         // Allocate a bit more than we need, so that most times we don't
         // need to reallocate.  But don't be wasteful by doubling or
         // anything like that, since we only expect a few to be added.
         const size_t extra_room = 10;
-        size_t newsize = m_instsymbols.size() + moresyms + extra_room;
-        m_instsymbols.reserve (newsize);
+        size_t newsize = syms.size() + moresyms + extra_room;
+        syms.reserve (newsize);
 
         // adjust stats
         spin_lock lock (shadingsys().m_stat_mutex);
@@ -425,11 +433,12 @@ ShaderInstance::evaluate_writes_globals_and_userdata_params ()
 {
     writes_globals (false);
     userdata_params (false);
-    for (auto&& s : symbols()) {
+    const ShaderInstance *cthis = this;  // just looking, don't unshare
+    for (auto&& s : cthis->symbols()) {
         if (s.symtype() == SymTypeGlobal && s.everwritten())
             writes_globals (true);
         if ((s.symtype() == SymTypeParam || s.symtype() == SymTypeOutputParam)
-            && ! s.lockgeom() && ! s.connected())
+            && ! s.lockgeom() && ! s.interactive() && ! s.connected())
             userdata_params (true);
         if (s.symtype() == SymTypeTemp) // Once we hit a temp, we'll never
             break;                      // see another global or param.
@@ -453,47 +462,83 @@ ShaderInstance::evaluate_writes_globals_and_userdata_params ()
 void
 ShaderInstance::copy_code_from_master (ShaderGroup &group)
 {
-    OSL_ASSERT (m_instops.empty() && m_instargs.empty());
-    // reserve with enough room for a few insertions
-    m_instops.reserve (master()->m_ops.size()+10);
-    m_instargs.reserve (master()->m_args.size()+10);
-    m_instops = master()->m_ops;
-    m_instargs = master()->m_args;
+    OSL_ASSERT (m_instops.empty() && m_instargs.empty() && ! m_code_shared);
+    // Don't copy the code yet, just refer to the master's until somebody
+    // asks to modify it (see unshare_code).
+    m_code_shared = true;
+    {
+        off_t sharedmem = vectorbytes(master()->m_ops)
+                        + vectorbytes(master()->m_args);
+        spin_lock lock (shadingsys().m_stat_mutex);
+        shadingsys().m_stat_mem_inst_code_shared += sharedmem;
+    }
 
-    // Copy the symbols from the master
-    OSL_ASSERT (m_instsymbols.size() == 0 &&
+    // Likewise the symbols: they stay the master's until one of them
+    // differs, here because of the instance's parameter values and
+    // connections, or later because the optimizer changes one.
+    OSL_ASSERT (m_instsymbols.size() == 0 && ! m_syms_shared &&
                 "should not have copied m_instsymbols yet");
-    m_instsymbols = m_master->m_symbols;
+    m_syms_shared = true;
+    {
+        spin_lock lock (shadingsys().m_stat_mutex);
+        shadingsys().m_stat_mem_inst_syms_shared
+            += vectorbytes(master()->m_symbols);
+    }
 
-    // Copy the instance override data
+    // Apply the instance override data
     // Also set the renderer_output flags where needed.
     OSL_ASSERT (m_instoverrides.size() == (size_t)std::max(0,lastparam()));
-    OSL_ASSERT (m_instsymbols.size() >= (size_t)std::max(0,lastparam()));
+    OSL_ASSERT (master()->m_symbols.size() >= (size_t)std::max(0,lastparam()));
     if (m_instoverrides.size()) {
+        const ShaderInstance *cthis = this;
         for (size_t i = 0, e = lastparam();  i < e;  ++i) {
-            Symbol *si = &m_instsymbols[i];
+            // Look at the (possibly shared) symbol, and only ask for a
+            // writable one when there's something to change.
+            const Symbol *si = cthis->symbol(i);
             if (m_instoverrides[i].valuesource() == Symbol::DefaultVal) {
                 // Fix the length of any default-value variable length array
                 // parameters.
                 if (si->typespec().is_unsized_array())
-                    si->arraylen (si->initializers());
+                    symbol(i)->arraylen (si->initializers());
             } else {
+                Symbol *w = symbol(i);
                 if (m_instoverrides[i].arraylen())
-                    si->arraylen (m_instoverrides[i].arraylen());
-                si->valuesource (m_instoverrides[i].valuesource());
-                si->connected_down (m_instoverrides[i].connected_down());
-                si->lockgeom (m_instoverrides[i].lockgeom());
-                si->dataoffset (m_instoverrides[i].dataoffset());
-                si->set_dataptr(SymArena::Absolute, param_storage(i));
+                    w->arraylen (m_instoverrides[i].arraylen());
+                w->valuesource (m_instoverrides[i].valuesource());
+                w->connected_down (m_instoverrides[i].connected_down());
+                w->lockgeom (m_instoverrides[i].lockgeom());
+                w->dataoffset (m_instoverrides[i].dataoffset());
+                w->set_dataptr(SymArena::Absolute, param_storage(i));
             }
+            si = cthis->symbol(i);
             if (shadingsys().is_renderer_output (layername(), si->name(), &group)) {
-                si->renderer_output (true);
+                symbol(i)->renderer_output (true);
                 renderer_outputs (true);
+                si = cthis->symbol(i);
+            }
+            // Interactive params stay variable through optimization. One
+            // still using its default gets its own copy of the value, so
+            // that edits can't reach the master.
+            if (group.interactive() && si->symtype() == SymTypeParam
+                && si->lockgeom() && ! si->typespec().is_closure_based()
+                && ! si->typespec().is_structure()
+                && ! (si->valuesource() == Symbol::DefaultVal
+                      && (si->has_init_ops()
+                          || master()->symbol(i)->typespec().is_unsized_array()))
+                && group.is_interactive_param (layername(), si->name())) {
+                Symbol *w = symbol(i);
+                if (w->valuesource() == Symbol::DefaultVal) {
+                    w->valuesource (Symbol::InstanceVal);
+                    w->set_dataptr (SymArena::Absolute, param_storage(i));
+                }
+                w->interactive (true);
+                w->lockgeom (false);
             }
         }
     }
     evaluate_writes_globals_and_userdata_params ();
-    off_t symmem = vectorbytes(m_instsymbols) - vectorbytes(m_instoverrides);
+    // Private symbols, if any, were charged by unshare_symbols.
+    off_t symmem = - vectorbytes(m_instoverrides);
     SymOverrideInfoVec().swap (m_instoverrides);  // free it
 
     // adjust stats
@@ -507,6 +552,90 @@ ShaderInstance::copy_code_from_master (ShaderGroup &group)
 
 
 
+void
+ShaderInstance::unshare_code ()
+{
+    OSL_DASSERT (m_code_shared && m_instops.empty() && m_instargs.empty());
+    // reserve with enough room for a few insertions
+    m_instops.reserve (master()->m_ops.size()+10);
+    m_instargs.reserve (master()->m_args.size()+10);
+    m_instops = master()->m_ops;
+    m_instargs = master()->m_args;
+    m_code_shared = false;
+
+    off_t sharedmem = vectorbytes(master()->m_ops)
+                    + vectorbytes(master()->m_args);
+    m_code_mem = vectorbytes(m_instops) + vectorbytes(m_instargs);
+    ShadingSystemImpl &ss (shadingsys());
+    spin_lock lock (ss.m_stat_mutex);
+    ss.m_stat_mem_inst_code_shared -= sharedmem;
+    ss.m_stat_inst_code_copied += 1;
+    ss.m_stat_mem_inst_code += m_code_mem;
+    ss.m_stat_mem_inst += m_code_mem;
+    ss.m_stat_memory += m_code_mem;
+}
+
+
+
+void
+ShaderInstance::release_code ()
+{
+    off_t sharedmem = m_code_shared ? vectorbytes(master()->m_ops)
+                                      + vectorbytes(master()->m_args)
+                                    : 0;
+    off_t codemem = m_code_mem;
+    OpcodeVec().swap (m_instops);
+    std::vector<int>().swap (m_instargs);
+    m_code_shared = false;
+    m_code_mem = 0;
+
+    ShadingSystemImpl &ss (shadingsys());
+    spin_lock lock (ss.m_stat_mutex);
+    ss.m_stat_mem_inst_code_shared -= sharedmem;
+    ss.m_stat_mem_inst_code -= codemem;
+    ss.m_stat_mem_inst -= codemem;
+    ss.m_stat_memory -= codemem;
+}
+
+
+
+void
+ShaderInstance::unshare_symbols ()
+{
+    OSL_DASSERT (m_syms_shared && m_instsymbols.empty());
+    m_instsymbols = master()->m_symbols;
+    m_syms_shared = false;
+
+    off_t sharedmem = vectorbytes(master()->m_symbols);
+    off_t symmem = vectorbytes(m_instsymbols);
+    ShadingSystemImpl &ss (shadingsys());
+    spin_lock lock (ss.m_stat_mutex);
+    ss.m_stat_mem_inst_syms_shared -= sharedmem;
+    ss.m_stat_inst_syms_copied += 1;
+    ss.m_stat_mem_inst_syms += symmem;
+    ss.m_stat_mem_inst += symmem;
+    ss.m_stat_memory += symmem;
+}
+
+
+
+off_t
+ShaderInstance::release_symbols ()
+{
+    off_t sharedmem = m_syms_shared ? vectorbytes(master()->m_symbols) : 0;
+    off_t symmem = vectorbytes(m_instsymbols);
+    SymbolVec().swap (m_instsymbols);
+    m_syms_shared = false;
+    if (sharedmem) {
+        ShadingSystemImpl &ss (shadingsys());
+        spin_lock lock (ss.m_stat_mutex);
+        ss.m_stat_mem_inst_syms_shared -= sharedmem;
+    }
+    return symmem;
+}
+
+
+
 std::string
 ConnectedParam::str (const ShaderInstance *inst, bool unmangle) const
 {
@@ -599,7 +728,7 @@ ShaderInstance::mergeable (const ShaderInstance &b, const ShaderGroup& /*g*/) co
     // their unoptimized master), but they may have an "instance
     // override" vector that describes which parameters have
     // instance-specific values or connections.
-    bool optimized = (m_instsymbols.size() != 0 || m_instops.size() != 0);
+    bool optimized = (symbols().size() != 0 || ops().size() != 0);
 
     // Same instance overrides
     if (m_instoverrides.size() || b.m_instoverrides.size()) {
@@ -680,16 +809,16 @@ ShaderInstance::mergeable (const ShaderInstance &b, const ShaderGroup& /*g*/) co
     }
 
     // Same symbol table
-    if (! equivalent (m_instsymbols, b.m_instsymbols)) {
+    if (! equivalent (symbols(), b.symbols())) {
         return false;
     }
 
     // Same opcodes to run
-    if (! equivalent (m_instops, b.m_instops)) {
+    if (! equivalent (ops(), b.ops())) {
         return false;
     }
     // Same arguments to the ops
-    if (m_instargs != b.m_instargs) {
+    if (args() != b.args()) {
         return false;
     }
 
@@ -778,6 +907,25 @@ ShaderGroup::find_symbol (ustring layername, ustring symbolname) const
 
 
 
+bool
+ShaderGroup::is_interactive_param (ustring layername, ustring paramname) const
+{
+    for (ustring p : m_interactive_params) {
+        if (p == paramname)
+            return true;
+        // "layer.param" form
+        string_view s (p);
+        if (s.size() == layername.size() + 1 + paramname.size()
+            && Strutil::starts_with (s, layername)
+            && s[layername.size()] == '.'
+            && Strutil::ends_with (s, paramname))
+            return true;
+    }
+    return false;
+}
+
+
+
 void
 ShaderGroup::clear_entry_layers ()
 {
@@ -848,7 +996,8 @@ ShaderGroup::serialize () const
                 }
                 bool lockgeom = dstsyms_exist ? s->lockgeom()
                                               : inst->instoverride(p)->lockgeom();
-                if (! lockgeom)
+                // Interactive params are only unlocked by the group
+                if (! lockgeom && ! (dstsyms_exist && s->interactive()))
                     out << Strutil::sprintf (" [[int lockgeom=%d]]", lockgeom);
                 out << " ;\n";
             }
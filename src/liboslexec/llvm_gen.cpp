@@ -14,6 +14,7 @@
 #include "oslexec_pvt.h"
 #include <OSL/genclosure.h>
 #include "backendllvm.h"
+#include "splineimpl.h"
 
 using namespace OSL;
 using namespace OSL::pvt;
@@ -2230,8 +2231,33 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
                           llvm::Value* &alpha, llvm::Value* &dalphadx,
                           llvm::Value* &dalphady, llvm::Value* &errormessage)
 {
-    llvm::Value* opt = rop.ll.call_function ("osl_get_texture_options",
+    // Almost always, every texture option is a compile-time constant. So
+    // rather than re-initializing the context's TextureOpt and making one
+    // call per option on every lookup, we apply the constant options to a
+    // TextureOpt right here, emit that as a constant block in the module,
+    // and the generated code just copies it to scratch space. Once we hit
+    // an option whose value isn't known, the block is copied and that
+    // option and all subsequent ones fall back to the osl_texture_set_*
+    // calls, which keeps overlapping options (e.g. "width" followed by
+    // "swidth") applied in order. OptiX can't use a host memory image, so
+    // it always takes the call path.
+    bool building_proto = ! rop.use_optix();
+    TextureOpt proto;
+    llvm::Value* opt = building_proto
+                     ? rop.temp_texture_options_ptr()
+                     : rop.ll.call_function ("osl_get_texture_options",
                                              rop.sg_void_ptr());
+    auto finish_proto = [&]() {
+        if (building_proto) {
+            llvm::Value* src = rop.ll.constant_data_ptr (&proto, sizeof(proto),
+                                                         (int)alignof(TextureOpt),
+                                                         "texture_options");
+            rop.ll.op_memcpy (opt, src, (int)sizeof(proto),
+                              (int)alignof(TextureOpt));
+            building_proto = false;
+        }
+    };
+
     llvm::Value* missingcolor = NULL;
     TextureOpt optdefaults;  // So we can check the defaults
     bool swidth_set = false, twidth_set = false, rwidth_set = false;
@@ -2256,9 +2282,17 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
         TypeDesc valtype = Val.typespec().simpletype ();
         const int *ival = Val.typespec().is_int() && Val.is_constant() ? (const int *)Val.data() : NULL;
         const float *fval = Val.typespec().is_float() && Val.is_constant() ? (const float *)Val.data() : NULL;
+        // Constant value that can still go straight into the prebuilt block
+        bool to_proto = building_proto && Val.is_constant();
 
 #define PARAM_INT(paramname)                                            \
         if (name == Strings::paramname && valtype == TypeDesc::INT)   { \
+            if (to_proto) {                                             \
+                proto.paramname = *ival;                                \
+                paramname##_set = true;                                 \
+                continue;                                               \
+            }                                                           \
+            finish_proto ();                                            \
             if (! paramname##_set &&                                    \
                 ival && *ival == optdefaults.paramname)                 \
                 continue;     /* default constant */                    \
@@ -2271,6 +2305,12 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
 #define PARAM_FLOAT(paramname)                                          \
         if (name == Strings::paramname &&                               \
             (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT)) { \
+            if (to_proto) {                                             \
+                proto.paramname = Val.coerce_float();                   \
+                paramname##_set = true;                                 \
+                continue;                                               \
+            }                                                           \
+            finish_proto ();                                            \
             if (! paramname##_set &&                                    \
                 ((ival && *ival == optdefaults.paramname) ||            \
                  (fval && *fval == optdefaults.paramname)))             \
@@ -2286,6 +2326,17 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
 #define PARAM_FLOAT_STR(paramname)                                      \
         if (name == Strings::paramname &&                               \
             (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT)) { \
+            if (to_proto) {                                             \
+                proto.s##paramname = Val.coerce_float();                \
+                proto.t##paramname = Val.coerce_float();                \
+                if (tex3d)                                              \
+                    proto.r##paramname = Val.coerce_float();            \
+                s##paramname##_set = true;                              \
+                t##paramname##_set = true;                              \
+                r##paramname##_set = true;                              \
+                continue;                                               \
+            }                                                           \
+            finish_proto ();                                            \
             if (! s##paramname##_set && ! t##paramname##_set &&         \
                 ! r##paramname##_set &&                                 \
                 ((ival && *ival == optdefaults.s##paramname) ||         \
@@ -2305,6 +2356,14 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
 
 #define PARAM_STRING_CODE(paramname,decoder,fieldname)                  \
         if (name == Strings::paramname && valtype == TypeDesc::STRING) { \
+            if (to_proto) {                                             \
+                int code = decoder (Val.get_string());                  \
+                if (code >= 0)                                          \
+                    proto.fieldname = decltype(proto.fieldname)(code);  \
+                paramname##_set = true;                                 \
+                continue;                                               \
+            }                                                           \
+            finish_proto ();                                            \
             if (Val.is_constant()) {                                    \
                 int code = decoder (Val.get_string());                  \
                 if (! paramname##_set && code == optdefaults.fieldname) \
@@ -2331,13 +2390,21 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
         PARAM_FLOAT (rblur)
 
         if (name == Strings::wrap && valtype == TypeDesc::STRING) {
-            if (Val.is_constant()) {
+            if (to_proto) {
+                TextureOpt::Wrap mode = TextureOpt::decode_wrapmode (Val.get_string());
+                proto.swrap = mode;
+                proto.twrap = mode;
+                if (tex3d)
+                    proto.rwrap = mode;
+            } else if (Val.is_constant()) {
+                finish_proto ();
                 int mode = TextureOpt::decode_wrapmode (Val.get_string());
                 llvm::Value *val = rop.ll.constant (mode);
                 rop.ll.call_function ("osl_texture_set_stwrap_code", opt, val);
                 if (tex3d)
                     rop.ll.call_function ("osl_texture_set_rwrap_code", opt, val);
             } else {
+                finish_proto ();
                 llvm::Value *val = rop.llvm_load_value (Val);
                 rop.ll.call_function ("osl_texture_set_stwrap", opt, val);
                 if (tex3d)
@@ -2361,7 +2428,14 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
                 if (v.empty() && ! subimage_set) {
                     continue;     // Ignore nulls unless they are overrides
                 }
+                // (A ustring in the block wouldn't survive aot.)
+                if (to_proto && ! rop.ll.aot()) {
+                    proto.subimagename = v;
+                    subimage_set = true;
+                    continue;
+                }
             }
+            finish_proto ();
             llvm::Value *val = rop.llvm_load_value (Val);
             rop.ll.call_function ("osl_texture_set_subimagename", opt, val);
             subimage_set = true;
@@ -2385,6 +2459,9 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
         }
         if (name == Strings::missingcolor &&
                    equivalent(valtype,TypeDesc::TypeColor)) {
+            // The missingcolor points at stack memory, so it can't be part
+            // of the prebuilt options block.
+            finish_proto ();
             if (! missingcolor) {
                 // If not already done, allocate enough storage for the
                 // missingcolor value (4 floats), and call the special 
@@ -2398,6 +2475,7 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
             continue;
         }
         if (name == Strings::missingalpha && valtype == TypeDesc::FLOAT) {
+            finish_proto ();
             if (! missingcolor) {
                 // If not already done, allocate enough storage for the
                 // missingcolor value (4 floats), and call the special 
@@ -2431,6 +2509,8 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
 #endif
     }
 
+    // Every option was constant: the prebuilt block is the whole story.
+    finish_proto ();
     return opt;
 }
 
@@ -2472,7 +2552,7 @@ LLVMGEN (llvm_gen_texture)
     llvm::Value * args[] = {
         rop.sg_void_ptr(),
         rop.llvm_load_value (Filename),
-        rop.ll.constant_ptr (texture_handle),
+        rop.llvm_texture_handle (texture_handle, Filename),
         opt,
         rop.llvm_load_value (S),
         rop.llvm_load_value (T),
@@ -2531,7 +2611,7 @@ LLVMGEN (llvm_gen_texture3d)
     llvm::Value *args[] = {
         rop.sg_void_ptr(),
         rop.llvm_load_value (Filename),
-        rop.ll.constant_ptr (texture_handle),
+        rop.llvm_texture_handle (texture_handle, Filename),
         opt,
         rop.llvm_void_ptr (P),
         // Auto derivs of P if !user_derivs
@@ -2589,7 +2669,7 @@ LLVMGEN (llvm_gen_environment)
     llvm::Value *args[] = {
         rop.sg_void_ptr(),
         rop.llvm_load_value (Filename),
-        rop.ll.constant_ptr (texture_handle),
+        rop.llvm_texture_handle (texture_handle, Filename),
         opt,
         rop.llvm_void_ptr (R),
         user_derivs ? rop.llvm_void_ptr (*rop.opargsym (op, 3)) : rop.llvm_void_ptr (R, 1),
@@ -2744,6 +2824,21 @@ llvm_gen_noise_options (BackendLLVM &rop, int opnum,
             rop.ll.call_function ("osl_noiseparams_set_impulses", opt,
                                     rop.llvm_load_value (Val, 0, NULL, 0,
                                                          TypeDesc::TypeFloat));
+        } else if (name == Strings::octaves &&
+                   (Val.typespec().is_float() || Val.typespec().is_int())) {
+            rop.ll.call_function ("osl_noiseparams_set_octaves", opt,
+                                    rop.llvm_load_value (Val, 0, NULL, 0,
+                                                         TypeDesc::TypeInt));
+        } else if (name == Strings::lacunarity &&
+                   (Val.typespec().is_float() || Val.typespec().is_int())) {
+            rop.ll.call_function ("osl_noiseparams_set_lacunarity", opt,
+                                    rop.llvm_load_value (Val, 0, NULL, 0,
+                                                         TypeDesc::TypeFloat));
+        } else if (name == Strings::gain &&
+                   (Val.typespec().is_float() || Val.typespec().is_int())) {
+            rop.ll.call_function ("osl_noiseparams_set_gain", opt,
+                                    rop.llvm_load_value (Val, 0, NULL, 0,
+                                                         TypeDesc::TypeFloat));
         } else {
             rop.shadingcontext()->errorf("Unknown %s optional argument: \"%s\", <%s> (%s:%d)",
                                          op.opname(), name, valtype,
@@ -2844,6 +2939,16 @@ LLVMGEN (llvm_gen_noise)
         pass_options = true;
         derivs = true;
         name = periodic ? Strings::gaborpnoise : Strings::gabornoise;
+    } else if ((name == Strings::fbm || name == Strings::turbulence ||
+                name == Strings::ridged) && !periodic) {
+        // Fractal noise takes its octave controls from the noise options
+        pass_name = true;
+        pass_sg = true;
+        pass_options = true;
+        derivs = true;
+        name = (name == Strings::fbm) ? Strings::fbmnoise
+             : (name == Strings::turbulence) ? Strings::turbulencenoise
+             : Strings::ridgednoise;
     } else {
         rop.shadingcontext()->errorf("%snoise type \"%s\" is unknown, called from (%s:%d)",
                                 (periodic ? "periodic " : ""), name,
@@ -3043,7 +3148,7 @@ LLVMGEN (llvm_gen_gettextureinfo)
     std::vector<llvm::Value*> args;
     args.push_back(rop.sg_void_ptr());
     args.push_back(rop.llvm_load_value (Filename));
-    args.push_back(rop.ll.constant_ptr (texture_handle));
+    args.push_back(rop.llvm_texture_handle (texture_handle, Filename));
     if (use_coords) {
         args.push_back(rop.llvm_load_value(*S));
         args.push_back(rop.llvm_load_value(*T));
@@ -3089,10 +3194,21 @@ LLVMGEN (llvm_gen_getmessage)
     OSL_DASSERT(Result.typespec().is_int() && Name.typespec().is_string());
     OSL_DASSERT(has_source == 0 || Source.typespec().is_string());
 
+    // A constant name that the group's blackboard has a slot for, asked
+    // of the blackboard itself (not a "trace" or other renderer source),
+    // is looked up by slot.
+    int slot = -1;
+    if (Name.is_constant() && (! has_source || (Source.is_constant()
+                                                && Source.get_string().empty())))
+        slot = rop.group().message_slot (Name.get_string());
+
     llvm::Value *args[9];
     args[0] = rop.sg_void_ptr();
-    args[1] = has_source ? rop.llvm_load_value(Source) 
-                         : rop.ll.constant(ustring());
+    if (slot >= 0)
+        args[1] = rop.ll.constant (slot);
+    else
+        args[1] = has_source ? rop.llvm_load_value(Source)
+                             : rop.ll.constant(ustring());
     args[2] = rop.llvm_load_value (Name);
 
     if (Data.typespec().is_closure_based()) {
@@ -3111,7 +3227,8 @@ LLVMGEN (llvm_gen_getmessage)
     args[7] = rop.ll.constant(op.sourcefile());
     args[8] = rop.ll.constant(op.sourceline());
 
-    llvm::Value *r = rop.ll.call_function ("osl_getmessage", args);
+    llvm::Value *r = rop.ll.call_function (slot >= 0 ? "osl_getmessage_slot"
+                                                     : "osl_getmessage", args);
     rop.llvm_store_value (r, Result);
     return true;
 }
@@ -3127,25 +3244,32 @@ LLVMGEN (llvm_gen_setmessage)
     Symbol& Data   = *rop.opargsym (op, 1);
     OSL_DASSERT(Name.typespec().is_string());
 
-    llvm::Value *args[7];
-    args[0] = rop.sg_void_ptr();
-    args[1] = rop.llvm_load_value (Name);
+    int slot = Name.is_constant() ? rop.group().message_slot (Name.get_string())
+                                  : -1;
+
+    llvm::Value *args[8];
+    int a = 0;
+    args[a++] = rop.sg_void_ptr();
+    if (slot >= 0)
+        args[a++] = rop.ll.constant (slot);
+    args[a++] = rop.llvm_load_value (Name);
     if (Data.typespec().is_closure_based()) {
         // FIXME: secret handshake for closures ...
-        args[2] = rop.ll.constant (TypeDesc(TypeDesc::UNKNOWN,
+        args[a++] = rop.ll.constant (TypeDesc(TypeDesc::UNKNOWN,
                                               Data.typespec().arraylength()));
         // We need a void ** here so the function can modify the closure
-        args[3] = rop.llvm_void_ptr(Data);
+        args[a++] = rop.llvm_void_ptr(Data);
     } else {
-        args[2] = rop.ll.constant (Data.typespec().simpletype());
-        args[3] = rop.llvm_void_ptr (Data);
+        args[a++] = rop.ll.constant (Data.typespec().simpletype());
+        args[a++] = rop.llvm_void_ptr (Data);
     }
 
-    args[4] = rop.ll.constant(rop.inst()->id());
-    args[5] = rop.ll.constant(op.sourcefile());
-    args[6] = rop.ll.constant(op.sourceline());
+    args[a++] = rop.ll.constant(rop.inst()->id());
+    args[a++] = rop.ll.constant(op.sourcefile());
+    args[a++] = rop.ll.constant(op.sourceline());
 
-    rop.ll.call_function ("osl_setmessage", args);
+    rop.ll.call_function (slot >= 0 ? "osl_setmessage_slot" : "osl_setmessage",
+                          cspan<llvm::Value*>(args, a));
     return true;
 }
 
@@ -3242,11 +3366,50 @@ LLVMGEN (llvm_gen_spline)
              Knots.typespec().is_array() &&  
              (!has_knot_count || (has_knot_count && Knot_count.typespec().is_int())));
 
-    std::string name = Strutil::sprintf("osl_%s_", op.opname());
     // only use derivatives for result if:
     //   result has derivs and (value || knots) have derivs
     bool result_derivs = Result.has_derivs() && (Value.has_derivs() || Knots.has_derivs());
 
+    // Ramps and color curves nearly always end up with a constant basis
+    // and knots after optimization.  For those, apply the basis to the
+    // knots once here, and let the shadeop just evaluate each segment's
+    // polynomial (or, for splineinverse, look up a table of samples).
+    if (Spline.is_constant() && Knots.is_constant() && !Knots.has_derivs()
+          && (!has_knot_count || Knot_count.is_constant())) {
+        int knot_count = has_knot_count ? Knot_count.get_int()
+                                        : Knots.typespec().arraylength();
+        int ncomps = Knots.typespec().simpletype().elementtype().aggregate;
+        bool inverse = (op.opname() == "splineinverse");
+        bool with_inverse = inverse;
+        std::vector<float> table;
+        int nsegs = 0;
+        if (knot_count <= Knots.typespec().arraylength())
+            nsegs = Spline::build_table (table,
+                        Spline::basis_type_of (Spline.get_string()),
+                        (const float *)Knots.dataptr(), knot_count, ncomps,
+                        with_inverse);
+        if (nsegs && with_inverse == inverse) {
+            std::string name = Strutil::sprintf ("osl_%s_table_%s%s%sf%s",
+                op.opname(), result_derivs ? "d" : "",
+                Result.typespec().is_float() ? "f" : "v",
+                result_derivs ? "d" : "", ncomps == 1 ? "f" : "v");
+            llvm::Value * args[] = {
+                rop.llvm_void_ptr (Result),
+                rop.llvm_void_ptr (Value),
+                rop.ll.constant_data_ptr (table.data(),
+                                          table.size() * sizeof(float),
+                                          (int)alignof(float), "spline_table"),
+                rop.ll.constant (nsegs)
+            };
+            rop.ll.call_function (name.c_str(), args);
+
+            if (Result.has_derivs() && !result_derivs)
+                rop.llvm_zero_derivs (Result);
+            return true;
+        }
+    }
+
+    std::string name = Strutil::sprintf("osl_%s_", op.opname());
     if (result_derivs)
         name += "d";
     if (Result.typespec().is_float())
@@ -3329,6 +3492,85 @@ llvm_gen_keyword_fill(BackendLLVM &rop, Opcode &op, const ClosureRegistry::Closu
 
 
 
+// If everything that goes into a closure component is known at JIT time,
+// build the component now, once, as read-only data in the module, and
+// store a pointer to it in Result -- nothing to allocate from the closure
+// pool or fill in on each shade. Returns false (having emitted nothing) if
+// the component must be built at run time after all: when a param isn't
+// constant, when the renderer wants a setup() call for each one, or when
+// the code can't refer to host memory (AOT, OptiX).
+static bool
+llvm_gen_static_closure (BackendLLVM &rop, Opcode &op,
+                         const ClosureRegistry::ClosureEntry *clentry,
+                         const Symbol *weight, Symbol &Result, int argsoffset)
+{
+    if (rop.ll.aot() || rop.use_optix() || clentry->setup)
+        return false;
+    if (weight && ! weight->is_constant())
+        return false;
+    if (weight && rop.is_zero (*weight)) {
+        // osl_allocate_weighted_closure_component would return NULL
+        rop.llvm_store_value (rop.ll.void_ptr_null(), Result, 0, NULL, 0);
+        return true;
+    }
+
+    // Match every arg to the spot it fills, as llvm_gen_closure and
+    // llvm_gen_keyword_fill would. Anything they'd complain about goes
+    // their way, so the complaint is made.
+    std::vector<std::pair<const ClosureParam *, const Symbol *>> fills;
+    for (int carg = 0; carg < clentry->nformal; ++carg) {
+        const ClosureParam &p = clentry->params[carg];
+        if (p.key != NULL)
+            break;
+        const Symbol &sym = *rop.opargsym (op, argsoffset + carg);
+        if (! sym.is_constant() || sym.typespec().is_closure_array()
+              || sym.typespec().is_structure()
+              || ! equivalent (sym.typespec().simpletype(), p.type))
+            return false;
+        fills.emplace_back (&p, &sym);
+    }
+    for (int argno = argsoffset + clentry->nformal;  argno + 1 < op.nargs();  argno += 2) {
+        const Symbol &Key   = *rop.opargsym (op, argno);
+        const Symbol &Value = *rop.opargsym (op, argno + 1);
+        if (! Value.is_constant())
+            return false;
+        const ClosureParam *kp = nullptr;
+        for (int t = 0; t < clentry->nkeyword && ! kp; ++t) {
+            const ClosureParam &p = clentry->params[clentry->nformal + t];
+            if (equivalent (p.type, Value.typespec().simpletype())
+                  && ! strcmp (Key.get_string().c_str(), p.key))
+                kp = &p;
+        }
+        if (! kp)
+            return false;
+        fills.emplace_back (kp, &Value);
+    }
+
+    // Lay it out just as ShadingContext::closure_component_allot would.
+    // (The vector of ClosureComponent gives us its alignment; value
+    // initialization gives the zeroed params of the no-prepare case.)
+    size_t size = sizeof(ClosureComponent) + clentry->struct_size;
+    std::vector<ClosureComponent> buf ((size + sizeof(ClosureComponent) - 1)
+                                       / sizeof(ClosureComponent));
+    ClosureComponent *comp = buf.data();
+    comp->id = clentry->id;
+    comp->w = weight ? *(const Color3 *)weight->data() : Color3(1.0f);
+    if (clentry->prepare)
+        clentry->prepare (rop.shadingsys().renderer(), clentry->id, comp->data());
+    for (auto&& f : fills) {
+        OSL_DASSERT (f.first->offset + f.first->field_size <= clentry->struct_size);
+        memcpy ((char *)comp->data() + f.first->offset, f.second->data(),
+                f.first->type.size());
+    }
+    llvm::Value *ptr = rop.ll.constant_data_ptr (comp, size,
+                                                 (int)alignof(ClosureComponent),
+                                                 "closure");
+    rop.llvm_store_value (ptr, Result, 0, NULL, 0);
+    return true;
+}
+
+
+
 LLVMGEN (llvm_gen_closure)
 {
     Opcode &op (rop.inst()->ops()[opnum]);
@@ -3353,9 +3595,14 @@ LLVMGEN (llvm_gen_closure)
 
     OSL_DASSERT (op.nargs() >= (2 + weighted + clentry->nformal));
 
+    if (llvm_gen_static_closure (rop, op, clentry, weight, Result, 2 + weighted))
+        return true;
+
     // Call osl_allocate_closure_component(closure, id, size).  It returns
     // the memory for the closure parameter data.
-    llvm::Value *render_ptr = rop.ll.constant_ptr(rop.shadingsys().renderer(), rop.ll.type_void_ptr());
+    llvm::Value *render_ptr = rop.ll.aot()
+                            ? rop.ll.aot_slot_value ("renderer", "")
+                            : rop.ll.constant_ptr(rop.shadingsys().renderer(), rop.ll.type_void_ptr());
     llvm::Value *sg_ptr = rop.sg_void_ptr();
     llvm::Value *id_int = rop.ll.constant(clentry->id);
     llvm::Value *size_int = rop.ll.constant(clentry->struct_size);
@@ -3387,7 +3634,9 @@ LLVMGEN (llvm_gen_closure)
     // zero out the closure parameter memory.
     if (clentry->prepare) {
         // Call clentry->prepare(renderservices *, int id, void *mem)
-        llvm::Value *funct_ptr = rop.ll.constant_ptr((void *)clentry->prepare, rop.llvm_type_prepare_closure_func());
+        llvm::Value *funct_ptr = rop.ll.aot()
+            ? rop.ll.aot_slot_value ("closure_prepare", closure_name, rop.llvm_type_prepare_closure_func())
+            : rop.ll.constant_ptr((void *)clentry->prepare, rop.llvm_type_prepare_closure_func());
         llvm::Value *args[] = {render_ptr, id_int, mem_void_ptr};
         rop.ll.call_function (funct_ptr, args);
     } else {
@@ -3425,7 +3674,9 @@ LLVMGEN (llvm_gen_closure)
     // setup(render_services, id, mem_ptr).
     if (clentry->setup) {
         // Call clentry->setup(renderservices *, int id, void *mem)
-        llvm::Value *funct_ptr = rop.ll.constant_ptr((void *)clentry->setup, rop.llvm_type_setup_closure_func());
+        llvm::Value *funct_ptr = rop.ll.aot()
+            ? rop.ll.aot_slot_value ("closure_setup", closure_name, rop.llvm_type_setup_closure_func())
+            : rop.ll.constant_ptr((void *)clentry->setup, rop.llvm_type_setup_closure_func());
         llvm::Value *args[] = {render_ptr, id_int, mem_void_ptr};
         rop.ll.call_function (funct_ptr, args);
     }
@@ -3546,8 +3797,8 @@ LLVMGEN (llvm_gen_pointcloud_search)
     static ustring errorfmt("Arrays too small for pointcloud lookup at (%s:%d)");
     llvm::Value *err_args[] = {
         rop.sg_void_ptr(),
-        rop.ll.constant_ptr ((void *)errorfmt.c_str()),
-        rop.ll.constant_ptr ((void *)op.sourcefile().c_str()),
+        rop.ll.void_ptr (rop.ll.constant (errorfmt)),
+        rop.ll.void_ptr (rop.ll.constant (op.sourcefile())),
         rop.ll.constant (op.sourceline()),
     };
     rop.ll.call_function ("osl_error", err_args);
@@ -3606,8 +3857,8 @@ LLVMGEN (llvm_gen_pointcloud_get)
     static ustring errorfmt("Arrays too small for pointcloud attribute get at (%s:%d)");
     llvm::Value *err_args[] = {
         rop.sg_void_ptr(),
-        rop.ll.constant_ptr ((void *)errorfmt.c_str()),
-        rop.ll.constant_ptr ((void *)op.sourcefile().c_str()),
+        rop.ll.void_ptr (rop.ll.constant (errorfmt)),
+        rop.ll.void_ptr (rop.ll.constant (op.sourcefile())),
         rop.ll.constant (op.sourceline()),
     };
     rop.ll.call_function ("osl_error", err_args);
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <unordered_map>
@@ -450,7 +451,7 @@ BackendLLVM::llvm_assign_initial_value (const Symbol& sym, bool force)
     // retrieved de novo or copied from a previous retrieval), or 0 if no
     // such userdata was available.
     llvm::BasicBlock *after_userdata_block = NULL;
-    if (! sym.lockgeom() && ! sym.typespec().is_closure()) {
+    if (! sym.lockgeom() && ! sym.interactive() && ! sym.typespec().is_closure()) {
         ustring symname = sym.name();
         TypeDesc type = sym.typespec().simpletype();
 
@@ -559,8 +560,10 @@ BackendLLVM::llvm_assign_initial_value (const Symbol& sym, bool force)
     } else if (! sym.lockgeom() && ! sym.typespec().is_closure()) {
         // geometrically-varying param; memcpy its default value
         TypeDesc t = sym.typespec().simpletype();
-        ll.op_memcpy (llvm_void_ptr (sym), ll.constant_ptr (sym.data()),
-                      t.size(), t.basesize() /*align*/);
+        llvm::Value *src = ll.aot()
+            ? ll.aot_slot_value ("symdata", aot_symdata_key (sym))
+            : ll.constant_ptr (sym.data());
+        ll.op_memcpy (llvm_void_ptr (sym), src, t.size(), t.basesize() /*align*/);
         if (sym.has_derivs())
             llvm_zero_derivs (sym);
     } else {
@@ -864,6 +867,8 @@ BackendLLVM::build_llvm_init ()
     m_llvm_userdata_base_ptr = ll.current_function_arg(2); //arg_it++;
     m_llvm_output_base_ptr = ll.current_function_arg(3); //arg_it++;
     m_llvm_shadeindex = ll.current_function_arg(4); //arg_it++;
+    // New function, reset the texture options scratch space
+    m_llvm_temp_texture_options_ptr = nullptr;
 
     // Set up a new IR builder
     llvm::BasicBlock *entry_bb = ll.new_basic_block (unique_name);
@@ -957,6 +962,8 @@ BackendLLVM::build_llvm_instance (bool groupentry)
     m_llvm_userdata_base_ptr = ll.current_function_arg(2); //arg_it++;
     m_llvm_output_base_ptr = ll.current_function_arg(3); //arg_it++;
     m_llvm_shadeindex = ll.current_function_arg(4); //arg_it++;
+    // New function, reset the texture options scratch space
+    m_llvm_temp_texture_options_ptr = nullptr;
 
     llvm::BasicBlock *entry_bb = ll.new_basic_block (unique_layer_name);
     m_exit_instance_block = NULL;
@@ -1226,9 +1233,10 @@ BackendLLVM::initialize_llvm_group ()
         ll.debug_setup_compilation_unit(compile_unit_name);
     }
 
-    // Set up optimization passes. Don't target the host if we're building
+    // Set up optimization passes. A group that is being tiered gets only
+    // the quick passes for now. Don't target the host if we're building
     // for OptiX.
-    ll.setup_optimization_passes (shadingsys().llvm_optimize(),
+    ll.setup_optimization_passes (llvm_optimize_level(),
                                   shadingsys().llvm_target_host() && !use_optix());
 
     // Clear the shaderglobals and groupdata types -- they will be
@@ -1291,6 +1299,198 @@ static void empty_group_func (void*, void*)
 
 
 
+bool
+BackendLLVM::aot_emit_group (llvm::Function *init_func,
+                             const std::vector<llvm::Function*> &funcs)
+{
+    if (ll.aot_unrelocatable().size()) {
+        shadingcontext()->errorfmt("Can't compile shader group \"{}\" ahead of time: {}",
+                                   group().name(), ll.aot_unrelocatable());
+        return false;
+    }
+    std::string err;
+    if (! ll.emit_object (group().m_aot_object, &err)) {
+        shadingcontext()->errorfmt("Can't compile shader group \"{}\" ahead of time: {}",
+                                   group().name(), err);
+        return false;
+    }
+
+    std::string &m (group().m_aot_manifest);
+    m.clear ();
+    m += aot_manifest_line ({ "osl_aot_manifest", "1" });
+    m += aot_manifest_line ({ "osl_version", OSL_LIBRARY_VERSION_STRING });
+    m += aot_manifest_line ({ "target", ll.target_isa_name(ll.target_isa()) });
+    m += aot_manifest_line ({ "spec_hash", Strutil::sprintf ("%016x", aot_spec_hash (group())) });
+    m += aot_manifest_line ({ "groupdata_size", Strutil::sprintf ("%d", group().llvm_groupdata_size()) });
+    // The code indexes messages by their slot in this (sorted) list
+    std::vector<std::string> names { "message_names" };
+    for (ustring name : group().message_names())
+        names.push_back (name.string());
+    m += aot_manifest_line (names);
+    m += aot_manifest_line ({ "init", ll.func_name (init_func) });
+    for (int layer = 0, n = group().nlayers(); layer < n; ++layer) {
+        if (funcs[layer] && group().is_entry_layer (layer))
+            m += aot_manifest_line ({ "layer", Strutil::sprintf ("%d", layer),
+                                      ll.func_name (funcs[layer]) });
+    }
+    for (auto&& slot : ll.aot_slots()) {
+        std::vector<std::string> line { "slot", slot.name, slot.kind };
+        line.insert (line.end(), slot.keys.begin(), slot.keys.end());
+        m += aot_manifest_line (line);
+    }
+    return true;
+}
+
+
+
+bool
+BackendLLVM::aot_load_group ()
+{
+    std::string err;
+    int nlayers = group().nlayers();
+    std::string init_name;
+    std::vector<std::string> layer_names (nlayers);
+    std::vector<std::vector<std::string>> slots;
+    size_t groupdata_size = 0;
+    std::vector<std::string> message_names;
+    for (auto&& line : aot_manifest_parse (group().m_aot_manifest)) {
+        if (line.size() >= 2 && line[0] == "init")
+            init_name = line[1];
+        else if (line.size() >= 3 && line[0] == "layer"
+                 && Strutil::stoi(line[1]) >= 0 && Strutil::stoi(line[1]) < nlayers)
+            layer_names[Strutil::stoi(line[1])] = line[2];
+        else if (line.size() >= 2 && line[0] == "groupdata_size")
+            groupdata_size = size_t (Strutil::stoi (line[1]));
+        else if (line.size() >= 1 && line[0] == "message_names")
+            message_names.assign (line.begin() + 1, line.end());
+        else if (line.size() >= 3 && line[0] == "slot")
+            slots.push_back (line);
+    }
+
+    ll.module (ll.new_module ("osl_aot"));
+    if (! ll.make_jit_execengine (&err, ll.lookup_isa_by_name(shadingsys().m_llvm_jit_target),
+                                  shadingsys().llvm_debugging_symbols(),
+                                  shadingsys().llvm_profiling_events())) {
+        shadingcontext()->warningfmt("Ahead-of-time code for shader group \"{}\" can't be used (failed to create engine: {}); compiling it instead",
+                                     group().name(), err);
+        ll.module (NULL);
+        return false;
+    }
+
+    // The object only refers to the helper functions by name; let the
+    // engine find them the same way it would for JITed code.
+    initialize_llvm_helper_function_map();
+    ll.InstallLazyFunctionCreator (helper_function_lookup);
+
+    // Lay out the groupdata, which also assigns the offsets the shaders
+    // use for their params. It had better come out as it did when the
+    // object was compiled.
+    m_llvm_type_sg = NULL;
+    m_llvm_type_groupdata = NULL;
+    m_llvm_type_closure_component = NULL;
+    llvm_type_groupdata ();
+    bool ok = (group().llvm_groupdata_size() == groupdata_size);
+    if (! ok)
+        err = "groupdata layout differs";
+    // Likewise the message slots, which the code has baked in.
+    if (ok && ! std::equal (message_names.begin(), message_names.end(),
+                            group().message_names().begin(),
+                            group().message_names().end(),
+                            [](const std::string &a, ustring b) { return a == b; })) {
+        ok = false;
+        err = "message slots differ";
+    }
+    if (ok)
+        ok = ll.add_object (group().m_aot_object, &err);
+
+    // Fill the slots with this process's idea of each value.
+    for (size_t s = 0; ok && s < slots.size(); ++s) {
+        const std::vector<std::string> &line (slots[s]);
+        void **slot = (void **) ll.getPointerToSymbol (line[1]);
+        if (! slot)
+            continue;   // optimized away
+        string_view kind (line[2]);
+        for (size_t k = 3; ok && k < line.size(); ++k) {
+            const std::string &key (line[k]);
+            void *val = nullptr;
+            if (kind == "ustring") {
+                val = (void *) ustring(key).c_str();
+            } else if (kind == "renderer") {
+                val = renderer();
+            } else if (kind == "texture_handle") {
+                val = renderer()->get_texture_handle (ustring(key), shadingcontext());
+            } else if (kind == "closure_prepare" || kind == "closure_setup") {
+                const ClosureRegistry::ClosureEntry *clentry
+                    = shadingsys().find_closure (ustring(key));
+                if (clentry)
+                    val = (kind == "closure_prepare") ? (void *) clentry->prepare
+                                                      : (void *) clentry->setup;
+                else {
+                    err = Strutil::sprintf ("unknown closure %s", key);
+                    ok = false;
+                }
+            } else if (kind == "symdata") {
+                int layer = Strutil::stoi (key);
+                size_t space = key.find (' ');
+                ShaderInstance *inst = (layer >= 0 && layer < nlayers) ? group()[layer] : nullptr;
+                int symindex = (inst && space != std::string::npos)
+                             ? inst->findsymbol (ustring(key.substr(space+1))) : -1;
+                if (symindex >= 0)
+                    val = inst->symbol(symindex)->data();
+                else {
+                    err = Strutil::sprintf ("unknown symbol \"%s\"", key);
+                    ok = false;
+                }
+            } else {
+                err = Strutil::sprintf ("unknown slot kind \"%s\"", kind);
+                ok = false;
+            }
+            slot[k-3] = val;
+        }
+    }
+
+    RunLLVMGroupFunc init = ok ? (RunLLVMGroupFunc) ll.getPointerToSymbol (init_name) : nullptr;
+    if (ok && ! init) {
+        err = "no init function";
+        ok = false;
+    }
+    std::vector<RunLLVMGroupFunc> layers (nlayers, nullptr);
+    for (int layer = 0; ok && layer < nlayers; ++layer) {
+        if (! group().is_entry_layer (layer))
+            continue;
+        layers[layer] = (RunLLVMGroupFunc) ll.getPointerToSymbol (layer_names[layer]);
+        if (! layers[layer]) {
+            err = Strutil::sprintf ("no function for layer %d", layer);
+            ok = false;
+        }
+    }
+
+    if (! ok) {
+        shadingcontext()->warningfmt("Ahead-of-time code for shader group \"{}\" can't be used ({}); compiling it instead",
+                                     group().name(), err);
+        ll.execengine (NULL);
+        ll.module (NULL);
+        return false;
+    }
+
+    group().llvm_compiled_init (init);
+    for (int layer = 0; layer < nlayers; ++layer)
+        if (layers[layer])
+            group().llvm_compiled_layer (layer, layers[layer]);
+    if (group().num_entry_layers())
+        group().llvm_compiled_version (NULL);
+    else
+        group().llvm_compiled_version (group().llvm_compiled_layer(nlayers-1));
+
+    // As with JITed code, the loaded code and slots live on in the memory
+    // manager after the engine is gone.
+    ll.execengine (NULL);
+    ll.module (NULL);
+    return true;
+}
+
+
+
 void
 BackendLLVM::run ()
 {
@@ -1305,6 +1505,17 @@ BackendLLVM::run ()
     OIIO::Timer timer;
     std::string err;
 
+    // Code saved by ShadingSystem::aot_compile only needs to be loaded.
+    if (group().m_aot_object.size() && ! group().m_aot_compile && ! use_optix()
+          && aot_load_group ()) {
+        m_stat_total_llvm_time = m_stat_llvm_jit_time = timer();
+        shadingsys().m_stat_groups_aot_loaded += 1;
+        if (shadingsys().m_compile_report)
+            shadingcontext()->infof("Loaded shader group %s compiled ahead of time (%1.2fs)",
+                                    group().name(), m_stat_total_llvm_time);
+        return;
+    }
+
     {
 #ifdef OSL_LLVM_NO_BITCODE
     // I don't know which exact part has thread safety issues, but it
@@ -1342,6 +1553,14 @@ BackendLLVM::run ()
         ! ll.make_jit_execengine (&err, ll.lookup_isa_by_name(shadingsys().m_llvm_jit_target),
                                   shadingsys().llvm_debugging_symbols(),
                                   shadingsys().llvm_profiling_events())) {
+        if (group().m_aot_compile) {
+            // Only a clone made by aot_compile, which will report the
+            // failure to its caller; nothing will try to run it.
+            shadingcontext()->errorfmt("Can't compile shader group \"{}\" ahead of time: failed to create engine: {}",
+                                       group().name(), err);
+            ll.module (NULL);
+            return;
+        }
         shadingcontext()->errorf("Failed to create engine: %s\n", err);
         OSL_ASSERT (0);
         return;
@@ -1350,6 +1569,9 @@ BackendLLVM::run ()
     // End of mutex lock, for the OSL_LLVM_NO_BITCODE case
     }
 
+    // Generate relocatable code if it's to be saved and loaded elsewhere.
+    ll.aot (group().m_aot_compile);
+
     m_stat_llvm_setup_time += timer.lap();
 
     // Set up m_num_used_layers to be the number of layers that are
@@ -1489,7 +1711,7 @@ BackendLLVM::run ()
         safegroup = Strutil::replace (safegroup     , ":", "_", true);
         if (safegroup.size() > 235)
             safegroup = Strutil::sprintf ("TRUNC_%s_%d", safegroup.substr(safegroup.size()-235), group().id());
-        std::string name = Strutil::sprintf ("%s_O%d.ll", safegroup, shadingsys().llvm_optimize());
+        std::string name = Strutil::sprintf ("%s_O%d.ll", safegroup, llvm_optimize_level());
         OIIO::ofstream out;
         OIIO::Filesystem::open(out, name);
         if (out) {
@@ -1500,7 +1722,11 @@ BackendLLVM::run ()
         }
     }
 
-    if (use_optix()) {
+    if (group().m_aot_compile) {
+        // Save the code rather than running it.
+        aot_emit_group (init_func, funcs);
+    }
+    else if (use_optix()) {
         std::string name = Strutil::sprintf ("%s_%d", group().name(), group().id());
 
 #if (OPTIX_VERSION < 70000)
@@ -6,6 +6,7 @@
 #include <memory>
 #include <cinttypes>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/strutil.h>
 #include <OpenImageIO/thread.h>
 #include <boost/thread/tss.hpp>   /* for thread_specific_ptr */
 
@@ -37,7 +38,9 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/ValueSymbolTable.h>
+#include <llvm/ADT/SmallString.h>
 #include <llvm/Linker/Linker.h>
+#include <llvm/Object/ObjectFile.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/CommandLine.h>
@@ -2667,6 +2670,11 @@ LLVM_Util::wide_constant_bool (bool i)
 llvm::Value *
 LLVM_Util::constant_ptr (void *p, llvm::PointerType *type)
 {
+    if (m_aot && p && m_aot_unrelocatable.empty())
+        m_aot_unrelocatable = OIIO::Strutil::sprintf ("pointer constant %p in function %s",
+                                                p, m_current_function
+                                                   ? func_name (m_current_function)
+                                                   : std::string("(none)"));
     if (! type)
         type = type_void_ptr();
     return builder().CreateIntToPtr (constant (size_t (p)), type, "const pointer");
@@ -2674,9 +2682,35 @@ LLVM_Util::constant_ptr (void *p, llvm::PointerType *type)
 
 
 
+llvm::Value *
+LLVM_Util::constant_data_ptr (const void *data, size_t size, int align,
+                              const std::string &name)
+{
+    llvm::ArrayRef<uint8_t> bytes ((const uint8_t *)data, size);
+    llvm::Constant *init = llvm::ConstantDataArray::get (context(), bytes);
+    llvm::GlobalVariable *g = new llvm::GlobalVariable (*module(),
+                                    init->getType(), true /* constant */,
+                                    llvm::GlobalValue::PrivateLinkage, init,
+                                    debug() ? name : std::string());
+    g->setUnnamedAddr (llvm::GlobalValue::UnnamedAddr::Global);
+#if OSL_LLVM_VERSION >= 110
+    g->setAlignment (llvm::Align(align));
+#elif OSL_LLVM_VERSION >= 100
+    g->setAlignment (llvm::MaybeAlign(align));
+#else
+    g->setAlignment (align);
+#endif
+    return void_ptr (g);
+}
+
+
+
 llvm::Value *
 LLVM_Util::constant (ustring s)
 {
+    if (m_aot && s.c_str())
+        return ptr_cast (aot_slot_value ("ustring", s), type_string());
+
     // Create a const size_t with the ustring contents
     size_t bits = sizeof(size_t)*8;
     llvm::Value *str = llvm::ConstantInt::get (context(),
@@ -2689,6 +2723,9 @@ LLVM_Util::constant (ustring s)
 llvm::Value *
 LLVM_Util::wide_constant (ustring s)
 {
+    if (m_aot && s.c_str())
+        return widen_value (constant (s));
+
     // Create a const size_t with the ustring contents
     size_t bits = sizeof(size_t)*8;
     llvm::Value *str = llvm::ConstantInt::get (context(),
@@ -5486,6 +5523,111 @@ LLVM_Util::ptx_compile_group (llvm::Module* lib_module, const std::string& name,
 
 
 
+llvm::Value *
+LLVM_Util::aot_slot (string_view kind, cspan<std::string> keys)
+{
+    std::string id (kind);
+    for (auto&& k : keys) {
+        id += '\0';
+        id += k;
+    }
+    llvm::Value *&slot (m_aot_slot_map[id]);
+    if (! slot) {
+        llvm::Type *type = type_array (type_void_ptr(), int(keys.size()));
+        AotSlot s;
+        s.name = OIIO::Strutil::sprintf ("osl_aot_slot_%d", int(m_aot_slots.size()));
+        s.kind = kind;
+        s.keys.assign (keys.begin(), keys.end());
+        // Not constant, and with external linkage, so that the optimizer
+        // can make no assumptions about what the loader will put there.
+        slot = new llvm::GlobalVariable (*module(), type, false /*constant*/,
+                                         llvm::GlobalValue::ExternalLinkage,
+                                         llvm::Constant::getNullValue(type),
+                                         s.name);
+        m_aot_slots.push_back (std::move(s));
+    }
+    return void_ptr (slot);
+}
+
+
+
+llvm::Value *
+LLVM_Util::aot_slot_value (string_view kind, string_view key, llvm::Type *type)
+{
+    std::string k (key);
+    llvm::Value *slot = ptr_cast (aot_slot (kind, cspan<std::string>(&k, 1)),
+                                  type_ptr (type_void_ptr()));
+    llvm::Value *val = op_load (type_void_ptr(), slot);
+    return type ? ptr_cast (val, type) : val;
+}
+
+
+
+bool
+LLVM_Util::emit_object (std::string &out, std::string *err)
+{
+    llvm::TargetMachine *target_machine = execengine()
+                                        ? execengine()->getTargetMachine()
+                                        : nullptr;
+    if (! target_machine) {
+        if (err)
+            *err = "no target machine to generate code for";
+        return false;
+    }
+
+    llvm::legacy::PassManager mod_pm;
+    llvm::SmallString<4096> object;
+    llvm::raw_svector_ostream object_stream (object);
+#if OSL_LLVM_VERSION >= 100
+    bool failed = target_machine->addPassesToEmitFile (mod_pm, object_stream,
+                                                       nullptr,
+                                                       llvm::CGFT_ObjectFile);
+#else
+    bool failed = target_machine->addPassesToEmitFile (mod_pm, object_stream,
+                                                       nullptr,
+                                                       llvm::TargetMachine::CGFT_ObjectFile);
+#endif
+    if (failed) {
+        if (err)
+            *err = "target can't emit object files";
+        return false;
+    }
+    mod_pm.run (*module());
+    out.assign (object.data(), object.size());
+    return true;
+}
+
+
+
+bool
+LLVM_Util::add_object (string_view object, std::string *err)
+{
+    std::unique_ptr<llvm::MemoryBuffer> buffer
+        = llvm::MemoryBuffer::getMemBufferCopy (llvm::StringRef(object.data(), object.size()),
+                                                "osl_aot_object");
+    auto obj = llvm::object::ObjectFile::createObjectFile (buffer->getMemBufferRef());
+    if (! obj) {
+        if (err)
+            *err = llvm::toString (obj.takeError());
+        return false;
+    }
+    execengine()->addObjectFile (llvm::object::OwningBinary<llvm::object::ObjectFile>
+                                     (std::move(*obj), std::move(buffer)));
+    execengine()->finalizeObject ();
+    m_ModuleIsFinalized = true;
+    return true;
+}
+
+
+
+void *
+LLVM_Util::getPointerToSymbol (const std::string &name)
+{
+    return (void *) execengine()->getGlobalValueAddress (name);
+}
+
+
+
 std::string
 LLVM_Util::bitcode_string (llvm::Function *func)
 {
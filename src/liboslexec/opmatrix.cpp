@@ -128,6 +128,54 @@ OSL_SHADEOP OSL_HOSTDEVICE void osl_transformn_dvmdv(void *result, void* M_, voi
 }
 
 #ifndef __CUDACC__
+// Retrieve the matrix (or its inverse) for the named space from the
+// renderer, consulting the context's matrix cache first if enabled.
+// Only successful lookups are cached, so unknown spaces keep reporting
+// errors on every use.
+static bool
+get_cached_matrix (ShaderGlobals *sg, Matrix44 &M, ustring name, bool inverse)
+{
+    ShadingContext *ctx = (ShadingContext *)sg->context;
+    TransformationPtr xform = nullptr;
+    if (name == Strings::shader)
+        xform = sg->shader2common;
+    else if (name == Strings::object)
+        xform = sg->object2common;
+
+    // Object-dependent spaces are keyed by their transformation, named
+    // spaces are keyed by the object too since renderers may resolve
+    // them relative to the object being shaded.
+    TransformationPtr key = xform ? xform : sg->object2common;
+    bool use_cache = ctx->shadingsys().matrix_cache() != 0;
+    if (use_cache) {
+        if (const Matrix44 *cached = ctx->matrix_cache().find (name, sg->time,
+                                                               key, inverse)) {
+            M = *cached;
+            return true;
+        }
+    }
+
+    bool ok;
+    RendererServices *renderer = ctx->renderer();
+    if (name == Strings::shader || name == Strings::object) {
+        if (inverse)
+            renderer->get_inverse_matrix (sg, M, xform, sg->time);
+        else
+            renderer->get_matrix (sg, M, xform, sg->time);
+        ok = true;
+    } else if (inverse) {
+        ok = renderer->get_inverse_matrix (sg, M, name, sg->time);
+    } else {
+        ok = renderer->get_matrix (sg, M, name, sg->time);
+    }
+
+    if (ok && use_cache)
+        ctx->matrix_cache().insert (name, sg->time, key, inverse, M);
+    return ok;
+}
+
+
+
 OSL_SHADEOP int
 osl_get_matrix (void *sg_, void *r, const char *from)
 {
@@ -138,18 +186,9 @@ osl_get_matrix (void *sg_, void *r, const char *from)
         MAT(r).makeIdentity ();
         return true;
     }
-    if (USTR(from) == Strings::shader) {
-        ctx->renderer()->get_matrix (sg, MAT(r), sg->shader2common, sg->time);
-        return true;
-    }
-    if (USTR(from) == Strings::object) {
-        ctx->renderer()->get_matrix (sg, MAT(r), sg->object2common, sg->time);
-        return true;
-    }
-    int ok = ctx->renderer()->get_matrix (sg, MAT(r), USTR(from), sg->time);
+    int ok = get_cached_matrix (sg, MAT(r), USTR(from), false);
     if (! ok) {
         MAT(r).makeIdentity();
-        ShadingContext *ctx = (ShadingContext *)((ShaderGlobals *)sg)->context;
         if (ctx->shadingsys().unknown_coordsys_error())
             ctx->errorf("Unknown transformation \"%s\"", from);
     }
@@ -168,18 +207,9 @@ osl_get_inverse_matrix (void *sg_, void *r, const char *to)
         MAT(r).makeIdentity ();
         return true;
     }
-    if (USTR(to) == Strings::shader) {
-        ctx->renderer()->get_inverse_matrix (sg, MAT(r), sg->shader2common, sg->time);
-        return true;
-    }
-    if (USTR(to) == Strings::object) {
-        ctx->renderer()->get_inverse_matrix (sg, MAT(r), sg->object2common, sg->time);
-        return true;
-    }
-    int ok = ctx->renderer()->get_inverse_matrix (sg, MAT(r), USTR(to), sg->time);
+    int ok = get_cached_matrix (sg, MAT(r), USTR(to), true);
     if (! ok) {
         MAT(r).makeIdentity ();
-        ShadingContext *ctx = (ShadingContext *)((ShaderGlobals *)sg)->context;
         if (ctx->shadingsys().unknown_coordsys_error())
             ctx->errorf("Unknown transformation \"%s\"", to);
     }
@@ -9,8 +9,12 @@
 /////////////////////////////////////////////////////////////////////////
 // Notes on how messages work:
 //
-// The messages are stored in a ParamValueList in the ShadingContext.
-// For simple types, just slurp them up into the PVL.
+// The messages are stored in the MessageList of the ShadingContext.
+// Message names that are constant in the shader group get a slot in it,
+// and the code generated for them calls the _slot variants below with
+// that slot number; everything else is found by name.  Apart from how
+// the message is found, both variants behave identically, including the
+// errors for setting a message twice or after it was queried.
 //
 // FIXME -- setmessage only stores message values, not derivs, so
 // getmessage only retrieves the values and has zero derivs.
@@ -26,8 +30,8 @@ OSL_NAMESPACE_ENTER
 namespace pvt {
 
 
-OSL_SHADEOP void
-osl_setmessage (ShaderGlobals *sg, const char *name_, long long type_, void *val, int layeridx, const char* sourcefile_, int sourceline)
+static void
+setmessage (ShaderGlobals *sg, int slot, const char *name_, long long type_, void *val, int layeridx, const char* sourcefile_, int sourceline)
 {
     const ustring &name (USTR(name_));
     const ustring &sourcefile (USTR(sourcefile_));
@@ -38,7 +42,7 @@ osl_setmessage (ShaderGlobals *sg, const char *name_, long long type_, void *val
         type.basetype = TypeDesc::PTR;  // for closures, we store a pointer
 
     MessageList &messages (sg->context->messages());
-    const Message* m = messages.find(name);
+    const Message* m = messages.find(name, slot);
     if (m != NULL) {
         if (m->name == name) {
             // message already exists?
@@ -56,34 +60,39 @@ osl_setmessage (ShaderGlobals *sg, const char *name_, long long type_, void *val
         }
     }
     // The message didn't exist - create it
-    messages.add(name, val, type, layeridx, sourcefile, sourceline);
+    messages.add(name, val, type, layeridx, sourcefile, sourceline, slot);
 }
 
 
 
-OSL_SHADEOP int
-osl_getmessage (ShaderGlobals *sg, const char *source_, const char *name_,
-                long long type_, void *val, int derivs,
-                int layeridx, const char* sourcefile_, int sourceline)
+OSL_SHADEOP void
+osl_setmessage (ShaderGlobals *sg, const char *name_, long long type_, void *val, int layeridx, const char* sourcefile_, int sourceline)
 {
-    const ustring &source (USTR(source_));
-    const ustring &name (USTR(name_));
-    const ustring &sourcefile (USTR(sourcefile_));
+    setmessage (sg, -1, name_, type_, val, layeridx, sourcefile_, sourceline);
+}
 
-    // recreate TypeDesc -- we just crammed it into an int!
-    TypeDesc type = TYPEDESC(type_);
+
+
+OSL_SHADEOP void
+osl_setmessage_slot (ShaderGlobals *sg, int slot, const char *name_, long long type_, void *val, int layeridx, const char* sourcefile_, int sourceline)
+{
+    setmessage (sg, slot, name_, type_, val, layeridx, sourcefile_, sourceline);
+}
+
+
+
+// Look up a message on the blackboard (by slot, if slot isn't -1).
+static int
+getmessage (ShaderGlobals *sg, int slot, ustring name, TypeDesc type,
+            void *val, int derivs, int layeridx, ustring sourcefile,
+            int sourceline)
+{
     bool is_closure = (type.basetype == TypeDesc::UNKNOWN); // secret code for closure
     if (is_closure)
         type.basetype = TypeDesc::PTR;  // for closures, we store a pointer
 
-    static ustring ktrace ("trace");
-    if (source == ktrace) {
-        // Source types where we need to ask the renderer
-        return sg->renderer->getmessage (sg, source, name, type, val, derivs);
-    }
-
     MessageList &messages (sg->context->messages());
-    const Message* m = messages.find(name);
+    const Message* m = messages.find(name, slot);
     if (m != NULL) {
         if (m->name == name) {
             if (m->type != type) {
@@ -123,10 +132,46 @@ osl_getmessage (ShaderGlobals *sg, const char *source_, const char *name_,
     }
     // Message not found -- we must record this event in case another layer tries to set the message again later on
     if (sg->context->shadingsys().strict_messages())
-        messages.add(name, NULL, type, layeridx, sourcefile, sourceline);
+        messages.add(name, NULL, type, layeridx, sourcefile, sourceline, slot);
     return 0;
 }
 
 
+
+OSL_SHADEOP int
+osl_getmessage (ShaderGlobals *sg, const char *source_, const char *name_,
+                long long type_, void *val, int derivs,
+                int layeridx, const char* sourcefile_, int sourceline)
+{
+    const ustring &source (USTR(source_));
+    const ustring &name (USTR(name_));
+
+    // recreate TypeDesc -- we just crammed it into an int!
+    TypeDesc type = TYPEDESC(type_);
+
+    static ustring ktrace ("trace");
+    if (source == ktrace) {
+        // Source types where we need to ask the renderer
+        if (type.basetype == TypeDesc::UNKNOWN)
+            type.basetype = TypeDesc::PTR;  // closures are stored as pointers
+        return sg->renderer->getmessage (sg, source, name, type, val, derivs);
+    }
+
+    return getmessage (sg, -1, name, type, val, derivs, layeridx,
+                       USTR(sourcefile_), sourceline);
+}
+
+
+
+OSL_SHADEOP int
+osl_getmessage_slot (ShaderGlobals *sg, int slot, const char *name_,
+                     long long type_, void *val, int derivs,
+                     int layeridx, const char* sourcefile_, int sourceline)
+{
+    return getmessage (sg, slot, USTR(name_), TYPEDESC(type_), val, derivs,
+                       layeridx, USTR(sourcefile_), sourceline);
+}
+
+
 } // namespace pvt
 OSL_NAMESPACE_EXIT
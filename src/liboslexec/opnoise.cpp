@@ -602,6 +602,40 @@ NOISE_IMPL_DERIV_OPT (gabornoise, GaborNoise)
 PNOISE_IMPL_DERIV_OPT (gaborpnoise, GaborPNoise)
 
 
+
+// Fractal noise shares the option-taking signature with gabor so that
+// octaves/lacunarity/gain can arrive through NoiseParams.  All octaves are
+// summed inside one call rather than one noise op per octave.
+template<FractalType Type>
+struct FractalNoise {
+    OSL_HOSTDEVICE FractalNoise () { }
+
+    template<class R, class S> OSL_HOSTDEVICE
+    inline void operator() (StringParam /*noisename*/, Dual2<R> &result,
+                            const Dual2<S> &s,
+                            ShaderGlobals* /*sg*/, const NoiseParams *opt) const {
+        FractalNoiseImpl<Type> impl (opt->octaves, opt->lacunarity, opt->gain);
+        impl (result, s);
+    }
+
+    template<class R, class S, class T> OSL_HOSTDEVICE
+    inline void operator() (StringParam /*noisename*/, Dual2<R> &result,
+                            const Dual2<S> &s, const Dual2<T> &t,
+                            ShaderGlobals* /*sg*/, const NoiseParams *opt) const {
+        FractalNoiseImpl<Type> impl (opt->octaves, opt->lacunarity, opt->gain);
+        impl (result, s, t);
+    }
+};
+
+typedef FractalNoise<FractalType::FBM> FBMNoise;
+typedef FractalNoise<FractalType::Turbulence> TurbulenceNoise;
+typedef FractalNoise<FractalType::Ridged> RidgedNoise;
+
+NOISE_IMPL_DERIV_OPT (fbmnoise, FBMNoise)
+NOISE_IMPL_DERIV_OPT (turbulencenoise, TurbulenceNoise)
+NOISE_IMPL_DERIV_OPT (ridgednoise, RidgedNoise)
+
+
 // Turn off warnings about unused params, since the NullNoise methods are stubs.
 OSL_PRAGMA_WARNING_PUSH
 OSL_GCC_PRAGMA(GCC diagnostic ignored "-Wunused-parameter")
@@ -695,6 +729,15 @@ struct GenericNoise {
         } else if (name == STRING_PARAMS(gabor)) {
             GaborNoise gnoise;
             gnoise (name, result, s, sg, opt);
+        } else if (name == STRING_PARAMS(fbm)) {
+            FBMNoise fnoise;
+            fnoise (name, result, s, sg, opt);
+        } else if (name == STRING_PARAMS(turbulence)) {
+            TurbulenceNoise fnoise;
+            fnoise (name, result, s, sg, opt);
+        } else if (name == STRING_PARAMS(ridged)) {
+            RidgedNoise fnoise;
+            fnoise (name, result, s, sg, opt);
         } else if (name == STRING_PARAMS(null)) {
             NullNoise noise; noise(result, s);
         } else if (name == STRING_PARAMS(unull)) {
@@ -737,6 +780,15 @@ struct GenericNoise {
         } else if (name == STRING_PARAMS(gabor)) {
             GaborNoise gnoise;
             gnoise (name, result, s, t, sg, opt);
+        } else if (name == STRING_PARAMS(fbm)) {
+            FBMNoise fnoise;
+            fnoise (name, result, s, t, sg, opt);
+        } else if (name == STRING_PARAMS(turbulence)) {
+            TurbulenceNoise fnoise;
+            fnoise (name, result, s, t, sg, opt);
+        } else if (name == STRING_PARAMS(ridged)) {
+            RidgedNoise fnoise;
+            fnoise (name, result, s, t, sg, opt);
         } else if (name == STRING_PARAMS(null)) {
             NullNoise noise; noise(result, s, t);
         } else if (name == STRING_PARAMS(unull)) {
@@ -888,6 +940,30 @@ osl_noiseparams_set_impulses (void *opt, float i)
 
 
 
+OSL_SHADEOP OSL_HOSTDEVICE void
+osl_noiseparams_set_octaves (void *opt, int o)
+{
+    ((RendererServices::NoiseOpt *)opt)->octaves = o;
+}
+
+
+
+OSL_SHADEOP OSL_HOSTDEVICE void
+osl_noiseparams_set_lacunarity (void *opt, float l)
+{
+    ((RendererServices::NoiseOpt *)opt)->lacunarity = l;
+}
+
+
+
+OSL_SHADEOP OSL_HOSTDEVICE void
+osl_noiseparams_set_gain (void *opt, float g)
+{
+    ((RendererServices::NoiseOpt *)opt)->gain = g;
+}
+
+
+
 OSL_SHADEOP void
 osl_count_noise (void *sg_)
 {
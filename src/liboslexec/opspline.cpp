@@ -120,5 +120,46 @@ OSL_SHADEOP OSL_HOSTDEVICE void osl_splineinverse_dffdf(void *out, const char *s
 
 
 
+// Versions for splines whose basis and knots were constant at compile
+// time, taking the table built by Spline::build_table.
+
+OSL_SHADEOP OSL_HOSTDEVICE void osl_spline_table_fff(void *out, void *x,
+                                       void *table, int nsegs)
+{
+  Spline::evaluate_table (*(float *)out, *(float *)x, (const float *)table, nsegs);
+}
+
+OSL_SHADEOP OSL_HOSTDEVICE void osl_spline_table_dfdff(void *out, void *x,
+                                         void *table, int nsegs)
+{
+  Spline::evaluate_table (DFLOAT(out), DFLOAT(x), (const float *)table, nsegs);
+}
+
+OSL_SHADEOP OSL_HOSTDEVICE void osl_spline_table_vfv(void *out, void *x,
+                                       void *table, int nsegs)
+{
+  Spline::evaluate_table (*(Vec3 *)out, *(float *)x, (const Vec3 *)table, nsegs);
+}
+
+OSL_SHADEOP OSL_HOSTDEVICE void osl_spline_table_dvdfv(void *out, void *x,
+                                         void *table, int nsegs)
+{
+  Spline::evaluate_table (DVEC(out), DFLOAT(x), (const Vec3 *)table, nsegs);
+}
+
+OSL_SHADEOP OSL_HOSTDEVICE void osl_splineinverse_table_fff(void *out, void *x,
+                                              void *table, int nsegs)
+{
+  Spline::inverse_table (*(float *)out, *(float *)x, (const float *)table, nsegs);
+}
+
+OSL_SHADEOP OSL_HOSTDEVICE void osl_splineinverse_table_dfdff(void *out, void *x,
+                                                void *table, int nsegs)
+{
+  Spline::inverse_table (DFLOAT(out), DFLOAT(x), (const float *)table, nsegs);
+}
+
+
+
 } // namespace pvt
 OSL_NAMESPACE_EXIT
@@ -13,7 +13,6 @@
 #include <cstdarg>
 
 #include <OpenImageIO/strutil.h>
-#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
 
 #include "oslexec_pvt.h"
@@ -203,7 +202,7 @@ osl_warning (ShaderGlobals *sg, const char* format_str, ...)
 
 
 OSL_SHADEOP void
-osl_fprintf (ShaderGlobals* /*sg*/, const char *filename,
+osl_fprintf (ShaderGlobals *sg, const char *filename,
              const char* format_str, ...)
 {
     va_list args;
@@ -211,11 +210,7 @@ osl_fprintf (ShaderGlobals* /*sg*/, const char *filename,
     std::string s = Strutil::vsprintf (format_str, args);
     va_end (args);
 
-    static OIIO::mutex fprintf_mutex;
-    OIIO::lock_guard lock (fprintf_mutex);
-    FILE *file = OIIO::Filesystem::fopen (filename, "a");
-    fputs (s.c_str(), file);
-    fclose (file);
+    sg->context->record_to_file (USTR(filename), s);
 }
 
 
@@ -9,6 +9,8 @@
 #include <stack>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <list>
 #include <regex>
 #include <set>
@@ -30,6 +32,7 @@
 
 #include <OpenImageIO/ustring.h>
 #include <OpenImageIO/thread.h>
+#include <OpenImageIO/timer.h>
 #include <OpenImageIO/paramlist.h>
 #include <OpenImageIO/refcnt.h>
 #include <OpenImageIO/color.h>
@@ -104,11 +107,12 @@ typedef void (*RunLLVMGroupFunc)(void* shaderglobals,
                                  void* output_base_pointer,
                                  int shadeindex);
 #if OSL_USE_BATCHED
+/// Lane `i` of the batch has shade index `shadeindex + i`.
 typedef void (*RunLLVMGroupFuncWide)(void* batchedshaderglobals,
                                      void* heap_arena_ptr,
-                                     // void* userdata_base_pointer,
-                                     // void* output_base_pointer,
-                                     // wide int shadeindex
+                                     void* userdata_base_pointer,
+                                     void* output_base_pointer,
+                                     int shadeindex,
                                      int run_mask_value);
 #endif
 
@@ -446,6 +450,60 @@ private:
 
 
 
+/// Collects the fprintf output of every shading thread and writes it to
+/// the destination files in large appends, rather than opening, writing
+/// and closing the file on each call.  Pending text is kept per file name
+/// and the files are spread over a fixed number of independently locked
+/// shards, so threads writing different files rarely contend.  Text
+/// handed over in one append() is never split or interleaved with other
+/// appends, and appends to the same file are written in the order they
+/// arrived.  Files that can't be opened are reported through the
+/// ShadingSystem's error handler.
+class FileOutputManager {
+public:
+    FileOutputManager (ShadingSystemImpl &shadingsys)
+        : m_shadingsys(shadingsys), m_flush_threshold(0),
+          m_bytes_written(0), m_file_writes(0)
+    { }
+    FileOutputManager (const FileOutputManager&) = delete;
+    ~FileOutputManager () { flush (); }
+
+    /// Number of bytes a file may accumulate before it is written out.
+    /// Zero writes every append immediately.
+    void flush_threshold (size_t bytes) { m_flush_threshold = bytes; }
+    size_t flush_threshold () const { return m_flush_threshold; }
+
+    /// Queue text to be appended to the named file.
+    void append (ustring filename, string_view text);
+
+    /// Write out everything that is pending, for all files.
+    void flush ();
+
+    long long bytes_written () const { return m_bytes_written; }
+    long long file_writes () const { return m_file_writes; }
+
+private:
+    static constexpr int nshards = 16;
+    struct alignas(64) Shard {
+        mutex m_mutex;
+        std::unordered_map<ustring, std::string, ustringHash> m_pending;
+    };
+
+    Shard &shard (ustring filename) {
+        return m_shards[filename.hash() % nshards];
+    }
+    // Append text to the file on disk; caller holds the shard lock.
+    void write (ustring filename, const std::string &text);
+
+    ShadingSystemImpl &m_shadingsys;          ///< Backpointer to shadingsys
+    Shard m_shards[nshards];
+    std::atomic<size_t> m_flush_threshold;    ///< Bytes held before writing
+    std::atomic<long long> m_bytes_written;   ///< Stat: bytes written
+    std::atomic<long long> m_file_writes;     ///< Stat: file appends
+};
+
+
+
 class ShadingSystemImpl
 {
 public:
@@ -494,6 +552,25 @@ public:
     bool ReParameter (ShaderGroup &group,
                       string_view layername, string_view paramname,
                       TypeDesc type, const void *val);
+    bool respecialize (ShaderGroup *group, ShadingContext *ctx,
+                       float settle_time);
+    int recompile_hot_groups (ShadingContext *ctx);
+
+    /// Hash the group's spec and, if an identical group is already known,
+    /// arrange for this one to share its optimized and compiled code;
+    /// otherwise make this group the one that others will share.
+    void dedup_group (ShaderGroup &group);
+    /// The identical group whose code `group` runs in place of its own,
+    /// or empty if it compiles for itself. Re-hashes as needed if either
+    /// was edited since they were matched up.
+    ShaderGroupRef shared_body (ShaderGroup &group);
+    /// The derivative-free variant of `group`, cloned from it (but not yet
+    /// optimized) on first request. Empty if there can't be one.
+    ShaderGroupRef no_derivs_variant (ShaderGroup &group);
+    bool aot_compile (ShaderGroup *group, std::string &object,
+                      std::string &manifest, ShadingContext *ctx);
+    bool aot_load (ShaderGroup *group, string_view object,
+                   string_view manifest);
 
     // Internal error, warning, info, and message reporting routines that
     // take std::format-like arguments.
@@ -522,6 +599,8 @@ public:
     void message (const std::string &message) const;
 
     std::string getstats (int level=1) const;
+    std::string getstats_json (int level=1) const;
+    void reset_stats_interval ();
 
     ErrorHandler &errhandler () const { return *m_err; }
 
@@ -536,6 +615,15 @@ public:
 
     void release_context (ShadingContext *ctx);
 
+    ShadingContext *get_shared_context (PerThreadInfo *threadinfo,
+                                        TextureSystem::Perthread *texture_threadinfo=NULL);
+
+    /// Which slot of the shared context pool the calling thread prefers.
+    static int shared_context_home_slot (int nslots);
+
+    /// Destination of all shader fprintf output.
+    FileOutputManager &file_output () { return m_file_output; }
+
     bool execute (ShadingContext &ctx, ShaderGroup &group, int shadeindex,
                   ShaderGlobals &ssg, void* userdata_base_ptr,
                   void* output_base_ptr, bool run=true);
@@ -563,10 +651,13 @@ public:
     bool strict_messages() const { return m_strict_messages; }
     bool range_checking() const { return m_range_checking; }
     bool unknown_coordsys_error() const { return m_unknown_coordsys_error; }
+    int matrix_cache() const { return m_matrix_cache; }
     bool connection_error() const { return m_connection_error; }
     bool relaxed_param_typecheck() const { return m_relaxed_param_typecheck; }
     int optimize () const { return m_optimize; }
     int llvm_optimize () const { return m_llvm_optimize; }
+    int llvm_tier1_optimize () const { return m_llvm_tier1_optimize; }
+    int llvm_tier_threshold () const { return m_llvm_tier_threshold; }
     int llvm_debug () const { return m_llvm_debug; }
     int llvm_debug_layers () const { return m_llvm_debug_layers; }
     int llvm_debug_ops () const { return m_llvm_debug_ops; }
@@ -703,6 +794,32 @@ private:
     int find_named_layer_in_group (ShaderGroup& group,
                                    ustring layername, ShaderInstance * &inst);
 
+    /// Create a new group and add it to the census; if make_current is
+    /// true, it also becomes the target of the group-less API calls.
+    ShaderGroupRef new_group (string_view groupname, bool make_current);
+
+    /// Create a group that stays out of the census and the group
+    /// statistics, to be a private clone of another one.
+    ShaderGroupRef new_clone_group (string_view groupname);
+
+    /// Parse a serialized group description (as accepted by the
+    /// three-argument ShaderGroupBegin) into an already-begun group.
+    /// Return false and issue an error if it could not be parsed.
+    bool parse_group_spec (ShaderGroup& group, string_view usage,
+                           string_view groupspec);
+
+    /// Build and end a new group from the serialized spec of `group`,
+    /// carrying over the settings that the spec leaves out. It doesn't
+    /// become the current group, and like any clone it isn't counted as a
+    /// group of its own (in the census, the number of groups still to
+    /// compile, or the group stats). Return an empty ref on failure.
+    ShaderGroupRef clone_group (const ShaderGroup& group);
+
+    /// Number of named counters, and the current value of one of them
+    /// (by index into the table that getstats_json walks).
+    static int num_stat_counters ();
+    double stat_counter (int index) const;
+
     /// Turn a connectionname (such as "Kd" or "Cout[1]", etc.) into a
     /// ConnectedParam descriptor.  This routine is strictly a helper for
     /// ConnectShaders, and will issue error messages on its behalf.
@@ -765,6 +882,7 @@ private:
     bool m_error_repeats;                 ///< Allow repeats of identical err/warn?
     bool m_range_checking;                ///< Range check arrays & components?
     bool m_unknown_coordsys_error;        ///< Error to use unknown xform name?
+    int m_matrix_cache;                   ///< Cache named-space matrices?
     bool m_connection_error;              ///< Error for ConnectShaders to fail?
     bool m_greedyjit;                     ///< JIT as much as we can?
     bool m_countlayerexecs;               ///< Count number of layer execs?
@@ -787,6 +905,7 @@ private:
     bool m_opt_middleman;                 ///< Middle-man optimization?
     bool m_opt_texture_handle;            ///< Use texture handles?
     bool m_opt_seed_bblock_aliases;       ///< Turn on basic block alias seeds
+    bool m_opt_hoist_transforms;          ///< Share matrices among transforms?
     bool m_opt_batched_analysis;          ///< Perform extra analysis required for batched execution?
     bool m_llvm_jit_fma;                  ///< Allow fused multiply/add in JIT
     bool m_llvm_jit_aggressive;           ///< Turn on llvm "aggressive" JIT
@@ -795,6 +914,9 @@ private:
     int m_vector_width;                   ///< SIMD width maximum (8)
     int m_opt_passes;                     ///< Opt passes per layer
     int m_llvm_optimize;                  ///< OSL optimization strategy
+    int m_llvm_tier1_optimize;            ///< Strategy for quick first JIT
+    int m_llvm_tier_threshold;            ///< Executions before promotion
+    bool m_dedup_groups;                  ///< Share code of identical groups
     int m_debug;                          ///< Debugging output
     int m_llvm_debug;                     ///< More LLVM debugging output
     int m_llvm_debug_layers;              ///< Add layer enter/exit printfs
@@ -822,11 +944,14 @@ private:
     int m_max_local_mem_KB;               ///< Local storage can a shader use
     bool m_compile_report;                ///< Print compilation report?
     bool m_buffer_printf;                 ///< Buffer/batch printf output?
+    bool m_buffer_fprintf;                ///< Hold fprintf output per shade?
+    int m_fprintf_flush_bytes;            ///< File output write threshold
     bool m_no_noise;                      ///< Substitute trivial noise calls
     bool m_no_pointcloud;                 ///< Substitute trivial pointcloud calls
     bool m_force_derivs;                  ///< Force derivs on everything
     bool m_allow_shader_replacement;      ///< Allow shader masters to replace
     int m_exec_repeat;                    ///< How many times to execute group
+    int m_no_derivs_raytypes;             ///< Default for groups (see there)
     int m_opt_warnings;                   ///< Warn on inability to optimize
     int m_gpu_opt_error;                  ///< Error on inability to optimize
                                           ///<   away things that can't GPU.
@@ -839,6 +964,15 @@ private:
     mutable mutex m_mutex;
     mutable boost::thread_specific_ptr<PerThreadInfo> m_perthread_info;
 
+    // Contexts shared by all threads: a fixed number of slots, each
+    // either empty or holding an idle context.
+    int m_max_shared_contexts;            ///< Slots in the shared pool
+    std::once_flag m_shared_contexts_init;
+    std::unique_ptr<std::atomic<ShadingContext*>[]> m_shared_contexts;
+    int m_nshared_context_slots;          ///< Size of m_shared_contexts
+
+    FileOutputManager m_file_output;      ///< Buffered fprintf output
+
     // Stats
     atomic_int m_stat_shaders_loaded;     ///< Stat: shaders loaded
     atomic_int m_stat_shaders_requested;  ///< Stat: shaders requested
@@ -848,9 +982,14 @@ private:
     atomic_int m_stat_groupinstances;     ///< Stat: total inst in all groups
     atomic_int m_stat_instances_compiled; ///< Stat: instances compiled
     atomic_int m_stat_groups_compiled;    ///< Stat: groups compiled
+    atomic_int m_stat_groups_recompiled;  ///< Stat: hot groups promoted
+    atomic_int m_stat_groups_deduplicated;///< Stat: groups sharing code
+    atomic_int m_stat_groups_aot_loaded;  ///< Stat: groups run from aot code
     atomic_int m_stat_empty_instances;    ///< Stat: shaders empty after opt
     atomic_int m_stat_merged_inst;        ///< Stat: number of merged instances
     atomic_int m_stat_merged_inst_opt;    ///< Stat: merged insts after opt
+    atomic_int m_stat_inst_code_copied;   ///< Stat: insts copying master code
+    atomic_int m_stat_inst_syms_copied;   ///< Stat: insts copying master syms
     atomic_int m_stat_empty_groups;       ///< Stat: groups empty after opt
     atomic_int m_stat_regexes;            ///< Stat: how many regex's compiled
     atomic_int m_stat_preopt_syms;        ///< Stat: pre-optimization symbols
@@ -859,6 +998,7 @@ private:
     atomic_int m_stat_preopt_ops;         ///< Stat: pre-optimization ops
     atomic_int m_stat_postopt_ops;        ///< Stat: post-optimization ops
     atomic_int m_stat_middlemen_eliminated; ///< Stat: middlemen eliminated
+    atomic_int m_stat_transforms_hoisted; ///< Stat: xforms sharing a matrix
     atomic_int m_stat_const_connections;  ///< Stat: const connections elim'd
     atomic_int m_stat_global_connections; ///< Stat: global connections elim'd
     atomic_int m_stat_tex_calls_codegened;///< Stat: total texture calls
@@ -877,6 +1017,8 @@ private:
     double m_stat_getattribute_fail_time; ///< Stat: time spent in getattribute
     atomic_ll m_stat_getattribute_calls;  ///< Stat: Number of getattribute
     atomic_ll m_stat_get_userdata_calls;  ///< Stat: # of get_userdata calls
+    atomic_ll m_stat_uniform_lanes_checks;   ///< Stat: batched uniform checks
+    atomic_ll m_stat_uniform_lanes_fastpath; ///< Stat: ... that were uniform
     atomic_ll m_stat_noise_calls;         ///< Stat: # of noise calls
     long long m_stat_pointcloud_searches;
     long long m_stat_pointcloud_searches_total_results;
@@ -900,11 +1042,19 @@ private:
     PeakCounter<off_t> m_stat_mem_inst_syms;
     PeakCounter<off_t> m_stat_mem_inst_paramvals;
     PeakCounter<off_t> m_stat_mem_inst_connections;
+    PeakCounter<off_t> m_stat_mem_inst_code;        ///< Private ops+args
+    PeakCounter<off_t> m_stat_mem_inst_code_shared; ///< Referenced, not copied
+    PeakCounter<off_t> m_stat_mem_inst_syms_shared; ///< Referenced, not copied
 
     mutable spin_mutex m_stat_mutex;     ///< Mutex for non-atomic stats
+    mutable spin_mutex m_stat_interval_mutex; ///< Guards the two below
+    std::vector<double> m_stat_interval_base; ///< Counters at interval start
+    long long m_stat_interval_start = OIIO::Timer::now(); ///< Its ticks
     ClosureRegistry m_closure_registry;
     std::vector<std::weak_ptr<ShaderGroup> > m_all_shader_groups;
     mutable spin_mutex m_all_shader_groups_mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<ShaderGroup>> m_group_bodies;
+    mutex m_group_bodies_mutex;           ///< Guards m_group_bodies & links
 
     // State for entering shader groups -- this is only for the
     // non-threadsafe calls to Parameter/etc that don't take a group
@@ -1049,16 +1199,16 @@ public:
     /// Return a pointer to the symbol (specified by integer index),
     /// or NULL (if index was -1, as returned by 'findsymbol').
     Symbol *symbol (int index) {
-        return index >= 0 && index < (int)m_instsymbols.size()
-            ? &m_instsymbols[index] : NULL;
+        SymbolVec &syms (symbols());
+        return index >= 0 && index < (int)syms.size() ? &syms[index] : NULL;
     }
     const Symbol *symbol (int index) const {
-        return index >= 0 && index < (int)m_instsymbols.size()
-            ? &m_instsymbols[index] : NULL;
+        const SymbolVec &syms (symbols());
+        return index >= 0 && index < (int)syms.size() ? &syms[index] : NULL;
     }
 
     /// Given symbol pointer, what is its index in the table?
-    int symbolindex (Symbol *s) { return s - &m_instsymbols[0]; }
+    int symbolindex (Symbol *s) { return s - &symbols()[0]; }
 
     /// Return a pointer to the master's version of the indexed symbol.
     /// It's a const*, since you shouldn't mess with the master's copy.
@@ -1183,50 +1333,90 @@ public:
     /// Return a SymRange for the set of param symbols that is suitable to
     /// pass as a "range for".
     friend SymRange<Symbol> param_range (ShaderInstance *i) {
-        if (i->m_instsymbols.size() == 0 || i->firstparam() == i->lastparam())
+        SymbolVec &syms (i->symbols());
+        if (syms.size() == 0 || i->firstparam() == i->lastparam())
             return SymRange<Symbol> ();
         else
-            return SymRange<Symbol> (&i->m_instsymbols[0] + i->firstparam(),
-                                     &i->m_instsymbols[0] + i->lastparam());
+            return SymRange<Symbol> (&syms[0] + i->firstparam(),
+                                     &syms[0] + i->lastparam());
     }
 
     friend SymRange<const Symbol> param_range (const ShaderInstance *i) {
-        if (i->m_instsymbols.size() == 0 || i->firstparam() == i->lastparam())
+        const SymbolVec &syms (i->symbols());
+        if (syms.size() == 0 || i->firstparam() == i->lastparam())
             return SymRange<const Symbol> ();
         else
-            return SymRange<const Symbol> (&i->m_instsymbols[0] + i->firstparam(),
-                                           &i->m_instsymbols[0] + i->lastparam());
+            return SymRange<const Symbol> (&syms[0] + i->firstparam(),
+                                           &syms[0] + i->lastparam());
     }
 
     friend SymRange<Symbol> sym_range (ShaderInstance *i) {
-        if (i->m_instsymbols.size() == 0)
+        SymbolVec &syms (i->symbols());
+        if (syms.size() == 0)
             return SymRange<Symbol> ();
         else
-            return SymRange<Symbol> (&i->m_instsymbols[0],
-                                     &i->m_instsymbols[0] + i->m_instsymbols.size());
+            return SymRange<Symbol> (&syms[0], &syms[0] + syms.size());
     }
     friend SymRange<const Symbol> sym_range (const ShaderInstance *i) {
-        if (i->m_instsymbols.size() == 0)
+        const SymbolVec &syms (i->symbols());
+        if (syms.size() == 0)
             return SymRange<const Symbol> ();
         else
-            return SymRange<const Symbol> (&i->m_instsymbols[0],
-                                           &i->m_instsymbols[0] + i->m_instsymbols.size());
+            return SymRange<const Symbol> (&syms[0], &syms[0] + syms.size());
     }
 
     int Psym () const { return m_Psym; }
     int Nsym () const { return m_Nsym; }
 
-    const std::vector<int> & args () const { return m_instargs; }
-    std::vector<int> & args () { return m_instargs; }
+    // The code (ops and args) and the symbols are copy-on-write: after
+    // copy_code_from_master, the const accessors keep reading the master's
+    // copy, and only the first non-const access makes a private one. So
+    // layers that are never modified (for example, because they turn out to
+    // be unused or merged away) never pay for one. Passes that only look
+    // should do so through a const ShaderInstance.
+    const std::vector<int> & args () const {
+        return m_code_shared ? master()->m_args : m_instargs;
+    }
+    std::vector<int> & args () {
+        if (m_code_shared)
+            unshare_code ();
+        return m_instargs;
+    }
     int arg (int argnum) const { return args()[argnum]; }
     const Symbol *argsymbol (int argnum) const { return symbol(arg(argnum)); }
     Symbol *argsymbol (int argnum) { return symbol(arg(argnum)); }
-    const OpcodeVec & ops () const { return m_instops; }
-    OpcodeVec & ops () { return m_instops; }
+    const OpcodeVec & ops () const {
+        return m_code_shared ? master()->m_ops : m_instops;
+    }
+    OpcodeVec & ops () {
+        if (m_code_shared)
+            unshare_code ();
+        return m_instops;
+    }
     const Opcode & op (int opnum) const { return ops()[opnum]; }
     Opcode & op (int opnum) { return ops()[opnum]; }
-    SymbolVec &symbols () { return m_instsymbols; }
-    const SymbolVec &symbols () const { return m_instsymbols; }
+    SymbolVec &symbols () {
+        if (m_syms_shared)
+            unshare_symbols ();
+        return m_instsymbols;
+    }
+    const SymbolVec &symbols () const {
+        return m_syms_shared ? master()->m_symbols : m_instsymbols;
+    }
+
+    /// Is the code still shared with the master (no private copy yet)?
+    bool code_shared () const { return m_code_shared; }
+
+    /// Are the symbols still shared with the master?
+    bool symbols_shared () const { return m_syms_shared; }
+
+    /// Give up the code (ops and args), whether it is shared or private.
+    void release_code ();
+
+    /// Give up the symbols, whether they are shared or private. Return the
+    /// bytes of the private copy, if there was one (for the caller to take
+    /// off the memory stats).
+    off_t release_symbols ();
 
     /// Make sure there's room for more symbols.
     ///
@@ -1311,11 +1501,21 @@ public:
     bool mergeable (const ShaderInstance &b, const ShaderGroup &g) const;
 
 private:
+    /// Make the private copy of the master's code that a shared instance
+    /// needs before it can be modified.
+    void unshare_code ();
+
+    /// Likewise for the symbols.
+    void unshare_symbols ();
+
     ShaderMaster::ref m_master;         ///< Reference to the master
     SymOverrideInfoVec m_instoverrides; ///< Instance parameter info
     SymbolVec m_instsymbols;            ///< Symbols used by the instance
     OpcodeVec m_instops;                ///< Actual code instructions
     std::vector<int> m_instargs;        ///< Arguments for all the ops
+    bool m_code_shared;                 ///< Ops/args still the master's?
+    bool m_syms_shared;                 ///< Symbols still the master's?
+    off_t m_code_mem;                   ///< Bytes charged for private code
     ustring m_layername;                ///< Name of this layer
     std::vector<int> m_iparams;         ///< int param values
     std::vector<float> m_fparams;       ///< float param values
@@ -1341,15 +1541,19 @@ private:
 
 
 
+/// Bump allocator for the per-shade memory of a ShadingContext (closures,
+/// messages, scratch).  Memory comes from a list of equal-sized blocks
+/// that are kept across clear() calls and reused.  BlockSize is only the
+/// initial block size: reserve() grows it so that a group's typical usage
+/// fits in one block, and no block is allocated until the first alloc(),
+/// so contexts that never need a pool don't pay for one.  An allocation
+/// too large for a block gets a block of its own, freed at the next
+/// clear().  The pool also remembers how many bytes were allocated since
+/// the last clear() and the most ever allocated between two clears.
 template<int BlockSize>
 class SimplePool {
 public:
-    SimplePool() {
-        // pool must have at least one block available to avoid special cases
-        m_blocks.emplace_back(new char[BlockSize]);
-        m_block_offset = BlockSize;
-        m_current_block = 0;
-    }
+    SimplePool() {}
 
     // avoid 'attempting to reference a deleted function' of std::unique_ptr<char>s
     // in reference to those member variables of ShadingContext
@@ -1363,33 +1567,73 @@ public:
     char * alloc(size_t size, size_t alignment=1) {
         // Alignment must be power of two
         OSL_DASSERT((alignment & (alignment - 1)) == 0);
-
-        // Assume sizes are never larger than the configured BlockSize
-        OSL_DASSERT(size + alignment - 1 <= BlockSize);
-
-        // Fix up alignment
-        m_block_offset += alignment_offset_calc(m_blocks[m_current_block].get() + m_block_offset, alignment);
-
-        // Do we have at least 'size' bytes available in our current block?
-        if (m_block_offset + size > BlockSize) {
-            // the current block doesn't have enough room, make a new block
-            m_current_block++;
-            if (m_blocks.size() == m_current_block)
-                m_blocks.emplace_back(new char[BlockSize]);
-            m_block_offset = alignment_offset_calc(m_blocks[m_current_block].get(), alignment);
+        if (m_blocks_used) {
+            char* block = m_blocks[m_blocks_used - 1].get();
+            size_t offset = m_block_offset
+                          + alignment_offset_calc(block + m_block_offset, alignment);
+            // Do we have at least 'size' bytes available in our current block?
+            if (offset + size <= m_block_size) {
+                // Count the alignment padding too, so that a block of
+                // peak() bytes holds everything one shade allocated.
+                m_used += offset + size - m_block_offset;
+                m_block_offset = offset + size;
+                return block + offset;
+            }
         }
-        char* ptr = m_blocks[m_current_block].get() + m_block_offset;
-        OSL_DASSERT(reinterpret_cast<uintptr_t>(ptr) % alignment == 0);
-        m_block_offset += size;
-        return ptr;
+        return alloc_new_block(size, alignment);
     }
 
     void clear () {
-        m_current_block = 0;
+        m_peak = std::max(m_peak, m_used);
+        m_used = 0;
+        m_blocks_used = 0;
         m_block_offset = 0;
+        m_large_blocks.clear();
+    }
+
+    /// Make the blocks at least `size` bytes, so that a shade allocating
+    /// that much needs only one of them.  Blocks never shrink.  Only call
+    /// this right after clear().
+    void reserve(size_t size) {
+        OSL_DASSERT(m_blocks_used == 0);
+        if (size > m_block_size) {
+            // Round up to a multiple of the initial size, to avoid
+            // reallocating for each slightly larger group.
+            m_block_size = (size + BlockSize - 1) / BlockSize * BlockSize;
+            m_blocks.clear();
+        }
     }
 
+    /// Bytes allocated since the last clear(), alignment padding included.
+    size_t used() const { return m_used; }
+
+    /// The most bytes ever allocated between two clear() calls.
+    size_t peak() const { return std::max(m_peak, m_used); }
+
+    /// Current size of the blocks.
+    size_t block_size() const { return m_block_size; }
+
 private:
+    char * alloc_new_block(size_t size, size_t alignment) {
+        if (size + alignment - 1 > m_block_size) {
+            // Too big for any block: give it one of its own
+            m_large_blocks.emplace_back(new char[size + alignment - 1]);
+            char* ptr = m_large_blocks.back().get();
+            size_t offset = alignment_offset_calc(ptr, alignment);
+            m_used += offset + size;
+            return ptr + offset;
+        }
+        // the current block doesn't have enough room, move on to the next
+        if (m_blocks.size() == m_blocks_used)
+            m_blocks.emplace_back(new char[m_block_size]);
+        char* block = m_blocks[m_blocks_used++].get();
+        size_t offset = alignment_offset_calc(block, alignment);
+        OSL_DASSERT(reinterpret_cast<uintptr_t>(block + offset) % alignment == 0);
+        m_used += offset + size;
+        m_block_offset = offset + size;
+        return block + offset;
+    }
+
     static inline size_t alignment_offset_calc(void* ptr, size_t alignment) {
         uintptr_t ptrbits = reinterpret_cast<uintptr_t>(ptr);
         uintptr_t offset = ((ptrbits + alignment - 1) & -alignment) - ptrbits;
@@ -1397,16 +1641,81 @@ private:
         return offset;
     }
 
-    std::vector<std::unique_ptr<char[]>> m_blocks; ///< Hold blocks of BlockSize bytes
-    size_t  m_current_block;    ///< Index into the m_blocks array
-    size_t  m_block_offset;     ///< Offset from the start of the current block
+    std::vector<std::unique_ptr<char[]>> m_blocks; ///< Hold blocks of m_block_size bytes
+    std::vector<std::unique_ptr<char[]>> m_large_blocks; ///< Oversized allocations
+    size_t  m_block_size = BlockSize; ///< Size of each block in m_blocks
+    size_t  m_blocks_used = 0;  ///< Blocks in use; the last is the current one
+    size_t  m_block_offset = 0; ///< Offset from the start of the current block
+    size_t  m_used = 0;         ///< Bytes allocated since clear()
+    size_t  m_peak = 0;         ///< High-water mark of m_used
 };
 
+/// Small cache of the named-space matrices a context has retrieved from
+/// the renderer, so that repeated transform(), matrix(), and getmatrix()
+/// calls involving the same space don't go back to
+/// RendererServices::get_matrix (or re-invert the matrix) every time.
+/// Entries are keyed by the space name, the time, the identity of the
+/// object being shaded (its object2common transformation), and whether
+/// it's the forward or inverse matrix. It's a tiny round-robin table,
+/// since shaders rarely refer to more than a handful of spaces.
+class MatrixCache {
+public:
+    MatrixCache () { clear(); }
+
+    /// Forget all cached matrices.
+    void clear () {
+        m_nentries = 0;
+        m_next = 0;
+    }
+
+    /// Return a pointer to the cached matrix for the given key, or
+    /// nullptr if it's not in the cache.
+    const Matrix44* find (ustring name, float time, TransformationPtr object,
+                          bool inverse) const {
+        for (int i = 0; i < m_nentries; ++i) {
+            const Entry& e (m_entries[i]);
+            if (e.name == name && e.time == time && e.object == object
+                && e.inverse == inverse)
+                return &e.M;
+        }
+        return nullptr;
+    }
+
+    /// Add a matrix to the cache, replacing the oldest entry if the
+    /// cache is full.
+    void insert (ustring name, float time, TransformationPtr object,
+                 bool inverse, const Matrix44& M) {
+        Entry& e (m_entries[m_next]);
+        e.name = name;
+        e.time = time;
+        e.object = object;
+        e.inverse = inverse;
+        e.M = M;
+        m_next = (m_next + 1) % max_entries;
+        m_nentries = std::min (m_nentries + 1, int(max_entries));
+    }
+
+private:
+    struct Entry {
+        ustring name;              ///< Name of the space
+        float time;                ///< Time the matrix was retrieved for
+        TransformationPtr object;  ///< Identity of the object shaded
+        bool inverse;              ///< Is it the inverse matrix?
+        Matrix44 M;                ///< The matrix itself
+    };
+    static const int max_entries = 8;
+    Entry m_entries[max_entries];
+    int m_nentries;                ///< Number of valid entries
+    int m_next;                    ///< Next entry to replace
+};
+
+
+
 /// Represents a single message for use by getmessage and setmessage opcodes
 ///
 struct Message {
-    Message(ustring name, const TypeDesc& type, int layeridx, ustring sourcefile, int sourceline, Message* next) :
-       name(name), data(nullptr), type(type), layeridx(layeridx), sourcefile(sourcefile), sourceline(sourceline), next(next) {}
+    Message(ustring name, const TypeDesc& type, int layeridx, ustring sourcefile, int sourceline) :
+       name(name), data(nullptr), type(type), layeridx(layeridx), sourcefile(sourcefile), sourceline(sourceline) {}
 
     /// Some messages don't have data because getmessage() was called before setmessage
     /// (which is flagged as an error to avoid ambiguities caused by execution order)
@@ -1419,36 +1728,113 @@ struct Message {
     int layeridx;           ///< layer index where this was message was created
     ustring sourcefile;     ///< source code file that contains the call that created this message
     int sourceline;         ///< source code line that contains the call that created this message
-    Message* next;          ///< linked list of messages (managed by MessageList below)
 };
 
-/// Represents the list of messages set by a given shader using setmessage and getmessage
+/// Represents the messages set by a given shader using setmessage and
+/// getmessage (the "blackboard").
+///
+/// Every message name that appears as a constant in the group's
+/// setmessage/getmessage ops gets a slot, numbered by its position in
+/// the group's sorted message_names(); the generated code passes the
+/// slot, so those messages are found by indexing.  Messages with names
+/// computed at runtime go into a small open-addressed hash table.  A
+/// name always lives in the same place whichever way it's referred to:
+/// runtime names that turn out to have a slot use the slot.
 ///
 struct MessageList {
-     MessageList() : list_head(nullptr), message_data() {}
+    MessageList() {}
 
-     void clear() {
-         list_head = NULL;
-         message_data.clear();
-     }
+    void clear() {
+        std::fill (m_slots.begin(), m_slots.end(), nullptr);
+        if (m_table_count) {
+            std::fill (m_table.begin(), m_table.end(), nullptr);
+            m_table_count = 0;
+        }
+        message_data.clear();
+    }
 
-    const Message* find(ustring name) const {
-        for (const Message* m = list_head; m != NULL; m = m->next)
-            if (m->name == name)
-                return m; // name matches
+    /// Give each of the (sorted) names a slot.  The names must outlive
+    /// the shade; they belong to the group being executed.
+    void set_slots(const std::vector<ustring>& names) {
+        m_slot_names = &names;
+        m_slots.assign (names.size(), nullptr);
+    }
+
+    /// Size the message storage for about `size` bytes per shade.
+    void reserve(size_t size) { message_data.reserve(size); }
+
+    /// Bytes of messages (and their data) set since the last clear().
+    size_t used() const { return message_data.used(); }
+
+    /// Find the named message, or return nullptr.  If slot isn't -1, it
+    /// must be the slot of name.
+    const Message* find(ustring name, int slot = -1) const {
+        if (slot < 0)
+            slot = slot_of(name);
+        OSL_DASSERT(slot < 0 || (*m_slot_names)[slot] == name);
+        if (slot >= 0)
+            return m_slots[slot];
+        if (! m_table_count)
+            return nullptr;
+        size_t mask = m_table.size() - 1;
+        for (size_t i = name.hash() & mask; m_table[i]; i = (i + 1) & mask)
+            if (m_table[i]->name == name)
+                return m_table[i];
         return nullptr; // not found
     }
 
-    void add(ustring name, void* data, const TypeDesc& type, int layeridx, ustring sourcefile, int sourceline) {
-        list_head = new (message_data.alloc(sizeof(Message), alignof(Message))) Message(name, type, layeridx, sourcefile, sourceline, list_head);
+    /// Record a message (with no data, if data is null, for a getmessage
+    /// that found nothing).  The name must not already be present.
+    void add(ustring name, void* data, const TypeDesc& type, int layeridx, ustring sourcefile, int sourceline, int slot = -1) {
+        Message* m = new (message_data.alloc(sizeof(Message), alignof(Message))) Message(name, type, layeridx, sourcefile, sourceline);
         if (data) {
-            list_head->data = message_data.alloc(type.size());
-            memcpy(list_head->data, data, type.size());
+            m->data = message_data.alloc(type.size());
+            memcpy(m->data, data, type.size());
+        }
+        if (slot < 0)
+            slot = slot_of(name);
+        if (slot >= 0) {
+            m_slots[slot] = m;
+            return;
         }
+        if (2 * (m_table_count + 1) > m_table.size())
+            grow_table();
+        insert(m);
     }
 
 private:
-    Message*         list_head;
+    int slot_of(ustring name) const {
+        if (! m_slot_names || m_slot_names->empty())
+            return -1;
+        auto found = std::lower_bound (m_slot_names->begin(),
+                                       m_slot_names->end(), name);
+        if (found == m_slot_names->end() || *found != name)
+            return -1;
+        return int(found - m_slot_names->begin());
+    }
+
+    void insert(Message* m) {
+        size_t mask = m_table.size() - 1;
+        size_t i = m->name.hash() & mask;
+        while (m_table[i])
+            i = (i + 1) & mask;
+        m_table[i] = m;
+        ++m_table_count;
+    }
+
+    void grow_table() {
+        std::vector<Message*> old (std::max (size_t(16), 2 * m_table.size()), nullptr);
+        old.swap (m_table);
+        m_table_count = 0;
+        for (Message* m : old)
+            if (m)
+                insert(m);
+    }
+
+    std::vector<Message*> m_slots;      ///< Messages with constant names
+    const std::vector<ustring>* m_slot_names = nullptr; ///< Name of each slot
+    std::vector<Message*> m_table;      ///< Hash table of the other messages
+    size_t m_table_count = 0;           ///< Messages in m_table
     SimplePool<1024> message_data;
 };
 
@@ -1516,6 +1902,48 @@ public:
     size_t llvm_groupdata_size () const { return m_llvm_groupdata_size; }
     void llvm_groupdata_size (size_t size) { m_llvm_groupdata_size = size; }
 
+    /// Bytes of closure and message storage that one execution of the
+    /// group allocates, estimated from its ops when it is optimized.
+    /// These are only estimates, not bounds either way: ops inside loops
+    /// are counted once, but ops in branches that aren't taken, closures
+    /// built at JIT time and getmessage calls that find their message
+    /// all count too.  pool_size_closures()/pool_size_messages() fold in
+    /// what was actually observed.
+    size_t closure_bytes_hint () const { return m_closure_bytes_hint; }
+    size_t message_bytes_hint () const { return m_message_bytes_hint; }
+
+    /// The constant message names used by the group's setmessage and
+    /// getmessage ops, sorted; each one's index is its MessageList slot.
+    const std::vector<ustring>& message_names () const { return m_message_names; }
+
+    /// The MessageList slot for a message name, or -1 if it has none.
+    int message_slot (ustring name) const {
+        auto found = std::lower_bound (m_message_names.begin(),
+                                       m_message_names.end(), name);
+        if (found == m_message_names.end() || *found != name)
+            return -1;
+        return int(found - m_message_names.begin());
+    }
+
+    /// How big a context's pools should be to run this group: the larger
+    /// of the optimizer's estimate and the peak seen so far.
+    size_t pool_size_closures () const {
+        return std::max (m_closure_bytes_hint,
+                         size_t(m_stat_peak_closure_bytes.load()));
+    }
+    size_t pool_size_messages () const {
+        return std::max (m_message_bytes_hint,
+                         size_t(m_stat_peak_message_bytes.load()));
+    }
+
+    /// Note the closure, message, and scratch memory used by one
+    /// execution, keeping the per-group high-water marks.
+    void record_pool_usage (size_t closures, size_t messages, size_t scratch) {
+        atomic_max (m_stat_peak_closure_bytes, closures);
+        atomic_max (m_stat_peak_message_bytes, messages);
+        atomic_max (m_stat_peak_scratch_bytes, scratch);
+    }
+
     size_t llvm_groupdata_wide_size () const { return m_llvm_groupdata_wide_size; }
     void llvm_groupdata_wide_size (size_t size) { m_llvm_groupdata_wide_size = size; }
 
@@ -1575,12 +2003,26 @@ public:
 
     long long int executions () const { return m_executions; }
 
-    void start_running () {
-#ifndef NDEBUG
-       m_executions++;
+    /// Count an execution. Release builds only count when tiered
+    /// compilation, which needs the count, is on. (The tier can't say:
+    /// the first execution comes before the group is compiled.)
+    void start_running (bool tiered) {
+#ifdef NDEBUG
+       if (! tiered)
+           return;
 #endif
+       m_executions++;
     }
 
+    /// Tiered compilation state: LLVMTierNone for a group compiled once
+    /// in the usual way; LLVMTierQuick for one JITed with the cheap
+    /// "llvm_tier1_optimize" passes and counting executions toward
+    /// promotion; LLVMTierPromoted for one that was (or whose clone is
+    /// being) compiled at full "llvm_optimize" strength.
+    enum LLVMTier { LLVMTierNone = 0, LLVMTierQuick = 1, LLVMTierPromoted = 2 };
+    int llvm_tier () const { return m_llvm_tier; }
+    void llvm_tier (int tier) { m_llvm_tier = tier; }
+
     void name (ustring name) { m_name = name; }
     ustring name () const { return m_name; }
 
@@ -1633,12 +2075,77 @@ public:
     void set_raytypes (int raytypes_on, int raytypes_off) {
         m_raytypes_on  = raytypes_on;
         m_raytypes_off = raytypes_off;
+        spec_edited ();
     }
     int raytypes_on ()  const { return m_raytypes_on; }
     int raytypes_off () const { return m_raytypes_off; }
 
-    void clear_symlocs() { m_symlocs.clear(); }
+    /// Does the group have params that stay editable after optimization?
+    bool interactive () const { return ! m_interactive_params.empty(); }
+
+    /// Is the named param of the named layer in "interactive_params"?
+    bool is_interactive_param (ustring layername, ustring paramname) const;
+
+    /// Note that an interactive param was just edited: drop any
+    /// specialized version (so the edit shows at once) and restart the
+    /// settling clock.
+    void interactive_edited () {
+        ++m_edit_epoch;
+        m_last_edit_ticks = OIIO::Timer::now();
+        specialized (ShaderGroupRef());
+    }
+    /// Note that a lockgeom=0 param of a tiered group was edited after
+    /// optimization. Its promoted clone still holds the old value, so drop
+    /// the clone and go back to running (and counting executions of) the
+    /// quick code, which reads the param live.
+    void tier_edited () {
+        ++m_edit_epoch;
+        specialized (ShaderGroupRef());
+        m_executions = 0;
+        m_llvm_tier = LLVMTierQuick;
+    }
+    int edit_epoch () const { return m_edit_epoch; }
+    double seconds_since_edit () const {
+        return OIIO::Timer::seconds (OIIO::Timer::now() - m_last_edit_ticks);
+    }
+
+    /// The fully specialized replacement for an interactive group that
+    /// matches its current param values, or empty if none is ready.
+    /// (A quick-compiled group that recompile_hot_groups() promoted keeps
+    /// its fully optimized clone here, too.)
+    ShaderGroupRef specialized () const { return std::atomic_load (&m_specialized); }
+    void specialized (ShaderGroupRef g) { std::atomic_store (&m_specialized, g); }
+
+    /// Might this group run the code of an identical group rather than
+    /// compiling its own? (Cheap enough to ask before every execute; the
+    /// ShadingSystemImpl::shared_body() it gates says for sure.)
+    bool maybe_shared () const { return m_dedup_dirty || m_dedup_sharing; }
+    /// Note that something that goes into the group's code changed, so
+    /// the group must be hashed again before it can share, and any
+    /// derivative-free variant is out of date.
+    void spec_edited () {
+        m_dedup_dirty = 1;
+        if (m_no_derivs_raytypes) {
+            std::atomic_store (&m_no_derivs_variant, ShaderGroupRef());
+            m_no_derivs_failed = false;   // the new spec may clone fine
+        }
+    }
+
+    /// Executes whose raytype has any of these bits set run the group's
+    /// derivative-free variant: a clone in which no symbol carries
+    /// derivatives, so Dx/Dy/area are zero and texture lookups get zero
+    /// filter widths, in exchange for less code and smaller group data.
+    int no_derivs_raytypes () const { return m_no_derivs_raytypes; }
+    /// The derivative-free variant, if it has been built.
+    ShaderGroupRef no_derivs_variant () const {
+        return std::atomic_load (&m_no_derivs_variant);
+    }
+    /// Is this the derivative-free variant of some group?
+    bool no_derivs () const { return m_no_derivs; }
+
+    void clear_symlocs() { m_symlocs.clear(); spec_edited(); }
     void add_symlocs(cspan<SymLocationDesc> symlocs) {
+        spec_edited ();
         for (auto& s : symlocs) {
             // Insert and maintain sorted order
             auto f = std::lower_bound(m_symlocs.begin(), m_symlocs.end(), s.name);
@@ -1679,6 +2186,8 @@ private:
     volatile int m_batch_jitted = 0; ///< Is it already jitted for batch execution?
     size_t m_llvm_groupdata_size = 0;///< Heap size needed for its groupdata
     size_t m_llvm_groupdata_wide_size = 0;    ///< Heap size needed for its wide groupdata
+    size_t m_closure_bytes_hint = 0; ///< Estimated closure bytes per shade
+    size_t m_message_bytes_hint = 0; ///< Estimated message bytes per shade
     int m_id;                        ///< Unique ID for the group
     int m_num_entry_layers = 0;      ///< Number of marked entry layers
     RunLLVMGroupFunc m_llvm_compiled_version = nullptr;
@@ -1692,6 +2201,10 @@ private:
     std::vector<ShaderInstanceRef> m_layers;
     ustring m_name;
     int m_exec_repeat = 1;           ///< How many times to execute group
+    int m_no_derivs_raytypes = 0;    ///< Raytypes to run no_derivs variant
+    bool m_no_derivs = false;        ///< Is this the no-derivs variant?
+    ShaderGroupRef m_no_derivs_variant; ///< Derivative-free clone
+    std::atomic<bool> m_no_derivs_failed { false }; ///< Couldn't clone it
     int m_raytype_queries = -1;      ///< Bitmask of raytypes queried
     int m_raytypes_on = 0;           ///< Bitmask of raytypes we assume to be on
     int m_raytypes_off = 0;          ///< Bitmask of raytypes we assume to be off
@@ -1701,6 +2214,7 @@ private:
     std::vector<ustring> m_textures_needed;
     std::vector<ustring> m_closures_needed;
     std::vector<ustring> m_globals_needed;  // semi-deprecated
+    std::vector<ustring> m_message_names;   ///< Constant message names
     std::vector<ustring> m_userdata_names;
     std::vector<TypeDesc> m_userdata_types;
     std::vector<int> m_userdata_offsets;
@@ -1711,18 +2225,45 @@ private:
     std::vector<ustring> m_attribute_scopes;
     std::vector<ustring> m_renderer_outputs; ///< Names of renderer outputs
     std::vector<SymLocationDesc> m_symlocs; ///< SORTED!!
+    std::vector<ustring> m_interactive_params; ///< Editable "[layer.]param"
+    ShaderGroupRef m_specialized;         ///< Specialized for current edits
+    std::weak_ptr<ShaderGroup> m_self;    ///< The ref new_group handed out
+    ShaderGroupRef m_shared_body;         ///< Identical group we run instead
+    atomic_ll m_dedup_hash {0};           ///< Hash of spec (0 = can't share)
+    atomic_int m_dedup_dirty {0};         ///< Spec edited since last hashed
+    atomic_int m_dedup_sharing {0};       ///< Is m_shared_body set?
+    bool m_clone = false;                 ///< Private clone (see clone_group)
+    atomic_int m_edit_epoch {0};          ///< Bumped by each interactive edit
+    atomic_ll m_last_edit_ticks {0};      ///< When the last edit happened
+    atomic_int m_llvm_tier {0};           ///< LLVMTier of its compiled code
     bool m_unknown_textures_needed;
     bool m_unknown_closures_needed;
     bool m_unknown_attributes_needed;
     atomic_ll m_executions {0};       ///< Number of times the group executed
     atomic_ll m_stat_total_shading_time_ticks {0}; ///< Total shading time (ticks)
+    atomic_ll m_stat_peak_closure_bytes {0}; ///< Most closure memory in a shade
+    atomic_ll m_stat_peak_message_bytes {0}; ///< Most message memory in a shade
+    atomic_ll m_stat_peak_scratch_bytes {0}; ///< Most scratch memory in a shade
+
+    // Raise an atomic high-water mark to val, if it's not already there.
+    static void atomic_max (atomic_ll &peak, size_t val) {
+        long long v = (long long) val;
+        long long cur = peak.load();
+        while (v > cur && ! peak.compare_exchange_weak (cur, v))
+            ;
+    }
 
     // PTX assembly for compiled ShaderGroup
     std::string m_llvm_ptx_compiled_version;
 
+    // Ahead-of-time compilation (see ShadingSystem::aot_compile)
+    bool m_aot_compile = false;           ///< Emit an object, don't JIT
+    std::string m_aot_object;             ///< Native object file contents
+    std::string m_aot_manifest;           ///< How to load m_aot_object
+
     ParamValueList m_pending_params;      ///< Pending Parameter() values
     ustring m_group_use;                  ///< "Usage" of group
-    bool m_complete = false;              ///< Successfully ShaderGroupEnd?
+    std::atomic<bool> m_complete { false }; ///< Successfully ShaderGroupEnd?
 
     friend class OSL::pvt::ShadingSystemImpl;
     friend class OSL::pvt::BackendLLVM;
@@ -1730,10 +2271,25 @@ private:
     friend class OSL::pvt::BatchedBackendLLVM;
 #endif
     friend class ShadingContext;
+    friend uint64_t aot_spec_hash (const ShaderGroup &group);
 };
 
 
 
+/// Hash of everything about a group's specification that goes into the
+/// code generated for it, used to make sure that code compiled ahead of
+/// time is loaded only into a group that would have compiled the same.
+uint64_t aot_spec_hash (const ShaderGroup &group);
+
+/// An aot manifest is lines of tab-separated, escaped fields. Make one
+/// line of it from the given fields (including the trailing newline).
+std::string aot_manifest_line (const std::vector<std::string> &fields);
+
+/// Split an aot manifest into lines of unescaped fields.
+std::vector<std::vector<std::string>> aot_manifest_parse (string_view manifest);
+
+
+
 /// The full context for executing a shader group.
 ///
 class OSLEXECPUBLIC ShadingContext {
@@ -1749,6 +2305,14 @@ public:
     ///
     RendererServices *renderer () const { return m_renderer; }
 
+    /// Return the group that should actually run when `requested` is
+    /// asked to execute for a ray of the given raytype: the identical
+    /// group whose code it shares, if any; then its derivative-free
+    /// variant, if the raytype calls for one; then the specialized or
+    /// promoted clone of whichever of those it is, if one is installed;
+    /// otherwise `requested` itself.
+    ShaderGroup& select_group (ShaderGroup& requested, int raytype);
+
     /// Bind a shader group and globals to this context and prepare to
     /// execute. (See similarly named method of ShadingSystem.)
     bool execute_init(ShaderGroup& group, int shadeindex,
@@ -1792,15 +2356,24 @@ public:
 
         /// Bind a shader group and batched of globals to this context and prepare to
         /// execute. (See similarly named method of ShadingSystem.)
-        bool execute_init (ShaderGroup &group, int batch_size, BatchedShaderGlobals<WidthT> &bsg, bool run=true);
+        bool execute_init (ShaderGroup &group, int batch_size, int shadeindex,
+                           BatchedShaderGlobals<WidthT> &bsg,
+                           void* userdata_base_ptr, void* output_base_ptr,
+                           bool run=true);
 
         /// Execute the layer whose index is specified. (See similarly named
         /// method of ShadingSystem.)
-        bool execute_layer (int batch_size, BatchedShaderGlobals<WidthT> &bsg, int layer);
+        bool execute_layer (int batch_size, int shadeindex,
+                            BatchedShaderGlobals<WidthT> &bsg,
+                            void* userdata_base_ptr, void* output_base_ptr,
+                            int layer);
 
         /// Execute the shader group, including init, run of single entry point
         /// layer, and cleanup. (See similarly named method of ShadingSystem.)
-        bool execute(ShaderGroup &group, int batch_size, BatchedShaderGlobals<WidthT> &bsg, bool run=true);
+        bool execute(ShaderGroup &group, int batch_size, int shadeindex,
+                     BatchedShaderGlobals<WidthT> &bsg,
+                     void* userdata_base_ptr, void* output_base_ptr,
+                     bool run=true);
 
         template<typename ...ArgListT>
         inline
@@ -1938,6 +2511,10 @@ public:
     BatchedMessageBuffer & batched_messages_buffer() { return m_batched_messages_buffer; }
 #endif
 
+    /// Return a reference to the cache of named-space matrices.
+    ///
+    MatrixCache & matrix_cache () { return m_matrix_cache; }
+
     /// Look up a query from a dictionary (typically XML), staring the
     /// search from the root of the dictionary, and returning ID of the
     /// first matching node.
@@ -1958,6 +2535,11 @@ public:
                             TypeDesc attr_type, void *attr_dest);
 
     PerThreadInfo *thread_info () const { return m_threadinfo; }
+    void thread_info (PerThreadInfo *threadinfo) { m_threadinfo = threadinfo; }
+
+    /// Did this context come from the pool shared by all threads?
+    bool shared () const { return m_shared; }
+    void shared (bool s) { m_shared = s; }
 
     TextureSystem::Perthread *texture_thread_info () const {
         if (! m_texture_thread_info)
@@ -1991,10 +2573,42 @@ public:
 
     void incr_get_userdata_calls () { ++m_stat_get_userdata_calls; }
 
+    /// Count a batched runtime uniform-lanes check, and whether it let a
+    /// single uniform call stand in for the varying one. (Only called by
+    /// code generated while the "profile" attribute is on.)
+    void incr_uniform_lanes_checks (bool fastpath) {
+        ++m_stat_uniform_lanes_checks;
+        m_stat_uniform_lanes_fastpath += fastpath;
+    }
+
+    /// Userdata binding table set by ShadingSystem::bind_userdata, or
+    /// nullptr to call RendererServices::get_userdata.
+    const UserDataBinding *userdata_bindings () const { return m_userdata_bindings; }
+    const void *userdata_record () const { return m_userdata_record; }
+    void bind_userdata (const UserDataBinding *bindings, const void *record) {
+        m_userdata_bindings = bindings;
+        m_userdata_record = record;
+    }
+
+    /// Per-lane userdata binding tables and records for batched shading.
+    const UserDataBinding *const *batched_userdata_bindings () const {
+        return m_batched_userdata_bindings;
+    }
+    const void *const *batched_userdata_records () const {
+        return m_batched_userdata_records;
+    }
+    void batched_bind_userdata (const UserDataBinding *const *bindings,
+                                const void *const *records) {
+        m_batched_userdata_bindings = bindings;
+        m_batched_userdata_records = records;
+    }
+
     // Clear the stats we record per-execution in this context (unlocked)
     void clear_runtime_stats () {
         m_stat_get_userdata_calls = 0;
         m_stat_layers_executed = 0;
+        m_stat_uniform_lanes_checks = 0;
+        m_stat_uniform_lanes_fastpath = 0;
     }
 
     // Transfer the per-execution stats from this context to the shading
@@ -2002,6 +2616,8 @@ public:
     void record_runtime_stats () {
         shadingsys().m_stat_get_userdata_calls += m_stat_get_userdata_calls;
         shadingsys().m_stat_layers_executed += m_stat_layers_executed;
+        shadingsys().m_stat_uniform_lanes_checks += m_stat_uniform_lanes_checks;
+        shadingsys().m_stat_uniform_lanes_fastpath += m_stat_uniform_lanes_fastpath;
     }
 
     bool allow_warnings() {
@@ -2020,9 +2636,12 @@ public:
 #if OSL_USE_BATCHED
     void record_error (ErrorHandler::ErrCode code, const std::string &text, Mask<MaxSupportedSimdLaneCount> mask) const;
     void record_to_file(ustring filename, const std::string &text, Mask<MaxSupportedSimdLaneCount> mask) const;
-    // Process all the recorded fprintf messages
-    void process_file_output () const;
 #endif
+    // Record fprintf output (buffered until execute_cleanup if the
+    // "buffer_fprintf" attribute is set)
+    void record_to_file (ustring filename, const std::string &text) const;
+    // Hand all the recorded fprintf messages to the FileOutputManager
+    void process_file_output () const;
     // Process all the recorded errors, warnings, printfs
     void process_errors () const;
 
@@ -2080,27 +2699,40 @@ private:
     ShadingSystemImpl &m_shadingsys;    ///< Backpointer to shadingsys
     RendererServices *m_renderer;       ///< Ptr to renderer services
     PerThreadInfo *m_threadinfo;        ///< Ptr to our thread's info
+    bool m_shared = false;              ///< Belongs to the shared pool?
     mutable TextureSystem::Perthread *m_texture_thread_info; ///< Ptr to texture thread info
     ShaderGroup *m_group;               ///< Ptr to shader group
+    ShaderGroup *m_requested_group = nullptr; ///< Group asked to execute
+    ShaderGroupRef m_specialized_group; ///< Clone or variant being run
+    ShaderGroup *m_dedup_requested = nullptr; ///< Last group that had a twin
+    ShaderGroupRef m_dedup_body;        ///< ...and the twin whose code it ran
     // Heap memory
     std::unique_ptr<char, decltype(&OIIO::aligned_free)> m_heap { nullptr, &OIIO::aligned_free };
     size_t m_heapsize = 0;
     using RegexMap = std::unordered_map<ustring, std::unique_ptr<std::regex>, ustringHash>;
     RegexMap m_regex_map;               ///< Compiled regex's
     MessageList m_messages;             ///< Message blackboard
+    MatrixCache m_matrix_cache;         ///< Cached named-space matrices
 #if OSL_USE_BATCHED
     BatchedMessageBuffer m_batched_messages_buffer;    ///< Buffer for Batched Message blackboard
 #endif
     int m_max_warnings;                 ///< To avoid processing too many warnings
     int m_stat_get_userdata_calls;      ///< Number of calls to get_userdata
     int m_stat_layers_executed;         ///< Number of layers executed
+    int m_stat_uniform_lanes_checks = 0;   ///< Batched uniform-lanes checks
+    int m_stat_uniform_lanes_fastpath = 0; ///< ... that found uniform lanes
     long long m_ticks;                  ///< Time executing the shader
 
+    const UserDataBinding *m_userdata_bindings = nullptr; ///< Indexed userdata
+    const void *m_userdata_record = nullptr;  ///< Point's userdata record
+    const UserDataBinding *const *m_batched_userdata_bindings = nullptr;
+    const void *const *m_batched_userdata_records = nullptr;
+
     TextureOpt m_textureopt;            ///< texture call options
     RendererServices::NoiseOpt m_noiseopt; ///< noise call options
     RendererServices::TraceOpt m_traceopt; ///< trace call options
 
-    SimplePool<20 * 1024> m_closure_pool;
+    SimplePool<4 * 1024> m_closure_pool;   ///< Grown by reserve() as needed
     SimplePool<64 * 1024> m_scratch_pool;
 
     Dictionary *m_dictionary;
@@ -2126,15 +2758,16 @@ private:
     };
     mutable std::vector<ErrorItem> m_buffered_errors;
 
-#if OSL_USE_BATCHED
-    // Buffering of fprintf's so they can be output
-    // to the file one data lane at a time
+    // Buffering of fprintf's so that each shade's output reaches the
+    // FileOutputManager in one piece per file (and, when batched, one data
+    // lane at a time)
     struct FileItem
     {
         FileItem() = default;
         FileItem(ustring filename_,
                   std::string msgString_,
-                  Mask<MaxSupportedSimdLaneCount> mask_)
+                  Mask<MaxSupportedSimdLaneCount> mask_ =
+                      Mask<MaxSupportedSimdLaneCount>(true))
         : filename(filename_)
         , msgString(msgString_)
         , mask(mask_)
@@ -2146,7 +2779,6 @@ private:
     };
     mutable std::vector<FileItem> m_buffered_file_output;
 
-#endif
     // When interpreting symbol addresses we need to know if the
     // wide data offsets should be used
     int batch_size_executed;
@@ -2180,10 +2812,14 @@ struct NoiseParams {
     Vec3 direction;
     float bandwidth;
     float impulses;
+    int octaves;          ///< Fractal noise: number of octaves summed
+    float lacunarity;     ///< Fractal noise: frequency step per octave
+    float gain;           ///< Fractal noise: amplitude step per octave
 
     NoiseParams ()
         : anisotropic(0), do_filter(true), direction(1.0f,0.0f,0.0f),
-          bandwidth(1.0f), impulses(16.0f)
+          bandwidth(1.0f), impulses(16.0f),
+          octaves(4), lacunarity(2.0f), gain(0.5f)
     {
     }
 };
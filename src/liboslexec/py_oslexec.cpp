@@ -0,0 +1,469 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Python bindings for building shader groups and shading arrays of points
+// with them.  Globals come in as NumPy arrays; userdata inputs and output
+// parameters travel through symloc arenas laid out as NumPy record arrays,
+// so the shaders read and write the caller's memory directly.
+
+#include "py_osl.h"
+
+#include <OpenImageIO/parallel.h>
+
+#include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+
+namespace PyOSL {
+
+using namespace OSL;
+
+
+
+// A shader group together with the record layouts of its placed userdata
+// and outputs. Each point's values are packed into one fixed-size record,
+// so the offsets baked into the JIT code hold for any array of points.
+struct PyShaderGroup {
+    struct Field {
+        std::string name;
+        TypeDesc type;
+        int64_t offset;
+    };
+
+    ShaderGroupRef group;
+    std::vector<Field> userdata;
+    std::vector<Field> outputs;
+    int64_t userdata_stride = 0;
+    int64_t output_stride   = 0;
+    bool compiled = false;  // layouts are frozen once the group is JITed
+};
+
+
+
+// The shading system and the renderer it calls back into.  Python has no
+// renderer of its own, so the stock RendererServices (which still provides
+// texture lookups through OIIO's TextureSystem) stands in for one.
+class PyShadingSystem {
+public:
+    PyShadingSystem()
+        : m_renderer(new RendererServices)
+        , m_ss(new ShadingSystem(m_renderer.get()))
+    {
+    }
+
+    ShadingSystem& ss() { return *m_ss; }
+
+private:
+    std::unique_ptr<RendererServices> m_renderer;
+    std::unique_ptr<ShadingSystem> m_ss;  // must die before m_renderer
+};
+
+
+
+static TypeDesc
+typedesc_from_python(const py::object& obj)
+{
+    if (py::isinstance<py::str>(obj))
+        return TypeDesc(obj.cast<std::string>());
+    return obj.cast<TypeDesc>();
+}
+
+
+
+// Find the type of the parameter that `name` refers to, searching from
+// the last layer back like the renderer output lookup does.  `name` may be
+// a bare parameter name or "layer.param".
+static bool
+find_param_type(ShadingSystem& ss, ShaderGroup* group, const std::string& name,
+                bool want_output, TypeDesc& type)
+{
+    int nlayers = 0;
+    ss.getattribute(group, "num_layers", nlayers);
+    std::vector<ustring> layernames(nlayers);
+    if (nlayers)
+        ss.getattribute(group, "layer_names",
+                        TypeDesc(TypeDesc::STRING, nlayers), &layernames[0]);
+    for (int layer = nlayers - 1; layer >= 0; --layer) {
+        OSLQuery q(group, layer);
+        for (const auto& p : q.parameters()) {
+            if (p.isstruct || p.isclosure || p.isoutput != want_output)
+                continue;
+            if (p.name.string() == name
+                || layernames[layer].string() + "." + p.name.string() == name) {
+                type = p.type;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+
+static int64_t
+layout_fields(ShadingSystem& ss, ShaderGroup* group,
+              const std::vector<std::string>& names, bool outputs,
+              std::vector<PyShaderGroup::Field>& fields)
+{
+    fields.clear();
+    int64_t offset = 0;
+    for (const auto& name : names) {
+        TypeDesc type;
+        if (!find_param_type(ss, group, name, outputs, type))
+            throw py::value_error("no " + std::string(outputs ? "output" : "input")
+                                  + " parameter named '" + name + "'");
+        if (type.basetype != TypeDesc::FLOAT && type.basetype != TypeDesc::INT)
+            throw py::value_error("parameter '" + name
+                                  + "' is not float- or int-based");
+        fields.push_back({ name, type, offset });
+        offset += int64_t(type.size());
+    }
+    return offset;
+}
+
+
+
+// Re-send both layouts to the shading system as symlocs.
+static void
+update_symlocs(ShadingSystem& ss, PyShaderGroup& g)
+{
+    std::vector<SymLocationDesc> symlocs;
+    for (const auto& f : g.userdata)
+        symlocs.emplace_back(f.name, f.type, false, SymArena::UserData,
+                             f.offset, g.userdata_stride);
+    for (const auto& f : g.outputs)
+        symlocs.emplace_back(f.name, f.type, false, SymArena::Outputs,
+                             f.offset, g.output_stride);
+    ss.clear_symlocs(g.group.get());
+    ss.add_symlocs(g.group.get(), symlocs);
+}
+
+
+
+// NumPy dtype of one record of a layout: a field per parameter, with
+// aggregates and arrays as a trailing subarray dimension.
+static py::object
+record_dtype(const std::vector<PyShaderGroup::Field>& fields, int64_t stride)
+{
+    py::list names, formats, offsets;
+    for (const auto& f : fields) {
+        const char* base = f.type.basetype == TypeDesc::FLOAT ? "f4" : "i4";
+        int nvals        = int(f.type.numelements()) * f.type.aggregate;
+        names.append(f.name);
+        formats.append(nvals == 1 ? py::str(base)
+                                  : py::str("({},){}").format(nvals, base));
+        offsets.append(f.offset);
+    }
+    py::dict spec;
+    spec["names"]    = names;
+    spec["formats"]  = formats;
+    spec["offsets"]  = offsets;
+    spec["itemsize"] = stride;
+    return py::module::import("numpy").attr("dtype")(spec);
+}
+
+
+
+// A read-only view of one global: `nvals` floats per point for `npoints`
+// points, or null if it wasn't passed.
+static const float*
+global_array(const py::object& obj, const char* name, int nvals,
+             int64_t& npoints,
+             std::vector<py::array_t<float, py::array::c_style
+                                                | py::array::forcecast>>& keep)
+{
+    if (obj.is_none())
+        return nullptr;
+    auto arr = py::array_t<float, py::array::c_style | py::array::forcecast>::ensure(obj);
+    if (!arr || arr.size() % nvals)
+        throw py::value_error(std::string("global '") + name + "' must hold "
+                              + std::to_string(nvals) + " floats per point");
+    int64_t n = int64_t(arr.size() / nvals);
+    if (npoints >= 0 && n != npoints)
+        throw py::value_error(std::string("global '") + name
+                              + "' has the wrong number of points");
+    npoints = n;
+    keep.push_back(arr);
+    return arr.data();
+}
+
+
+
+void
+declare_shadergroup(py::module& m)
+{
+    py::class_<PyShaderGroup>(m, "ShaderGroup")
+        .def_property_readonly("userdata_dtype",
+                               [](const PyShaderGroup& g) {
+                                   return record_dtype(g.userdata,
+                                                       g.userdata_stride);
+                               })
+        .def_property_readonly("output_dtype", [](const PyShaderGroup& g) {
+            return record_dtype(g.outputs, g.output_stride);
+        });
+}
+
+
+
+void
+declare_shadingsystem(py::module& m)
+{
+    using namespace pybind11::literals;
+
+    py::class_<PyShadingSystem>(m, "ShadingSystem")
+        .def(py::init<>())
+
+        .def("attribute",
+             [](PyShadingSystem& self, const std::string& name, int val) {
+                 return self.ss().attribute(name, val);
+             })
+        .def("attribute",
+             [](PyShadingSystem& self, const std::string& name, float val) {
+                 return self.ss().attribute(name, val);
+             })
+        .def("attribute",
+             [](PyShadingSystem& self, const std::string& name,
+                const std::string& val) {
+                 return self.ss().attribute(name, val);
+             })
+
+        .def(
+            "ShaderGroupBegin",
+            [](PyShadingSystem& self, const std::string& groupname,
+               const std::string& usage, const std::string& groupspec) {
+                PyShaderGroup g;
+                g.group = self.ss().ShaderGroupBegin(groupname, usage,
+                                                     groupspec);
+                if (!g.group)
+                    throw std::runtime_error("could not create shader group");
+                return g;
+            },
+            "groupname"_a = "", "usage"_a = "surface", "groupspec"_a = "")
+        .def("ShaderGroupEnd",
+             [](PyShadingSystem& self, PyShaderGroup& g) {
+                 return self.ss().ShaderGroupEnd(*g.group);
+             })
+        .def(
+            "Parameter",
+            [](PyShadingSystem& self, PyShaderGroup& g,
+               const std::string& name, const py::object& typeobj,
+               const py::object& value, bool lockgeom) {
+                TypeDesc type = typedesc_from_python(typeobj);
+                size_t nvals  = type.numelements() * type.aggregate;
+                py::sequence vals = py::isinstance<py::sequence>(value)
+                                            && !py::isinstance<py::str>(value)
+                                        ? py::reinterpret_borrow<py::sequence>(value)
+                                        : py::make_tuple(value);
+                if (vals.size() != nvals)
+                    throw py::value_error("expected " + std::to_string(nvals)
+                                          + " values for '" + name + "'");
+                if (type.basetype == TypeDesc::FLOAT) {
+                    std::vector<float> v(nvals);
+                    for (size_t i = 0; i < nvals; ++i)
+                        v[i] = vals[i].cast<float>();
+                    return self.ss().Parameter(*g.group, name, type, v.data(),
+                                               lockgeom);
+                }
+                if (type.basetype == TypeDesc::INT) {
+                    std::vector<int> v(nvals);
+                    for (size_t i = 0; i < nvals; ++i)
+                        v[i] = vals[i].cast<int>();
+                    return self.ss().Parameter(*g.group, name, type, v.data(),
+                                               lockgeom);
+                }
+                if (type.basetype == TypeDesc::STRING) {
+                    std::vector<ustring> v(nvals);
+                    for (size_t i = 0; i < nvals; ++i)
+                        v[i] = ustring(vals[i].cast<std::string>());
+                    return self.ss().Parameter(*g.group, name, type, v.data(),
+                                               lockgeom);
+                }
+                throw py::value_error("unsupported parameter type for '"
+                                      + name + "'");
+            },
+            "group"_a, "name"_a, "type"_a, "value"_a, "lockgeom"_a = true)
+        .def(
+            "Shader",
+            [](PyShadingSystem& self, PyShaderGroup& g,
+               const std::string& usage, const std::string& shadername,
+               const std::string& layername) {
+                return self.ss().Shader(*g.group, usage, shadername,
+                                        layername);
+            },
+            "group"_a, "usage"_a, "shadername"_a, "layername"_a = "")
+        .def("ConnectShaders",
+             [](PyShadingSystem& self, PyShaderGroup& g,
+                const std::string& srclayer, const std::string& srcparam,
+                const std::string& dstlayer, const std::string& dstparam) {
+                 return self.ss().ConnectShaders(*g.group, srclayer, srcparam,
+                                                 dstlayer, dstparam);
+             })
+
+        // Choose the parameters that shade() reads from userdata records
+        // (they must not be lockgeom) and the outputs it returns. Both
+        // must be set before the group is compiled.
+        .def(
+            "set_userdata",
+            [](PyShadingSystem& self, PyShaderGroup& g,
+               const std::vector<std::string>& names) {
+                if (g.compiled)
+                    throw std::runtime_error("group is already compiled");
+                g.userdata_stride = layout_fields(self.ss(), g.group.get(),
+                                                  names, false, g.userdata);
+                update_symlocs(self.ss(), g);
+            },
+            "group"_a, "names"_a)
+        .def(
+            "set_outputs",
+            [](PyShadingSystem& self, PyShaderGroup& g,
+               const std::vector<std::string>& names) {
+                if (g.compiled)
+                    throw std::runtime_error("group is already compiled");
+                g.output_stride = layout_fields(self.ss(), g.group.get(),
+                                                names, true, g.outputs);
+                update_symlocs(self.ss(), g);
+            },
+            "group"_a, "names"_a)
+
+        .def("optimize_group",
+             [](PyShadingSystem& self, PyShaderGroup& g) {
+                 py::gil_scoped_release gil;
+                 self.ss().optimize_group(g.group.get(), nullptr);
+                 g.compiled = true;
+             })
+
+        // Shade npoints points, which is taken from the globals if not
+        // given. Returns a dict of output name -> NumPy array, all of them
+        // views into the one record array the shaders wrote.
+        .def(
+            "shade",
+            [](PyShadingSystem& self, PyShaderGroup& g, int64_t npoints,
+               const py::object& P, const py::object& N, const py::object& I,
+               const py::object& u, const py::object& v,
+               const py::object& time, const py::object& userdata,
+               int nthreads) {
+                ShadingSystem& ss(self.ss());
+
+                std::vector<py::array_t<float, py::array::c_style
+                                                   | py::array::forcecast>>
+                    keep;
+                const float* Pdata = global_array(P, "P", 3, npoints, keep);
+                const float* Ndata = global_array(N, "N", 3, npoints, keep);
+                const float* Idata = global_array(I, "I", 3, npoints, keep);
+                const float* udata = global_array(u, "u", 1, npoints, keep);
+                const float* vdata = global_array(v, "v", 1, npoints, keep);
+                const float* tdata = global_array(time, "time", 1, npoints,
+                                                  keep);
+                if (npoints < 0)
+                    throw py::value_error("npoints was not given and can't "
+                                          "be inferred from the globals");
+
+                // A record array of exactly the group's userdata dtype is
+                // used in place; a dict of per-parameter arrays is packed
+                // into a temporary one, which it must fill completely.
+                py::object uddtype = record_dtype(g.userdata,
+                                                  g.userdata_stride);
+                py::array udrecords;
+                void* userdata_base_ptr = nullptr;
+                if (!userdata.is_none()) {
+                    if (py::isinstance<py::dict>(userdata)) {
+                        py::dict uddict = userdata.cast<py::dict>();
+                        for (const auto& f : g.userdata)
+                            if (!uddict.contains(f.name))
+                                throw py::value_error("userdata dict has no '"
+                                                      + f.name + "'");
+                        udrecords = py::array(py::dtype::from_args(uddtype),
+                                              { py::ssize_t(npoints) });
+                        // Don't leave the padding between fields as garbage
+                        memset(udrecords.mutable_data(), 0, udrecords.nbytes());
+                        for (auto item : uddict)
+                            udrecords[item.first] = item.second;
+                    } else {
+                        udrecords = userdata.cast<py::array>();
+                        if (!udrecords.dtype().equal(py::dtype::from_args(uddtype))
+                            || !(udrecords.flags() & py::array::c_style))
+                            throw py::value_error("userdata must be a dict or a "
+                                                  "contiguous array of "
+                                                  "userdata_dtype");
+                    }
+                    if (udrecords.size() != npoints)
+                        throw py::value_error("userdata has the wrong number "
+                                              "of points");
+                    userdata_base_ptr = udrecords.mutable_data();
+                } else if (g.userdata.size()) {
+                    throw py::value_error("the group reads userdata but "
+                                          "none was given");
+                }
+                py::array outrecords(
+                    py::dtype::from_args(record_dtype(g.outputs,
+                                                      g.output_stride)),
+                    { py::ssize_t(npoints) });
+                void* output_base_ptr = outrecords.mutable_data();
+
+                g.compiled = true;
+                {
+                    py::gil_scoped_release gil;
+                    Matrix44 Mshad, Mobj;  // identity, points are in common space
+                    OIIO::parallel_for_chunked(
+                        0, npoints, 0,
+                        [&](int64_t begin, int64_t end) {
+                            PerThreadInfo* thread_info = ss.create_thread_info();
+                            ShadingContext* ctx = ss.get_context(thread_info);
+                            ShaderGlobals sg;
+                            memset((char*)&sg, 0, sizeof(ShaderGlobals));
+                            sg.shader2common = OSL::TransformationPtr(&Mshad);
+                            sg.object2common = OSL::TransformationPtr(&Mobj);
+                            sg.surfacearea   = 1;
+                            sg.N = sg.Ng = Vec3(0, 0, 1);
+                            for (int64_t i = begin; i < end; ++i) {
+                                if (Pdata)
+                                    sg.P = ((const Vec3*)Pdata)[i];
+                                if (Ndata)
+                                    sg.N = sg.Ng = ((const Vec3*)Ndata)[i];
+                                if (Idata)
+                                    sg.I = ((const Vec3*)Idata)[i];
+                                if (udata)
+                                    sg.u = udata[i];
+                                if (vdata)
+                                    sg.v = vdata[i];
+                                if (tdata)
+                                    sg.time = tdata[i];
+                                ss.execute(*ctx, *g.group, int(i), sg,
+                                           userdata_base_ptr, output_base_ptr);
+                            }
+                            ss.release_context(ctx);
+                            ss.destroy_thread_info(thread_info);
+                        },
+                        OIIO::parallel_options(nthreads));
+                }
+
+                py::dict result;
+                for (const auto& f : g.outputs)
+                    result[py::str(f.name)] = outrecords[py::str(f.name)];
+                return result;
+            },
+            "group"_a, "npoints"_a = -1, "P"_a = py::none(),
+            "N"_a = py::none(), "I"_a = py::none(), "u"_a = py::none(),
+            "v"_a = py::none(), "time"_a = py::none(),
+            "userdata"_a = py::none(), "nthreads"_a = 0);
+}
+
+
+
+#define OSL_DECLARE_PYMODULE(x) PYBIND11_MODULE(x, m)
+
+OSL_DECLARE_PYMODULE(PYMODULE_NAME)
+{
+    // Force an OIIO module load so we have TypeDesc, among other things.
+    py::module oiio = py::module::import("OpenImageIO");
+
+    m.attr("osl_version")    = OSL_VERSION;
+    m.attr("VERSION")        = OSL_VERSION;
+    m.attr("VERSION_STRING") = PY_STR(OSL_LIBRARY_VERSION_STRING);
+    m.attr("__version__")    = PY_STR(OSL_LIBRARY_VERSION_STRING);
+
+    declare_shadergroup(m);
+    declare_shadingsystem(m);
+}
+
+}  // namespace PyOSL
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
+#include <algorithm>
 #include <vector>
 #include <cstdio>
 #include <cmath>
@@ -40,7 +41,11 @@ static ustring u_nop    ("nop"),
                u_isconnected ("isconnected"),
                u_setmessage ("setmessage"),
                u_getmessage ("getmessage"),
-               u_getattribute ("getattribute");
+               u_getattribute ("getattribute"),
+               u_matrix ("matrix"),
+               u_transform ("transform"),
+               u_transformv ("transformv"),
+               u_transformn ("transformn");
 
 
 OSL_NAMESPACE_ENTER
@@ -1771,13 +1776,18 @@ RuntimeOptimizer::mark_outgoing_connections ()
 {
     OSL_ASSERT (! inst()->m_instoverrides.size() &&
                "don't call this before copy_code_from_master");
+    // Only write symbols whose flag actually changes, so that a layer
+    // whose symbols are still shared with its master keeps sharing them.
+    const ShaderInstance *cinst = inst();
     inst()->outgoing_connections (false);
-    FOREACH_PARAM (auto&& s, inst())
-        s.connected_down (false);
+    for (int i = cinst->firstparam(), e = cinst->lastparam();  i < e;  ++i)
+        if (cinst->symbol(i)->connected_down())
+            inst()->symbol(i)->connected_down (false);
     for (int lay = layer()+1;  lay < group().nlayers();  ++lay) {
         for (auto&& c : group()[lay]->m_connections)
             if (c.srclayer == layer()) {
-                inst()->symbol(c.src.param)->connected_down (true);
+                if (! cinst->symbol(c.src.param)->connected_down())
+                    inst()->symbol(c.src.param)->connected_down (true);
                 inst()->outgoing_connections (true);
             }
     }
@@ -2245,6 +2255,94 @@ RuntimeOptimizer::optimize_ops (int beginop, int endop,
 
 
 
+/// Find transformations between the same pair of constant named spaces
+/// and have them all share one matrix, computed once ahead of the first
+/// of them, rather than each asking the renderer for the same pair of
+/// matrices.  Return the number of transform ops that were changed.
+int
+RuntimeOptimizer::hoist_transforms ()
+{
+    OpcodeVec &code (inst()->ops());
+    ustring syn = shadingsys().commonspace_synonym();
+    RendererServices *rend = shadingsys().renderer();
+
+    // Gather the main code transform ops of constant named spaces,
+    // grouped by their (from,to) pair, in program order.
+    typedef std::pair<ustring,ustring> SpacePair;
+    std::map<SpacePair, std::vector<int>> xforms;
+    for (int opnum = inst()->maincodebegin(), e = inst()->maincodeend();
+         opnum < e;  ++opnum) {
+        Opcode &op (code[opnum]);
+        TypeDesc::VECSEMANTICS vectype;
+        if (op.opname() == u_transform)
+            vectype = TypeDesc::POINT;
+        else if (op.opname() == u_transformv)
+            vectype = TypeDesc::VECTOR;
+        else if (op.opname() == u_transformn)
+            vectype = TypeDesc::NORMAL;
+        else
+            continue;
+        int nargs = op.nargs();
+        Symbol *From = (nargs == 3) ? NULL : opargsym (op, 1);
+        Symbol *To = opargsym (op, (nargs == 3) ? 1 : 2);
+        if (! To->typespec().is_string() || ! To->is_constant() ||
+            (From && ! From->is_constant()))
+            continue;   // matrix form, or spaces not known until runtime
+        ustring from = From ? From->get_string() : Strings::common;
+        ustring to = To->get_string();
+        if (from == syn)
+            from = Strings::common;
+        if (to == syn)
+            to = Strings::common;
+        if (from == to)
+            continue;   // identity, the back end will just copy
+        if (rend->transform_points (NULL, from, to, 0.0f, NULL, NULL, 0, vectype))
+            continue;   // renderer may do a nonlinear transformation
+        xforms[SpacePair(from, to)].push_back (opnum);
+    }
+
+    // Rewrite each group that would otherwise retrieve the same matrices
+    // more than once, noting where its shared matrix must be computed.
+    // The first transform of a group must be unconditionally executed so
+    // that the matrix is always valid for all subsequent ones.
+    struct Hoist { int opnum, M, from, to; };
+    std::vector<Hoist> hoists;
+    int changed = 0;
+    for (auto&& x : xforms) {
+        const std::vector<int> &ops (x.second);
+        if (ops.size() < 2 || ! op_is_unconditionally_executed (ops[0]))
+            continue;
+        make_symbol_room (3);
+        Hoist h;
+        h.opnum = ops[0];
+        h.from = add_constant (TypeDesc::TypeString, &x.first.first);
+        h.to = add_constant (TypeDesc::TypeString, &x.first.second);
+        h.M = add_temp (TypeDesc::TypeMatrix);
+        for (int opnum : ops) {
+            Opcode &op (code[opnum]);
+            int nargs = op.nargs();
+            int R = oparg (op, 0);
+            int P = oparg (op, (nargs == 3) ? 2 : 3);
+            turn_into_new_op (op, op.opname(), R, h.M, P,
+                              "share hoisted transformation matrix");
+            ++changed;
+        }
+        hoists.push_back (h);
+    }
+
+    // Insert the matrix computations last to first, so that inserting
+    // one doesn't invalidate the op numbers of those still to come.
+    std::sort (hoists.begin(), hoists.end(),
+               [](const Hoist &a, const Hoist &b){ return a.opnum > b.opnum; });
+    for (auto&& h : hoists)
+        insert_code (h.opnum, u_matrix, GroupWithNext, h.M, h.from, h.to);
+
+    shadingsys().m_stat_transforms_hoisted += changed;
+    return changed;
+}
+
+
+
 void
 RuntimeOptimizer::optimize_instance ()
 {
@@ -2318,6 +2416,12 @@ RuntimeOptimizer::optimize_instance ()
         // code for this instance and make various transformations.
         int changed = optimize_ops (0, (int)inst()->ops().size());
 
+        // After the first pass has resolved whatever space names it can,
+        // let transforms between the same spaces share their matrix.
+        if (m_pass == 0 && optimize() >= 2 &&
+                shadingsys().m_opt_hoist_transforms)
+            changed += hoist_transforms ();
+
         // Now that we've rewritten the code, we need to re-track the
         // variable lifetimes.
         track_variable_lifetimes ();
@@ -2383,8 +2487,12 @@ RuntimeOptimizer::optimize_instance ()
 void
 RuntimeOptimizer::resolve_isconnected ()
 {
-    for (auto& op : inst()->ops()) {
-        if (op.opname() == u_isconnected) {
+    // Scan without forcing a private copy; only a layer that actually
+    // calls isconnected() gets written.
+    const ShaderInstance *cinst = inst();
+    for (int opnum = 0, e = (int)cinst->ops().size();  opnum < e;  ++opnum) {
+        if (cinst->ops()[opnum].opname() == u_isconnected) {
+            Opcode &op (inst()->ops()[opnum]);
             inst()->make_symbol_room (1);
             SymbolPtr s = inst()->argsymbol (op.firstarg() + 1);
             while (const StructSpec *structspec = s->typespec().structspec()) {
@@ -2401,7 +2509,8 @@ RuntimeOptimizer::resolve_isconnected ()
                 s = inst()->symbol(fieldsymid);
             }
             bool upconnected = s->connected();
-            if (!s->lockgeom() && shadingsys().userdata_isconnected())
+            if (!s->lockgeom() && !s->interactive()
+                && shadingsys().userdata_isconnected())
                 upconnected = true;
             int val = (upconnected ? 1 : 0) + (s->connected_down() ? 2 : 0);
             turn_into_assign (op, add_constant(TypeDesc::TypeInt, &val),
@@ -2510,6 +2619,14 @@ RuntimeOptimizer::mark_symbol_derivatives (SymDependency &symdeps, SymIntSet &vi
 void
 RuntimeOptimizer::track_variable_dependencies ()
 {
+    if (group().no_derivs()) {
+        // The derivative-free variant of a group: nothing carries
+        // derivs, whatever the ops or connections would otherwise want.
+        for (auto&& s : inst()->symbols())
+            s.has_derivs (false);
+        return;
+    }
+
     SymDependency symdeps;
 
     // It's important to note that this is simplistically conservative
@@ -2814,7 +2931,7 @@ RuntimeOptimizer::collapse_syms ()
     }
 
     // Remap all the function arguments to the new indices
-    for (auto&& arg : inst()->m_instargs)
+    for (auto&& arg : inst()->args())
         arg = symbol_remap[arg];
 
     // Fix our connections from upstream shaders
@@ -2829,7 +2946,7 @@ RuntimeOptimizer::collapse_syms ()
     }
 
     // Swap the new symbol list for the old.
-    std::swap (inst()->m_instsymbols, new_symbols);
+    std::swap (inst()->symbols(), new_symbols);
     {
         // adjust memory stats
         // Remember that they're already swapped
@@ -2915,7 +3032,7 @@ RuntimeOptimizer::collapse_ops ()
     }
 
     // Swap the new code for the old.
-    std::swap (inst()->m_instops, new_ops);
+    std::swap (inst()->ops(), new_ops);
 
     // These are no longer valid
     m_bblockids.clear ();
@@ -3049,8 +3166,10 @@ RuntimeOptimizer::run ()
             printinst (std::cout);
             std::cout << "\n--------------------------------\n" << std::endl;
         }
-        old_nsyms += inst()->symbols().size();
-        old_nops += inst()->ops().size();
+        // N.B. const access, so we don't force a private copy of the code
+        const ShaderInstance *cinst = inst();
+        old_nsyms += cinst->symbols().size();
+        old_nops += cinst->ops().size();
     }
 
     // Clear messages sent for the group, they will be filled in by
@@ -3139,8 +3258,9 @@ RuntimeOptimizer::run ()
             printinst (std::cout);
             std::cout << "\n--------------------------------\n" << std::endl;
         }
-        new_nsyms += inst()->symbols().size();
-        new_nops += inst()->ops().size();
+        const ShaderInstance *cinst = inst();
+        new_nsyms += cinst->symbols().size();
+        new_nops += cinst->ops().size();
     }
 
     m_unknown_textures_needed = false;
@@ -3148,6 +3268,9 @@ RuntimeOptimizer::run ()
     m_unknown_attributes_needed = false;
     m_textures_needed.clear();
     m_closures_needed.clear();
+    m_closure_bytes_hint = 0;
+    m_message_bytes_hint = 0;
+    m_message_names.clear();
     m_globals_read = 0;
     m_globals_write = 0;
     m_globals_needed.clear();
@@ -3163,7 +3286,7 @@ RuntimeOptimizer::run ()
             s.layer (layer);
             // Find interpolated parameters
             if ((s.symtype() == SymTypeParam || s.symtype() == SymTypeOutputParam)
-                && ! s.lockgeom()) {
+                && ! s.lockgeom() && ! s.interactive()) {
                 UserDataNeeded udn (s.name(), layer, s.typespec().simpletype(),
                                     s.data(), s.has_derivs());
                 std::set<UserDataNeeded>::iterator found;
@@ -3187,7 +3310,8 @@ RuntimeOptimizer::run ()
             if (s.has_derivs())
                 ++new_deriv_syms;
         }
-        for (auto&& op : inst()->ops()) {
+        const ShaderInstance *cinst = inst();
+        for (auto&& op : cinst->ops()) {
             const OpDescriptor *opd = shadingsys().op_descriptor (op.opname());
             if (! opd)
                 continue;
@@ -3221,9 +3345,32 @@ RuntimeOptimizer::run ()
                 if (sym->is_constant()) {
                     ustring closurename = sym->get_string();
                     m_closures_needed.insert (closurename);
+                    if (auto clentry = shadingsys().find_closure (closurename))
+                        m_closure_bytes_hint += sizeof(ClosureComponent)
+                                              + clentry->struct_size
+                                              + alignof(ClosureComponent) - 1;
                 } else {
                     m_unknown_closures_needed = true;
                 }
+            } else if ((op.opname() == u_mul || op.opname() == u_add)
+                       && opargsym (op, 0)->typespec().is_closure_based()) {
+                m_closure_bytes_hint += (op.opname() == u_mul
+                                         ? sizeof(ClosureMul) + alignof(ClosureMul)
+                                         : sizeof(ClosureAdd) + alignof(ClosureAdd)) - 1;
+            } else if (op.opname() == u_setmessage) {
+                // setmessage (name, value)
+                m_message_bytes_hint += sizeof(Message) + alignof(Message) - 1
+                    + opargsym (op, 1)->typespec().simpletype().size();
+                Symbol *name = opargsym (op, 0);
+                if (name->is_constant())
+                    m_message_names.insert (name->get_string());
+            } else if (op.opname() == u_getmessage) {
+                // Getting an unset message records that it was asked for
+                m_message_bytes_hint += sizeof(Message) + alignof(Message) - 1;
+                // getmessage (result, [source,] name, value)
+                Symbol *name = opargsym (op, op.nargs() == 4 ? 2 : 1);
+                if (name->is_constant())
+                    m_message_names.insert (name->get_string());
             } else if (op.opname() == u_getattribute) {
                 Symbol *sym1 = opargsym (op, 1);
                 OSL_DASSERT (sym1 && sym1->typespec().is_string());
@@ -3344,7 +3491,8 @@ RuntimeOptimizer::check_for_error_calls(bool warn)
     for (int layer = 0;  layer < nlayers;  ++layer) {
         set_inst (layer);
         inst()->has_error_op(false);
-        for (auto&& op : inst()->ops()) {
+        const ShaderInstance *cinst = inst();  // don't unshare the code
+        for (auto&& op : cinst->ops()) {
             if (op.opname() == Strings::error) {
                 inst()->has_error_op(true);
                 if (warn)
@@ -3372,7 +3520,8 @@ RuntimeOptimizer::police_failed_optimizations()
         set_inst (layer);
         if (inst()->unused())
             continue;  // no need to print or gather stats for unused layers
-        for (auto&& op : inst()->ops()) {
+        const ShaderInstance *cinst = inst();
+        for (auto&& op : cinst->ops()) {
             const OpDescriptor *opd = shadingsys().op_descriptor (op.opname());
             if (! opd)
                 continue;
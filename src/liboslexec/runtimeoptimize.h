@@ -319,6 +319,9 @@ public:
 
     int eliminate_middleman ();
 
+    /// Make transforms between the same constant spaces share a matrix.
+    int hoist_transforms ();
+
     /// Squeeze out unused symbols from an instance that has been
     /// optimized.
     void collapse_syms ();
@@ -443,6 +446,7 @@ private:
     std::vector<ustring> m_local_messages_sent; ///< Messages set in this inst
     std::set<ustring> m_textures_needed;
     std::set<ustring> m_closures_needed;
+    std::set<ustring> m_message_names;   ///< Constant names of messages
     std::set<ustring> m_globals_needed;
     int m_globals_read = 0;
     int m_globals_write = 0;
@@ -450,6 +454,8 @@ private:
     bool m_unknown_textures_needed;
     bool m_unknown_closures_needed;
     bool m_unknown_attributes_needed;
+    size_t m_closure_bytes_hint = 0;  ///< Closure memory per shade (est.)
+    size_t m_message_bytes_hint = 0;  ///< Message memory per shade (est.)
     std::set<UserDataNeeded> m_userdata_needed;
     double m_stat_opt_locking_time;       ///<   locking time
     double m_stat_specialization_time;    ///<   specialization time
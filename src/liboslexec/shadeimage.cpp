@@ -7,6 +7,12 @@
 #include <OpenImageIO/imagebufalgo_util.h>
 
 #include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+#if OSL_USE_BATCHED
+#  include <OSL/batched_shaderglobals.h>
+#endif
+
+#include "oslexec_pvt.h"
 
 using namespace OSL;
 using namespace OSL::pvt;
@@ -20,17 +26,9 @@ OSL_NAMESPACE_ENTER
 
 
 
-bool
-shade_image (ShadingSystem &shadingsys, ShaderGroup &group,
-             const ShaderGlobals *defaultsg,
-             OIIO::ImageBuf &buf, cspan<ustring> outputs,
-             ShadeImageLocations shadelocations,
-             OIIO::ROI roi, OIIO::parallel_options popt)
+static bool
+check_float_buffer (OIIO::ImageBuf &buf)
 {
-    using namespace OIIO;
-    using namespace ImageBufAlgo;
-    if (! roi.defined())
-        roi = buf.roi();
     if (buf.spec().format != TypeDesc::FLOAT) {
 #if OIIO_VERSION >= 20300
         buf.errorfmt("Cannot OSL::shade_image() into a {} buffer, float is required",
@@ -41,46 +39,26 @@ shade_image (ShadingSystem &shadingsys, ShaderGroup &group,
 #endif
         return false;
     }
+    return true;
+}
 
-    parallel_image (roi, popt, [&](OIIO::ROI roi){
-
-    // Request an OSL::PerThreadInfo for this thread.
-    OSL::PerThreadInfo *thread_info = shadingsys.create_thread_info();
-
-    // Request a shading context so that we can execute the shader.
-    // We could get_context/release_context for each shading point,
-    // but to save overhead, it's more efficient to reuse a context
-    // within a thread.
-    ShadingContext *ctx = shadingsys.get_context (thread_info);
 
-    // Ensure the group has already been optimized
-    shadingsys.optimize_group (&group, ctx);
 
-    Matrix44 Mshad, Mobj;  // just let these be identity for now
-    OIIO::ROI roi_full = buf.roi_full();
+// Fill in the ShaderGlobals fields that are the same for every pixel,
+// either from the caller's template or with reasonable defaults.
+static void
+init_shaderglobals (ShaderGlobals &sg, const ShaderGlobals *defaultsg,
+                    ShadeImageLocations shadelocations,
+                    const OIIO::ROI &roi_full,
+                    const Matrix44 &Mshad, const Matrix44 &Mobj)
+{
     int xres = roi_full.width();
     int yres = roi_full.height();
     int zres = roi_full.depth();
 
-    // Gather some information about the outputs once, rather than for
-    // each pixel.
-    const ShaderSymbol **output_sym  = OIIO_ALLOCA(const ShaderSymbol*, outputs.size());
-    TypeDesc *output_type = OIIO_ALLOCA(TypeDesc, outputs.size());
-    int *output_nchans = OIIO_ALLOCA(int, outputs.size());
-    for (int i = 0;  i < int(outputs.size());  ++i) {
-        output_sym[i] = shadingsys.find_symbol (group, outputs[i]);
-        output_type[i] = shadingsys.symbol_typedesc (output_sym[i]);
-        output_nchans[i] = output_type[i].numelements() * output_type[i].aggregate;
-    }
-
-    // Set up shader globals and a little test grid of points to shade.
-    // Note that some of the fields can be set up once and used for all of
-    // the shades. Others need to be changed for every point shaded.
-    //
     // Note that because we are shading a single object that is a flat image
     // plane, a lot of this is simplified. In a real 3D render, most of
     // these fields would need to be reset for every shade.
-    ShaderGlobals sg;
     if (defaultsg) {
         // If the caller passed a default SG template, use it to initialize
         // the sg and in particular to set all the constant fields.
@@ -122,22 +100,133 @@ shade_image (ShadingSystem &shadingsys, ShaderGroup &group,
         // the ShaderGlobals.
         // sg.renderstate = &sg;
     }
+}
+
+
+
+// The u (or v) shading coordinate of pixel i along an axis of the full
+// window [begin, begin+res).
+static inline float
+shade_coord (int i, int begin, int res, ShadeImageLocations shadelocations)
+{
+    if (shadelocations == ShadePixelCenters)
+        return float(i-begin+0.5f) / res;
+    return (res == 1) ? 0.5f : float(i-begin) / (res - 1);
+}
+
+
+
+// Decide whether the group's symlocs place the outputs directly in the
+// pixels of buf, concatenated channel by channel just as the copy loops
+// would store them.  Sets placed if every output is placed that way, and
+// leaves it false if none of them are placed at all.  Any other
+// arrangement is an error, since the shaders would write who knows where.
+static bool
+check_output_placement (ShaderGroup &group, OIIO::ImageBuf &buf,
+                        cspan<ustring> outputs, bool &placed)
+{
+    int nplaced = 0, chan = 0;
+    bool ok = true;
+    int64_t pixel_bytes = int64_t(buf.spec().pixel_bytes());
+    for (int i = 0;  i < int(outputs.size());  ++i) {
+        const SymLocationDesc *symloc = group.find_symloc (outputs[i],
+                                                           SymArena::Outputs);
+        if (! symloc)
+            continue;
+        ++nplaced;
+        if (symloc->type.basetype != TypeDesc::FLOAT || symloc->derivs
+            || symloc->offset != int64_t(chan * sizeof(float))
+            || symloc->stride != pixel_bytes)
+            ok = false;
+        chan += int(symloc->type.numelements()) * symloc->type.aggregate;
+        if (chan > buf.nchannels())
+            ok = false;
+    }
+    placed = (nplaced > 0);
+    if (placed && (nplaced < int(outputs.size()) || ! buf.localpixels()))
+        ok = false;
+    if (! ok) {
+#if OIIO_VERSION >= 20300
+        buf.errorfmt("Cannot OSL::shade_image(): the group's output symlocs don't match the buffer layout");
+#else
+        buf.error("Cannot OSL::shade_image(): the group's output symlocs don't match the buffer layout");
+#endif
+    }
+    return ok;
+}
+
+
+
+bool
+shade_image (ShadingSystem &shadingsys, ShaderGroup &group,
+             const ShaderGlobals *defaultsg,
+             OIIO::ImageBuf &buf, cspan<ustring> outputs,
+             ShadeImageLocations shadelocations,
+             OIIO::ROI roi, OIIO::parallel_options popt)
+{
+    using namespace OIIO;
+    using namespace ImageBufAlgo;
+    if (! roi.defined())
+        roi = buf.roi();
+    if (! check_float_buffer (buf))
+        return false;
+    bool placed = false;
+    if (! check_output_placement (group, buf, outputs, placed))
+        return false;
+
+    parallel_image (roi, popt, [&](OIIO::ROI roi){
+
+    // Request an OSL::PerThreadInfo for this thread.
+    OSL::PerThreadInfo *thread_info = shadingsys.create_thread_info();
+
+    // Request a shading context so that we can execute the shader.
+    // We could get_context/release_context for each shading point,
+    // but to save overhead, it's more efficient to reuse a context
+    // within a thread.
+    ShadingContext *ctx = shadingsys.get_context (thread_info);
+
+    // Ensure the group has already been optimized
+    shadingsys.optimize_group (&group, ctx);
+
+    Matrix44 Mshad, Mobj;  // just let these be identity for now
+    OIIO::ROI roi_full = buf.roi_full();
+    int xres = roi_full.width();
+    int yres = roi_full.height();
+
+    // Gather some information about the outputs once, rather than for
+    // each pixel.
+    const ShaderSymbol **output_sym  = OIIO_ALLOCA(const ShaderSymbol*, outputs.size());
+    TypeDesc *output_type = OIIO_ALLOCA(TypeDesc, outputs.size());
+    int *output_nchans = OIIO_ALLOCA(int, outputs.size());
+    for (int i = 0;  i < int(outputs.size());  ++i) {
+        output_sym[i] = shadingsys.find_symbol (group, outputs[i]);
+        output_type[i] = shadingsys.symbol_typedesc (output_sym[i]);
+        output_nchans[i] = output_type[i].numelements() * output_type[i].aggregate;
+    }
+
+    // Set up shader globals and a little test grid of points to shade.
+    // Note that some of the fields can be set up once and used for all of
+    // the shades. Others need to be changed for every point shaded.
+    ShaderGlobals sg;
+    init_shaderglobals (sg, defaultsg, shadelocations, roi_full, Mshad, Mobj);
+    const OIIO::ImageSpec &spec (buf.spec());
 
     // Loop over all pixels in the image (in x and y)...
     for (OIIO::ImageBuf::Iterator<float> p (buf, roi);  ! p.done();  ++p) {
         // Set the shader globals that vary from point to pixel to pixel
         sg.P = Vec3 (p.x(), p.y(), p.z());
-        if (shadelocations == ShadePixelCenters) {
-            sg.u    = float(p.x()-roi_full.xbegin+0.5f) / xres;
-            sg.v    = float(p.y()-roi_full.ybegin+0.5f) / yres;
-            // float w = float(p.z()-roi_full.zbegin+0.5f) / zres;
-        } else {
-            sg.u    = (xres == 1) ? 0.5f : float(p.x()-roi_full.xbegin) / (xres - 1);
-            sg.v    = (yres == 1) ? 0.5f : float(p.y()-roi_full.ybegin) / (yres - 1);
-            // float w = (zres == 1) ? 0.5f : float(p.z()-roi_full.zbegin) / (zres - 1);
-        }
+        sg.u = shade_coord (p.x(), roi_full.xbegin, xres, shadelocations);
+        sg.v = shade_coord (p.y(), roi_full.ybegin, yres, shadelocations);
 
         // Actually run the shader for this point
+        if (placed) {
+            // The shader stores the outputs right into the pixel.
+            int shadeindex = ((p.z() - spec.z) * spec.height + (p.y() - spec.y))
+                             * spec.width + (p.x() - spec.x);
+            shadingsys.execute (*ctx, group, shadeindex, sg, nullptr,
+                                buf.localpixels());
+            continue;
+        }
         shadingsys.execute (*ctx, group, sg);
 
         // Save all the designated outputs.
@@ -171,5 +260,194 @@ shade_image (ShadingSystem &shadingsys, ShaderGroup &group,
 
 
 
+#if OSL_USE_BATCHED
+
+template<int WidthT>
+static void
+batched_shade_roi (ShadingSystem &shadingsys, ShaderGroup &group,
+                   const ShaderGlobals *defaultsg,
+                   OIIO::ImageBuf &buf, cspan<ustring> outputs,
+                   ShadeImageLocations shadelocations, bool placed,
+                   OIIO::ROI roi)
+{
+    OSL::PerThreadInfo *thread_info = shadingsys.create_thread_info();
+    ShadingContext *ctx = shadingsys.get_context (thread_info);
+    auto executor = shadingsys.batched<WidthT>();
+
+    // Ensure the group has already been JITed for this width
+    executor.jit_group (&group, ctx);
+
+    Matrix44 Mshad, Mobj;  // just let these be identity for now
+    OIIO::ROI roi_full = buf.roi_full();
+    int xres = roi_full.width();
+    int yres = roi_full.height();
+
+    const ShaderSymbol **output_sym  = OIIO_ALLOCA(const ShaderSymbol*, outputs.size());
+    TypeDesc *output_type = OIIO_ALLOCA(TypeDesc, outputs.size());
+    int *output_nchans = OIIO_ALLOCA(int, outputs.size());
+    const void **output_data = OIIO_ALLOCA(const void*, outputs.size());
+    int *output_lanes = OIIO_ALLOCA(int, outputs.size());
+    for (int i = 0;  i < int(outputs.size());  ++i) {
+        output_sym[i] = shadingsys.find_symbol (group, outputs[i]);
+        output_type[i] = shadingsys.symbol_typedesc (output_sym[i]);
+        output_nchans[i] = output_type[i].numelements() * output_type[i].aggregate;
+        // Renderer outputs are always varying, but an output the group
+        // doesn't declare as one may have been found uniform, in which
+        // case it holds a single value for all the lanes.
+        const Symbol *sym = (const Symbol *) output_sym[i];
+        output_lanes[i] = (sym && sym->is_uniform()) ? 1 : WidthT;
+    }
+
+    // Every lane starts out as a copy of the same scalar template, and
+    // only P, u, and v are rewritten per batch below.
+    ShaderGlobals sg;
+    init_shaderglobals (sg, defaultsg, shadelocations, roi_full, Mshad, Mobj);
+
+    BatchedShaderGlobals<WidthT> bsg;
+    auto &usg = bsg.uniform;
+    memset (&usg, 0, sizeof(UniformShaderGlobals));
+    usg.renderstate = sg.renderstate;
+    usg.tracedata = sg.tracedata;
+    usg.objdata = sg.objdata;
+    usg.raytype = sg.raytype;
+
+    auto &vsg = bsg.varying;
+    using OSL::assign_all;
+    assign_all (vsg.dPdx, sg.dPdx);
+    assign_all (vsg.dPdy, sg.dPdy);
+    assign_all (vsg.dPdz, sg.dPdz);
+    assign_all (vsg.I, sg.I);
+    assign_all (vsg.dIdx, sg.dIdx);
+    assign_all (vsg.dIdy, sg.dIdy);
+    assign_all (vsg.N, sg.N);
+    assign_all (vsg.Ng, sg.Ng);
+    assign_all (vsg.dudx, sg.dudx);
+    assign_all (vsg.dudy, sg.dudy);
+    assign_all (vsg.dvdx, sg.dvdx);
+    assign_all (vsg.dvdy, sg.dvdy);
+    assign_all (vsg.dPdu, sg.dPdu);
+    assign_all (vsg.dPdv, sg.dPdv);
+    assign_all (vsg.time, sg.time);
+    assign_all (vsg.dtime, sg.dtime);
+    assign_all (vsg.dPdtime, sg.dPdtime);
+    assign_all (vsg.Ps, sg.Ps);
+    assign_all (vsg.dPsdx, sg.dPsdx);
+    assign_all (vsg.dPsdy, sg.dPsdy);
+    assign_all (vsg.object2common, sg.object2common);
+    assign_all (vsg.shader2common, sg.shader2common);
+    assign_all (vsg.surfacearea, sg.surfacearea);
+    assign_all (vsg.flipHandedness, sg.flipHandedness);
+    assign_all (vsg.backfacing, sg.backfacing);
+
+    // With placed outputs, the buffer itself is the output arena and a
+    // pixel's shade index is its offset from the buffer origin.  Batches
+    // never straddle a row, so their lanes are consecutive shade indices.
+    const OIIO::ImageSpec &spec (buf.spec());
+    void *output_base_ptr = placed ? buf.localpixels() : nullptr;
+
+    for (int z = roi.zbegin;  z < roi.zend;  ++z) {
+        for (int y = roi.ybegin;  y < roi.yend;  ++y) {
+            float v = shade_coord (y, roi_full.ybegin, yres, shadelocations);
+            for (int x = roi.xbegin;  x < roi.xend;  x += WidthT) {
+                int batch_size = std::min (WidthT, roi.xend - x);
+                for (int lane = 0;  lane < batch_size;  ++lane) {
+                    vsg.P[lane] = Vec3 (x+lane, y, z);
+                    vsg.u[lane] = shade_coord (x+lane, roi_full.xbegin, xres,
+                                               shadelocations);
+                    vsg.v[lane] = v;
+                }
+
+                int shadeindex = ((z - spec.z) * spec.height + (y - spec.y))
+                                 * spec.width + (x - spec.x);
+                executor.execute (*ctx, group, batch_size, shadeindex, bsg,
+                                  nullptr, output_base_ptr);
+                if (placed)
+                    continue;
+
+                // Copy the designated outputs out of the context.  Wide
+                // values are stored component by component, each holding
+                // WidthT lanes (or just one, if uniform).
+                for (int i = 0;  i < int(outputs.size());  ++i)
+                    output_data[i] = shadingsys.symbol_address (*ctx, output_sym[i]);
+                OIIO::ImageBuf::Iterator<float> p (buf, x, y, z);
+                for (int lane = 0;  lane < batch_size;  ++lane, ++p) {
+                    int chan = 0;
+                    for (int i = 0;  i < int(outputs.size());  ++i) {
+                        const void *data = output_data[i];
+                        if (!data)
+                            continue;  // Skip if symbol isn't found
+                        TypeDesc t = output_type[i];
+                        int tvals = output_nchans[i];
+                        if (chan+tvals > buf.nchannels())
+                            break;
+                        int lanes = output_lanes[i];
+                        int l = (lanes == 1) ? 0 : lane;
+                        if (t.basetype == TypeDesc::FLOAT) {
+                            for (int c = 0; c < tvals; ++c)
+                                p[chan++] = ((const float *)data)[c*lanes + l];
+                        } else if (t.basetype == TypeDesc::INT) {
+                            for (int c = 0; c < tvals; ++c)
+                                p[chan++] = ((const int *)data)[c*lanes + l];
+                        }
+                        // N.B. Drop any outputs that aren't float- or int-based
+                    }
+                }
+            }
+        }
+    }
+
+    shadingsys.release_context (ctx);
+    shadingsys.destroy_thread_info (thread_info);
+}
+
+
+
+bool
+shade_image (ShadingSystem &shadingsys, ShaderGroup &group, int batch_size,
+             const ShaderGlobals *defaultsg,
+             OIIO::ImageBuf &buf, cspan<ustring> outputs,
+             ShadeImageLocations shadelocations,
+             OIIO::ROI roi, OIIO::parallel_options popt)
+{
+    using namespace OIIO;
+    using namespace ImageBufAlgo;
+    if (! roi.defined())
+        roi = buf.roi();
+    if (! check_float_buffer (buf))
+        return false;
+
+    RendererServices *rs = shadingsys.renderer();
+    bool supported = (batch_size == 16 && rs && rs->batched(WidthOf<16>()))
+                  || (batch_size == 8 && rs && rs->batched(WidthOf<8>()));
+    if (! supported) {
+#if OIIO_VERSION >= 20300
+        buf.errorfmt("Cannot OSL::shade_image() with batch size {}, the renderer has no batched services for it",
+                     batch_size);
+#else
+        buf.error("Cannot OSL::shade_image() with batch size %d, the renderer has no batched services for it",
+                  batch_size);
+#endif
+        return false;
+    }
+
+    bool placed = false;
+    if (! check_output_placement (group, buf, outputs, placed))
+        return false;
+
+    parallel_image (roi, popt, [&](OIIO::ROI roi){
+        if (batch_size == 16)
+            batched_shade_roi<16> (shadingsys, group, defaultsg, buf, outputs,
+                                   shadelocations, placed, roi);
+        else
+            batched_shade_roi<8> (shadingsys, group, defaultsg, buf, outputs,
+                                  shadelocations, placed, roi);
+    });
+    return true;
+}
+
+#endif
+
+
+
 OSL_NAMESPACE_EXIT
 
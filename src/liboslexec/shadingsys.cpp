@@ -6,6 +6,7 @@
 #include <string>
 #include <cstdio>
 #include <fstream>
+#include <cmath>
 #include <cstdlib>
 #include <mutex>
 
@@ -215,6 +216,41 @@ ShadingSystem::ReParameter (ShaderGroup &group, string_view layername,
 
 
 
+bool
+ShadingSystem::respecialize (ShaderGroup *group, ShadingContext *ctx,
+                             float settle_time)
+{
+    return m_impl->respecialize (group, ctx, settle_time);
+}
+
+
+
+int
+ShadingSystem::recompile_hot_groups (ShadingContext *ctx)
+{
+    return m_impl->recompile_hot_groups (ctx);
+}
+
+
+
+bool
+ShadingSystem::aot_compile (ShaderGroup *group, std::string &object,
+                            std::string &manifest, ShadingContext *ctx)
+{
+    return m_impl->aot_compile (group, object, manifest, ctx);
+}
+
+
+
+bool
+ShadingSystem::aot_load (ShaderGroup *group, string_view object,
+                         string_view manifest)
+{
+    return m_impl->aot_load (group, object, manifest);
+}
+
+
+
 PerThreadInfo *
 ShadingSystem::create_thread_info ()
 {
@@ -248,6 +284,15 @@ ShadingSystem::release_context (ShadingContext *ctx)
 
 
 
+ShadingContext *
+ShadingSystem::get_shared_context (PerThreadInfo *threadinfo,
+                                   TextureSystem::Perthread *texture_threadinfo)
+{
+    return m_impl->get_shared_context (threadinfo, texture_threadinfo);
+}
+
+
+
 bool
 ShadingSystem::execute(ShadingContext& ctx, ShaderGroup& group, int index,
                        ShaderGlobals& globals, void* userdata_base_ptr,
@@ -315,46 +360,74 @@ ShadingSystem::execute_layer(ShadingContext& ctx, int index,
 template<int WidthT>
 bool
 ShadingSystem::BatchedExecutor<WidthT>::execute (ShadingContext &ctx, ShaderGroup &group,
-        int batch_size, BatchedShaderGlobals<WidthT> &globals_batch, bool run)
+        int batch_size, int shadeindex, BatchedShaderGlobals<WidthT> &globals_batch,
+        void* userdata_base_ptr, void* output_base_ptr, bool run)
 {
-    return ctx.batched<WidthT>().execute(group, batch_size, globals_batch, run);
+    return ctx.batched<WidthT>().execute(group, batch_size, shadeindex,
+                                         globals_batch, userdata_base_ptr,
+                                         output_base_ptr, run);
 }
 
 template<int WidthT>
 bool
 ShadingSystem::BatchedExecutor<WidthT>::execute_init (ShadingContext &ctx, ShaderGroup &group,
-        int batch_size, BatchedShaderGlobals<WidthT> &globals_batch, bool run)
+        int batch_size, int shadeindex, BatchedShaderGlobals<WidthT> &globals_batch,
+        void* userdata_base_ptr, void* output_base_ptr, bool run)
 {
-    return ctx.batched<WidthT>().execute_init (group, batch_size, globals_batch, run);
+    return ctx.batched<WidthT>().execute_init (group, batch_size, shadeindex,
+                                               globals_batch, userdata_base_ptr,
+                                               output_base_ptr, run);
 }
 
 
 template<int WidthT>
 bool
-ShadingSystem::BatchedExecutor<WidthT>::execute_layer (ShadingContext &ctx, int batch_size, BatchedShaderGlobals<WidthT> &globals_batch,
-                              int layernumber)
+ShadingSystem::BatchedExecutor<WidthT>::execute_layer (ShadingContext &ctx, int batch_size,
+        int shadeindex, BatchedShaderGlobals<WidthT> &globals_batch,
+        void* userdata_base_ptr, void* output_base_ptr, int layernumber)
 {
-    return ctx.batched<WidthT>().execute_layer (batch_size, globals_batch, layernumber);
+    return ctx.batched<WidthT>().execute_layer (batch_size, shadeindex,
+                                                globals_batch, userdata_base_ptr,
+                                                output_base_ptr, layernumber);
 }
 
 template<int WidthT>
 bool
-ShadingSystem::BatchedExecutor<WidthT>::execute_layer (ShadingContext &ctx, int batch_size, BatchedShaderGlobals<WidthT> &globals_batch,
-                              ustring layername)
+ShadingSystem::BatchedExecutor<WidthT>::execute_layer (ShadingContext &ctx, int batch_size,
+        int shadeindex, BatchedShaderGlobals<WidthT> &globals_batch,
+        void* userdata_base_ptr, void* output_base_ptr, ustring layername)
 {
     int layernumber = m_shading_system.find_layer (*ctx.group(), layername);
-    return layernumber >= 0 ? ctx.batched<WidthT>().execute_layer (batch_size, globals_batch, layernumber) : false;
+    return layernumber >= 0
+        ? ctx.batched<WidthT>().execute_layer (batch_size, shadeindex,
+                                               globals_batch, userdata_base_ptr,
+                                               output_base_ptr, layernumber)
+        : false;
 }
 
 template<int WidthT>
 bool
-ShadingSystem::BatchedExecutor<WidthT>::execute_layer (ShadingContext &ctx, int batch_size, BatchedShaderGlobals<WidthT> &globals_batch,
-                              const ShaderSymbol *symbol)
+ShadingSystem::BatchedExecutor<WidthT>::execute_layer (ShadingContext &ctx, int batch_size,
+        int shadeindex, BatchedShaderGlobals<WidthT> &globals_batch,
+        void* userdata_base_ptr, void* output_base_ptr,
+        const ShaderSymbol *symbol)
 {
     OSL_ASSERT (symbol);
     const Symbol *sym = reinterpret_cast<const Symbol *>(symbol);
     int layernumber = sym->layer();
-    return layernumber >= 0 ? ctx.batched<WidthT>().execute_layer (batch_size, globals_batch, layernumber) : false;
+    return layernumber >= 0
+        ? ctx.batched<WidthT>().execute_layer (batch_size, shadeindex,
+                                               globals_batch, userdata_base_ptr,
+                                               output_base_ptr, layernumber)
+        : false;
+}
+
+template<int WidthT>
+void
+ShadingSystem::BatchedExecutor<WidthT>::bind_userdata (ShadingContext &ctx,
+        const UserDataBinding *const *bindings, const void *const *records)
+{
+    ctx.batched_bind_userdata (bindings, records);
 }
 #endif
 
@@ -366,6 +439,32 @@ ShadingSystem::execute_cleanup (ShadingContext &ctx)
 
 
 
+void
+ShadingSystem::bind_userdata (ShadingContext &ctx,
+                              const UserDataBinding *bindings,
+                              const void *record)
+{
+    ctx.bind_userdata (bindings, record);
+}
+
+
+
+void
+ShadingSystem::clear_matrix_cache (ShadingContext &ctx)
+{
+    ctx.matrix_cache().clear ();
+}
+
+
+
+void
+ShadingSystem::flush_file_output ()
+{
+    m_impl->file_output().flush ();
+}
+
+
+
 int
 ShadingSystem::find_layer (const ShaderGroup &group, ustring layername) const
 {
@@ -409,6 +508,11 @@ const ShaderSymbol*
 ShadingSystem::find_symbol (const ShaderGroup &group, ustring layername,
                             ustring symbolname) const
 {
+    // A group that shares the code of an identical one is never optimized
+    // itself; its symbols are those of the one it shares.
+    if (group.maybe_shared())
+        if (ShaderGroupRef body = m_impl->shared_body (const_cast<ShaderGroup&>(group)))
+            return find_symbol (*body, layername, symbolname);
     if (! group.optimized())
         return NULL;   // has to be post-optimized
     return (const ShaderSymbol *) group.find_symbol (layername, symbolname);
@@ -567,6 +671,22 @@ ShadingSystem::configure_batch_execution_at(int width)
 }
 #endif
 
+std::string
+ShadingSystem::getstats_json (int level) const
+{
+    return m_impl->getstats_json (level);
+}
+
+
+
+void
+ShadingSystem::reset_stats_interval ()
+{
+    m_impl->reset_stats_interval ();
+}
+
+
+
 std::string
 ShadingSystem::getstats (int level) const
 {
@@ -934,7 +1054,8 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_lockgeom_default (true), m_strict_messages(true),
       m_error_repeats(false),
       m_range_checking(true),
-      m_unknown_coordsys_error(true), m_connection_error(true),
+      m_unknown_coordsys_error(true), m_matrix_cache(1),
+      m_connection_error(true),
       m_greedyjit(false), m_countlayerexecs(false),
       m_relaxed_param_typecheck(false),
       m_max_warnings_per_thread(100),
@@ -949,6 +1070,7 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_opt_fold_getattribute(true),
       m_opt_middleman(true), m_opt_texture_handle(true),
       m_opt_seed_bblock_aliases(true),
+      m_opt_hoist_transforms(true),
 #if OSL_USE_BATCHED
       m_opt_batched_analysis((renderer->batched(WidthOf<16>()) != nullptr) |
                              (renderer->batched(WidthOf<8>()) != nullptr)),
@@ -961,6 +1083,8 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_vector_width(4),
       m_opt_passes(10),
       m_llvm_optimize(1),
+      m_llvm_tier1_optimize(10), m_llvm_tier_threshold(0),
+      m_dedup_groups(true),
       m_debug(0), m_llvm_debug(0),
       m_llvm_debug_layers(0), m_llvm_debug_ops(0),
       m_llvm_target_host(1),
@@ -972,14 +1096,17 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_max_local_mem_KB(2048),
       m_compile_report(false),
       m_buffer_printf(true),
+      m_buffer_fprintf(false), m_fprintf_flush_bytes(0),
       m_no_noise(false),
       m_no_pointcloud(false),
       m_force_derivs(false),
       m_allow_shader_replacement(false),
-      m_exec_repeat(1),
+      m_exec_repeat(1), m_no_derivs_raytypes(0),
       m_opt_warnings(0),
       m_gpu_opt_error(0),
       m_colorspace("Rec709"),
+      m_max_shared_contexts(0), m_nshared_context_slots(0),
+      m_file_output(*this),
       m_stat_opt_locking_time(0), m_stat_specialization_time(0),
       m_stat_total_llvm_time(0),
       m_stat_llvm_setup_time(0), m_stat_llvm_irgen_time(0),
@@ -993,9 +1120,14 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
     m_stat_groupinstances = 0;
     m_stat_instances_compiled = 0;
     m_stat_groups_compiled = 0;
+    m_stat_groups_recompiled = 0;
+    m_stat_groups_deduplicated = 0;
+    m_stat_groups_aot_loaded = 0;
     m_stat_empty_instances = 0;
     m_stat_merged_inst = 0;
     m_stat_merged_inst_opt = 0;
+    m_stat_inst_code_copied = 0;
+    m_stat_inst_syms_copied = 0;
     m_stat_empty_groups = 0;
     m_stat_regexes = 0;
     m_stat_preopt_syms = 0;
@@ -1004,6 +1136,7 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
     m_stat_preopt_ops = 0;
     m_stat_postopt_ops = 0;
     m_stat_middlemen_eliminated = 0;
+    m_stat_transforms_hoisted = 0;
     m_stat_const_connections = 0;
     m_stat_global_connections = 0;
     m_stat_tex_calls_codegened = 0;
@@ -1014,6 +1147,8 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
     m_stat_getattribute_fail_time = 0;
     m_stat_getattribute_calls = 0;
     m_stat_get_userdata_calls = 0;
+    m_stat_uniform_lanes_checks = 0;
+    m_stat_uniform_lanes_fastpath = 0;
     m_stat_noise_calls = 0;
     m_stat_pointcloud_searches = 0;
     m_stat_pointcloud_searches_total_results = 0;
@@ -1341,6 +1476,15 @@ ShadingSystemImpl::~ShadingSystemImpl ()
     }
 
     printstats ();
+
+    // Delete the idle contexts of the shared pool (any still borrowed
+    // are the app's responsibility, like the per-thread ones).
+    for (int i = 0;  i < m_nshared_context_slots;  ++i)
+        delete m_shared_contexts[i].exchange (nullptr);
+
+    // Whatever shader fprintf output is still buffered goes out now.
+    m_file_output.flush ();
+
     // N.B. just let m_texsys go -- if we asked for one to be created,
     // we asked for a shared one.
 
@@ -1437,6 +1581,7 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
     ATTR_SET ("opt_middleman", int, m_opt_middleman);
     ATTR_SET ("opt_texture_handle", int, m_opt_texture_handle);
     ATTR_SET ("opt_seed_bblock_aliases", int, m_opt_seed_bblock_aliases);
+    ATTR_SET ("opt_hoist_transforms", int, m_opt_hoist_transforms);
     ATTR_SET ("opt_batched_analysis", int, m_opt_batched_analysis);
     ATTR_SET ("llvm_jit_fma", int, m_llvm_jit_fma);
     ATTR_SET ("llvm_jit_aggressive", int, m_llvm_jit_aggressive);
@@ -1445,6 +1590,9 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
     ATTR_SET ("opt_passes", int, m_opt_passes);
     ATTR_SET ("optimize_nondebug", int, m_optimize_nondebug);
     ATTR_SET ("llvm_optimize", int, m_llvm_optimize);
+    ATTR_SET ("llvm_tier1_optimize", int, m_llvm_tier1_optimize);
+    ATTR_SET ("llvm_tier_threshold", int, m_llvm_tier_threshold);
+    ATTR_SET ("dedup_groups", int, m_dedup_groups);
     ATTR_SET ("llvm_debug", int, m_llvm_debug);
     ATTR_SET ("llvm_debug_layers", int, m_llvm_debug_layers);
     ATTR_SET ("llvm_debug_ops", int, m_llvm_debug_ops);
@@ -1457,19 +1605,23 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
     ATTR_SET ("strict_messages", int, m_strict_messages);
     ATTR_SET ("range_checking", int, m_range_checking);
     ATTR_SET ("unknown_coordsys_error", int, m_unknown_coordsys_error);
+    ATTR_SET ("matrix_cache", int, m_matrix_cache);
     ATTR_SET ("connection_error", int, m_connection_error);
     ATTR_SET ("greedyjit", int, m_greedyjit);
     ATTR_SET ("relaxed_param_typecheck", int, m_relaxed_param_typecheck);
     ATTR_SET ("countlayerexecs", int, m_countlayerexecs);
     ATTR_SET ("max_warnings_per_thread", int, m_max_warnings_per_thread);
+    ATTR_SET ("max_shared_contexts", int, m_max_shared_contexts);
     ATTR_SET ("max_local_mem_KB", int, m_max_local_mem_KB);
     ATTR_SET ("compile_report", int, m_compile_report);
     ATTR_SET ("buffer_printf", int, m_buffer_printf);
+    ATTR_SET ("buffer_fprintf", int, m_buffer_fprintf);
     ATTR_SET ("no_noise", int, m_no_noise);
     ATTR_SET ("no_pointcloud", int, m_no_pointcloud);
     ATTR_SET ("force_derivs", int, m_force_derivs);
     ATTR_SET ("allow_shader_replacement", int, m_allow_shader_replacement);
     ATTR_SET ("exec_repeat", int, m_exec_repeat);
+    ATTR_SET ("no_derivs_raytypes", int, m_no_derivs_raytypes);
     ATTR_SET ("opt_warnings", int, m_opt_warnings);
     ATTR_SET ("gpu_opt_error", int, m_gpu_opt_error);
     ATTR_SET_STRING ("commonspace", m_commonspace_synonym);
@@ -1507,6 +1659,12 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
             m_raytypes.emplace_back(((const char **)val)[i]);
         return true;
     }
+    if (name == "no_derivs_raytypes" && type.basetype == TypeDesc::STRING) {
+        m_no_derivs_raytypes = 0;
+        for (size_t i = 0;  i < type.numelements();  ++i)
+            m_no_derivs_raytypes |= raytype_bit (ustring(((const char **)val)[i]));
+        return true;
+    }
     if (name == "renderer_outputs" && type.basetype == TypeDesc::STRING) {
         m_renderer_outputs.clear ();
         for (size_t i = 0;  i < type.numelements();  ++i)
@@ -1526,6 +1684,11 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
         }
         return true;
     }
+    if (name == "fprintf_flush_bytes" && type == TypeDesc::INT) {
+        m_fprintf_flush_bytes = std::max (*(const int *)val, 0);
+        m_file_output.flush_threshold (size_t(m_fprintf_flush_bytes));
+        return true;
+    }
     if (name == "error_repeats") {
         // Special case: setting error_repeats also clears the "previously
         // seen" error and warning lists.
@@ -1541,6 +1704,151 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
 
 
 
+// Every counter that getattribute("stat:<name>") can report: its name,
+// C type, unit, whether it is cumulative, and how to read it. Cumulative
+// counters only ever grow, so for an interval we report how much they
+// grew; the others (memory levels, maxima) are reported as they stand.
+#define OSL_STAT_COUNTERS(X) \
+    X (masters,                           int,       "count", true,  m_stat_shaders_loaded) \
+    X (groups,                            int,       "count", true,  m_stat_groups) \
+    X (instances_compiled,                int,       "count", true,  m_stat_instances_compiled) \
+    X (groups_compiled,                   int,       "count", true,  m_stat_groups_compiled) \
+    X (groups_recompiled,                 int,       "count", true,  m_stat_groups_recompiled) \
+    X (groups_deduplicated,               int,       "count", false, m_stat_groups_deduplicated) \
+    X (groups_aot_loaded,                 int,       "count", true,  m_stat_groups_aot_loaded) \
+    X (empty_instances,                   int,       "count", true,  m_stat_empty_instances) \
+    X (merged_inst,                       int,       "count", true,  m_stat_merged_inst) \
+    X (merged_inst_opt,                   int,       "count", true,  m_stat_merged_inst_opt) \
+    X (inst_code_copied,                  int,       "count", true,  m_stat_inst_code_copied) \
+    X (inst_syms_copied,                  int,       "count", true,  m_stat_inst_syms_copied) \
+    X (empty_groups,                      int,       "count", true,  m_stat_empty_groups) \
+    X (instances,                         int,       "count", true,  m_stat_groupinstances) \
+    X (regexes,                           int,       "count", true,  m_stat_regexes) \
+    X (preopt_syms,                       int,       "count", true,  m_stat_preopt_syms) \
+    X (postopt_syms,                      int,       "count", true,  m_stat_postopt_syms) \
+    X (syms_with_derivs,                  int,       "count", true,  m_stat_syms_with_derivs) \
+    X (preopt_ops,                        int,       "count", true,  m_stat_preopt_ops) \
+    X (postopt_ops,                       int,       "count", true,  m_stat_postopt_ops) \
+    X (middlemen_eliminated,              int,       "count", true,  m_stat_middlemen_eliminated) \
+    X (transforms_hoisted,                int,       "count", true,  m_stat_transforms_hoisted) \
+    X (fprintf_bytes,                     long long, "bytes", true,  m_file_output.bytes_written()) \
+    X (fprintf_file_writes,               long long, "count", true,  m_file_output.file_writes()) \
+    X (const_connections,                 int,       "count", true,  m_stat_const_connections) \
+    X (global_connections,                int,       "count", true,  m_stat_global_connections) \
+    X (tex_calls_codegened,               int,       "count", true,  m_stat_tex_calls_codegened) \
+    X (tex_calls_as_handles,              int,       "count", true,  m_stat_tex_calls_as_handles) \
+    X (master_load_time,                  float,     "seconds", true,  m_stat_master_load_time) \
+    X (optimization_time,                 float,     "seconds", true,  m_stat_optimization_time) \
+    X (opt_locking_time,                  float,     "seconds", true,  m_stat_opt_locking_time) \
+    X (specialization_time,               float,     "seconds", true,  m_stat_specialization_time) \
+    X (total_llvm_time,                   float,     "seconds", true,  m_stat_total_llvm_time) \
+    X (llvm_setup_time,                   float,     "seconds", true,  m_stat_llvm_setup_time) \
+    X (llvm_irgen_time,                   float,     "seconds", true,  m_stat_llvm_irgen_time) \
+    X (llvm_opt_time,                     float,     "seconds", true,  m_stat_llvm_opt_time) \
+    X (llvm_jit_time,                     float,     "seconds", true,  m_stat_llvm_jit_time) \
+    X (inst_merge_time,                   float,     "seconds", true,  m_stat_inst_merge_time) \
+    X (getattribute_calls,                long long, "count", true,  m_stat_getattribute_calls) \
+    X (get_userdata_calls,                long long, "count", true,  m_stat_get_userdata_calls) \
+    X (uniform_lanes_checks,              long long, "count", true,  m_stat_uniform_lanes_checks) \
+    X (uniform_lanes_fastpath,            long long, "count", true,  m_stat_uniform_lanes_fastpath) \
+    X (noise_calls,                       long long, "count", true,  m_stat_noise_calls) \
+    X (pointcloud_searches,               long long, "count", true,  m_stat_pointcloud_searches) \
+    X (pointcloud_gets,                   long long, "count", true,  m_stat_pointcloud_gets) \
+    X (pointcloud_writes,                 long long, "count", true,  m_stat_pointcloud_writes) \
+    X (pointcloud_searches_total_results, long long, "count", true,  m_stat_pointcloud_searches_total_results) \
+    X (pointcloud_max_results,            int,       "count", false, m_stat_pointcloud_max_results) \
+    X (pointcloud_failures,               int,       "count", true,  m_stat_pointcloud_failures) \
+    X (memory_current,                    long long, "bytes", false, m_stat_memory.current()) \
+    X (memory_peak,                       long long, "bytes", false, m_stat_memory.peak()) \
+    X (mem_master_current,                long long, "bytes", false, m_stat_mem_master.current()) \
+    X (mem_master_peak,                   long long, "bytes", false, m_stat_mem_master.peak()) \
+    X (mem_master_ops_current,            long long, "bytes", false, m_stat_mem_master_ops.current()) \
+    X (mem_master_ops_peak,               long long, "bytes", false, m_stat_mem_master_ops.peak()) \
+    X (mem_master_args_current,           long long, "bytes", false, m_stat_mem_master_args.current()) \
+    X (mem_master_args_peak,              long long, "bytes", false, m_stat_mem_master_args.peak()) \
+    X (mem_master_syms_current,           long long, "bytes", false, m_stat_mem_master_syms.current()) \
+    X (mem_master_syms_peak,              long long, "bytes", false, m_stat_mem_master_syms.peak()) \
+    X (mem_master_defaults_current,       long long, "bytes", false, m_stat_mem_master_defaults.current()) \
+    X (mem_master_defaults_peak,          long long, "bytes", false, m_stat_mem_master_defaults.peak()) \
+    X (mem_master_consts_current,         long long, "bytes", false, m_stat_mem_master_consts.current()) \
+    X (mem_master_consts_peak,            long long, "bytes", false, m_stat_mem_master_consts.peak()) \
+    X (mem_inst_current,                  long long, "bytes", false, m_stat_mem_inst.current()) \
+    X (mem_inst_peak,                     long long, "bytes", false, m_stat_mem_inst.peak()) \
+    X (mem_inst_syms_current,             long long, "bytes", false, m_stat_mem_inst_syms.current()) \
+    X (mem_inst_syms_peak,                long long, "bytes", false, m_stat_mem_inst_syms.peak()) \
+    X (mem_inst_paramvals_current,        long long, "bytes", false, m_stat_mem_inst_paramvals.current()) \
+    X (mem_inst_paramvals_peak,           long long, "bytes", false, m_stat_mem_inst_paramvals.peak()) \
+    X (mem_inst_connections_current,      long long, "bytes", false, m_stat_mem_inst_connections.current()) \
+    X (mem_inst_connections_peak,         long long, "bytes", false, m_stat_mem_inst_connections.peak()) \
+    X (mem_inst_code_current,             long long, "bytes", false, m_stat_mem_inst_code.current()) \
+    X (mem_inst_code_peak,                long long, "bytes", false, m_stat_mem_inst_code.peak()) \
+    X (mem_inst_code_shared_current,      long long, "bytes", false, m_stat_mem_inst_code_shared.current()) \
+    X (mem_inst_code_shared_peak,         long long, "bytes", false, m_stat_mem_inst_code_shared.peak()) \
+    X (mem_inst_syms_shared_current,      long long, "bytes", false, m_stat_mem_inst_syms_shared.current()) \
+    X (mem_inst_syms_shared_peak,         long long, "bytes", false, m_stat_mem_inst_syms_shared.peak()) \
+    X (llvm_jit_memory,                   long long, "bytes", false, LLVM_Util::total_jit_memory_held())
+
+
+
+namespace {
+
+struct StatCounterDesc {
+    const char *name;
+    TypeDesc type;
+    const char *unit;
+    bool cumulative;
+};
+
+static const StatCounterDesc stat_counters[] = {
+#define STAT_COUNTER_DESC(name,ctype,unit,cumulative,expr)              \
+    { #name, TypeDesc(OIIO::BaseTypeFromC<ctype>::value), unit, cumulative },
+    OSL_STAT_COUNTERS (STAT_COUNTER_DESC)
+#undef STAT_COUNTER_DESC
+};
+
+enum StatCounterIndex {
+#define STAT_COUNTER_INDEX(name,ctype,unit,cumulative,expr) stat_index_##name,
+    OSL_STAT_COUNTERS (STAT_COUNTER_INDEX)
+#undef STAT_COUNTER_INDEX
+};
+
+
+
+static std::string
+json_string (string_view s)
+{
+    std::string r ("\"");
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            r += '\\';
+        if ((unsigned char)c < 0x20)
+            r += Strutil::sprintf ("\\u%04x", int(c));
+        else
+            r += c;
+    }
+    r += '"';
+    return r;
+}
+
+
+
+// JSON has no NaN or infinity, so those are reported as null.
+static std::string
+json_number (double x)
+{
+    if (! std::isfinite (x))
+        return "null";
+    std::ostringstream out;
+    out.imbue (std::locale::classic());  // force C locale
+    out.precision (9);
+    out << x;
+    return out.str();
+}
+
+}  // anonymous namespace
+
+
+
 bool
 ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
                                  void *val)
@@ -1588,6 +1896,7 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("opt_middleman", int, m_opt_middleman);
     ATTR_DECODE ("opt_texture_handle", int, m_opt_texture_handle);
     ATTR_DECODE ("opt_seed_bblock_aliases", int, m_opt_seed_bblock_aliases);
+    ATTR_DECODE ("opt_hoist_transforms", int, m_opt_hoist_transforms);
     ATTR_DECODE ("llvm_jit_fma", int, m_llvm_jit_fma);
     ATTR_DECODE ("llvm_jit_aggressive", int, m_llvm_jit_aggressive);
     ATTR_DECODE_STRING ("llvm_jit_target", m_llvm_jit_target);
@@ -1595,6 +1904,9 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("opt_passes", int, m_opt_passes);
     ATTR_DECODE ("optimize_nondebug", int, m_optimize_nondebug);
     ATTR_DECODE ("llvm_optimize", int, m_llvm_optimize);
+    ATTR_DECODE ("llvm_tier1_optimize", int, m_llvm_tier1_optimize);
+    ATTR_DECODE ("llvm_tier_threshold", int, m_llvm_tier_threshold);
+    ATTR_DECODE ("dedup_groups", int, m_dedup_groups);
     ATTR_DECODE ("debug", int, m_debug);
     ATTR_DECODE ("llvm_debug", int, m_llvm_debug);
     ATTR_DECODE ("llvm_debug_layers", int, m_llvm_debug_layers);
@@ -1608,11 +1920,13 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("error_repeats", int, m_error_repeats);
     ATTR_DECODE ("range_checking", int, m_range_checking);
     ATTR_DECODE ("unknown_coordsys_error", int, m_unknown_coordsys_error);
+    ATTR_DECODE ("matrix_cache", int, m_matrix_cache);
     ATTR_DECODE ("connection_error", int, m_connection_error);
     ATTR_DECODE ("greedyjit", int, m_greedyjit);
     ATTR_DECODE ("countlayerexecs", int, m_countlayerexecs);
     ATTR_DECODE ("relaxed_param_typecheck", int, m_relaxed_param_typecheck);
     ATTR_DECODE ("max_warnings_per_thread", int, m_max_warnings_per_thread);
+    ATTR_DECODE ("max_shared_contexts", int, m_max_shared_contexts);
     ATTR_DECODE_STRING ("commonspace", m_commonspace_synonym);
     ATTR_DECODE_STRING ("colorspace", m_colorspace);
     ATTR_DECODE_STRING ("debug_groupname", m_debug_groupname);
@@ -1624,75 +1938,34 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("max_local_mem_KB", int, m_max_local_mem_KB);
     ATTR_DECODE ("compile_report", int, m_compile_report);
     ATTR_DECODE ("buffer_printf", int, m_buffer_printf);
+    ATTR_DECODE ("buffer_fprintf", int, m_buffer_fprintf);
+    ATTR_DECODE ("fprintf_flush_bytes", int, m_fprintf_flush_bytes);
     ATTR_DECODE ("no_noise", int, m_no_noise);
     ATTR_DECODE ("no_pointcloud", int, m_no_pointcloud);
     ATTR_DECODE ("force_derivs", int, m_force_derivs);
     ATTR_DECODE ("allow_shader_replacement", int, m_allow_shader_replacement);
     ATTR_DECODE ("exec_repeat", int, m_exec_repeat);
+    ATTR_DECODE ("no_derivs_raytypes", int, m_no_derivs_raytypes);
     ATTR_DECODE ("opt_warnings", int, m_opt_warnings);
     ATTR_DECODE ("gpu_opt_error", int, m_gpu_opt_error);
 
-    ATTR_DECODE ("stat:masters", int, m_stat_shaders_loaded);
-    ATTR_DECODE ("stat:groups", int, m_stat_groups);
-    ATTR_DECODE ("stat:instances_compiled", int, m_stat_instances_compiled);
-    ATTR_DECODE ("stat:groups_compiled", int, m_stat_groups_compiled);
-    ATTR_DECODE ("stat:empty_instances", int, m_stat_empty_instances);
-    ATTR_DECODE ("stat:merged_inst", int, m_stat_merged_inst);
-    ATTR_DECODE ("stat:merged_inst_opt", int, m_stat_merged_inst_opt);
-    ATTR_DECODE ("stat:empty_groups", int, m_stat_empty_groups);
-    ATTR_DECODE ("stat:instances", int, m_stat_groupinstances);
-    ATTR_DECODE ("stat:regexes", int, m_stat_regexes);
-    ATTR_DECODE ("stat:preopt_syms", int, m_stat_preopt_syms);
-    ATTR_DECODE ("stat:postopt_syms", int, m_stat_postopt_syms);
-    ATTR_DECODE ("stat:syms_with_derivs", int, m_stat_syms_with_derivs);
-    ATTR_DECODE ("stat:preopt_ops", int, m_stat_preopt_ops);
-    ATTR_DECODE ("stat:postopt_ops", int, m_stat_postopt_ops);
-    ATTR_DECODE ("stat:middlemen_eliminated", int, m_stat_middlemen_eliminated);
-    ATTR_DECODE ("stat:const_connections", int, m_stat_const_connections);
-    ATTR_DECODE ("stat:global_connections", int, m_stat_global_connections);
-    ATTR_DECODE ("stat:tex_calls_codegened", int, m_stat_tex_calls_codegened);
-    ATTR_DECODE ("stat:tex_calls_as_handles", int, m_stat_tex_calls_as_handles);
-    ATTR_DECODE ("stat:master_load_time", float, m_stat_master_load_time);
-    ATTR_DECODE ("stat:optimization_time", float, m_stat_optimization_time);
-    ATTR_DECODE ("stat:opt_locking_time", float, m_stat_opt_locking_time);
-    ATTR_DECODE ("stat:specialization_time", float, m_stat_specialization_time);
-    ATTR_DECODE ("stat:total_llvm_time", float, m_stat_total_llvm_time);
-    ATTR_DECODE ("stat:llvm_setup_time", float, m_stat_llvm_setup_time);
-    ATTR_DECODE ("stat:llvm_irgen_time", float, m_stat_llvm_irgen_time);
-    ATTR_DECODE ("stat:llvm_opt_time", float, m_stat_llvm_opt_time);
-    ATTR_DECODE ("stat:llvm_jit_time", float, m_stat_llvm_jit_time);
-    ATTR_DECODE ("stat:inst_merge_time", float, m_stat_inst_merge_time);
-    ATTR_DECODE ("stat:getattribute_calls", long long, m_stat_getattribute_calls);
-    ATTR_DECODE ("stat:get_userdata_calls", long long, m_stat_get_userdata_calls);
-    ATTR_DECODE ("stat:noise_calls", long long, m_stat_noise_calls);
-    ATTR_DECODE ("stat:pointcloud_searches", long long, m_stat_pointcloud_searches);
-    ATTR_DECODE ("stat:pointcloud_gets", long long, m_stat_pointcloud_gets);
-    ATTR_DECODE ("stat:pointcloud_writes", long long, m_stat_pointcloud_writes);
-    ATTR_DECODE ("stat:pointcloud_searches_total_results", long long, m_stat_pointcloud_searches_total_results);
-    ATTR_DECODE ("stat:pointcloud_max_results", int, m_stat_pointcloud_max_results);
-    ATTR_DECODE ("stat:pointcloud_failures", int, m_stat_pointcloud_failures);
-    ATTR_DECODE ("stat:memory_current", long long, m_stat_memory.current());
-    ATTR_DECODE ("stat:memory_peak", long long, m_stat_memory.peak());
-    ATTR_DECODE ("stat:mem_master_current", long long, m_stat_mem_master.current());
-    ATTR_DECODE ("stat:mem_master_peak", long long, m_stat_mem_master.peak());
-    ATTR_DECODE ("stat:mem_master_ops_current", long long, m_stat_mem_master_ops.current());
-    ATTR_DECODE ("stat:mem_master_ops_peak", long long, m_stat_mem_master_ops.peak());
-    ATTR_DECODE ("stat:mem_master_args_current", long long, m_stat_mem_master_args.current());
-    ATTR_DECODE ("stat:mem_master_args_peak", long long, m_stat_mem_master_args.peak());
-    ATTR_DECODE ("stat:mem_master_syms_current", long long, m_stat_mem_master_syms.current());
-    ATTR_DECODE ("stat:mem_master_syms_peak", long long, m_stat_mem_master_syms.peak());
-    ATTR_DECODE ("stat:mem_master_defaults_current", long long, m_stat_mem_master_defaults.current());
-    ATTR_DECODE ("stat:mem_master_defaults_peak", long long, m_stat_mem_master_defaults.peak());
-    ATTR_DECODE ("stat:mem_master_consts_current", long long, m_stat_mem_master_consts.current());
-    ATTR_DECODE ("stat:mem_master_consts_peak", long long, m_stat_mem_master_consts.peak());
-    ATTR_DECODE ("stat:mem_inst_current", long long, m_stat_mem_inst.current());
-    ATTR_DECODE ("stat:mem_inst_peak", long long, m_stat_mem_inst.peak());
-    ATTR_DECODE ("stat:mem_inst_syms_current", long long, m_stat_mem_inst_syms.current());
-    ATTR_DECODE ("stat:mem_inst_syms_peak", long long, m_stat_mem_inst_syms.peak());
-    ATTR_DECODE ("stat:mem_inst_paramvals_current", long long, m_stat_mem_inst_paramvals.current());
-    ATTR_DECODE ("stat:mem_inst_paramvals_peak", long long, m_stat_mem_inst_paramvals.peak());
-    ATTR_DECODE ("stat:mem_inst_connections_current", long long, m_stat_mem_inst_connections.current());
-    ATTR_DECODE ("stat:mem_inst_connections_peak", long long, m_stat_mem_inst_connections.peak());
+#define STAT_COUNTER_DECODE(name,ctype,unit,cumulative,expr)            \
+    ATTR_DECODE ("stat:" #name, ctype, expr);
+    OSL_STAT_COUNTERS (STAT_COUNTER_DECODE)
+#undef STAT_COUNTER_DECODE
+    if (name == "stat:num_counters" && type == TypeDesc::TypeInt) {
+        *(int *)val = num_stat_counters();
+        return true;
+    }
+    if ((name == "stat:counter_names" || name == "stat:counter_units")
+          && type.basetype == TypeDesc::STRING) {
+        int n = std::min (int(type.numelements()), num_stat_counters());
+        for (int i = 0; i < n; ++i)
+            ((ustring *)val)[i] = ustring (name == "stat:counter_names"
+                                           ? stat_counters[i].name
+                                           : stat_counters[i].unit);
+        return true;
+    }
 
     if (name == "colorsystem" && type.basetype == TypeDesc::PTR) {
         *(void**)val = &colorsystem();
@@ -1757,6 +2030,7 @@ ShadingSystemImpl::attribute (ShaderGroup *group, string_view name,
     // No current group attributes to set
     if (! group)
         return attribute (name, type, val);
+    group->spec_edited ();
     lock_guard lock (group->m_mutex);
     if (name == "renderer_outputs" && type.basetype == TypeDesc::STRING) {
         group->m_renderer_outputs.clear ();
@@ -1774,6 +2048,27 @@ ShadingSystemImpl::attribute (ShaderGroup *group, string_view name,
         group->m_exec_repeat = *(const int *)val;
         return true;
     }
+    if (name == "no_derivs_raytypes" && type == TypeDesc::TypeInt) {
+        group->m_no_derivs_raytypes = *(const int *)val;
+        return true;
+    }
+    if (name == "no_derivs_raytypes" && type.basetype == TypeDesc::STRING) {
+        group->m_no_derivs_raytypes = 0;
+        for (size_t i = 0;  i < type.numelements();  ++i)
+            group->m_no_derivs_raytypes |= raytype_bit (ustring(((const char **)val)[i]));
+        return true;
+    }
+    if (name == "interactive_params" && type.basetype == TypeDesc::STRING) {
+        if (group->optimized()) {
+            errorfmt("Group \"{}\": \"interactive_params\" must be set before the group is optimized",
+                     group->name());
+            return false;
+        }
+        group->m_interactive_params.clear ();
+        for (size_t i = 0;  i < type.numelements();  ++i)
+            group->m_interactive_params.emplace_back(((const char **)val)[i]);
+        return true;
+    }
     if (name == "groupname" && type == TypeDesc::TypeString) {
         group->name (ustring(((const char **)val)[0]));
         return true;
@@ -1863,12 +2158,38 @@ ShadingSystemImpl::getattribute (ShaderGroup *group, string_view name,
         *(int *)val = group->m_exec_repeat;
         return true;
     }
+    if (name == "no_derivs_raytypes" && type == TypeDesc::TypeInt) {
+        *(int *)val = group->m_no_derivs_raytypes;
+        return true;
+    }
+    if (name == "num_interactive_params" && type == TypeDesc::TypeInt) {
+        *(int *)val = (int) group->m_interactive_params.size();
+        return true;
+    }
+    if (name == "interactive_params" && type.basetype == TypeDesc::STRING) {
+        size_t n = std::min (type.numelements(), group->m_interactive_params.size());
+        for (size_t i = 0;  i < n;  ++i)
+            ((ustring *)val)[i] = group->m_interactive_params[i];
+        for (size_t i = n;  i < type.numelements();  ++i)
+            ((ustring *)val)[i] = ustring();
+        return true;
+    }
+    if (name == "specialized" && type == TypeDesc::TypeInt) {
+        *(int *)val = group->specialized() ? 1 : 0;
+        return true;
+    }
     if (name == "ptx_compiled_version" && type.basetype == TypeDesc::PTR) {
         bool exists = !group->m_llvm_ptx_compiled_version.empty();
         *(std::string *)val = exists ? group->m_llvm_ptx_compiled_version : "";
         return true;
     }
 
+    // A group that shares the code of an identical one answers the rest
+    // from that one, which is the one that gets optimized.
+    if (group->maybe_shared())
+        if (ShaderGroupRef body = shared_body (*group))
+            return getattribute (body.get(), name, type, val);
+
     // All the remaining attributes require the group to already be
     // optimized.
     if (! group->optimized()) {
@@ -1906,6 +2227,26 @@ ShadingSystemImpl::getattribute (ShaderGroup *group, string_view name,
         *(int *)val = (int)group->m_unknown_closures_needed;
         return true;
     }
+    if (name == "closure_bytes_needed" && type == TypeDesc::TypeInt) {
+        *(int *)val = (int)group->m_closure_bytes_hint;
+        return true;
+    }
+    if (name == "message_bytes_needed" && type == TypeDesc::TypeInt) {
+        *(int *)val = (int)group->m_message_bytes_hint;
+        return true;
+    }
+    if (name == "closure_bytes_peak" && type == TypeDesc::TypeInt) {
+        *(int *)val = (int)group->m_stat_peak_closure_bytes;
+        return true;
+    }
+    if (name == "message_bytes_peak" && type == TypeDesc::TypeInt) {
+        *(int *)val = (int)group->m_stat_peak_message_bytes;
+        return true;
+    }
+    if (name == "scratch_bytes_peak" && type == TypeDesc::TypeInt) {
+        *(int *)val = (int)group->m_stat_peak_scratch_bytes;
+        return true;
+    }
 
     if (name == "num_globals_needed" && type == TypeDesc::TypeInt) {
         *(int *)val = (int)group->m_globals_needed.size();
@@ -2093,6 +2434,7 @@ ShadingSystemImpl::getstats (int level) const
 #define STROPT(name) if (m_##name.size()) opt += Strutil::sprintf(#name "=\"%s\" ", m_##name)
     INTOPT (optimize);
     INTOPT (llvm_optimize);
+    INTOPT (llvm_tier_threshold);
     INTOPT (debug);
     INTOPT (profile);
     INTOPT (llvm_debug);
@@ -2102,6 +2444,8 @@ ShadingSystemImpl::getstats (int level) const
     BOOLOPT (llvm_output_bitcode);
     BOOLOPT (llvm_dumpasm);
     BOOLOPT (llvm_prune_ir_strategy);
+    if (! m_dedup_groups)   // only when off, keeping the default line as it was
+        BOOLOPT (dedup_groups);
     BOOLOPT (lazylayers);
     BOOLOPT (lazyglobals);
     BOOLOPT (lazyunconnected);
@@ -2191,6 +2535,10 @@ ShadingSystemImpl::getstats (int level) const
     out << "    Avg instances per group: "
         << Strutil::sprintf ("%.1f", iperg) << "\n";
     out << "  Shading contexts: " << m_stat_contexts << "\n";
+    if (m_file_output.file_writes())
+        out << "  Shader fprintf output: "
+            << Strutil::memformat (m_file_output.bytes_written()) << " in "
+            << m_file_output.file_writes() << " file writes\n";
     if (m_countlayerexecs)
         out << "  Total layers executed: " << m_stat_layers_executed << "\n";
 
@@ -2213,10 +2561,22 @@ ShadingSystemImpl::getstats (int level) const
 
     out << "  Compiled " << m_stat_groups_compiled << " groups, "
         << m_stat_instances_compiled << " instances\n";
+    if (m_llvm_tier_threshold > 0)
+        out << "  Recompiled " << m_stat_groups_recompiled
+            << " hot groups at full optimization\n";
+    if (m_stat_groups_deduplicated > 0)
+        out << "  Deduplicated " << m_stat_groups_deduplicated
+            << " groups (now sharing the code of an identical group)\n";
+    if (m_stat_groups_aot_loaded > 0)
+        out << "  Loaded " << m_stat_groups_aot_loaded
+            << " groups from code compiled ahead of time\n";
     out << "  Merged " << (m_stat_merged_inst+m_stat_merged_inst_opt)
         << " instances (" << m_stat_merged_inst << " initial, "
         << m_stat_merged_inst_opt << " after opt) in "
         << Strutil::timeintervalformat (m_stat_inst_merge_time, 2) << "\n";
+    out << "  Copied master code for " << m_stat_inst_code_copied
+        << " instances, master symbols for " << m_stat_inst_syms_copied
+        << " (the rest shared them)\n";
     if (m_stat_instances_compiled > 0)
         out << "  After optimization, " << m_stat_empty_instances
             << " empty instances ("
@@ -2240,6 +2600,9 @@ ShadingSystemImpl::getstats (int level) const
                             (int)m_stat_global_connections);
     out << Strutil::sprintf ("  Middlemen eliminated: %d\n",
                             (int)m_stat_middlemen_eliminated);
+    if (m_stat_transforms_hoisted)
+        out << Strutil::sprintf ("  Transforms sharing a hoisted matrix: %d\n",
+                                (int)m_stat_transforms_hoisted);
     out << Strutil::sprintf ("  Derivatives needed on %d / %d symbols (%.1f%%)\n",
                             (int)m_stat_syms_with_derivs, (int)m_stat_postopt_syms,
                             (100.0*(int)m_stat_syms_with_derivs)/std::max((int)m_stat_postopt_syms,1));
@@ -2273,6 +2636,9 @@ ShadingSystemImpl::getstats (int level) const
             << Strutil::timeintervalformat (m_stat_getattribute_fail_time, 2) << ")\n";
     }
     out << "  Number of get_userdata calls: " << m_stat_get_userdata_calls << "\n";
+    if (m_stat_uniform_lanes_checks)
+        out << "  Batched uniform-lanes checks: " << m_stat_uniform_lanes_checks
+            << " (" << m_stat_uniform_lanes_fastpath << " called once for all lanes)\n";
     if (profile() > 1)
         out << "  Number of noise calls: " << m_stat_noise_calls << "\n";
     if (m_stat_pointcloud_searches || m_stat_pointcloud_writes) {
@@ -2297,6 +2663,11 @@ ShadingSystemImpl::getstats (int level) const
     out << "        Instance syms:         " << m_stat_mem_inst_syms.memstat() << '\n';
     out << "        Instance param values: " << m_stat_mem_inst_paramvals.memstat() << '\n';
     out << "        Instance connections:  " << m_stat_mem_inst_connections.memstat() << '\n';
+    out << "        Instance code:         " << m_stat_mem_inst_code.memstat() << '\n';
+    out << "        Instance code shared:  " << m_stat_mem_inst_code_shared.memstat()
+        << " (referenced from masters, not copied)\n";
+    out << "        Instance syms shared:  " << m_stat_mem_inst_syms_shared.memstat()
+        << " (referenced from masters, not copied)\n";
 
     size_t jitmem = LLVM_Util::total_jit_memory_held();
     out << "    LLVM JIT memory: " << Strutil::memformat(jitmem) << '\n';
@@ -2343,6 +2714,152 @@ ShadingSystemImpl::getstats (int level) const
 
 
 
+int
+ShadingSystemImpl::num_stat_counters ()
+{
+    return int (sizeof(stat_counters) / sizeof(stat_counters[0]));
+}
+
+
+
+double
+ShadingSystemImpl::stat_counter (int index) const
+{
+    // Read the field itself. Going through getattribute would take
+    // m_mutex, and compare names, for every counter of every poll.
+    switch (index) {
+#define STAT_COUNTER_READ(name,ctype,unit,cumulative,expr)              \
+    case stat_index_##name: return double ((ctype)(expr));
+    OSL_STAT_COUNTERS (STAT_COUNTER_READ)
+#undef STAT_COUNTER_READ
+    default: return 0.0;
+    }
+}
+
+
+
+void
+ShadingSystemImpl::reset_stats_interval ()
+{
+    std::vector<double> base (num_stat_counters());
+    for (int i = 0, n = num_stat_counters(); i < n; ++i)
+        base[i] = stat_counter (i);
+    spin_lock lock (m_stat_interval_mutex);
+    m_stat_interval_base.swap (base);
+    m_stat_interval_start = OIIO::Timer::now();
+}
+
+
+
+std::string
+ShadingSystemImpl::getstats_json (int level) const
+{
+    if (level <= 0)
+        return "{}";
+
+    // Sample everything first, so that the numbers are as close to
+    // simultaneous as we can make them without stopping the world.
+    int ncounters = num_stat_counters();
+    std::vector<double> values (ncounters), base;
+    for (int i = 0; i < ncounters; ++i)
+        values[i] = stat_counter (i);
+    long long interval_start;
+    {
+        spin_lock lock (m_stat_interval_mutex);
+        base = m_stat_interval_base;
+        interval_start = m_stat_interval_start;
+    }
+    base.resize (ncounters, 0.0);   // no reset yet: since startup
+
+    std::ostringstream out;
+    out.imbue (std::locale::classic());  // force C locale
+    out.precision (9);
+    out << "{\n  \"osl_version\": " << json_string (OSL_LIBRARY_VERSION_STRING) << ",\n";
+    out << "  \"counters\": {";
+    for (int i = 0; i < ncounters; ++i) {
+        const StatCounterDesc &c (stat_counters[i]);
+        out << (i ? ",\n" : "\n") << "    " << json_string (c.name) << ": { "
+            << "\"value\": " << json_number (values[i])
+            << ", \"type\": " << json_string (c.type.c_str())
+            << ", \"unit\": " << json_string (c.unit)
+            << ", \"cumulative\": " << (c.cumulative ? "true" : "false") << " }";
+    }
+    out << "\n  },\n";
+
+    out << "  \"interval\": {\n    \"seconds\": "
+        << json_number (OIIO::Timer::seconds (OIIO::Timer::now() - interval_start))
+        << ",\n    \"counters\": {";
+    bool first = true;
+    for (int i = 0; i < ncounters; ++i) {
+        if (! stat_counters[i].cumulative)
+            continue;
+        out << (first ? "\n" : ",\n") << "      "
+            << json_string (stat_counters[i].name) << ": "
+            << json_number (values[i] - base[i]);
+        first = false;
+    }
+    out << "\n    }\n  }";
+
+    // Per-group (and with level > 1, per-layer) breakdown. Only the list
+    // of groups is locked, and only while we copy the references. The
+    // layers of a group are only looked at once it is complete, and only
+    // if nobody is optimizing it right now (we don't wait for that);
+    // otherwise its "nlayers" is null.
+    std::vector<ShaderGroupRef> groups;
+    {
+        spin_lock lock (m_all_shader_groups_mutex);
+        for (auto&& grp : m_all_shader_groups)
+            if (ShaderGroupRef g = grp.lock())
+                groups.push_back (g);
+    }
+    out << ",\n  \"groups\": [";
+    for (size_t gi = 0; gi < groups.size(); ++gi) {
+        const ShaderGroup &g (*groups[gi]);
+        std::unique_lock<mutex> glock (g.m_mutex, std::defer_lock);
+        bool layers_ok = g.m_complete && glock.try_lock();
+        out << (gi ? ",\n" : "\n") << "    { "
+            << "\"name\": " << json_string (g.name())
+            << ", \"id\": " << g.id();
+        if (layers_ok)
+            out << ", \"nlayers\": " << g.nlayers();
+        else
+            out << ", \"nlayers\": null";
+        out << ", \"optimized\": " << (g.optimized() ? "true" : "false")
+            << ", \"jitted\": " << (g.jitted() ? "true" : "false")
+            << ", \"does_nothing\": " << (g.does_nothing() ? "true" : "false")
+            << ", \"executions\": " << (long long) g.m_executions
+            << ", \"shading_time\": "
+            << json_number (OIIO::Timer::seconds ((long long) g.m_stat_total_shading_time_ticks));
+        out << ", \"closure_bytes_needed\": " << g.closure_bytes_hint()
+            << ", \"closure_bytes_peak\": " << (long long) g.m_stat_peak_closure_bytes
+            << ", \"message_bytes_needed\": " << g.message_bytes_hint()
+            << ", \"message_bytes_peak\": " << (long long) g.m_stat_peak_message_bytes
+            << ", \"scratch_bytes_peak\": " << (long long) g.m_stat_peak_scratch_bytes;
+        if (level > 1 && layers_ok) {
+            out << ",\n      \"layers\": [";
+            for (int li = 0, n = g.nlayers(); li < n; ++li) {
+                const ShaderInstance *inst = g[li];
+                out << (li ? ",\n" : "\n") << "        { "
+                    << "\"name\": " << json_string (inst->layername())
+                    << ", \"shader\": " << json_string (inst->shadername())
+                    << ", \"entry\": " << (inst->entry_layer() ? "true" : "false")
+                    << ", \"unused\": " << (inst->unused() ? "true" : "false")
+                    << ", \"empty\": " << (inst->empty_instance() ? "true" : "false")
+                    << ", \"symbols\": " << inst->symbols().size()
+                    << ", \"code_shared\": " << (inst->code_shared() ? "true" : "false")
+                    << ", \"symbols_shared\": " << (inst->symbols_shared() ? "true" : "false")
+                    << " }";
+            }
+            out << "\n      ]";
+        }
+        out << " }";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+
+
 void
 ShadingSystemImpl::printstats () const
 {
@@ -2382,9 +2899,30 @@ ShadingSystemImpl::Parameter (ShaderGroup& group, string_view name,
 
 ShaderGroupRef
 ShadingSystemImpl::ShaderGroupBegin (string_view groupname)
+{
+    return new_group (groupname, true);
+}
+
+
+
+ShaderGroupRef
+ShadingSystemImpl::new_clone_group (string_view groupname)
+{
+    ShaderGroupRef group (new ShaderGroup(groupname));
+    group->m_clone = true;
+    group->m_self = group;
+    return group;
+}
+
+
+
+ShaderGroupRef
+ShadingSystemImpl::new_group (string_view groupname, bool make_current)
 {
     ShaderGroupRef group (new ShaderGroup(groupname));
     group->m_exec_repeat = m_exec_repeat;
+    group->m_no_derivs_raytypes = m_no_derivs_raytypes;
+    group->m_self = group;
     {
         // Record the group in the SS's census of all extant groups
         spin_lock lock (m_all_shader_groups_mutex);
@@ -2393,7 +2931,8 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname)
         group->add_symlocs(m_symlocs);
         m_all_shader_groups.push_back (group);
         ++m_groups_to_compile_count;
-        m_curgroup = group;
+        if (make_current)
+            m_curgroup = group;
     }
     return group;
 }
@@ -2463,11 +3002,123 @@ ShadingSystemImpl::ShaderGroupEnd (ShaderGroup& group)
     }
 
     group.m_complete = true;
+    dedup_group (group);
     return true;
 }
 
 
 
+void
+ShadingSystemImpl::dedup_group (ShaderGroup &group)
+{
+    lock_guard lock (m_group_bodies_mutex);
+    group.m_dedup_dirty = 0;
+    if (group.m_dedup_sharing) {
+        group.m_dedup_sharing = 0;
+        std::atomic_store (&group.m_shared_body, ShaderGroupRef());
+        --m_stat_groups_deduplicated;
+    }
+
+    // Only a complete group that hasn't yet compiled code of its own can
+    // share, and then only if its code depends on nothing but its spec.
+    // (Once optimized, a group's lockgeom=0 params are read live by its
+    // code, so an edit to one of them takes it out of the running.)
+    uint64_t hash = 0;
+    if (m_dedup_groups && group.m_complete && ! group.m_clone
+          && group.nlayers() && ! group.optimized() && ! group.interactive()
+          && group.m_aot_object.empty() && ! group.m_aot_compile
+          && ! renderer()->supports ("OptiX")) {
+        // Everything that goes into the code: masters, instance values
+        // and connections (the serialized form), plus what the group
+        // knows about its outputs, entry points, ray types (including
+        // those that run without derivatives) and where its symbols live.
+        std::string spec = group.serialize ();
+        spec += Strutil::sprintf ("usage %s\nrepeat %d\nraytypes %d %d\nnoderivs %d\n",
+                                  group.m_group_use, group.m_exec_repeat,
+                                  group.raytypes_on(), group.raytypes_off(),
+                                  group.no_derivs_raytypes());
+        for (auto&& o : group.m_renderer_outputs)
+            spec += Strutil::sprintf ("output %s\n", o);
+        for (int i = 0, e = group.nlayers();  i < e;  ++i)
+            if (group[i]->entry_layer())
+                spec += Strutil::sprintf ("entry %s\n", group[i]->layername());
+        for (auto&& sl : group.m_symlocs)
+            spec += Strutil::sprintf ("symloc %s %s %d %d %d %d\n", sl.name,
+                                      sl.type, (int)sl.derivs, (int)sl.arena,
+                                      (long long)sl.offset, (long long)sl.stride);
+        hash = std::max (uint64_t(Strutil::strhash (spec)), uint64_t(1));
+    }
+    group.m_dedup_hash = hash;
+    if (! hash)
+        return;
+
+    std::weak_ptr<ShaderGroup> &known (m_group_bodies[hash]);
+    ShaderGroupRef body = known.lock ();
+    if (body && body.get() != &group && (uint64_t)body->m_dedup_hash == hash
+          && ! body->m_dedup_dirty && ! body->m_dedup_sharing) {
+        std::atomic_store (&group.m_shared_body, body);
+        group.m_dedup_sharing = 1;
+        ++m_stat_groups_deduplicated;
+    } else {
+        // First of its kind (or the previous one has changed or gone
+        // away): this group compiles the code that later twins share.
+        known = group.m_self;
+    }
+}
+
+
+
+ShaderGroupRef
+ShadingSystemImpl::shared_body (ShaderGroup &group)
+{
+    if (group.m_dedup_dirty)
+        dedup_group (group);
+    if (! group.m_dedup_sharing)
+        return ShaderGroupRef();
+    ShaderGroupRef body = std::atomic_load (&group.m_shared_body);
+    if (body && (body->m_dedup_dirty || body->m_dedup_hash != group.m_dedup_hash)) {
+        // The group we matched has since been edited; pair up afresh.
+        dedup_group (group);
+        body = std::atomic_load (&group.m_shared_body);
+    }
+    // And if it has since found a twin of its own, run that one's code.
+    if (body && body->maybe_shared())
+        if (ShaderGroupRef further = shared_body (*body))
+            body = further;
+    return body;
+}
+
+
+
+ShaderGroupRef
+ShadingSystemImpl::no_derivs_variant (ShaderGroup &group)
+{
+    ShaderGroupRef v = group.no_derivs_variant ();
+    if (v || ! group.m_no_derivs_raytypes || group.interactive()
+          || group.m_no_derivs_failed)
+        return v;
+
+    // Built from the group's current spec, so a later edit (which drops
+    // it, see ShaderGroup::spec_edited) gets a fresh one next time.
+    v = clone_group (group);
+    if (! v) {
+        // Don't keep trying. (Executing threads read the group's raytype
+        // setting concurrently, so that is left alone.)
+        group.m_no_derivs_failed = true;
+        return v;
+    }
+    v->m_no_derivs = true;
+    v->m_no_derivs_raytypes = 0;
+    // If another thread beat us to it, run theirs.
+    ShaderGroupRef theirs;
+    if (! std::atomic_compare_exchange_strong (&group.m_no_derivs_variant,
+                                               &theirs, v))
+        return theirs;
+    return v;
+}
+
+
+
 bool
 ShadingSystemImpl::Shader (string_view shaderusage,
                            string_view shadername,
@@ -2518,7 +3169,8 @@ ShadingSystemImpl::Shader (ShaderGroup& group, string_view shaderusage,
     if (group.m_group_use.empty()) {
         // First in a group
         group.clear ();
-        m_stat_groups += 1;
+        if (! group.m_clone)
+            m_stat_groups += 1;
         group.m_group_use = shaderusage;
     } else if (shaderusage != group.m_group_use) {
         errorfmt("Shader usage \"{}\" does not match current group ({})\n"
@@ -2528,7 +3180,8 @@ ShadingSystemImpl::Shader (ShaderGroup& group, string_view shaderusage,
     }
 
     group.append (instance);
-    m_stat_groupinstances += 1;
+    if (! group.m_clone)
+        m_stat_groupinstances += 1;
 
     // FIXME -- check for duplicate layer name within the group?
 
@@ -2664,6 +3317,18 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
                                      string_view groupspec)
 {
     ShaderGroupRef g = ShaderGroupBegin (groupname);
+    if (! parse_group_spec (*g, usage, groupspec))
+        return ShaderGroupRef();
+    return g;
+}
+
+
+
+bool
+ShadingSystemImpl::parse_group_spec (ShaderGroup& group, string_view usage,
+                                     string_view groupspec)
+{
+    ShaderGroup* g = &group;
     bool err = false;
     std::string errdesc;
     string_view errstatement;
@@ -2932,10 +3597,10 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
         error(msg);
         if (debug())
             infofmt("Broken group was:\n---{}\n---\n", groupspec);
-        return ShaderGroupRef();
+        return false;
     }
 
-    return g;
+    return true;
 }
 
 
@@ -2980,11 +3645,282 @@ ShadingSystemImpl::ReParameter (ShaderGroup &group, string_view layername_,
 
     // Do the deed
     memcpy (sym->data(), val, type.size());
+    group.spec_edited ();
+    if (sym->interactive())
+        group.interactive_edited ();
+    else if (group.optimized()
+             && group.llvm_tier() != ShaderGroup::LLVMTierNone)
+        group.tier_edited ();
+    return true;
+}
+
+
+
+ShaderGroupRef
+ShadingSystemImpl::clone_group (const ShaderGroup& group)
+{
+    // Build the clone without disturbing m_curgroup, which may be in use
+    // by whoever is declaring groups concurrently.
+    ShaderGroupRef g = new_clone_group (group.name());
+    if (! parse_group_spec (*g, group.m_group_use, group.serialize()))
+        return ShaderGroupRef();
+    g->m_renderer_outputs = group.m_renderer_outputs;
+    g->m_exec_repeat = group.m_exec_repeat;
+    g->set_raytypes (group.raytypes_on(), group.raytypes_off());
+    g->add_symlocs (group.m_symlocs);
+    if (group.num_entry_layers()) {
+        for (int i = 0, e = group.nlayers();  i < e;  ++i)
+            if (group[i]->entry_layer())
+                g->mark_entry_layer (group[i]->layername());
+    }
+    if (! ShaderGroupEnd (*g))
+        return ShaderGroupRef();
+    return g;
+}
+
+
+
+bool
+ShadingSystemImpl::respecialize (ShaderGroup *group, ShadingContext *ctx,
+                                 float settle_time)
+{
+    if (! group || ! group->interactive() || ! group->optimized())
+        return false;
+    if (group->specialized())
+        return true;    // already up to date with the latest edits
+    if (group->seconds_since_edit() < settle_time)
+        return false;   // still being edited, don't chase a moving target
+
+    // Snapshot the current parameter values. The serialized form leaves
+    // out the lockgeom=0 of the interactive params, so the clone sees them
+    // as ordinary constants and folds them like any other instance value.
+    int epoch = group->edit_epoch ();
+    ShaderGroupRef g = clone_group (*group);
+    if (! g)
+        return false;
+    g->llvm_tier (ShaderGroup::LLVMTierPromoted);   // never quick-compiled
+
+    bool own_ctx = (ctx == nullptr);
+    PerThreadInfo *threadinfo = nullptr;
+    if (own_ctx) {
+        threadinfo = create_thread_info ();
+        ctx = get_context (threadinfo);
+    }
+    optimize_group (*g, ctx, true /*jit*/);
+    if (own_ctx) {
+        release_context (ctx);
+        destroy_thread_info (threadinfo);
+    }
+
+    // If somebody edited a param while we were busy, this clone is already
+    // stale; discard it and let the next call try again.
+    // (Check again after installing it, in case an edit slipped in
+    // between the test and the store.)
+    if (group->edit_epoch() != epoch)
+        return false;
+    group->specialized (g);
+    if (group->edit_epoch() != epoch) {
+        group->specialized (ShaderGroupRef());
+        return false;
+    }
+    return true;
+}
+
+
+
+int
+ShadingSystemImpl::recompile_hot_groups (ShadingContext *ctx)
+{
+    if (m_llvm_tier_threshold <= 0)
+        return 0;
+
+    // Find the quick-compiled groups that have run often enough to be
+    // worth the full optimization. Only the census is locked, and only
+    // while we copy the references.
+    std::vector<ShaderGroupRef> hot;
+    {
+        spin_lock lock (m_all_shader_groups_mutex);
+        for (auto&& grp : m_all_shader_groups)
+            if (ShaderGroupRef g = grp.lock())
+                if (g->llvm_tier() == ShaderGroup::LLVMTierQuick
+                      && g->executions() >= m_llvm_tier_threshold)
+                    hot.push_back (g);
+    }
+    if (hot.empty())
+        return 0;
+
+    bool own_ctx = (ctx == nullptr);
+    PerThreadInfo *threadinfo = nullptr;
+    if (own_ctx) {
+        threadinfo = create_thread_info ();
+        ctx = get_context (threadinfo);
+    }
+    int promoted = 0;
+    for (auto&& group : hot) {
+        // Claim the group, so that a concurrent caller won't compile it
+        // too. A group whose clone fails stays claimed; it just keeps
+        // running its quick code.
+        int quick = ShaderGroup::LLVMTierQuick;
+        if (! group->m_llvm_tier.compare_exchange_strong (quick,
+                                       ShaderGroup::LLVMTierPromoted))
+            continue;
+
+        // Same dance as respecialize(): compile a fully optimized clone
+        // off to the side, then install it, unless a param edit made it
+        // stale in the meantime.
+        int epoch = group->edit_epoch ();
+        ShaderGroupRef g = clone_group (*group);
+        if (! g)
+            continue;
+        g->llvm_tier (ShaderGroup::LLVMTierPromoted);
+        optimize_group (*g, ctx, true /*jit*/);
+        if (group->edit_epoch() != epoch)
+            continue;
+        group->specialized (g);
+        if (group->edit_epoch() != epoch) {
+            group->specialized (ShaderGroupRef());
+            continue;
+        }
+        ++promoted;
+    }
+    if (own_ctx) {
+        release_context (ctx);
+        destroy_thread_info (threadinfo);
+    }
+    m_stat_groups_recompiled += promoted;
+    return promoted;
+}
+
+
+
+bool
+ShadingSystemImpl::aot_compile (ShaderGroup *group, std::string &object,
+                                std::string &manifest, ShadingContext *ctx)
+{
+    if (! group)
+        return false;
+    if (renderer()->supports ("OptiX")) {
+        errorfmt("Group \"{}\": ahead-of-time compilation is not supported for OptiX",
+                 group->name());
+        return false;
+    }
+
+    // Compile a clone, so that group itself is left as it was, free to be
+    // optimized and JITed (or loaded) as usual.
+    ShaderGroupRef g = clone_group (*group);
+    if (! g)
+        return false;
+    g->m_interactive_params = group->m_interactive_params;
+    g->m_aot_compile = true;
+    optimize_group (*g, ctx, true /*jit*/);
+    if (g->does_nothing()) {
+        errorfmt("Group \"{}\" does nothing; there is no code to compile ahead of time",
+                 group->name());
+        return false;
+    }
+    if (g->m_aot_object.empty())
+        return false;   // the backend already said why
+    object = std::move (g->m_aot_object);
+    manifest = std::move (g->m_aot_manifest);
     return true;
 }
 
 
 
+bool
+ShadingSystemImpl::aot_load (ShaderGroup *group, string_view object,
+                             string_view manifest)
+{
+    if (! group)
+        return false;
+    if (group->optimized()) {
+        errorfmt("Group \"{}\": ahead-of-time code must be loaded before the group is optimized",
+                 group->name());
+        return false;
+    }
+
+    // Check everything that can be checked before optimization. (The
+    // backend verifies the rest when it comes to bind the code.)
+    auto lines = aot_manifest_parse (manifest);
+    std::string version, target, hash;
+    for (auto&& line : lines) {
+        if (line.size() < 2)
+            continue;
+        if (line[0] == "osl_version")
+            version = line[1];
+        else if (line[0] == "target")
+            target = line[1];
+        else if (line[0] == "spec_hash")
+            hash = line[1];
+    }
+    const char *why = nullptr;
+    if (lines.empty() || lines[0].size() < 2 || lines[0][0] != "osl_aot_manifest"
+          || lines[0][1] != "1")
+        why = "not an aot manifest";
+    else if (version != OSL_LIBRARY_VERSION_STRING)
+        why = "compiled by a different OSL version";
+    else if (! LLVM_Util::supports_isa (LLVM_Util::lookup_isa_by_name (target)))
+        why = "compiled for an instruction set this machine lacks";
+    else if (hash != Strutil::sprintf ("%016x", aot_spec_hash (*group)))
+        why = "compiled from a different group specification";
+    if (why) {
+        errorfmt("Group \"{}\": can't use ahead-of-time code: {}",
+                 group->name(), why);
+        return false;
+    }
+    group->m_aot_object = object;
+    group->m_aot_manifest = manifest;
+    group->spec_edited ();   // it brings its own code; don't share
+    return true;
+}
+
+
+
+uint64_t
+aot_spec_hash (const ShaderGroup &group)
+{
+    std::string s = group.serialize ();
+    for (auto&& p : group.m_interactive_params)
+        s += Strutil::sprintf ("interactive %s\n", p);
+    for (auto&& o : group.m_renderer_outputs)
+        s += Strutil::sprintf ("output %s\n", o);
+    return Strutil::strhash (s);
+}
+
+
+
+std::string
+aot_manifest_line (const std::vector<std::string> &fields)
+{
+    std::string line;
+    for (auto&& f : fields) {
+        if (line.size())
+            line += '\t';
+        line += Strutil::escape_chars (f);
+    }
+    line += '\n';
+    return line;
+}
+
+
+
+std::vector<std::vector<std::string>>
+aot_manifest_parse (string_view manifest)
+{
+    std::vector<std::vector<std::string>> lines;
+    for (auto&& line : Strutil::splits (manifest, "\n")) {
+        if (line.empty())
+            continue;
+        std::vector<std::string> fields;
+        for (auto&& f : Strutil::splits (line, "\t"))
+            fields.push_back (Strutil::unescape_chars (f));
+        lines.push_back (std::move (fields));
+    }
+    return lines;
+}
+
+
+
 PerThreadInfo *
 ShadingSystemImpl::create_thread_info()
 {
@@ -3029,7 +3965,82 @@ ShadingSystemImpl::release_context (ShadingContext *ctx)
     if (! ctx)
         return;
     ctx->process_errors ();
-    ctx->thread_info()->context_pool.push (ctx);
+    ctx->bind_userdata (nullptr, nullptr);
+    ctx->batched_bind_userdata (nullptr, nullptr);
+    if (! ctx->shared()) {
+        ctx->thread_info()->context_pool.push (ctx);
+        return;
+    }
+
+    // Shared context: the PerThreadInfo it was borrowed with may go away,
+    // so forget it, then put the context in the first free slot, starting
+    // with this thread's home slot so it's likely to get it back.
+    ctx->thread_info (nullptr);
+    ctx->texture_thread_info (nullptr);
+    int nslots = m_nshared_context_slots;
+    int home = shared_context_home_slot (nslots);
+    for (int i = 0;  i < nslots;  ++i) {
+        std::atomic<ShadingContext*> &slot (m_shared_contexts[(home+i) % nslots]);
+        ShadingContext *empty = nullptr;
+        if (! slot.load (std::memory_order_relaxed) &&
+            slot.compare_exchange_strong (empty, ctx, std::memory_order_release))
+            return;
+    }
+    // The pool is full, don't let it grow without bound.
+    delete ctx;
+}
+
+
+
+ShadingContext *
+ShadingSystemImpl::get_shared_context (PerThreadInfo *threadinfo,
+                                       TextureSystem::Perthread *texture_threadinfo)
+{
+    if (! threadinfo) {
+        error ("ShadingSystem::get_shared_context called without a PerThreadInfo");
+        return nullptr;
+    }
+    std::call_once (m_shared_contexts_init, [&](){
+        int n = m_max_shared_contexts;
+        if (n <= 0)
+            n = 2 * std::max (1, (int)std::thread::hardware_concurrency());
+        m_shared_contexts.reset (new std::atomic<ShadingContext*>[n]);
+        for (int i = 0;  i < n;  ++i)
+            m_shared_contexts[i].store (nullptr, std::memory_order_relaxed);
+        m_nshared_context_slots = n;
+    });
+
+    // Take the first idle context found, starting at this thread's home
+    // slot.  Slots are only ever exchanged whole, so there's no ABA hazard.
+    ShadingContext *ctx = nullptr;
+    int nslots = m_nshared_context_slots;
+    int home = shared_context_home_slot (nslots);
+    for (int i = 0;  i < nslots && !ctx;  ++i) {
+        std::atomic<ShadingContext*> &slot (m_shared_contexts[(home+i) % nslots]);
+        if (slot.load (std::memory_order_relaxed))
+            ctx = slot.exchange (nullptr, std::memory_order_acquire);
+    }
+    if (! ctx) {
+        ctx = new ShadingContext (*this, threadinfo);
+        ctx->shared (true);
+    }
+    ctx->thread_info (threadinfo);
+    ctx->texture_thread_info (texture_threadinfo);
+    return ctx;
+}
+
+
+
+// Each thread prefers one slot of the shared context pool, so that a
+// thread that keeps releasing and reacquiring contexts tends to get back
+// the one it had, with its memory still warm in that core's cache.
+int
+ShadingSystemImpl::shared_context_home_slot (int nslots)
+{
+    static thread_local int home = -1;
+    if (home < 0)
+        home = int (std::hash<std::thread::id>()(std::this_thread::get_id()) & 0x7fffffff);
+    return nslots ? home % nslots : 0;
 }
 
 
@@ -3228,17 +4239,11 @@ ShadingSystemImpl::group_post_jit_cleanup (ShaderGroup &group)
     size_t connectionmem = 0;
     for (int layer = 0;  layer < group.nlayers();  ++layer) {
         ShaderInstance *inst = group[layer];
-        // We no longer needs ops and args -- create empty vectors and
-        // swap with the ones in the instance.
-        OpcodeVec emptyops;
-        inst->ops().swap (emptyops);
-        std::vector<int> emptyargs;
-        inst->args().swap (emptyargs);
+        // We no longer needs ops and args
+        inst->release_code ();
         if (inst->unused()) {
             // If we'll never use the layer, we don't need the syms at all
-            SymbolVec nosyms;
-            std::swap (inst->symbols(), nosyms);
-            symmem += vectorbytes(nosyms);
+            symmem += inst->release_symbols ();
             // also don't need the connection info any more
             connectionmem += (off_t) inst->clear_connections ();
         }
@@ -3258,6 +4263,15 @@ ShadingSystemImpl::group_post_jit_cleanup (ShaderGroup &group)
 void
 ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool do_jit)
 {
+    // A group that shares the code of an identical one is optimized and
+    // compiled only by way of that one.
+    if (group.maybe_shared()) {
+        if (ShaderGroupRef body = shared_body (group)) {
+            optimize_group (*body, ctx, do_jit);
+            return;
+        }
+    }
+
     if (ctx) {
         // Always have ShadingContext remember the group we just optimized
         // to allow calls to find_symbol and get_symbol to be valid after
@@ -3317,6 +4331,10 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
         group.m_unknown_closures_needed = rop.m_unknown_closures_needed;
         for (auto&& f : rop.m_closures_needed)
             group.m_closures_needed.push_back (f);
+        group.m_closure_bytes_hint = rop.m_closure_bytes_hint;
+        group.m_message_bytes_hint = rop.m_message_bytes_hint;
+        group.m_message_names.assign (rop.m_message_names.begin(),
+                                      rop.m_message_names.end());
         for (auto&& f : rop.m_globals_needed)
             group.m_globals_needed.push_back (f);
         group.m_globals_read = rop.m_globals_read;
@@ -3353,6 +4371,14 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
     }
 
     if (need_jit) {
+        // With tiered compilation, the first JIT of a group is a quick
+        // one; recompile_hot_groups() redoes the ones that turn out to
+        // matter.
+        if (m_llvm_tier_threshold > 0
+              && group.llvm_tier() == ShaderGroup::LLVMTierNone
+              && ! group.interactive() && ! group.m_aot_compile
+              && ! renderer()->supports ("OptiX"))
+            group.llvm_tier (ShaderGroup::LLVMTierQuick);
         BackendLLVM lljitter (*this, group, ctx);
         lljitter.run ();
 
@@ -3387,9 +4413,11 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
         destroy_thread_info(thread_info);
     }
 
-    m_stat_groups_compiled += 1;
-    m_stat_instances_compiled += group.nlayers();
-    m_groups_to_compile_count -= 1;
+    if (! group.m_clone) {
+        m_stat_groups_compiled += 1;
+        m_stat_instances_compiled += group.nlayers();
+        m_groups_to_compile_count -= 1;
+    }
 }
 
 #if OSL_USE_BATCHED
@@ -3462,9 +4490,11 @@ ShadingSystemImpl::Batched<WidthT>::jit_group (ShaderGroup &group, ShadingContex
                                           lljitter.m_llvm_local_mem);
 
     // TODO: not sure how to count these given batched vs. not
-    m_ssi.m_stat_groups_compiled += 1;
-    m_ssi.m_stat_instances_compiled += group.nlayers();
-    m_ssi.m_groups_to_compile_count -= 1;
+    if (! group.m_clone) {
+        m_ssi.m_stat_groups_compiled += 1;
+        m_ssi.m_stat_instances_compiled += group.nlayers();
+        m_ssi.m_groups_to_compile_count -= 1;
+    }
 }
 #endif
 
@@ -3610,6 +4640,9 @@ ShadingSystemImpl::merge_instances (ShaderGroup &group, bool post_opt)
 
     if (! m_opt_merge_instances || optimize() < 1)
         return 0;
+    // Edits address each layer by name, so never share interactive ones.
+    if (group.interactive())
+        return 0;
 
     OIIO::Timer timer;          // Time we spend looking for and doing merges
     int merges = 0;             // number of merges we do
@@ -3656,17 +4689,21 @@ ShadingSystemImpl::merge_instances (ShaderGroup &group, bool post_opt)
                     if (con.srclayer == b) {
                         con.srclayer = a;
                         A->outgoing_connections (true);
-                        if (A->symbols().size() && B->symbols().size()) {
-                            OSL_DASSERT (A->symbol(con.src.param)->name() ==
-                                         B->symbol(con.src.param)->name());
+                        const ShaderInstance *cA = A, *cB = B;
+                        if (cA->symbols().size() && cB->symbols().size()) {
+                            OSL_DASSERT (cA->symbol(con.src.param)->name() ==
+                                         cB->symbol(con.src.param)->name());
                         }
                     }
                 }
             }
 
             // Mark parameters of B as no longer connected
+            // (looking first, so B doesn't copy its master's symbols
+            // just to clear flags that are already clear)
+            const ShaderInstance *cB = B;
             for (int p = B->firstparam();  p < B->lastparam();  ++p) {
-                if (B->symbols().size())
+                if (cB->symbols().size() && cB->symbol(p)->connected_down())
                     B->symbol(p)->connected_down(false);
                 if (B->m_instoverrides.size())
                     B->instoverride(p)->connected_down(false);
@@ -4211,24 +5248,57 @@ OSL_SHADEOP int osl_get_attribute(void *sg_,
 
 
 
+// Copy userdata of the given type from its bound location within a
+// renderer's record into dst, clearing any derivs the record lacks.
+// Return false if the binding says the object doesn't have it.
+static bool
+copy_bound_userdata (const UserDataBinding &binding, const void *record,
+                     TypeDesc type, bool derivs, void *dst)
+{
+    if (binding.offset < 0 || ! record)
+        return false;
+    size_t size = type.size();
+    const char *src = (const char *)record + binding.offset;
+    if (derivs && binding.derivs) {
+        memcpy (dst, src, 3*size);
+    } else {
+        memcpy (dst, src, size);
+        if (derivs)
+            memset ((char *)dst + size, 0, 2*size);
+    }
+    return true;
+}
+
+
+
 OSL_SHADEOP int
 osl_bind_interpolated_param (void *sg_, const void *name, long long type,
                              int userdata_has_derivs, void *userdata_data,
                              int /*symbol_has_derivs*/, void *symbol_data,
                              int symbol_data_size,
-                             char *userdata_initialized, int /*userdata_index*/)
+                             char *userdata_initialized, int userdata_index)
 {
     char status = *userdata_initialized;
     if (status == 0) {
         // First time retrieving this userdata
         ShaderGlobals *sg = (ShaderGlobals *)sg_;
-        bool ok = sg->renderer->get_userdata (userdata_has_derivs, USTR(name),
-                                              TYPEDESC(type),
-                                              sg, userdata_data);
+        bool ok;
+        if (const UserDataBinding *bindings = sg->context->userdata_bindings()) {
+            // The renderer resolved the group's userdata to record
+            // offsets up front, so just copy it out of the record.
+            ok = copy_bound_userdata (bindings[userdata_index],
+                                      sg->context->userdata_record(),
+                                      TYPEDESC(type), userdata_has_derivs,
+                                      userdata_data);
+        } else {
+            ok = sg->renderer->get_userdata (userdata_has_derivs, USTR(name),
+                                             TYPEDESC(type),
+                                             sg, userdata_data);
+            sg->context->incr_get_userdata_calls ();
+        }
         // printf ("Binding %s %s : index %d, ok = %d\n", name,
         //         TYPEDESC(type).c_str(),userdata_index, ok);
         *userdata_initialized = status = 1 + ok;  // 1 = not found, 2 = found
-        sg->context->incr_get_userdata_calls ();
     }
     if (status == 2) {
         // If userdata was present, copy it to the shader variable
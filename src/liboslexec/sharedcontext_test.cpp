@@ -0,0 +1,106 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <OpenImageIO/thread.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+
+using namespace OSL;
+
+
+
+// A thread that gets back the context it just released should get the
+// same one, with its memory intact.
+static void
+test_reuse (ShadingSystem &ss)
+{
+    PerThreadInfo *ti = ss.create_thread_info();
+    ShadingContext *a = ss.get_shared_context (ti);
+    OIIO_CHECK_ASSERT (a != nullptr);
+    ss.release_context (a);
+    ShadingContext *b = ss.get_shared_context (ti);
+    OIIO_CHECK_EQUAL (a, b);
+
+    // Two held at once must be different contexts.
+    ShadingContext *c = ss.get_shared_context (ti);
+    OIIO_CHECK_ASSERT (c != nullptr && c != b);
+    ss.release_context (c);
+    ss.release_context (b);
+    ss.destroy_thread_info (ti);
+
+    // A context released on one thread may be picked up by another.
+    ShadingContext *d = nullptr;
+    std::thread t ([&](){
+        PerThreadInfo *ti2 = ss.create_thread_info();
+        d = ss.get_shared_context (ti2);
+        ss.release_context (d);
+        ss.destroy_thread_info (ti2);
+    });
+    t.join ();
+    OIIO_CHECK_ASSERT (d == b || d == c);
+}
+
+
+
+// Many threads hammering a small pool: no context may ever be handed to
+// two threads at once.
+static void
+test_threads (ShadingSystem &ss, int nthreads, int iterations)
+{
+    std::mutex in_use_mutex;
+    std::set<ShadingContext*> in_use;
+    std::atomic<int> failures (0);
+
+    OIIO::thread_group threads;
+    for (int t = 0;  t < nthreads;  ++t) {
+        threads.add_thread (new std::thread ([&](){
+            PerThreadInfo *ti = ss.create_thread_info();
+            for (int i = 0;  i < iterations;  ++i) {
+                // Sometimes hold two at once, to run the pool dry.
+                ShadingContext *ctx[2] = { nullptr, nullptr };
+                int n = (i % 3 == 0) ? 2 : 1;
+                for (int c = 0;  c < n;  ++c) {
+                    ctx[c] = ss.get_shared_context (ti);
+                    std::lock_guard<std::mutex> lock (in_use_mutex);
+                    if (! ctx[c] || ! in_use.insert (ctx[c]).second)
+                        ++failures;
+                }
+                for (int c = 0;  c < n;  ++c) {
+                    {
+                        std::lock_guard<std::mutex> lock (in_use_mutex);
+                        in_use.erase (ctx[c]);
+                    }
+                    ss.release_context (ctx[c]);
+                }
+            }
+            ss.destroy_thread_info (ti);
+        }));
+    }
+    threads.join_all ();
+    OIIO_CHECK_EQUAL (failures.load(), 0);
+    OIIO_CHECK_ASSERT (in_use.empty());
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+    RendererServices rend;
+    ShadingSystem ss (&rend);
+    ss.attribute ("max_shared_contexts", 4);
+
+    test_reuse (ss);
+    test_threads (ss, 16, 2000);
+
+    return unit_test_failures;
+}
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <vector>
+
 OSL_NAMESPACE_ENTER
 
 namespace pvt {
@@ -273,6 +275,190 @@ struct SplineInterp {
 };
 
 
+
+// ========================================================
+//
+// Precomputed tables for splines with constant knots
+//
+// When the basis and the knots of a spline are known at the time the
+// shader group is compiled, the code generator applies the basis matrix
+// to each segment's knots once and hands the "_table" shadeops the
+// resulting per-segment cubic coefficients, so each call only evaluates
+// the polynomial.  A table is a flat array of floats:
+//
+//   nsegs*4 coefficients, each of 1 float (float knots) or 3 (triples),
+//           tk[0..3] of the first segment, then of the second, etc.
+//
+// and, for float knots whose curve is strictly monotone, the data used
+// by inverse_table():
+//
+//   low knot, high knot, knots increasing (1) or not (0),
+//   kInverseSamples*nsegs+1 samples of the curve at evenly spaced x.
+//
+// ========================================================
+
+enum { kInverseSamples = 16 };  // inverse table samples per segment
+
+
+template <class RTYPE, class XTYPE, class CTYPE>
+OSL_HOSTDEVICE void
+evaluate_table (RTYPE &result, const XTYPE &xval, const CTYPE *coeffs,
+                int nsegs)
+{
+    using OIIO::clamp;
+    XTYPE x = clamp(xval, XTYPE(0.0), XTYPE(1.0));
+    x = x*(float)nsegs;
+    float seg_x = removeDerivatives(x);
+    int segnum = clamp((int)seg_x, 0, nsegs-1);
+
+    // x is the position along segment 'segnum'
+    x = x - float(segnum);
+    const CTYPE *tk = coeffs + 4*segnum;
+
+    RTYPE tresult;
+    tresult = (tk[0]   * x + tk[1]);
+    tresult = (tresult * x + tk[2]);
+    tresult = (tresult * x + tk[3]);
+    assignment(result, tresult);
+}
+
+
+OSL_HOSTDEVICE inline void
+inverse_result (float &x, float xval, float /*y*/, float /*slope*/)
+{
+    x = xval;
+}
+
+OSL_HOSTDEVICE inline void
+inverse_result (Dual2<float> &x, float xval, const Dual2<float> &y,
+                float slope)
+{
+    // dx/dy of the inverse is the reciprocal of the curve's slope
+    float invslope = (slope != 0.0f) ? 1.0f / slope : 0.0f;
+    x = Dual2<float> (xval, y.dx() * invslope, y.dy() * invslope);
+}
+
+
+// Table driven version of SplineInterp::inverse: find the sample
+// interval holding y, interpolate within it, then take one Newton step
+// on the cubic.  Results for out-of-range y match SplineInterp::inverse.
+template <class YTYPE>
+OSL_HOSTDEVICE void
+inverse_table (YTYPE &x, const YTYPE &y, const float *table, int nsegs)
+{
+    using OIIO::clamp;
+    const float *inv = table + 4*nsegs;
+    float yval = removeDerivatives(y);
+    float lowknot = inv[0], highknot = inv[1];
+    bool increasing = (inv[2] != 0.0f);
+    if (increasing ? (yval <= lowknot) : (yval >= lowknot)) {
+        x = YTYPE(0);
+        return;
+    }
+    if (increasing ? (yval >= highknot) : (yval <= highknot)) {
+        x = YTYPE(1);
+        return;
+    }
+
+    const float *samples = inv + 3;
+    int n = kInverseSamples * nsegs;
+    bool rising = samples[0] < samples[n];
+    float ymin = rising ? samples[0] : samples[n];
+    float ymax = rising ? samples[n] : samples[0];
+    if (yval < ymin || yval > ymax) {
+        // No segment brackets y, so the search in SplineInterp::inverse
+        // ends on the edge of the last segment nearest to y.
+        float v0 = samples[n - kInverseSamples], v1 = samples[n];
+        bool seg_increasing = (v0 < v1);
+        float vmin = seg_increasing ? v0 : v1;
+        float r0 = (1.0f / nsegs) * (nsegs - 1);
+        x = YTYPE(((yval < vmin) == seg_increasing) ? r0 : 1.0f);
+        return;
+    }
+
+    int lo = 0, hi = n;
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if ((samples[mid] <= yval) == rising)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    float h = 1.0f / n;
+    float t = (yval - samples[lo]) / (samples[hi] - samples[lo]);
+    float xval = (lo + t) * h;
+
+    Dual2<float> v;
+    evaluate_table (v, Dual2<float>(xval, 1.0f, 0.0f), table, nsegs);
+    float slope = v.dx();
+    if (slope != 0.0f)
+        xval = clamp(xval - (v.val() - yval) / slope, lo * h, hi * h);
+    inverse_result (x, xval, y, slope);
+}
+
+
+#ifndef __CUDA_ARCH__
+/// Fill in 'table' for the spline with the given basis type and constant
+/// knots (each of 'ncomps' floats, 1 or 3), and return its number of
+/// segments, or 0 if there are too few knots to make a spline.  If
+/// 'with_inverse' is true, also add the inverse data when the knots are
+/// floats and the curve is strictly monotone, and set 'with_inverse' to
+/// whether it was added.
+inline int
+build_table (std::vector<float> &table, int basis_type, const float *knots,
+             int knot_count, int ncomps, bool &with_inverse)
+{
+    const SplineBasis &spline (gBasisSet[basis_type]);
+    if (knot_count < 4) {
+        with_inverse = false;
+        return 0;
+    }
+    int nsegs = ((knot_count - 4) / spline.basis_step) + 1;
+    table.assign (size_t(nsegs) * 4 * ncomps, 0.0f);
+    for (int seg = 0; seg < nsegs; ++seg) {
+        int s = seg * spline.basis_step;
+        for (int c = 0; c < ncomps; ++c) {
+            float *tk = &table[seg*4*ncomps + c];
+            if (basis_type == kConstant) {
+                // Constant over the segment: the value is the only term
+                tk[3*ncomps] = knots[(seg+1)*ncomps + c];
+                continue;
+            }
+            const float *P = knots + s*ncomps + c;
+            for (int k = 0; k < 4; ++k)
+                tk[k*ncomps] = spline.basis[k][0] * P[0] +
+                               spline.basis[k][1] * P[ncomps] +
+                               spline.basis[k][2] * P[2*ncomps] +
+                               spline.basis[k][3] * P[3*ncomps];
+        }
+    }
+
+    if (with_inverse) {
+        with_inverse = false;
+        if (ncomps != 1 || basis_type == kConstant)
+            return nsegs;
+        int n = kInverseSamples * nsegs;
+        std::vector<float> samples (n + 1);
+        for (int i = 0; i <= n; ++i)
+            evaluate_table (samples[i], float(i) / n, table.data(), nsegs);
+        bool rising = samples[0] < samples[n];
+        for (int i = 1; i <= n; ++i)
+            if (rising ? !(samples[i-1] < samples[i])
+                       : !(samples[i-1] > samples[i]))
+                return nsegs;  // not monotone, leave inversion to search
+        int lowindex = spline.basis_step == 1 ? 1 : 0;
+        int highindex = spline.basis_step == 1 ? knot_count-2 : knot_count-1;
+        table.push_back (knots[lowindex]);
+        table.push_back (knots[highindex]);
+        table.push_back (knots[1] < knots[knot_count-2] ? 1.0f : 0.0f);
+        table.insert (table.end(), samples.begin(), samples.end());
+        with_inverse = true;
+    }
+    return nsegs;
+}
+#endif
+
+
 }; // namespace Spline
 }; // namespace pvt
 OSL_NAMESPACE_EXIT
@@ -0,0 +1,143 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+#include <limits>
+
+#include <OSL/oslconfig.h>
+
+#include "oslexec_pvt.h"
+
+#include <OSL/Imathx/Imathx.h>
+#include <OSL/dual_vec.h>
+#include <OSL/oslnoise.h>
+
+#include <OpenImageIO/fmath.h>
+
+using namespace OSL;
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+namespace  // anonymous
+{
+
+// Options reaching here are uniform across the batch (varying ones were
+// binned by the code generator), so the octave loop bounds are the same
+// for every lane and the whole fractal sum vectorizes as one loop.
+template<FractalType Type, typename ResultT, typename... ArgsT>
+static OSL_FORCEINLINE void
+wide_fractal(const NoiseParams* opt, Masked<ResultT> wresult,
+             Wide<const ArgsT>... wargs)
+{
+    FractalNoiseImpl<Type, CGScalar> impl(opt->octaves, opt->lacunarity,
+                                          opt->gain);
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            if (wresult.mask()[lane]) {
+                ResultT result;
+                impl(result, ArgsT(wargs[lane])...);
+                wresult[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+}  // namespace
+
+
+#define __OSL_FRACTAL_NOISE_OPS(opname, TYPE)                                 \
+    OSL_BATCHOP void __OSL_MASKED_OP2(opname, Wdf, Wdf)(                      \
+        char* name, char* r_ptr, char* x_ptr, char* bsg, char* opt,           \
+        char* varying_direction_ptr, unsigned int mask_value)                 \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<float>>(r_ptr, Mask(mask_value)),     \
+                           Wide<const Dual2<float>>(x_ptr));                  \
+    }                                                                         \
+                                                                              \
+    OSL_BATCHOP void __OSL_MASKED_OP3(opname, Wdf, Wdf, Wdf)(                 \
+        char* name, char* r_ptr, char* x_ptr, char* y_ptr, char* bsg,         \
+        char* opt, char* varying_direction_ptr, unsigned int mask_value)      \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<float>>(r_ptr, Mask(mask_value)),     \
+                           Wide<const Dual2<float>>(x_ptr),                   \
+                           Wide<const Dual2<float>>(y_ptr));                  \
+    }                                                                         \
+                                                                              \
+    OSL_BATCHOP void __OSL_MASKED_OP2(opname, Wdf, Wdv)(                      \
+        char* name, char* r_ptr, char* p_ptr, char* bsg, char* opt,           \
+        char* varying_direction_ptr, unsigned int mask_value)                 \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<float>>(r_ptr, Mask(mask_value)),     \
+                           Wide<const Dual2<Vec3>>(p_ptr));                   \
+    }                                                                         \
+                                                                              \
+    OSL_BATCHOP void __OSL_MASKED_OP3(opname, Wdf, Wdv, Wdf)(                 \
+        char* name, char* r_ptr, char* p_ptr, char* t_ptr, char* bsg,         \
+        char* opt, char* varying_direction_ptr, unsigned int mask_value)      \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<float>>(r_ptr, Mask(mask_value)),     \
+                           Wide<const Dual2<Vec3>>(p_ptr),                    \
+                           Wide<const Dual2<float>>(t_ptr));                  \
+    }                                                                         \
+                                                                              \
+    OSL_BATCHOP void __OSL_MASKED_OP2(opname, Wdv, Wdf)(                      \
+        char* name, char* r_ptr, char* x_ptr, char* bsg, char* opt,           \
+        char* varying_direction_ptr, unsigned int mask_value)                 \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<Vec3>>(r_ptr, Mask(mask_value)),      \
+                           Wide<const Dual2<float>>(x_ptr));                  \
+    }                                                                         \
+                                                                              \
+    OSL_BATCHOP void __OSL_MASKED_OP3(opname, Wdv, Wdf, Wdf)(                 \
+        char* name, char* r_ptr, char* x_ptr, char* y_ptr, char* bsg,         \
+        char* opt, char* varying_direction_ptr, unsigned int mask_value)      \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<Vec3>>(r_ptr, Mask(mask_value)),      \
+                           Wide<const Dual2<float>>(x_ptr),                   \
+                           Wide<const Dual2<float>>(y_ptr));                  \
+    }                                                                         \
+                                                                              \
+    OSL_BATCHOP void __OSL_MASKED_OP2(opname, Wdv, Wdv)(                      \
+        char* name, char* r_ptr, char* p_ptr, char* bsg, char* opt,           \
+        char* varying_direction_ptr, unsigned int mask_value)                 \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<Vec3>>(r_ptr, Mask(mask_value)),      \
+                           Wide<const Dual2<Vec3>>(p_ptr));                   \
+    }                                                                         \
+                                                                              \
+    OSL_BATCHOP void __OSL_MASKED_OP3(opname, Wdv, Wdv, Wdf)(                 \
+        char* name, char* r_ptr, char* p_ptr, char* t_ptr, char* bsg,         \
+        char* opt, char* varying_direction_ptr, unsigned int mask_value)      \
+    {                                                                         \
+        wide_fractal<TYPE>(reinterpret_cast<const NoiseParams*>(opt),         \
+                           Masked<Dual2<Vec3>>(r_ptr, Mask(mask_value)),      \
+                           Wide<const Dual2<Vec3>>(p_ptr),                    \
+                           Wide<const Dual2<float>>(t_ptr));                  \
+    }
+
+__OSL_FRACTAL_NOISE_OPS(fbmnoise, FractalType::FBM)
+__OSL_FRACTAL_NOISE_OPS(turbulencenoise, FractalType::Turbulence)
+__OSL_FRACTAL_NOISE_OPS(ridgednoise, FractalType::Ridged)
+
+
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#undef __OSL_FRACTAL_NOISE_OPS
+
+#include "undef_opname_macros.h"
@@ -83,6 +83,21 @@ zero_derivs(Masked<Dual2<float>> wr)
                                          char* x_ptr, char* bsg, char* opt,   \
                                          char* varying_direction_ptr,         \
                                          unsigned int mask_value);            \
+    OSL_BATCHOP void __OSL_MASKED_OP2(fbmnoise, A,                            \
+                                      B)(char* name_ptr, char* r_ptr,         \
+                                         char* x_ptr, char* bsg, char* opt,   \
+                                         char* varying_direction_ptr,         \
+                                         unsigned int mask_value);            \
+    OSL_BATCHOP void __OSL_MASKED_OP2(turbulencenoise, A,                     \
+                                      B)(char* name_ptr, char* r_ptr,         \
+                                         char* x_ptr, char* bsg, char* opt,   \
+                                         char* varying_direction_ptr,         \
+                                         unsigned int mask_value);            \
+    OSL_BATCHOP void __OSL_MASKED_OP2(ridgednoise, A,                         \
+                                      B)(char* name_ptr, char* r_ptr,         \
+                                         char* x_ptr, char* bsg, char* opt,   \
+                                         char* varying_direction_ptr,         \
+                                         unsigned int mask_value);            \
     OSL_BATCHOP void __OSL_MASKED_OP2(noise, A, B)(char* r_ptr, char* x_ptr,  \
                                                    unsigned int mask_value);  \
     OSL_BATCHOP void __OSL_MASKED_OP2(simplexnoise, A,                        \
@@ -132,6 +147,18 @@ zero_derivs(Masked<Dual2<float>> wr)
             __OSL_MASKED_OP2(gabornoise, A, B)                                \
             (name_ptr, r_ptr, x_ptr, bsg, opt, varying_direction_ptr,         \
              mask_value);                                                     \
+        } else if (name == Strings::fbm) {                                    \
+            __OSL_MASKED_OP2(fbmnoise, A, B)                                  \
+            (name_ptr, r_ptr, x_ptr, bsg, opt, varying_direction_ptr,         \
+             mask_value);                                                     \
+        } else if (name == Strings::turbulence) {                             \
+            __OSL_MASKED_OP2(turbulencenoise, A, B)                           \
+            (name_ptr, r_ptr, x_ptr, bsg, opt, varying_direction_ptr,         \
+             mask_value);                                                     \
+        } else if (name == Strings::ridged) {                                 \
+            __OSL_MASKED_OP2(ridgednoise, A, B)                               \
+            (name_ptr, r_ptr, x_ptr, bsg, opt, varying_direction_ptr,         \
+             mask_value);                                                     \
         } else if (name == Strings::null) {                                   \
             __OSL_MASKED_OP2(nullnoise, A, B)(r_ptr, x_ptr, mask_value);      \
         } else if (name == Strings::unull) {                                  \
@@ -158,6 +185,15 @@ __OSL_GENERIC_DISPATCH2(Wdf, Wdf, Wf, Wf, Dual2<float>)
     OSL_BATCHOP void __OSL_MASKED_OP3(gabornoise, A, B, C)(                    \
         char* name_ptr, char* r_ptr, char* x_ptr, char* y_ptr, char* bsg,      \
         char* opt, char* varying_direction_ptr, unsigned int mask_value);      \
+    OSL_BATCHOP void __OSL_MASKED_OP3(fbmnoise, A, B, C)(                      \
+        char* name_ptr, char* r_ptr, char* x_ptr, char* y_ptr, char* bsg,      \
+        char* opt, char* varying_direction_ptr, unsigned int mask_value);      \
+    OSL_BATCHOP void __OSL_MASKED_OP3(turbulencenoise, A, B, C)(               \
+        char* name_ptr, char* r_ptr, char* x_ptr, char* y_ptr, char* bsg,      \
+        char* opt, char* varying_direction_ptr, unsigned int mask_value);      \
+    OSL_BATCHOP void __OSL_MASKED_OP3(ridgednoise, A, B, C)(                   \
+        char* name_ptr, char* r_ptr, char* x_ptr, char* y_ptr, char* bsg,      \
+        char* opt, char* varying_direction_ptr, unsigned int mask_value);      \
     OSL_BATCHOP void __OSL_MASKED_OP3(noise, A, B,                             \
                                       C)(char* r_ptr, char* x_ptr,             \
                                          char* y_ptr,                          \
@@ -218,6 +254,18 @@ __OSL_GENERIC_DISPATCH2(Wdf, Wdf, Wf, Wf, Dual2<float>)
             __OSL_MASKED_OP3(gabornoise, A, B, C)                              \
             (name_ptr, r_ptr, x_ptr, y_ptr, bsg, opt, varying_direction_ptr,   \
              mask_value);                                                      \
+        } else if (name == Strings::fbm) {                                     \
+            __OSL_MASKED_OP3(fbmnoise, A, B, C)                                \
+            (name_ptr, r_ptr, x_ptr, y_ptr, bsg, opt, varying_direction_ptr,   \
+             mask_value);                                                      \
+        } else if (name == Strings::turbulence) {                              \
+            __OSL_MASKED_OP3(turbulencenoise, A, B, C)                         \
+            (name_ptr, r_ptr, x_ptr, y_ptr, bsg, opt, varying_direction_ptr,   \
+             mask_value);                                                      \
+        } else if (name == Strings::ridged) {                                  \
+            __OSL_MASKED_OP3(ridgednoise, A, B, C)                             \
+            (name_ptr, r_ptr, x_ptr, y_ptr, bsg, opt, varying_direction_ptr,   \
+             mask_value);                                                      \
         } else if (name == Strings::null) {                                    \
             __OSL_MASKED_OP3(nullnoise, A, B, C)                               \
             (r_ptr, x_ptr, y_ptr, mask_value);                                 \
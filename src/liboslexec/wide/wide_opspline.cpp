@@ -613,6 +613,70 @@ splineinverse_evaluate_wide(
     impl_by_basis[basis_type](wR,wX,wK, knot_count);
 }
 
+
+// Lane loops for the table driven versions, used when the spline basis
+// and knots were constant at compile time.
+template <typename RAccessorT, typename XAccessorT, typename CoeffT>
+static OSL_NOINLINE
+void spline_table_evaluate_wide(
+    RAccessorT wR,
+    XAccessorT wX,
+    const CoeffT *coeffs,
+    int nsegs)
+{
+    static constexpr int vec_width = RAccessorT::width;
+
+    typedef typename XAccessorT::NonConstValueType X_Type;
+    typedef typename RAccessorT::ValueType R_Type;
+
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(vec_width))
+        for(int lane=0; lane < vec_width; ++lane) {
+            X_Type x = wX[lane];
+
+            if (wR.mask()[lane]) {
+                R_Type result;
+                Spline::evaluate_table(result, x, coeffs, nsegs);
+                wR[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+
+
+template <typename RAccessorT, typename XAccessorT>
+static OSL_NOINLINE
+void splineinverse_table_evaluate_wide(
+    RAccessorT wR,
+    XAccessorT wX,
+    const float *table,
+    int nsegs)
+{
+    static constexpr int vec_width = RAccessorT::width;
+
+    typedef typename XAccessorT::NonConstValueType X_Type;
+    typedef typename RAccessorT::ValueType R_Type;
+
+    OSL_FORCEINLINE_BLOCK
+    {
+#if !OSL_CLANG_VERSION || OSL_INTEL_COMPILER
+        // Clang was unable to vectorize the nested loops
+        OSL_OMP_PRAGMA(omp simd simdlen(vec_width))
+#endif
+        for(int lane=0; lane < vec_width; ++lane) {
+            X_Type x = wX[lane];
+
+            if (wR.mask()[lane]) {
+                R_Type result;
+                Spline::inverse_table(result, x, table, nsegs);
+                wR[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
 } // namespace unnamed
 
 
@@ -1151,6 +1215,73 @@ __OSL_MASKED_OP3(splineinverse,Wdf,f,Wdf)
     assign_all(woutDy, 0.0f);
 }
 
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline_table,Wf,Wf,f)
+(   void *wout_, void *wx_, void *table, int nsegs,
+    unsigned int mask_value)
+{
+    spline_table_evaluate_wide(
+        Masked<float>(wout_, Mask(mask_value)),
+        Wide<const float>(wx_),
+        (const float *)table, nsegs);
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline_table,Wdf,Wdf,f)
+(   void *wout_, void *wx_, void *table, int nsegs,
+    unsigned int mask_value)
+{
+    spline_table_evaluate_wide(
+        Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        Wide<const Dual2<float>>(wx_),
+        (const float *)table, nsegs);
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline_table,Wv,Wf,v)
+(   void *wout_, void *wx_, void *table, int nsegs,
+    unsigned int mask_value)
+{
+    spline_table_evaluate_wide(
+        Masked<Vec3>(wout_, Mask(mask_value)),
+        Wide<const float>(wx_),
+        (const Vec3 *)table, nsegs);
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline_table,Wdv,Wdf,v)
+(   void *wout_, void *wx_, void *table, int nsegs,
+    unsigned int mask_value)
+{
+    spline_table_evaluate_wide(
+        Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        Wide<const Dual2<float>>(wx_),
+        (const Vec3 *)table, nsegs);
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse_table,Wf,Wf,f)
+(   void *wout_, void *wx_, void *table, int nsegs,
+    unsigned int mask_value)
+{
+    splineinverse_table_evaluate_wide(
+        Masked<float>(wout_, Mask(mask_value)),
+        Wide<const float>(wx_),
+        (const float *)table, nsegs);
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse_table,Wdf,Wdf,f)
+(   void *wout_, void *wx_, void *table, int nsegs,
+    unsigned int mask_value)
+{
+    splineinverse_table_evaluate_wide(
+        Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        Wide<const Dual2<float>>(wx_),
+        (const float *)table, nsegs);
+}
+
 } // namespace __OSL_WIDE_PVT
 OSL_NAMESPACE_EXIT
 
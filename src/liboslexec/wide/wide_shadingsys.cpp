@@ -526,6 +526,45 @@ OSL_BATCHOP bool __OSL_OP(get_attribute_uniform)(
 }
 
 
+namespace {  // anonymous
+
+// Fill the wide userdata at wide_data for each lane of `mask` from that
+// lane's renderer record, as located by its binding table.  Lanes whose
+// object doesn't have the userdata are left out of the returned mask.
+Mask
+copy_bound_userdata(const UserDataBinding* const* bindings,
+                    const void* const* records, int userdata_index,
+                    TypeDesc type, bool derivs, void* wide_data, Mask mask)
+{
+    int ncomps   = type.numelements() * type.aggregate;
+    int compsize = int(type.basesize());
+    char* dst    = reinterpret_cast<char*>(wide_data);
+    Mask found(false);
+    mask.foreach([&](ActiveLane lane) -> void {
+        if (!bindings[lane] || !records[lane])
+            return;
+        const UserDataBinding& binding = bindings[lane][userdata_index];
+        if (binding.offset < 0)
+            return;
+        const char* src = reinterpret_cast<const char*>(records[lane])
+                          + binding.offset;
+        int ncopy = (derivs && binding.derivs) ? 3 * ncomps : ncomps;
+        for (int c = 0; c < ncopy; ++c)
+            memcpy(dst + (c * __OSL_WIDTH + lane) * compsize,
+                   src + c * compsize, compsize);
+        if (derivs)
+            for (int c = ncopy; c < 3 * ncomps; ++c)
+                memset(dst + (c * __OSL_WIDTH + lane) * compsize, 0,
+                       compsize);
+        found.set_on(lane);
+    });
+    return found;
+}
+
+}  // namespace
+
+
+
 OSL_BATCHOP int __OSL_OP(bind_interpolated_param)(
     void* bsg_, const void* name, long long type, int userdata_has_derivs,
     void* userdata_data, int symbol_has_derivs, void* symbol_data,
@@ -538,17 +577,28 @@ OSL_BATCHOP int __OSL_OP(bind_interpolated_param)(
     int status = (*userdata_initialized) >> 31;
     if (status == 0) {
         // First time retrieving this userdata
-        auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
-        MaskedData userDest(TYPEDESC(type), userdata_has_derivs,
-                            Mask(mask_value), userdata_data);
-        Mask foundUserData = bsg->uniform.renderer->batched(WidthTag())
-                                 ->get_userdata(USTR(name), bsg, userDest);
+        auto* bsg           = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+        ShadingContext* ctx = bsg->uniform.context;
+        Mask foundUserData;
+        if (auto bindings = ctx->batched_userdata_bindings()) {
+            // The renderer resolved the group's userdata to record
+            // offsets up front, so gather it from each lane's record.
+            foundUserData = copy_bound_userdata(
+                bindings, ctx->batched_userdata_records(), userdata_index,
+                TYPEDESC(type), userdata_has_derivs, userdata_data,
+                Mask(mask_value));
+        } else {
+            MaskedData userDest(TYPEDESC(type), userdata_has_derivs,
+                                Mask(mask_value), userdata_data);
+            foundUserData = bsg->uniform.renderer->batched(WidthTag())
+                                ->get_userdata(USTR(name), bsg, userDest);
+            ctx->incr_get_userdata_calls();
+        }
 
         // printf ("Binding %s %s : index %d, ok = %d\n", name,
         //         TYPEDESC(type).c_str(),userdata_index, foundUserData.value());
 
         *userdata_initialized = (1 << 31) | foundUserData.value();
-        bsg->uniform.context->incr_get_userdata_calls();
     }
     OSL_DASSERT((*userdata_initialized) >> 31 == 1);
     Mask foundUserData(*userdata_initialized & 0x7FFFFFFF);
@@ -563,6 +613,144 @@ OSL_BATCHOP int __OSL_OP(bind_interpolated_param)(
 }
 
 
+namespace {  // anonymous
+
+// Symbol location placement for a batch.  The wide symbol holds each of
+// its flattened components (values first, then derivatives) as a block
+// of __OSL_WIDTH lanes, while the symloc arena holds each point's
+// components contiguously, one point every `stride` bytes.  Lane `l`
+// corresponds to shade index `shadeindex + l`.
+template<typename T>
+OSL_FORCEINLINE void
+symloc_to_wide(char* wide_data, const char* src, long long stride,
+               int ncomps, int nzero, Mask mask)
+{
+    T* dst = reinterpret_cast<T*>(wide_data);
+    for (int c = 0; c < ncomps; ++c, dst += __OSL_WIDTH) {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            if (mask[lane])
+                dst[lane] = *reinterpret_cast<const T*>(
+                    src + lane * stride + c * sizeof(T));
+        }
+    }
+    for (int c = 0; c < nzero; ++c, dst += __OSL_WIDTH) {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            if (mask[lane])
+                dst[lane] = T(0);
+        }
+    }
+}
+
+
+
+template<typename T>
+OSL_FORCEINLINE void
+wide_to_symloc(char* dst, long long stride, const char* wide_data,
+               int ncomps, int nzero, Mask mask)
+{
+    const T* src = reinterpret_cast<const T*>(wide_data);
+    for (int c = 0; c < ncomps; ++c, src += __OSL_WIDTH) {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            if (mask[lane])
+                *reinterpret_cast<T*>(dst + lane * stride + c * sizeof(T))
+                    = src[lane];
+        }
+    }
+    for (int c = ncomps; c < ncomps + nzero; ++c) {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            if (mask[lane])
+                *reinterpret_cast<T*>(dst + lane * stride + c * sizeof(T))
+                    = T(0);
+        }
+    }
+}
+
+}  // namespace
+
+
+
+// Copy a userdata symloc for every active lane of the batch into the wide
+// symbol at wide_data.  `ncomps` components of `compsize` bytes are copied
+// and the following `nzero` components (derivatives the source didn't
+// have) are cleared.  Returns the mask of lanes that were filled, which is
+// empty when no userdata base pointer was supplied so that the caller
+// falls back to the parameter's default or init ops.
+OSL_BATCHOP int __OSL_MASKED_OP(copy_symloc_to_wide)(
+    void* wide_data, void* base_ptr, long long offset, long long stride,
+    int shadeindex, int ncomps, int compsize, int nzero,
+    unsigned int mask_value)
+{
+    if (!base_ptr)
+        return 0;
+    Mask mask(mask_value);
+    char* dst       = reinterpret_cast<char*>(wide_data);
+    const char* src = reinterpret_cast<const char*>(base_ptr) + offset
+                      + stride * shadeindex;
+    if (compsize == 4)
+        symloc_to_wide<uint32_t>(dst, src, stride, ncomps, nzero, mask);
+    else if (compsize == 8)
+        symloc_to_wide<uint64_t>(dst, src, stride, ncomps, nzero, mask);
+    else {
+        mask.foreach([=](ActiveLane lane) -> void {
+            for (int c = 0; c < ncomps; ++c)
+                memcpy(dst + (c * __OSL_WIDTH + lane) * compsize,
+                       src + lane * stride + c * compsize, compsize);
+            for (int c = ncomps; c < ncomps + nzero; ++c)
+                memset(dst + (c * __OSL_WIDTH + lane) * compsize, 0,
+                       compsize);
+        });
+    }
+    return mask_value;
+}
+
+
+
+// Copy the wide symbol at wide_data into an output symloc for every
+// active lane of the batch, clearing `nzero` trailing components when the
+// destination wants derivatives the symbol doesn't have.  Does nothing
+// when no output base pointer was supplied.
+OSL_BATCHOP void __OSL_MASKED_OP(copy_wide_to_symloc)(
+    void* base_ptr, long long offset, long long stride, int shadeindex,
+    void* wide_data, int ncomps, int compsize, int nzero,
+    unsigned int mask_value)
+{
+    if (!base_ptr)
+        return;
+    Mask mask(mask_value);
+    char* dst = reinterpret_cast<char*>(base_ptr) + offset
+                + stride * shadeindex;
+    const char* src = reinterpret_cast<const char*>(wide_data);
+    if (compsize == 4)
+        wide_to_symloc<uint32_t>(dst, stride, src, ncomps, nzero, mask);
+    else if (compsize == 8)
+        wide_to_symloc<uint64_t>(dst, stride, src, ncomps, nzero, mask);
+    else {
+        mask.foreach([=](ActiveLane lane) -> void {
+            for (int c = 0; c < ncomps; ++c)
+                memcpy(dst + lane * stride + c * compsize,
+                       src + (c * __OSL_WIDTH + lane) * compsize, compsize);
+            for (int c = ncomps; c < ncomps + nzero; ++c)
+                memset(dst + lane * stride + c * compsize, 0, compsize);
+        });
+    }
+}
+
+
+
+// Record the outcome of a runtime check for whether all active lanes of
+// a varying lookup held the same arguments.
+OSL_BATCHOP void __OSL_OP(incr_uniform_lanes_checks)(void* bsg_, int fastpath)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    bsg->uniform.context->incr_uniform_lanes_checks(fastpath);
+}
+
+
+
 // Asked if the raytype includes a bit pattern.
 OSL_BATCHOP int __OSL_OP(raytype_bit)(void* bsg_, int bit)
 {
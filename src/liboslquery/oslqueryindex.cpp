@@ -0,0 +1,644 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include <OSL/oslquery.h>
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/strutil.h>
+namespace Filesystem = OIIO::Filesystem;
+using OIIO::string_view;
+
+
+// Index file layout (all integers in native byte order):
+//
+//     IndexHeader
+//     entries, each:   uint64 name hash, int64 mtime, uint64 file size,
+//                      string key, string path, string record
+//     bucket table:    nbuckets uint64 entry offsets, 0 for an empty bucket
+//
+// Strings are a uint32 length followed by that many bytes.  The table is
+// open addressed with linear probing, and nbuckets is a power of two at
+// least twice the number of entries.  A record is the flattened OSLQuery
+// written by OSLQueryIndex::write_record().
+
+OSL_NAMESPACE_ENTER
+
+namespace {
+
+const char index_magic[8]    = { 'O', 'S', 'L', 'Q', 'I', 'D', 'X', 0 };
+const uint32_t index_version = 1;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nentries;
+    uint64_t nbuckets;
+    uint64_t table_offset;
+};
+
+
+
+// FNV-1a, so that the table doesn't depend on which hash the linked OIIO
+// happens to use for strings.
+inline uint64_t
+name_hash(string_view s)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : s) {
+        h ^= uint64_t((unsigned char)c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+
+// The key a shader is filed under: its .oso file name without directory
+// or extension, which is also how OSLQuery::open() names it.
+inline std::string
+index_key(string_view shadername)
+{
+    std::string key = Filesystem::filename(shadername);
+    if (Filesystem::extension(key) == ".oso")
+        key.resize(key.size() - 4);
+    return key;
+}
+
+
+
+class RecordWriter {
+public:
+    explicit RecordWriter(std::string& out) : m_out(out) {}
+
+    template<typename T> void pod(const T& val)
+    {
+        m_out.append((const char*)&val, sizeof(T));
+    }
+    void str(string_view s)
+    {
+        pod(uint32_t(s.size()));
+        m_out.append(s.data(), s.size());
+    }
+    template<typename T> void vec(const std::vector<T>& v)
+    {
+        pod(uint32_t(v.size()));
+        m_out.append((const char*)v.data(), v.size() * sizeof(T));
+    }
+    void strings(const std::vector<ustring>& v)
+    {
+        pod(uint32_t(v.size()));
+        for (auto&& s : v)
+            str(s);
+    }
+
+private:
+    std::string& m_out;
+};
+
+
+
+// Reads back what RecordWriter wrote.  Running off the end of the data
+// just sets a failure flag, so a truncated or corrupt index can't crash
+// the reader.
+class RecordReader {
+public:
+    RecordReader(const char* begin, const char* end) : m_p(begin), m_end(end)
+    {
+    }
+
+    bool ok() const { return m_ok; }
+
+    template<typename T> T pod()
+    {
+        T val {};
+        if (!need(sizeof(T)))
+            return val;
+        memcpy(&val, m_p, sizeof(T));
+        m_p += sizeof(T);
+        return val;
+    }
+    string_view str()
+    {
+        uint32_t n = pod<uint32_t>();
+        if (!need(n))
+            return string_view();
+        string_view s(m_p, n);
+        m_p += n;
+        return s;
+    }
+    template<typename T> void vec(std::vector<T>& v)
+    {
+        uint32_t n = pod<uint32_t>();
+        if (!need(size_t(n) * sizeof(T)))
+            return;
+        v.resize(n);
+        memcpy(v.data(), m_p, n * sizeof(T));
+        m_p += n * sizeof(T);
+    }
+    void strings(std::vector<ustring>& v)
+    {
+        uint32_t n = pod<uint32_t>();
+        for (uint32_t i = 0; i < n && m_ok; ++i)
+            v.emplace_back(str());
+    }
+
+private:
+    bool need(size_t n)
+    {
+        if (m_ok && size_t(m_end - m_p) < n)
+            m_ok = false;
+        return m_ok;
+    }
+
+    const char* m_p;
+    const char* m_end;
+    bool m_ok = true;
+};
+
+
+
+void
+write_param(RecordWriter& w, const OSLQuery::Parameter& p)
+{
+    w.str(p.name);
+    w.pod(uint8_t(p.type.basetype));
+    w.pod(uint8_t(p.type.aggregate));
+    w.pod(uint8_t(p.type.vecsemantics));
+    w.pod(int32_t(p.type.arraylen));
+    w.pod(uint8_t((p.isoutput ? 1 : 0) | (p.validdefault ? 2 : 0)
+                  | (p.varlenarray ? 4 : 0) | (p.isstruct ? 8 : 0)
+                  | (p.isclosure ? 16 : 0)));
+    w.vec(p.idefault);
+    w.vec(p.fdefault);
+    w.strings(p.sdefault);
+    w.strings(p.spacename);
+    w.strings(p.fields);
+    w.str(p.structname);
+    w.pod(uint32_t(p.metadata.size()));
+    for (auto&& m : p.metadata)
+        write_param(w, m);
+}
+
+
+
+void
+read_param(RecordReader& r, OSLQuery::Parameter& p)
+{
+    p.name                = ustring(r.str());
+    p.type.basetype       = r.pod<uint8_t>();
+    p.type.aggregate      = r.pod<uint8_t>();
+    p.type.vecsemantics   = r.pod<uint8_t>();
+    p.type.arraylen       = r.pod<int32_t>();
+    uint8_t flags         = r.pod<uint8_t>();
+    p.isoutput            = flags & 1;
+    p.validdefault        = flags & 2;
+    p.varlenarray         = flags & 4;
+    p.isstruct            = flags & 8;
+    p.isclosure           = flags & 16;
+    r.vec(p.idefault);
+    r.vec(p.fdefault);
+    r.strings(p.sdefault);
+    r.strings(p.spacename);
+    r.strings(p.fields);
+    p.structname   = ustring(r.str());
+    uint32_t nmeta = r.pod<uint32_t>();
+    for (uint32_t i = 0; i < nmeta && r.ok(); ++i) {
+        p.metadata.emplace_back();
+        read_param(r, p.metadata.back());
+    }
+    // Point data at the defaults, as the .oso reader does.
+    if (p.type.basetype == TypeDesc::INT)
+        p.data = p.idefault.data();
+    else if (p.type.basetype == TypeDesc::FLOAT)
+        p.data = p.fdefault.data();
+    else if (p.type.basetype == TypeDesc::STRING)
+        p.data = p.sdefault.data();
+}
+
+
+
+// Do the two paths name the same file (or directory)?  Where we can't
+// tell from the file system, as when one of them is gone, fall back to
+// comparing their absolute paths.
+bool
+same_file(const std::string& a, const std::string& b)
+{
+#ifndef _WIN32
+    struct stat sa, sb;
+    if (stat(a.c_str(), &sa) == 0 && stat(b.c_str(), &sb) == 0)
+        return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#endif
+    return Filesystem::abspath(a) == Filesystem::abspath(b);
+}
+
+
+
+// One entry of an index, as laid out in the file.
+struct IndexEntry {
+    uint64_t hash;
+    int64_t mtime;
+    uint64_t filesize;
+    string_view key, path, record;
+
+    bool read(const char* data, size_t size, uint64_t offset)
+    {
+        if (offset >= size)
+            return false;
+        RecordReader r(data + offset, data + size);
+        hash     = r.pod<uint64_t>();
+        mtime    = r.pod<int64_t>();
+        filesize = r.pod<uint64_t>();
+        key      = r.str();
+        path     = r.str();
+        record   = r.str();
+        return r.ok();
+    }
+
+    // Does the .oso this entry came from still look the same?
+    bool fresh() const
+    {
+        std::string p(path);
+        return Filesystem::exists(p)
+               && int64_t(Filesystem::last_write_time(p)) == mtime
+               && uint64_t(Filesystem::file_size(p)) == filesize;
+    }
+};
+
+}  // namespace
+
+
+
+OSLQueryIndex::OSLQueryIndex() {}
+
+
+
+OSLQueryIndex::~OSLQueryIndex() { close(); }
+
+
+
+bool
+OSLQueryIndex::open(string_view indexfile)
+{
+    close();
+    m_filename = indexfile;
+#ifndef _WIN32
+    int fd = ::open(m_filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE,
+                       fd, 0);
+        if (p != MAP_FAILED) {
+            m_data   = (const char*)p;
+            m_size   = size_t(st.st_size);
+            m_mapped = true;
+        }
+    }
+    if (fd >= 0)
+        ::close(fd);
+#endif
+    if (!m_data) {
+        // No mmap (or it failed): read the whole thing instead.
+        FILE* f = Filesystem::fopen(m_filename, "rb");
+        if (f) {
+            char buf[65536];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+                m_buffer.append(buf, n);
+            fclose(f);
+        }
+        if (!f || m_buffer.empty()) {
+            errorfmt("Could not read shader index \"{}\"", indexfile);
+            m_buffer.clear();
+            return false;
+        }
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+
+    IndexHeader header;
+    bool valid = m_size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, m_data, sizeof(header));
+        valid = !memcmp(header.magic, index_magic, sizeof(index_magic))
+                && header.version == index_version && header.nbuckets
+                && (header.nbuckets & (header.nbuckets - 1)) == 0
+                && header.table_offset <= m_size
+                && header.nbuckets <= (m_size - header.table_offset)
+                                          / sizeof(uint64_t);
+    }
+    if (!valid) {
+        errorfmt("\"{}\" is not a valid shader index", indexfile);
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+
+void
+OSLQueryIndex::close()
+{
+#ifndef _WIN32
+    if (m_mapped)
+        munmap((void*)m_data, m_size);
+#endif
+    m_data   = nullptr;
+    m_size   = 0;
+    m_mapped = false;
+    m_buffer.clear();
+}
+
+
+
+size_t
+OSLQueryIndex::size() const
+{
+    if (!m_data)
+        return 0;
+    IndexHeader header;
+    memcpy(&header, m_data, sizeof(header));
+    return header.nentries;
+}
+
+
+
+// Return the start of the entry filed under key, or nullptr.
+const char*
+OSLQueryIndex::find_entry(string_view key) const
+{
+    if (!m_data)
+        return nullptr;
+    IndexHeader header;
+    memcpy(&header, m_data, sizeof(header));
+    uint64_t hash = name_hash(key);
+    uint64_t mask = header.nbuckets - 1;
+    for (uint64_t i = 0, b = hash & mask; i < header.nbuckets;
+         ++i, b = (b + 1) & mask) {
+        uint64_t offset;
+        memcpy(&offset, m_data + header.table_offset + b * sizeof(uint64_t),
+               sizeof(offset));
+        if (!offset)
+            return nullptr;  // empty bucket ends the probe sequence
+        IndexEntry entry;
+        if (!entry.read(m_data, m_size, offset))
+            return nullptr;
+        if (entry.hash == hash && entry.key == key)
+            return m_data + offset;
+    }
+    return nullptr;
+}
+
+
+
+bool
+OSLQueryIndex::lookup(string_view shadername, OSLQuery& query,
+                      bool check_stale, string_view searchpath) const
+{
+    const char* e = find_entry(index_key(shadername));
+    if (!e)
+        return false;
+    IndexEntry entry;
+    entry.read(m_data, m_size, uint64_t(e - m_data));
+
+    // The key is only the base name, so make sure the record is for the
+    // file that OSLQuery::open() would read.
+    std::string path(entry.path);
+    std::string filename = shadername;
+    if (Filesystem::extension(filename) != ".oso")
+        filename += ".oso";
+    if (!Filesystem::parent_path(filename).empty() || searchpath.empty()) {
+        // open() reads the name as given, from the current directory
+        if (!same_file(path, filename))
+            return false;
+    } else {
+        std::vector<std::string> dirs;
+        Filesystem::searchpath_split(searchpath, dirs);
+        std::string found = Filesystem::searchpath_find(filename, dirs);
+        if (found.size()) {
+            if (!same_file(path, found))
+                return false;
+        } else {
+            std::string dir = Filesystem::parent_path(path);
+            if (dir.empty())
+                dir = ".";
+            bool indir = false;
+            for (auto&& d : dirs)
+                indir |= same_file(dir, d);
+            if (!indir)
+                return false;
+        }
+    }
+
+    if (check_stale && !entry.fresh())
+        return false;
+    if (!read_record(entry.record, query)) {
+        errorfmt("Corrupt record for \"{}\" in shader index \"{}\"",
+                 shadername, m_filename);
+        return false;
+    }
+    return true;
+}
+
+
+
+void
+OSLQueryIndex::write_record(const OSLQuery& query, std::string& out)
+{
+    RecordWriter w(out);
+    w.str(query.m_shadername);
+    w.str(query.m_shadertypename);
+    w.pod(uint32_t(query.m_params.size()));
+    for (auto&& p : query.m_params)
+        write_param(w, p);
+    w.pod(uint32_t(query.m_meta.size()));
+    for (auto&& m : query.m_meta)
+        write_param(w, m);
+}
+
+
+
+bool
+OSLQueryIndex::read_record(string_view record, OSLQuery& query)
+{
+    query.m_params.clear();
+    query.m_meta.clear();
+    RecordReader r(record.data(), record.data() + record.size());
+    query.m_shadername     = ustring(r.str());
+    query.m_shadertypename = ustring(r.str());
+    uint32_t nparams       = r.pod<uint32_t>();
+    for (uint32_t i = 0; i < nparams && r.ok(); ++i) {
+        query.m_params.emplace_back();
+        read_param(r, query.m_params.back());
+    }
+    uint32_t nmeta = r.pod<uint32_t>();
+    for (uint32_t i = 0; i < nmeta && r.ok(); ++i) {
+        query.m_meta.emplace_back();
+        read_param(r, query.m_meta.back());
+    }
+    return r.ok();
+}
+
+
+
+bool
+OSLQueryIndex::build(string_view indexfile,
+                     const std::vector<std::string>& osofiles,
+                     std::string& errormessage, int* nreused)
+{
+    // Records we can copy without parsing come from the existing index,
+    // if there is one.
+    OSLQueryIndex old;
+    if (Filesystem::exists(indexfile))
+        old.open(indexfile);
+    int reused = 0;
+
+    std::string data(sizeof(IndexHeader), '\0');
+    std::vector<std::pair<uint64_t, uint64_t>> entries;  // hash, offset
+    std::unordered_set<std::string> keys;
+
+    // Records hold absolute paths, so that the index can be used (and
+    // its records checked for staleness) from any directory.
+    auto add = [&](const std::string& file, const IndexEntry* oldentry) {
+        std::string path = Filesystem::abspath(file);
+        std::string key  = index_key(path);
+        if (!keys.insert(key).second)
+            return true;  // an earlier file already claimed this name
+        IndexEntry entry;
+        entry.hash     = name_hash(key);
+        entry.mtime    = int64_t(Filesystem::last_write_time(path));
+        entry.filesize = uint64_t(Filesystem::file_size(path));
+        std::string record;
+        if (oldentry && std::string(oldentry->path) == path
+            && oldentry->mtime == entry.mtime
+            && oldentry->filesize == entry.filesize) {
+            record.assign(oldentry->record.data(), oldentry->record.size());
+            ++reused;
+        } else {
+            OSLQuery query;
+            if (!query.open(path)) {
+                errormessage = query.geterror();
+                if (errormessage.empty())
+                    errormessage = OIIO::Strutil::fmt::format(
+                        "Could not read \"{}\"", path);
+                return false;
+            }
+            write_record(query, record);
+        }
+        entries.emplace_back(entry.hash, uint64_t(data.size()));
+        RecordWriter w(data);
+        w.pod(entry.hash);
+        w.pod(entry.mtime);
+        w.pod(entry.filesize);
+        w.str(key);
+        w.str(path);
+        w.str(record);
+        return true;
+    };
+
+    for (auto&& f : osofiles) {
+        std::string path = f;
+        if (Filesystem::extension(path) != ".oso")
+            path += ".oso";
+        if (!Filesystem::exists(path)) {
+            errormessage = OIIO::Strutil::fmt::format(
+                "File \"{}\" could not be found.", f);
+            return false;
+        }
+        IndexEntry oldentry;
+        const char* e = old.find_entry(index_key(path));
+        bool have_old = e
+                        && oldentry.read(old.m_data, old.m_size,
+                                         uint64_t(e - old.m_data));
+        if (!add(path, have_old ? &oldentry : nullptr))
+            return false;
+    }
+
+    // Carry over the shaders of the old index that weren't named this
+    // time, as long as their files are still around.
+    if (old.is_open()) {
+        IndexHeader header;
+        memcpy(&header, old.m_data, sizeof(header));
+        for (uint64_t b = 0; b < header.nbuckets; ++b) {
+            uint64_t offset;
+            memcpy(&offset,
+                   old.m_data + header.table_offset + b * sizeof(uint64_t),
+                   sizeof(offset));
+            IndexEntry oldentry;
+            if (!offset || !oldentry.read(old.m_data, old.m_size, offset)
+                || keys.count(std::string(oldentry.key)))
+                continue;
+            std::string path(oldentry.path);
+            if (Filesystem::exists(path) && !add(path, &oldentry))
+                return false;
+        }
+    }
+
+    // Hash table
+    uint64_t nbuckets = 1;
+    while (nbuckets < 2 * entries.size())
+        nbuckets *= 2;
+    std::vector<uint64_t> table(nbuckets, 0);
+    for (auto&& e : entries) {
+        uint64_t b = e.first & (nbuckets - 1);
+        while (table[b])
+            b = (b + 1) & (nbuckets - 1);
+        table[b] = e.second;
+    }
+    IndexHeader header;
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version      = index_version;
+    header.nentries     = uint32_t(entries.size());
+    header.nbuckets     = nbuckets;
+    header.table_offset = data.size();
+    memcpy(&data[0], &header, sizeof(header));
+    data.append((const char*)table.data(), nbuckets * sizeof(uint64_t));
+
+    // Write it beside the old one and swap it into place, so that anybody
+    // with the old index mapped keeps a consistent view of it.
+    old.close();
+    std::string tmpfile = std::string(indexfile) + ".tmp";
+    FILE* f             = Filesystem::fopen(tmpfile, "wb");
+    bool ok = f && fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (f)
+        ok &= (fclose(f) == 0);
+    std::string err;
+    if (!ok || !Filesystem::rename(tmpfile, indexfile, err)) {
+        Filesystem::remove(tmpfile, err);
+        errormessage = OIIO::Strutil::fmt::format(
+            "Could not write shader index \"{}\"", indexfile);
+        return false;
+    }
+    if (nreused)
+        *nreused = reused;
+    return true;
+}
+
+
+
+bool
+OSLQuery::open(const OSLQueryIndex& index, string_view shadername,
+               string_view searchpath)
+{
+    if (index.lookup(shadername, *this, true, searchpath))
+        return true;
+    m_params.clear();
+    m_meta.clear();
+    return open(shadername, searchpath);
+}
+
+OSL_NAMESPACE_EXIT
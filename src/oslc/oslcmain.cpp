@@ -3,10 +3,13 @@
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <OpenImageIO/filesystem.h>
@@ -25,7 +28,7 @@ usage()
     std::cout
         << "oslc -- Open Shading Language compiler " OSL_LIBRARY_VERSION_STRING
            "\n" OSL_COPYRIGHT_STRING "\n"
-           "Usage:  oslc [options] file\n"
+           "Usage:  oslc [options] file [file...]\n"
            "  Options:\n"
            "\t--help         Print this usage message\n"
            "\t-o filename    Specify output filename\n"
@@ -39,7 +42,11 @@ usage()
            "\t-E             Only preprocess the input and output to stdout\n"
            "\t-Werror        Treat all warnings as errors\n"
            "\t-embed-source  Embed preprocessed source in the oso file\n"
+           "\t-time          Print the time taken by each compiler phase\n"
+           "\t-j N           Compile multiple files using N threads\n"
+           "\t                  (default: number of cores)\n"
            "\t-buffer        (debugging) Force compile from buffer\n"
+           "\t-no-stdosl-cache  (debugging) Preprocess stdosl.h for every file\n"
            "\t-MD, -MMD      Write a depfile containing headers used, to a file\n"
            "\t-M, -MM        Like -MD, but write depfile to stdout\n"
            "\t-MF filename   Specify the name of the depfile to output (for -MD, -MMD)\n"
@@ -110,7 +117,9 @@ main(int argc, const char* argv[])
     std::vector<std::string> args;
     bool quiet               = false;
     bool compile_from_buffer = false;
-    std::string shader_path;
+    bool has_output_name     = false;
+    int nthreads             = 0;
+    std::vector<std::string> shader_paths;
 
     // Parse arguments from command line
     for (int a = 1; a < argc; ++a) {
@@ -132,6 +141,8 @@ main(int argc, const char* argv[])
                    || !strcmp(argv[a], "-Werror")
                    || !strcmp(argv[a], "-embed-source")
                    || !strcmp(argv[a], "--embed-source")
+                   || !strcmp(argv[a], "-time")
+                   || !strcmp(argv[a], "-no-stdosl-cache")
                    || !strcmp(argv[a], "-MD")
                    || !strcmp(argv[a], "--write-dependencies")
                    || !strcmp(argv[a], "-MMD")
@@ -150,6 +161,9 @@ main(int argc, const char* argv[])
             args.emplace_back(argv[a]);
             ++a;
             args.emplace_back(argv[a]);
+            has_output_name = true;
+        } else if (!strcmp(argv[a], "-j") && a < argc - 1) {
+            nthreads = atoi(argv[++a]);
         } else if (argv[a][0] == '-'
                    && (argv[a][1] == 'D' || argv[a][1] == 'U'
                        || argv[a][1] == 'I')) {
@@ -158,47 +172,90 @@ main(int argc, const char* argv[])
             compile_from_buffer = true;
         } else {
             // Shader to compile
-            shader_path = argv[a];
+            shader_paths.emplace_back(argv[a]);
         }
     }
 
-    if (shader_path.empty()) {
+    if (shader_paths.empty()) {
         std::cout << "ERROR: Missing shader path"
                   << "\n\n";
         usage();
         return EXIT_FAILURE;
     }
+    if (shader_paths.size() > 1 && has_output_name) {
+        std::cout << "ERROR: -o may not be used with multiple shaders"
+                  << "\n\n";
+        return EXIT_FAILURE;
+    }
 
-    OSLCompiler compiler(&default_oslc_error_handler);
-    bool ok = true;
-    if (compile_from_buffer) {
-        // Force a compile-from-buffer for debugging purposes
-        std::string sourcecode;
-        ok = OIIO::Filesystem::read_text_file(shader_path, sourcecode);
-        std::string osobuffer;
-        if (ok)
-            ok = compiler.compile_buffer(sourcecode, osobuffer, args, "",
-                                         shader_path);
-        if (ok) {
-            OIIO::ofstream file;
-            OIIO::Filesystem::open(file, compiler.output_filename());
-            if (file)
-                file << osobuffer;
-            ok = file.good();
+    // Each thread gets its own compiler, but they all share the process's
+    // cache of the preprocessed stdosl.h, so only the first one to need it
+    // pays for preprocessing it. A compiler reused for several buffers also
+    // remembers what it compiled from each, so a buffer named twice is only
+    // compiled once.
+    size_t nshaders = shader_paths.size();
+    std::vector<std::string> output_names(nshaders);
+    std::vector<char> succeeded(nshaders, 0);
+    auto compile_one = [&](OSLCompiler& compiler, size_t i) {
+        const std::string& shader_path(shader_paths[i]);
+        bool ok = true;
+        if (compile_from_buffer) {
+            // Force a compile-from-buffer for debugging purposes
+            std::string sourcecode;
+            ok = OIIO::Filesystem::read_text_file(shader_path, sourcecode);
+            std::string osobuffer;
+            if (ok)
+                ok = compiler.compile_buffer(sourcecode, osobuffer, args, "",
+                                             shader_path);
+            if (ok) {
+                OIIO::ofstream file;
+                OIIO::Filesystem::open(file, compiler.output_filename());
+                if (file)
+                    file << osobuffer;
+                ok = file.good();
+            }
+        } else {
+            // Ordinary compile from file
+            ok = compiler.compile(shader_path, args);
         }
+        output_names[i] = compiler.output_filename();
+        succeeded[i]    = ok;
+    };
+
+    if (nthreads <= 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max(1, std::min(nthreads, int(nshaders)));
+    if (nthreads == 1) {
+        OSLCompiler compiler(&default_oslc_error_handler);
+        for (size_t i = 0; i < nshaders; ++i)
+            compile_one(compiler, i);
     } else {
-        // Ordinary compile from file
-        ok = compiler.compile(shader_path, args);
+        std::atomic<size_t> next_shader(0);
+        OIIO::thread_group threads;
+        for (int t = 0; t < nthreads; ++t) {
+            threads.add_thread(new std::thread([&]() {
+                OSLCompiler compiler(&default_oslc_error_handler);
+                for (size_t i = next_shader++; i < nshaders;
+                     i         = next_shader++)
+                    compile_one(compiler, i);
+            }));
+        }
+        threads.join_all();
     }
 
-    if (ok) {
-        if (!quiet)
-            std::cout << "Compiled " << shader_path << " -> "
-                      << compiler.output_filename() << "\n";
-    } else {
-        std::cout << "FAILED " << shader_path << "\n";
-        return EXIT_FAILURE;
+    // Report in command line order, regardless of the order in which the
+    // shaders finished compiling.
+    bool allok = true;
+    for (size_t i = 0; i < nshaders; ++i) {
+        if (succeeded[i]) {
+            if (!quiet)
+                std::cout << "Compiled " << shader_paths[i] << " -> "
+                          << output_names[i] << "\n";
+        } else {
+            std::cout << "FAILED " << shader_paths[i] << "\n";
+            allok = false;
+        }
     }
 
-    return EXIT_SUCCESS;
+    return allok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -27,6 +27,7 @@ SPDX-License-Identifier: BSD-3-Clause
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/filesystem.h>
@@ -43,6 +44,9 @@ static bool verbose  = false;
 static bool help     = false;
 static bool runstats = false;
 static std::string oneparam;
+static std::string indexfile, buildindex;
+static OSLQueryIndex shaderindex;
+static std::vector<std::string> filenames;
 
 
 
@@ -145,7 +149,10 @@ oslinfo(const std::string& name)
 {
     OIIO::Timer t(runstats ? OIIO::Timer::StartNow : OIIO::Timer::DontStartNow);
     OSLQuery g;
-    g.open(name, searchpath);
+    bool fromindex = shaderindex.is_open()
+                     && shaderindex.lookup(name, g, true, searchpath);
+    if (!fromindex)
+        g.open(name, searchpath);
     std::string e = g.geterror();
     if (!e.empty()) {
         std::cout << "ERROR opening shader \"" << name << "\" (" << e << ")\n";
@@ -157,6 +164,8 @@ oslinfo(const std::string& name)
         return;  // don't show anything else, we are just benchmarking
     }
 
+    if (verbose && fromindex)
+        std::cout << "(from index " << indexfile << ")\n";
     if (oneparam.empty()) {
         std::cout << g.shadertype() << " \"" << g.shadername() << "\"\n";
         if (verbose) {
@@ -222,9 +231,8 @@ oslinfo(const std::string& name)
 static int
 input_file(int argc, const char* argv[])
 {
-    for (int i = 0; i < argc; i++) {
-        oslinfo(argv[i]);
-    }
+    for (int i = 0; i < argc; i++)
+        filenames.emplace_back(argv[i]);
     return 0;
 }
 
@@ -254,14 +262,42 @@ main(int argc, char* argv[])
         &help, "", "-v", &verbose, "Verbose", "--runstats", &runstats,
         "Benchmark shader loading time for queries", "-p %s", &searchpath,
         "Set searchpath for shaders", "--param %s", &oneparam,
-        "Output information in just this parameter", NULL);
+        "Output information in just this parameter", "--index %s", &indexfile,
+        "Look up shaders in this index before reading their .oso files",
+        "--build-index %s", &buildindex,
+        "Write (or update) an index of the named shaders instead of listing them",
+        NULL);
 
     if (ap.parse(argc, (const char**)argv) < 0) {
         std::cerr << ap.geterror() << std::endl;
         ap.usage();
+        return EXIT_SUCCESS;
     } else if (help || argc <= 1) {
         ap.usage();
+        return EXIT_SUCCESS;
+    }
+
+    if (buildindex.size()) {
+        std::string err;
+        int nreused = 0;
+        if (!OSLQueryIndex::build(buildindex, filenames, err, &nreused)) {
+            std::cout << "ERROR building index \"" << buildindex << "\" ("
+                      << err << ")\n";
+            return EXIT_FAILURE;
+        }
+        OSLQueryIndex written;
+        written.open(buildindex);
+        std::cout << "Wrote index " << buildindex << ": " << written.size()
+                  << " shaders, " << nreused << " reused\n";
+        return EXIT_SUCCESS;
+    }
+    if (indexfile.size() && !shaderindex.open(indexfile)) {
+        std::cout << "ERROR opening index \"" << indexfile << "\" ("
+                  << shaderindex.geterror() << ")\n";
+        return EXIT_FAILURE;
     }
+    for (auto&& name : filenames)
+        oslinfo(name);
     return EXIT_SUCCESS;
 }
 
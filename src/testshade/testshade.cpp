@@ -3,6 +3,7 @@
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -50,6 +51,9 @@ static std::vector<TypeDesc> outputvartypes;
 static std::string dataformatname = "";
 static std::vector<std::string> entrylayers;
 static std::vector<std::string> entryoutputs;
+static std::vector<std::string> printattribs;
+static std::vector<std::string> printgroupattribs;
+static std::string statsjson_file;
 static std::vector<int> entrylayer_index;
 static std::vector<const ShaderSymbol *> entrylayer_symbols;
 static bool debug1 = false;
@@ -68,6 +72,7 @@ static bool warmup = false;
 static bool profile = false;
 static bool O0 = false, O1 = false, O2 = false;
 static int llvm_opt = 1; // LLVM optimization level
+static int tier_threshold = 0; // Executions before a tiered group is promoted
 static bool pixelcenters = false;
 static bool debugnan = false;
 static bool debug_uninit = false;
@@ -90,13 +95,17 @@ static ParamValueList reparams;
 static std::string reparam_layer;
 static ErrorHandler errhandler;
 static int iters = 1;
+static bool move_space = false;
 static std::string raytype = "camera";
 static bool raytype_opt = false;
+static bool no_derivs = false;
+static bool twin = false;
 static std::string extraoptions;
 static std::string texoptions;
 static OSL::Matrix44 Mshad;  // "shader" space to "common" space matrix
 static OSL::Matrix44 Mobj;   // "object" space to "common" space matrix
 static ShaderGroupRef shadergroup;
+static ShaderGroupRef twingroup;   // identical copy of shadergroup (--twin)
 static std::string archivegroup;
 static int exprcount = 0;
 static bool shadingsys_options_set = false;
@@ -105,6 +114,12 @@ static float uoffset = 0, voffset = 0;
 static std::vector<const char*> shader_setup_args;
 static std::string localename = OIIO::Sysutil::getenv("TESTSHADE_LOCALE");
 static OIIO::ParamValueList userdata;
+static bool interactive = false;
+static std::string aot_compile_file;
+static std::string aot_load_file;
+static bool userdata_by_index = false;
+static std::vector<UserDataBinding> userdata_bindings;
+static std::vector<char> userdata_record;
 static char* userdata_base_ptr = nullptr;
 static char* output_base_ptr = nullptr;
 
@@ -156,6 +171,7 @@ set_shadingsys_options ()
     if (const char *llvm_opt_env = getenv ("TESTSHADE_LLVM_OPT"))  // overrides llvm_opt
         llvm_opt = atoi(llvm_opt_env);
     shadingsys->attribute ("llvm_optimize", llvm_opt);
+    shadingsys->attribute ("llvm_tier_threshold", tier_threshold);
 
     shadingsys->attribute ("profile", int(profile));
     shadingsys->attribute ("lockgeom", 1);
@@ -207,9 +223,6 @@ set_shadingsys_options ()
     if (batched) {
 #if OSL_USE_BATCHED
         bool batch_size_requested = (batch_size != -1);
-        // FIXME: For now, output placement is not supported for batched
-        // shading.
-        output_placement = false;
         // Not really looping, just emulating goto behavior using break
         for(;;) {
             if (!batch_size_requested || batch_size == 16) {
@@ -571,6 +584,37 @@ stash_userdata(int argc, const char* argv[])
 
 
 
+// Resolve the group's userdata against the --userdata values once, the
+// way a renderer would for each object: pack the values the group needs
+// into one record and note where each one landed.  Anything the group
+// asks for that wasn't given on the command line is marked absent.
+static void
+setup_userdata_bindings(ShaderGroup* group)
+{
+    int nuser = 0;
+    shadingsys->getattribute(group, "num_userdata", nuser);
+    userdata_bindings.assign(nuser, UserDataBinding());
+    userdata_record.clear();
+    if (!nuser)
+        return;
+    ustring* names  = nullptr;
+    TypeDesc* types = nullptr;
+    shadingsys->getattribute(group, "userdata_names", TypeDesc::PTR, &names);
+    shadingsys->getattribute(group, "userdata_types", TypeDesc::PTR, &types);
+    for (int i = 0; i < nuser; ++i) {
+        const OIIO::ParamValue* p = userdata.find_pv(names[i], types[i]);
+        if (!p)
+            continue;
+        size_t align = types[i].basesize();
+        size_t offset = (userdata_record.size() + align - 1) / align * align;
+        userdata_record.resize(offset + types[i].size());
+        memcpy(&userdata_record[offset], p->data(), types[i].size());
+        userdata_bindings[i].offset = offset;
+    }
+}
+
+
+
 void
 print_info()
 {
@@ -617,6 +661,12 @@ getargs (int argc, const char *argv[])
                 "--debug2", &debug2, "Even more debugging info",
                 "--llvm_debug", &llvm_debug, "Turn on LLVM debugging info",
                 "--runstats", &runstats, "Print run statistics",
+                "--printattrib %L", &printattribs,
+                        "Print a ShadingSystem attribute (e.g. stat:groups_compiled) after shading",
+                "--printgroupattrib %L", &printgroupattribs,
+                        "Print an attribute of the shader group after shading",
+                "--statsjson %s", &statsjson_file,
+                        "Write getstats_json(2) to FILE after shading",
                 "--stats", &runstats, "",  // DEPRECATED 1.7
                 "--batched", &batched, "Submit batches to ShadingSystem",
                 "--vary_pdxdy", &vary_Pdxdy, "populate Dx(P) & Dy(P) with varying values (vs. uniform)",
@@ -652,11 +702,23 @@ getargs (int argc, const char *argv[])
                         "Archive the group to a given filename",
                 "--raytype %s", &raytype, "Set the raytype",
                 "--raytype_opt", &raytype_opt, "Specify ray type mask for optimization",
+                "--no-derivs", &no_derivs, "Run the derivative-free variant of the group for --raytype rays",
+                "--twin", &twin,
+                        "Also shade an identical copy of the group after it, applying --reparam edits to the copy and saving its outputs",
                 "--iters %d", &iters, "Number of iterations",
+                "--move-space", &move_space, "Move \"myspace\" between iterations",
+                "--interactive", &interactive,
+                        "Keep --reparam params editable, respecializing after each edit",
+                "--aot-compile %s", &aot_compile_file,
+                        "Compile the group ahead of time to FILE (and FILE.manifest)",
+                "--aot-load %s", &aot_load_file,
+                        "Use the group code saved by --aot-compile in FILE",
                 "-O0", &O0, "Do no runtime shader optimization",
                 "-O1", &O1, "Do a little runtime shader optimization",
                 "-O2", &O2, "Do lots of runtime shader optimization",
                 "--llvm_opt %d", &llvm_opt, "LLVM JIT optimization level",
+                "--tier-threshold %d", &tier_threshold,
+                        "JIT quickly first, recompiling groups at full optimization after this many executions",
                 "--entry %L", &entrylayers, "Add layer to the list of entry points",
                 "--entryoutput %L", &entryoutputs, "Add output symbol to the list of entry points",
                 "--center", &pixelcenters, "Shade at output pixel 'centers' rather than corners",
@@ -677,6 +739,7 @@ getargs (int argc, const char *argv[])
                 "--userdata %@ %s %s", stash_userdata, nullptr, nullptr,
                         "Add userdata (args: name value) (options: type=%s)",
                 "--userdata_isconnected", &userdata_isconnected, "Consider lockgeom=0 to be isconnected()",
+                "--userdata_by_index", &userdata_by_index, "Bind --userdata values by index rather than get_userdata",
                 "--locale %s", &localename, "Set a different locale",
                 NULL);
     if (ap.parse(argc, argv) < 0 /*|| (shadernames.empty() && groupspec.empty())*/) {
@@ -851,6 +914,35 @@ setup_shaderglobals (ShaderGlobals &sg, ShadingSystem *shadingsys,
 
 
 
+// Print the value of a ShadingSystem attribute (or, if group is not null,
+// an attribute of the group) of whichever basic type it turns out to have.
+static void
+print_attribute (ShadingSystem *shadingsys, ShaderGroup *group,
+                 string_view name)
+{
+    auto get = [&](TypeDesc type, void *val) {
+        return group ? shadingsys->getattribute (group, name, type, val)
+                     : shadingsys->getattribute (name, type, val);
+    };
+    int i;
+    long long ll;
+    float f;
+    const char* s = nullptr;
+    std::cout << name << " = ";
+    if (get (TypeDesc::INT, &i))
+        std::cout << i << "\n";
+    else if (get (TypeDesc::INT64, &ll))
+        std::cout << ll << "\n";
+    else if (get (TypeDesc::FLOAT, &f))
+        std::cout << f << "\n";
+    else if (get (TypeDesc::STRING, &s))
+        std::cout << (s ? s : "") << "\n";
+    else
+        std::cout << "(unknown)\n";
+}
+
+
+
 static void
 setup_output_images (SimpleRenderer *rend, ShadingSystem *shadingsys,
                      ShaderGroupRef &shadergroup)
@@ -880,6 +972,20 @@ setup_output_images (SimpleRenderer *rend, ShadingSystem *shadingsys,
                                &layers[0]);
     }
 
+    // Interactive edit mode: the params we'll be changing with --reparam
+    // stay editable after the group is optimized.
+    if (interactive && reparams.size() && reparam_layer.size()) {
+        std::vector<std::string> names;
+        for (auto&& pv : reparams)
+            names.push_back (reparam_layer + "." + pv.name().string());
+        std::vector<const char *> cnames;
+        for (auto&& n : names)
+            cnames.push_back (n.c_str());
+        shadingsys->attribute (shadergroup.get(), "interactive_params",
+                               TypeDesc(TypeDesc::STRING, (int)cnames.size()),
+                               &cnames[0]);
+    }
+
     // Get info about the number of layers in the shader group
     int num_layers = 0;
     shadingsys->getattribute(shadergroup.get(), "num_layers", num_layers);
@@ -984,6 +1090,44 @@ setup_output_images (SimpleRenderer *rend, ShadingSystem *shadingsys,
 #endif
     }
 
+    if (no_derivs)
+        shadingsys->attribute (shadergroup.get(), "no_derivs_raytypes",
+                               shadingsys->raytype_bit (ustring (raytype)));
+
+    // Ahead-of-time compilation: save the compiled group for a later run,
+    // or use the code that an earlier run saved.
+    if (aot_compile_file.size()) {
+        std::string object, manifest;
+        OIIO::ofstream objout, manout;
+        OIIO::Filesystem::open (objout, aot_compile_file,
+                                std::ios::out | std::ios::binary);
+        OIIO::Filesystem::open (manout, aot_compile_file + ".manifest");
+        if (! shadingsys->aot_compile (shadergroup.get(), object, manifest)
+              || ! objout || ! manout) {
+            std::cerr << "Could not compile ahead of time to " << aot_compile_file << "\n";
+            exit (EXIT_FAILURE);
+        }
+        objout << object;
+        manout << manifest;
+    }
+    if (aot_load_file.size()) {
+        // The object is binary, so it must not go through text-mode
+        // newline translation the way the manifest can.
+        std::string object, manifest;
+        OIIO::ifstream objin;
+        OIIO::Filesystem::open (objin, aot_load_file,
+                                std::ios::in | std::ios::binary);
+        if (objin) {
+            std::ostringstream contents;
+            contents << objin.rdbuf();
+            object = contents.str();
+        }
+        if (object.empty()
+              || ! OIIO::Filesystem::read_text_file (aot_load_file + ".manifest", manifest)
+              || ! shadingsys->aot_load (shadergroup.get(), object, manifest))
+            std::cerr << "Could not load ahead-of-time code from " << aot_load_file << "\n";
+    }
+
     // N.B. Maybe nobody cares about running individual layers manually,
     // and all this entry layer output nonsense can go away.
     if (entryoutputs.size()) {
@@ -1365,6 +1509,15 @@ shade_region (SimpleRenderer *rend, ShaderGroup *shadergroup,
     // within a thread.
     ShadingContext *ctx = shadingsys->get_context (thread_info);
 
+    // Named spaces may have moved since this context last shaded
+    if (move_space)
+        shadingsys->clear_matrix_cache (*ctx);
+
+    // Every point of this "object" shares the one userdata record.
+    if (userdata_by_index)
+        shadingsys->bind_userdata (*ctx, userdata_bindings.data(),
+                                   userdata_record.data());
+
     // Set up shader globals and a little test grid of points to shade.
     ShaderGlobals shaderglobals;
 
@@ -1595,6 +1748,16 @@ batched_shade_region (SimpleRenderer *rend, ShaderGroup *shadergroup, OIIO::ROI
     // within a thread.
     ShadingContext *ctx = shadingsys->get_context (thread_info);
 
+    // Every lane shares the one userdata record.
+    const UserDataBinding* lane_bindings[WidthT];
+    const void* lane_records[WidthT];
+    if (userdata_by_index) {
+        std::fill_n(lane_bindings, WidthT, userdata_bindings.data());
+        std::fill_n(lane_records, WidthT, userdata_record.data());
+        shadingsys->batched<WidthT>().bind_userdata(*ctx, lane_bindings,
+                                                    lane_records);
+    }
+
     // Set up shader globals and a little test grid of points to shade.
     BatchedShaderGlobals<WidthT> sgBatch;
     setup_uniform_shaderglobals (sgBatch, shadingsys);
@@ -1611,6 +1774,11 @@ batched_shade_region (SimpleRenderer *rend, ShaderGroup *shadergroup, OIIO::ROI
         int bx[WidthT];
         int by[WidthT];
         int batchSize = std::min(WidthT, nhits-oHitIndex);
+        // Symbol placement needs the lanes of a batch to be consecutive
+        // shade indices, so don't let a batch wrap past the end of a
+        // row unless the region spans the full image width.
+        if ((output_base_ptr || userdata_base_ptr) && rwidth != xres)
+            batchSize = std::min(batchSize, rwidth - oHitIndex%rwidth);
 
         // TODO: vectorize this loop
         for(int bi=0; bi < batchSize; ++bi) {
@@ -1626,24 +1794,36 @@ batched_shade_region (SimpleRenderer *rend, ShaderGroup *shadergroup, OIIO::ROI
             by[bi] = ry;
         }
 
+        int shadeindex = by[0] * xres + bx[0];
+
         // Actually run the shader for this point
         if (entrylayer_index.empty()) {
             // Sole entry point for whole group, default behavior
-            shadingsys->batched<WidthT>().execute(*ctx, *shadergroup, batchSize, sgBatch);
+            shadingsys->batched<WidthT>().execute(*ctx, *shadergroup, batchSize,
+                                                  shadeindex, sgBatch,
+                                                  userdata_base_ptr,
+                                                  output_base_ptr);
         } else {
             // Explicit list of entries to call in order
-            shadingsys->batched<WidthT>().execute_init (*ctx, *shadergroup, batchSize, sgBatch);
+            shadingsys->batched<WidthT>().execute_init (*ctx, *shadergroup, batchSize,
+                                                        shadeindex, sgBatch,
+                                                        userdata_base_ptr,
+                                                        output_base_ptr);
             if (entrylayer_symbols.size()) {
                 for (size_t i = 0, e = entrylayer_symbols.size(); i < e; ++i)
-                    shadingsys->batched<WidthT>().execute_layer (*ctx, batchSize, sgBatch, entrylayer_symbols[i]);
+                    shadingsys->batched<WidthT>().execute_layer (*ctx, batchSize, shadeindex, sgBatch,
+                                                                 userdata_base_ptr, output_base_ptr,
+                                                                 entrylayer_symbols[i]);
             } else {
                 for (size_t i = 0, e = entrylayer_index.size(); i < e; ++i)
-                    shadingsys->batched<WidthT>().execute_layer (*ctx, batchSize, sgBatch, entrylayer_index[i]);
+                    shadingsys->batched<WidthT>().execute_layer (*ctx, batchSize, shadeindex, sgBatch,
+                                                                 userdata_base_ptr, output_base_ptr,
+                                                                 entrylayer_index[i]);
             }
             shadingsys->execute_cleanup (*ctx);
         }
 
-        if (save)
+        if (save && (print_outputs || !output_placement))
         {
             batched_save_outputs<WidthT>(rend, shadingsys, ctx, shadergroup, batchSize, bx, by);
         }
@@ -1841,6 +2021,22 @@ test_shade (int argc, const char *argv[])
     if (archivegroup.size())
         shadingsys->archive_shadergroup (shadergroup.get(), archivegroup);
 
+    // An identical group built from the first one's serialized spec, as a
+    // scene translator might declare it for a second object. Its outputs
+    // are the ones saved. (Only the spec is copied, not the output
+    // placement set up below, so -o needs --no-output-placement.)
+    if (twin) {
+        std::string pickle;
+        shadingsys->getattribute (shadergroup.get(), "pickle", pickle);
+        twingroup = shadingsys->ShaderGroupBegin (groupname + "_twin",
+                                                  "surface", pickle);
+        if (! twingroup) {
+            std::cerr << "ERROR: Could not build the twin group.\n";
+            return EXIT_FAILURE;
+        }
+        shadingsys->ShaderGroupEnd (*twingroup);
+    }
+
     if (outputfiles.size())
         std::cout << "\n";
 
@@ -1866,6 +2062,9 @@ test_shade (int argc, const char *argv[])
     if (debug1)
         test_group_attributes (shadergroup.get());
 
+    if (userdata_by_index)
+        setup_userdata_bindings (shadergroup.get());
+
     if (num_threads < 1)
         num_threads = OIIO::Sysutil::hardware_concurrency();
 
@@ -1886,6 +2085,9 @@ test_shade (int argc, const char *argv[])
         rend->warmup();
     double warmuptime = timer.lap ();
 
+    // With --twin, the outputs saved are those of the copy.
+    ShaderGroup *savegroup = twingroup ? twingroup.get() : shadergroup.get();
+
     // Allow a settable number of iterations to "render" the whole image,
     // which is useful for time trials of things that would be too quick
     // to accurately time for a single iteration
@@ -1895,8 +2097,15 @@ test_shade (int argc, const char *argv[])
         if (use_optix) {
             rend->render (xres, yres);
         } else if (use_shade_image) {
-            // TODO: do we need a batched option/version of shade_image?
-            OSL::shade_image (*shadingsys, *shadergroup, NULL,
+#if OSL_USE_BATCHED
+            if (batched)
+                OSL::shade_image (*shadingsys, *savegroup, batch_size, NULL,
+                                  *rend->outputbuf(0), outputvarnames,
+                                  pixelcenters ? ShadePixelCenters : ShadePixelGrid,
+                                  roi, num_threads);
+            else
+#endif
+            OSL::shade_image (*shadingsys, *savegroup, NULL,
                               *rend->outputbuf(0), outputvarnames,
                               pixelcenters ? ShadePixelCenters : ShadePixelGrid,
                               roi, num_threads);
@@ -1910,13 +2119,17 @@ test_shade (int argc, const char *argv[])
                 if (batch_size == 16) {
                     OIIO::ImageBufAlgo::parallel_image (roi, num_threads,
                         [&](OIIO::ROI sub_roi)->void {
-                            batched_shade_region<16> (rend, shadergroup.get(), sub_roi, save);
+                            batched_shade_region<16> (rend, shadergroup.get(), sub_roi, save && !twingroup);
+                            if (twingroup)
+                                batched_shade_region<16> (rend, twingroup.get(), sub_roi, save);
                         });
                 } else {
                     ASSERT((batch_size == 8) && "Unsupport batch size");
                     OIIO::ImageBufAlgo::parallel_image (roi, num_threads,
                         [&](OIIO::ROI sub_roi)->void {
-                            batched_shade_region<8> (rend, shadergroup.get(), sub_roi, save);
+                            batched_shade_region<8> (rend, shadergroup.get(), sub_roi, save && !twingroup);
+                            if (twingroup)
+                                batched_shade_region<8> (rend, twingroup.get(), sub_roi, save);
                         });
                 }
             } else
@@ -1924,20 +2137,41 @@ test_shade (int argc, const char *argv[])
             {
                 OIIO::ImageBufAlgo::parallel_image (roi, num_threads,
                     [&](OIIO::ROI sub_roi)->void {
-                        shade_region (rend, shadergroup.get(), sub_roi, save);
+                        shade_region (rend, shadergroup.get(), sub_roi, save && !twingroup);
+                        if (twingroup)
+                            shade_region (rend, twingroup.get(), sub_roi, save);
                     });
             }
 #endif
         }
 
+        // A renderer would promote hot groups from a background thread
+        // while shading goes on; between iterations will do for us.
+        if (tier_threshold > 0)
+            shadingsys->recompile_hot_groups ();
+
+        // Move "myspace" along x, as a renderer's spaces might change
+        // from one frame to the next.
+        if (move_space && (iter + 1 < iters)) {
+            OSL::Matrix44 Mmyspace;
+            Mmyspace.scale (OSL::Vec3 (1.0, 2.0, 1.0));
+            Mmyspace[3][0] = float(iter + 1);
+            rend->name_transform ("myspace", Mmyspace);
+        }
+
         // If any reparam was requested, do it now
         if (reparams.size() && reparam_layer.size() && (iter + 1 < iters)) {
             for (size_t p = 0;  p < reparams.size();  ++p) {
                 const ParamValue &pv (reparams[p]);
-                shadingsys->ReParameter (*shadergroup, reparam_layer.c_str(),
+                shadingsys->ReParameter (twingroup ? *twingroup : *shadergroup,
+                                         reparam_layer.c_str(),
                                          pv.name().c_str(), pv.type(),
                                          pv.data());
             }
+            // A renderer would do this from a background thread once the
+            // user stopped dragging the slider; we just do it right away.
+            if (interactive)
+                shadingsys->respecialize (shadergroup.get());
         }
     }
     double runtime = timer.lap();
@@ -1995,11 +2229,24 @@ test_shade (int argc, const char *argv[])
         std::cout << ustring::getstats() << "\n";
     }
 
+    for (auto& name : printattribs)
+        print_attribute (shadingsys, nullptr, name);
+    for (auto& name : printgroupattribs)
+        print_attribute (shadingsys, shadergroup.get(), name);
+    if (statsjson_file.size()) {
+        OIIO::ofstream jsonout;
+        OIIO::Filesystem::open (jsonout, statsjson_file);
+        jsonout << shadingsys->getstats_json (2);
+        if (! jsonout)
+            std::cerr << "Could not write " << statsjson_file << "\n";
+    }
+
     // Give the renderer a chance to do initial cleanup while everything is still alive
     rend->clear();
 
     // We're done with the shading system now, destroy it
     shadergroup.reset ();  // Must release this before destroying shadingsys
+    twingroup.reset ();
 
     delete shadingsys;
     int retcode = EXIT_SUCCESS;
@@ -0,0 +1,12 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Compile the group ahead of time, then shade again using the saved code.
+# Both runs should print the same thing, and the stat says the second one
+# really ran the saved code rather than falling back to compiling.
+stats = " --printattrib stat:groups_aot_loaded"
+command += testshade ("-g 2 2 -param label saved --aot-compile test_aot.o" + stats + " test")
+command += testshade ("-g 2 2 -param label saved --aot-load test_aot.o" + stats + " test")
@@ -0,0 +1,9 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+command = testshade("test")
+# Same shader with Nz unlocked: no closure arg is constant any more
+command += testshade("-param:type=normal:lockgeom=0 Nz 0,0,1 test")
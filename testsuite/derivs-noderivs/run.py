@@ -0,0 +1,14 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# The same group, run normally and then as its derivative-free variant
+# (selected because the camera rays shading it are marked no_derivs).
+command += testshade("-g 2 2 test")
+command += testshade("-g 2 2 --no-derivs test")
+# Only the first group is marked, so its identical twin (which --twin
+# builds from the spec alone) must not share its code, and keeps its
+# derivatives.
+command += testshade("-g 2 2 --no-derivs --twin --printattrib stat:groups_deduplicated test")
@@ -0,0 +1,21 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+import os
+
+for f in [ "buffered.txt", "unbuffered.txt" ] :
+    if os.path.isfile(f) :
+        os.remove (f)
+
+# Each of the 16 shades writes a 10 byte line. Held back per shade and
+# written once 64 bytes are pending, that makes two writes during the
+# run, with the last two lines written at shutdown.
+command = testshade ("-t 1 -g 4 4 --options buffer_fprintf=1,fprintf_flush_bytes=64 --printattrib stat:fprintf_file_writes --param filename buffered.txt test")
+
+# By default, every fprintf goes straight to the file.
+command += testshade ("-t 1 -g 4 4 --printattrib stat:fprintf_file_writes --param filename unbuffered.txt test")
+
+outputs = [ "out.txt", "buffered.txt", "unbuffered.txt" ]
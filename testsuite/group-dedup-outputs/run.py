@@ -0,0 +1,15 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# With --twin, the outputs saved are those of the identical copy, which
+# shares the first group's code. Its output symbols must be found through
+# the group it shares, both when testshade copies them out of the context
+# (by name, or by symbol in batched mode) and through shade_image().
+# (The twin has no output placement, so neither group may have one.)
+common = "-t 1 -g 20 3 -d float --twin --no-output-placement --printattrib stat:groups_deduplicated "
+command += testshade (common + "-o Cout twin.tif test")
+command += testshade (common + "--shadeimage -o Cout twinimage.tif test")
+outputs = [ "out.txt", "twin.tif", "twinimage.tif" ]
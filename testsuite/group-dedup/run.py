@@ -0,0 +1,21 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# --twin shades a second group built from the first one's spec, right
+# after it. The twin runs the first group's code rather than compiling its
+# own, and must print the same thing.
+stats = " --printattrib stat:groups_compiled --printattrib stat:groups_deduplicated"
+command += testshade ("--twin" + stats + " test")
+# An edit to the twin's params changes its spec, so it stops sharing and
+# compiles code of its own, while the first group keeps its value.
+command += testshade ("--twin -iters 2" + stats + " --layer testlay -param:lockgeom=0 scale 5.0 test -reparam testlay scale 15.0")
+# The twin copies only the spec, not what testshade declares about the
+# first group's outputs afterwards. Global renderer outputs leave both
+# groups alike, but outputs or symlocs declared on the first group alone
+# make them differ, and each compiles its own code.
+command += testshade ("--twin --no-output-placement -o out null" + stats + " test")
+command += testshade ("--twin --no-output-placement --groupoutputs -o out null" + stats + " test")
+command += testshade ("--twin -o out null" + stats + " test")
@@ -0,0 +1,13 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Instances share their master's code and symbols until they change them.
+# The two used layers are optimized, so each copies both; the unused one
+# never does. Once the group is compiled, nothing is left shared.
+command += testshade ("--layer lonelylayer lonely --layer alayer a --layer blayer b --connect alayer f_out blayer f_in "
+                      + "--printattrib stat:inst_code_copied --printattrib stat:inst_syms_copied "
+                      + "--printattrib stat:mem_inst_code_shared_current "
+                      + "--printattrib stat:mem_inst_syms_shared_current")
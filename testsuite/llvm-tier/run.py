@@ -0,0 +1,16 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Tiered JIT: the group is first compiled with the quick passes and
+# promoted to a fully optimized clone after its first execution; every
+# iteration must print the same thing regardless of which code ran.
+# The clone is not a new group, so only the quick compile counts toward
+# groups_compiled.
+stats = " --printattrib stat:groups_compiled --printattrib stat:groups_recompiled"
+command += testshade ("--tier-threshold 1 -iters 3" + stats + " test")
+# A lockgeom=0 edit must reach the promoted group too. Each edit drops the
+# promoted clone, so the group is promoted again after every iteration.
+command += testshade ("--tier-threshold 1 -iters 3" + stats + " --layer testlay -param:lockgeom=0 scale 5.0 test -reparam testlay scale 15.0")
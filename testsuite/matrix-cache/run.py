@@ -0,0 +1,15 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# "myspace" moves between iterations; each shade must see the new matrix
+# whether the matrix cache is off, per-shade, or cleared by the renderer.
+command  = testshade("--iters 3 --move-space --options matrix_cache=0 test")
+command += testshade("--iters 3 --move-space --options matrix_cache=1 test")
+command += testshade("--iters 3 --move-space --options matrix_cache=2 test")
+# Transforms between the same constant spaces share one hoisted matrix,
+# and must give what they do when each gets its own.
+command += testshade("--printattrib stat:transforms_hoisted hoist")
+command += testshade("--options opt_hoist_transforms=0 --printattrib stat:transforms_hoisted hoist")
@@ -0,0 +1,9 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# The same buffer compiled twice by one compiler: the second time reuses
+# the earlier oso, but must still repeat the warning.
+command = oslc ("-buffer -j 1 src/test.osl src/test.osl")
@@ -0,0 +1,15 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Several shaders in one oslc run, sharing the preprocessed stdosl.h (and
+# with it the M_PI/M_E macros) and the command line defines.
+command  = oslc ("-j 3 -DSCALE=3 src/a.osl src/b.osl src/c.osl")
+command += testshade ("a")
+command += testshade ("b")
+command += testshade ("c")
+# Without the cache, and without the define
+command += oslc ("-no-stdosl-cache -j 1 src/c.osl")
+command += testshade ("c")
@@ -0,0 +1,35 @@
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+#!/usr/bin/env python 
+
+import os
+
+for f in [ "shaders.oqi", "other.oqi" ] :
+    if os.path.isfile(f) :
+        os.remove (f)
+
+if not os.path.isdir("other") :
+    os.mkdir ("other")
+
+# Build the index, rebuild it from the unchanged shader (which should reuse
+# the record), then list the shader through the index.  With -v, oslinfo
+# says when the listing came from the index rather than the .oso file.
+command = oslinfo("--build-index shaders.oqi metadata")
+command += oslinfo("--build-index shaders.oqi metadata")
+command += oslinfo("-v --index shaders.oqi metadata")
+# The index files shaders by base name, but a path must name the very
+# file the record came from: another directory's metadata.oso is read
+# from disk, while a different path to the indexed one still hits.
+command += oslc("-o other/metadata.oso metadata.osl")
+command += oslinfo("-v --param myparam1 --index shaders.oqi other/metadata")
+command += oslinfo("-v --param myparam1 --index shaders.oqi ./metadata")
+# A bare name means the file in the current directory, even when the
+# index only knows another directory's shader of that name.
+command += oslinfo("--build-index other.oqi other/metadata")
+command += oslinfo("-v --param myparam1 --index other.oqi metadata")
+# Records hold absolute paths, so the index serves other directories too.
+oslinfo_bin = os.path.join (os.path.abspath (OSL_BUILD_DIR), "bin", "oslinfo")
+command += ("(cd other && " + oslinfo_bin
+            + " -v --param myparam1 --index ../shaders.oqi ../metadata"
+            + " >> ../out.txt 2>&1) ;\n")
@@ -0,0 +1,19 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# The estimates count the worst-case alignment padding of each op; the
+# peaks count the padding that was actually needed.  No pointcloud
+# lookups, so no scratch memory.
+command = testshade ("--printgroupattrib closure_bytes_needed "
+                     + "--printgroupattrib closure_bytes_peak "
+                     + "--printgroupattrib message_bytes_needed "
+                     + "--printgroupattrib message_bytes_peak "
+                     + "--printgroupattrib scratch_bytes_peak test")
+# An interactive group's edits run in a specialized clone, but the peaks
+# are kept for the group itself: only the second iteration, run by the
+# clone, allocates both closures.
+command += testshade ("--interactive -iters 2 --printgroupattrib closure_bytes_peak "
+                      + "--layer lay -param both 0 test -reparam lay both 1")
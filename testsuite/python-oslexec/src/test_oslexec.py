@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+from __future__ import print_function
+from __future__ import absolute_import
+
+import numpy as np
+import oslexec
+
+
+def printresults(out, n) :
+    for i in range(n) :
+        print ("   ", i, " ".join("{:g}".format(c) for c in out["Cout"][i]),
+               out["index"][i])
+
+
+ss = oslexec.ShadingSystem()
+group = ss.ShaderGroupBegin("group", "surface", "shader test layer1")
+ss.ShaderGroupEnd(group)
+
+# Userdata and outputs are placed in per-point records, described by
+# NumPy dtypes so that Python can fill and read them in place.
+ss.set_userdata(group, ["scale"])
+ss.set_outputs(group, ["Cout", "index"])
+print ("userdata fields:", group.userdata_dtype.names,
+       "itemsize", group.userdata_dtype.itemsize)
+print ("output fields:", group.output_dtype.names,
+       "itemsize", group.output_dtype.itemsize)
+
+n = 4
+P = np.array([[i, 2*i, 3*i] for i in range(n)], dtype=np.float32)
+u = np.linspace(0, 1, n, dtype=np.float32)
+
+# Userdata from a dict of arrays
+out = ss.shade(group, P=P, u=u,
+               userdata={ "scale" : np.arange(1, n+1, dtype=np.float32) })
+print ("dict userdata:")
+printresults(out, n)
+print ("outputs share one buffer:", np.shares_memory(out["Cout"], out["index"]))
+
+# Userdata from a record array, used without copying
+records = np.zeros(n, dtype=group.userdata_dtype)
+records["scale"] = 0.5
+out = ss.shade(group, P=P, u=u, userdata=records, nthreads=2)
+print ("record userdata:")
+printresults(out, n)
+
+# A dict must give every userdata field
+try :
+    ss.shade(group, P=P, u=u, userdata={})
+    print ("empty userdata dict accepted")
+except ValueError as e :
+    print ("empty userdata dict rejected:", e)
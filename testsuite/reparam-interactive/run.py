@@ -0,0 +1,11 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Interactive edit mode: scale and label are reparametered between
+# iterations without being declared lockgeom=0, and each edit should be
+# visible on the very next iteration. The edits are run by a specialized
+# clone, which is not counted as a group of its own.
+command += testshade ("--interactive -iters 3 --printgroupattrib specialized --printattrib stat:groups --printattrib stat:groups_compiled --layer testlay -param scale 5.0 test -reparam testlay scale 15.0 -reparam:type=string testlay label b")
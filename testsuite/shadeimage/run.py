@@ -0,0 +1,18 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Shade through the OSL::shade_image() utility, which goes a batch at a
+# time in batched mode.  One thread keeps the printed order stable.
+command = testshade("-t 1 -g 4 2 --shadeimage -o Cout null test")
+
+# Check the pixels, too.  By default testshade places the outputs in the
+# image buffer, so the shader writes the pixels itself; without placement
+# they are copied out of the context after each shade (in batched mode,
+# out of the wide values).  A width that isn't a multiple of the batch
+# size leaves a partial batch at the end of each row.
+command += testshade("-t 1 -g 20 3 -d float --shadeimage --param verbose 0 -o Cout out.tif test")
+command += testshade("-t 1 -g 20 3 -d float --shadeimage --no-output-placement --param verbose 0 -o Cout copyout.tif test")
+outputs = [ "out.txt", "out.tif", "copyout.tif" ]
@@ -0,0 +1,16 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# A varying space name whose lanes all hold the same value should take the
+# batched uniform-lanes fast path; one whose lanes differ should not. The
+# 8 points are a single batch at either batch width. Only batched runs
+# make the checks (and only with profiling on, which counts them).
+if os.environ.get ("TESTSHADE_BATCHED", "0") != "0" :
+    command += testshade ("-t 1 -g 8 1 --options profile=1 "
+                          + "--printattrib stat:uniform_lanes_checks "
+                          + "--printattrib stat:uniform_lanes_fastpath test")
+else :
+    command += testshade ("-t 1 -g 8 1 test")
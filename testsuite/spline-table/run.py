@@ -0,0 +1,9 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Splines with constant knots (table) against the same knots as lockgeom=0
+# params (search); only disagreements are printed.
+command += testshade ("-t 1 -g 64 1 test")
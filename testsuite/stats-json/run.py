@@ -0,0 +1,10 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# getstats_json must produce strict JSON (no NaN or Infinity) that reflects
+# the run that just happened.
+command += testshade ("-g 4 4 --statsjson stats.json test")
+command += pythonbin + " src/check_stats.py >> out.txt"
@@ -0,0 +1,34 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Parse the getstats_json output strictly: Python's json module would
+# otherwise accept the non-standard NaN and Infinity tokens.
+
+from __future__ import print_function
+import json
+import math
+
+def reject_constant (name) :
+    raise ValueError ("non-standard JSON constant " + name)
+
+with open ("stats.json") as f :
+    stats = json.load (f, parse_constant=reject_constant)
+
+def number_or_null (x) :
+    return x is None or (isinstance (x, (int, float)) and not (math.isinf (x) or math.isnan (x)))
+
+counters = stats["counters"]
+print ("counters all numbers or null:",
+       all (number_or_null (c["value"]) for c in counters.values()))
+print ("interval all numbers or null:",
+       all (number_or_null (v) for v in stats["interval"]["counters"].values()))
+print ("groups =", counters["groups"]["value"])
+print ("groups_compiled =", counters["groups_compiled"]["value"])
+groups = stats["groups"]
+print ("groups listed =", len (groups))
+g = groups[0]
+print ("nlayers =", g["nlayers"], " executed:", g["executions"] > 0)
+print ("layer shaders =", [str (layer["shader"]) for layer in g["layers"]])
@@ -0,0 +1,13 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Userdata comes from the bound record, so s and Cd take the --userdata
+# values everywhere and t, which has no value, keeps its default.
+command = testshade("-g 2 2 --userdata:type=float s 0.5 --userdata:type=color Cd 0.25,0.5,0.75 --userdata_by_index test")
+# Without the bindings the renderer's get_userdata answers instead, and
+# it fills s and t in from u and v, so ignoring the bound record would
+# show up as these values.
+command += testshade("-g 2 2 --userdata:type=float s 0.5 --userdata:type=color Cd 0.25,0.5,0.75 test")